@@ -0,0 +1,171 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AllocatorCheck.cpp
+// Check of the control allocator: moments delivered against the
+// closed-form vernier law over random demands, the cost of an
+// allocation, and dispersed descents flown with each
+//
+// ==============================================================
+
+#include "MonteCarlo.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+// Sink for timed results, so the timed loop is not optimized away
+static volatile double Sink;
+
+// Moment the vessel's verniers and RCS jets deliver at the levels and directions in its actuator buffer [N m]
+static VECTOR3 delivered(Surveyor& sc)
+{
+	VECTOR3 M = _V(0, 0, 0);
+	for (int i = 0; i < 9; i++) {
+		THRUSTER_HANDLE th = i < 3 ? sc.th_vernier[i] : sc.th_rcs[i - 3];
+		VECTOR3 pos, dir;
+		sc.GetThrusterRef(th, pos);
+		sc.Actuators.getDir(&sc, th, dir);
+		M += crossp(pos, unit(dir) * (sc.Actuators.getLevel(&sc, th) * sc.GetThrusterMax0(th)));
+	}
+	return M;
+}
+
+// Shortfall below which a demand counts as met: the RCS jets are not fired below ALLOCATOR_RCS_MIN_LEVEL [N m]
+const double MOMENT_TOLERANCE = 1e-3;
+
+// Moment shortfall over a set of demands
+struct Shortfall {
+	double sumSq = 0;   // Sum of squared shortfalls [N^2 m^2]
+	double worst = 0;   // Largest shortfall [N m]
+	int met = 0;        // Demands delivered to within MOMENT_TOLERANCE
+	int count = 0;
+
+	void add(VECTOR3 const& demand, VECTOR3 const& got)
+	{
+		double e = length(got - demand);
+		sumSq += e * e;
+		worst = max(worst, e);
+		if (e <= MOMENT_TOLERANCE) met++;
+		count++;
+	}
+	double rms() const { return count ? sqrt(sumSq / count) : 0; }
+};
+
+int main(int argc, char* argv[])
+{
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	int samples = 100000, runs = 100;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--scenario" && more) scenario = argv[++i];
+		else if (arg == "--samples" && more) samples = atoi(argv[++i]);
+		else if (arg == "--runs" && more) runs = atoi(argv[++i]);
+		else {
+			printf("Usage: AllocatorCheck [--scenario FILE] [--samples N] [--runs N]\n");
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	ScenarioState init;
+	if (!loadScenario(scenario, init)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	bool ok = true;
+
+	// A vessel whose first step configures its allocator from the stub's thrusters
+	DescentConfig dc;
+	dc.options.ControlAllocation = 1;
+	HeadlessDescent d(init, VesselDispersion(), dc);
+	d.preStep();
+	Surveyor& sc = d.vessel();
+	AutoPilot allocating = sc.GetAutoPilot();
+	AutoPilotOptions closedOptions = allocating.getOptions();
+	closedOptions.ControlAllocation = 0;
+	AutoPilot closed = allocating;
+	closed.setOptions(closedOptions);
+	ok = ok && allocating.getAllocator().configured();
+
+	// Random moment demands and steady state levels, through the angular velocity loop of each law. Demands within the
+	// verniers' reach must be met exactly by the allocator; beyond it, the allocator's shortfall is the smaller.
+	{
+		std::mt19937_64 rng(1);
+		std::uniform_real_distribution<double> moment(-20, 20), level(0, 1);
+		AutoPilotParams const& p = allocating.getParams();
+		Shortfall law[2][2]; // [closed-form, allocator][within reach, beyond]
+		int worse = 0;
+		for (int n = 0; n < samples; n++) {
+			VECTOR3 M = _V(moment(rng), moment(rng), 0.1 * moment(rng));
+			VECTOR3 omega = _V(M.x / p.Kp_wx, M.y / p.Kp_wy, M.z / p.Kp_wz);
+			double l = level(rng);
+			VECTOR3 got[2];
+			AutoPilot* ap[2] = { &closed, &allocating };
+			for (int k = 0; k < 2; k++) {
+				ap[k]->angularVelocityController(&sc, _V(0, 0, 0), omega, l);
+				ap[k]->setVernierThrusters(&sc);
+				got[k] = delivered(sc);
+			}
+			// Within reach: the vernier 1 gimbal can make the roll moment at the clipped level, and the others have margin
+			double clipped = min(max(l, 0.05), 0.95);
+			bool reach = fabs(M.z) < 0.9 * clipped * sin(p.AlphaLimit) * VERNIER_THRUST * VERNIER_RAD &&
+				fabs(M.x) + fabs(M.y) < 0.5 * min(clipped, 1 - clipped) * VERNIER_THRUST * VERNIER_RAD;
+			for (int k = 0; k < 2; k++) law[k][reach ? 0 : 1].add(M, got[k]);
+			if (length(got[1] - M) > length(got[0] - M) + MOMENT_TOLERANCE) worse++;
+		}
+		printf("%-12s %-8s %8s %10s %16s %16s\n", "Law", "Demands", "Count", "Met", "RMS short [N m]", "Worst [N m]");
+		char const* names[2] = { "Closed-form", "Allocator" };
+		for (int k = 0; k < 2; k++) {
+			for (int r = 0; r < 2; r++) {
+				Shortfall const& s = law[k][r];
+				printf("%-12s %-8s %8d %9.1f%% %16.3e %16.3e\n", names[k], r ? "beyond" : "within", s.count,
+					s.count ? 100.0 * s.met / s.count : 0.0, s.rms(), s.worst);
+			}
+		}
+		printf("Allocator short of the closed-form law on %d of %d demands\n", worse, samples);
+		ok = ok && law[1][0].met == law[1][0].count && law[1][1].rms() < law[0][1].rms();
+	}
+
+	// Cost of an allocation, with nothing saturated and with verniers, gimbal and jets saturating
+	{
+		ControlAllocator const& a = allocating.getAllocator();
+		double const limit = sin(allocating.getParams().AlphaLimit);
+		VECTOR3 const demands[2] = { _V(3, -2, 0.5), _V(60, -40, 15) };
+		printf("\n%-12s %14s\n", "Demand", "Time [ns]");
+		for (int k = 0; k < 2; k++) {
+			int const N = 200000;
+			double v[3], s, rcs[ALLOCATOR_RCS], check = 0;
+			auto start = std::chrono::steady_clock::now();
+			for (int n = 0; n < N; n++) {
+				VECTOR3 M = demands[k] * (1 + 1e-6 * (n & 7));
+				a.allocate(M, 3 * VERNIER_THRUST * 0.3, 0.3 * limit, limit, v, s, rcs);
+				check += v[0] + rcs[0];
+			}
+			double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / N;
+			Sink = check;
+			printf("%-12s %14.1f\n", k ? "saturated" : "unsaturated", ns);
+		}
+	}
+
+	// Dispersed descents with each law
+	{
+		MonteCarloConfig mc;
+		mc.runs = runs;
+		mc.nominal = init;
+		printf("\n%-12s %10s %10s %14s %14s\n", "Law", "Landed", "Crashed", "Speed p50", "Vernier prop");
+		int landed[2];
+		for (int k = 0; k < 2; k++) {
+			mc.descent.options.ControlAllocation = k;
+			MonteCarlo engine(mc);
+			MonteCarloSummary s = engine.summarize(engine.run());
+			landed[k] = s.landed;
+			printf("%-12s %9.1f%% %10d %14.3f %14.3f\n", k ? "Allocator" : "Closed-form", 100.0 * s.landed / max(s.runs, 1),
+				s.crashed, s.vertSpeed.p50, s.vernierProp.mean);
+		}
+		ok = ok && landed[1] >= landed[0];
+	}
+
+	printf("\n%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
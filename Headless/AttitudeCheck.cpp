@@ -0,0 +1,167 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AttitudeCheck.cpp
+// Accuracy check of the attitude math in AttitudeMath.h and the
+// vernier controller built on it, against the inverse trigonometric
+// formulas the controller used before, on random vehicle states and
+// on the degenerate states those formulas could not handle
+//
+// ==============================================================
+
+#include "Surveyor.h"
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+// Outputs of the vernier controller
+struct VernierOutput {
+	double level[3]; // Vernier thrust levels
+	double alpha;    // Vernier 1 thrust vector angle [rad]
+};
+
+static VECTOR3 referenceOmegaD(VECTOR3 const& v, AutoPilotParams const& p)
+// The outer loop as formulated with acos and the lateral speed
+{
+	double lateral = sqrt(v.x * v.x + v.y * v.y);
+	double speed = length(v);
+	VECTOR3 lambda = _V(v.y / lateral, -v.x / lateral, 0);
+	double ang = acos(-v.z / speed);
+	if (ang < p.AngleDeadband) return _V(0, 0, 0);
+	return lambda * -min(p.Kp_ang * ang, p.RateLimit);
+}
+
+static VernierOutput referenceRateLoop(VECTOR3 const& omega_d, VECTOR3 const& omega, double thrustLevel, AutoPilotParams const& p)
+// The angular velocity loop as formulated with asin, sin and cos
+{
+	VernierOutput o;
+	VECTOR3 e = omega - omega_d;
+	if (length(e) < p.RateDeadband) {
+		o.level[0] = o.level[1] = o.level[2] = thrustLevel;
+		o.alpha = 0;
+		return o;
+	}
+	double F1 = VERNIER_THRUST * min(max(thrustLevel, 0.05), 0.95);
+	VECTOR3 M = _V(p.Kp_wx * e.x, p.Kp_wy * e.y, p.Kp_wz * e.z);
+	double alpha = min(max(asin(-(M.z / (VERNIER_RAD * F1))), -p.AlphaLimit), p.AlphaLimit);
+	double F2 = ((F1 * cos(alpha)) - (M.x / VERNIER_RAD)) - ((1 / sqrt(3)) * ((VERNIER_STA * F1 * sin(alpha)) - M.y) / VERNIER_RAD);
+	double F3 = ((F1 * cos(alpha)) - (M.x / VERNIER_RAD)) + ((1 / sqrt(3)) * ((VERNIER_STA * F1 * sin(alpha)) - M.y) / VERNIER_RAD);
+	o.level[0] = min(max(F1 / VERNIER_THRUST, 0), 1);
+	o.level[1] = min(max(F3 / VERNIER_THRUST, 0), 1);
+	o.level[2] = min(max(F2 / VERNIER_THRUST, 0), 1);
+	o.alpha = alpha;
+	return o;
+}
+
+static VernierOutput controller(Surveyor& sc, AutoPilot& ap, VECTOR3 const& v, VECTOR3 const& w, double thrustLevel)
+// Outputs of AutoPilot::vernierControl for a state
+{
+	StateFrame sf;
+	memset(&sf, 0, sizeof(sf));
+	sf.Airspeed = v;
+	sf.AngularVel = w;
+	sf.EmptyMass = Surveyor::CalcEmptyMass(sf.PropRetro);
+	sc.CompleteState(sf);
+	ap.vernierControl(&sc, sf, thrustLevel);
+
+	VernierOutput o;
+	for (int i = 0; i < 3; i++) o.level[i] = sc.Actuators.getLevel(&sc, sc.th_vernier[i]);
+	VECTOR3 dir;
+	sc.Actuators.getDir(&sc, sc.th_vernier[0], dir);
+	o.alpha = atan2(dir.x, dir.z);
+	return o;
+}
+
+static bool finite(VernierOutput const& o)
+{
+	return std::isfinite(o.level[0]) && std::isfinite(o.level[1]) && std::isfinite(o.level[2]) && std::isfinite(o.alpha);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t n = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+	double tolerance = 1e-9;
+	bool ok = true;
+
+	Surveyor sc(0, 1);
+	sc.clbkSetClassCaps(0);
+	AutoPilot ap;
+	AutoPilotParams p;
+	ap.setParams(p);
+
+	std::mt19937_64 rng(42);
+	std::normal_distribution<double> N(0.0, 1.0);
+	std::uniform_real_distribution<double> U(0.0, 1.0);
+
+	// Rotation vector from the quaternion, and from the old acos formula, against the angle from atan2, which is
+	// accurate at every angle. Angles span 1e-9 rad to a half turn.
+	double errQuat = 0, errAcos = 0;
+	for (size_t i = 0; i < n; i++) {
+		double ang = PI * pow(10.0, -9.5 * U(rng));
+		double psi = 2 * PI * U(rng);
+		double speed = pow(10.0, -2 + 6 * U(rng));
+		VECTOR3 v = _V(sin(ang) * cos(psi), sin(ang) * sin(psi), -cos(ang)) * speed;
+		double lateral = sqrt(v.x * v.x + v.y * v.y);
+		VECTOR3 lambda = _V(v.y / lateral, -v.x / lateral, 0);
+		VECTOR3 exact = lambda * atan2(lateral, -v.z);
+
+		VECTOR3 r = rotationVector(shortestArc(_V(0, 0, 1), -v));
+		VECTOR3 old = lambda * acos(-v.z / length(v));
+		errQuat = max(errQuat, length(r - exact) / length(exact));
+		errAcos = max(errAcos, length(old - exact) / length(exact));
+	}
+	printf("%-40s %12.3g\n", "rotation vector, quaternion (rel. error)", errQuat);
+	printf("%-40s %12.3g\n", "rotation vector, acos (rel. error)", errAcos);
+	if (!(errQuat <= 1e-10)) ok = false;
+
+	// Controller outputs against the old formulas, over attitude errors from inside the deadband to saturation.
+	// States where the old roll loop took asin of an argument beyond +-1 are counted separately: it returned NaN
+	// there, which the clamp turned into the negative gimbal limit whatever the sign of the roll error.
+	double errLevel = 0, errAlpha = 0;
+	size_t outOfRange = 0;
+	for (size_t i = 0; i < n; i++) {
+		double ang = pow(10.0, -3.5 + 4 * U(rng));
+		double psi = 2 * PI * U(rng);
+		double speed = 1 + 2500 * U(rng);
+		VECTOR3 v = _V(sin(ang) * cos(psi), sin(ang) * sin(psi), -cos(ang)) * speed;
+		VECTOR3 w = _V(N(rng), N(rng), N(rng)) * pow(10.0, -5 + 3 * U(rng));
+		double level = U(rng) < 0.3 ? 0.0 : U(rng);
+
+		VECTOR3 od = referenceOmegaD(v, p);
+		VECTOR3 e = w - od;
+		double F1 = VERNIER_THRUST * min(max(level, 0.05), 0.95);
+		if (fabs(p.Kp_wz * e.z / (VERNIER_RAD * F1)) > 1 && length(e) >= p.RateDeadband) {
+			outOfRange++;
+			continue;
+		}
+		VernierOutput ref = referenceRateLoop(od, w, level, p);
+		VernierOutput out = controller(sc, ap, v, w, level);
+		for (int k = 0; k < 3; k++) errLevel = max(errLevel, fabs(out.level[k] - ref.level[k]));
+		errAlpha = max(errAlpha, fabs(out.alpha - ref.alpha));
+	}
+	printf("%-40s %12.3g\n", "vernier levels (abs. error)", errLevel);
+	printf("%-40s %12.3g\n", "vernier 1 angle (abs. error, rad)", errAlpha);
+	printf("%-40s %12zu\n", "states skipped, roll asin out of range", outOfRange);
+	if (!(errLevel <= tolerance && errAlpha <= tolerance)) ok = false;
+
+	// Degenerate states: velocity along the roll axis either way, at rest, and with a lateral component that
+	// underflows when squared. The old formulas divide by zero lateral speed in all of them.
+	struct { const char* name; VECTOR3 v; } cases[] = {
+		{ "retrograde, no lateral speed", _V(0, 0, -100) },
+		{ "prograde, no lateral speed", _V(0, 0, 100) },
+		{ "at rest", _V(0, 0, 0) },
+		{ "lateral speed 1e-200 m/s", _V(1e-200, 0, -100) },
+	};
+	VECTOR3 w = _V(1e-3, -2e-3, 5e-4);
+	for (auto const& c : cases) {
+		VernierOutput out = controller(sc, ap, c.v, w, 0.5);
+		bool good = finite(out);
+		printf("%-40s %12s\n", c.name, good ? "finite" : "NOT FINITE");
+		if (!good) ok = false;
+	}
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
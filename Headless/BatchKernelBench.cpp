@@ -0,0 +1,97 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// BatchKernelBench.cpp
+// Checks the batched vernier controller against the scalar
+// AutoPilot::vernierControl on random vehicle states, and measures
+// control evaluations per second for each instruction set
+//
+// ==============================================================
+
+#include "AutoPilotBatch.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+// Random vehicle states covering the attitude deadband, the proportional range, saturation and the degenerate cases
+static void randomStates(size_t n, VernierBatch& b, uint64_t seed)
+{
+	std::mt19937_64 rng(seed);
+	std::normal_distribution<double> N(0.0, 1.0);
+	std::uniform_real_distribution<double> U(0.0, 1.0);
+	b.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		// Velocity mostly along -z, with the error angle spread over several decades
+		double ang = pow(10.0, -3.5 + 4 * U(rng));
+		double psi = 2 * PI * U(rng);
+		double speed = 1 + 2500 * U(rng);
+		VECTOR3 v = _V(sin(ang) * cos(psi), sin(ang) * sin(psi), -cos(ang)) * speed;
+		// and a few along the roll axis, or at rest
+		if (i % 1000 == 1) v = _V(0, 0, speed);
+		if (i % 1000 == 2) v = _V(0, 0, 0);
+		VECTOR3 w = _V(N(rng), N(rng), N(rng)) * pow(10.0, -5 + 3 * U(rng));
+		b.set(i, v, w, U(rng) < 0.3 ? 0.0 : U(rng));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t n = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+	int reps = argc > 2 ? atoi(argv[2]) : 20;
+	double tolerance = 1e-9;
+
+	VernierBatch states;
+	randomStates(n, states, 42);
+
+	// Scalar reference through the real autopilot and the stand-in vessel
+	Surveyor sc(0, 1);
+	sc.clbkSetClassCaps(0);
+	AutoPilot ap;
+	StateFrame sf;
+	StubVessel& s = sc.Stub();
+	std::vector<double> ref(4 * n);
+	auto t0 = std::chrono::steady_clock::now();
+	for (int r = 0; r < reps; r++) {
+		for (size_t i = 0; i < n; i++) {
+			s.rvel = _V(states.Vx[i], states.Vy[i], states.Vz[i]);
+			s.avel = _V(states.Wx[i], states.Wy[i], states.Wz[i]);
+			sc.SampleState(sf, 0, 0);
+			ap.vernierControl(&sc, sf, states.ThrustLevel[i]);
+			// Compare the commanded values, before the buffer drops changes below its tolerance
+			VECTOR3 dir;
+			sc.Actuators.getDir(&sc, sc.th_vernier[0], dir);
+			ref[4 * i] = sc.Actuators.getLevel(&sc, sc.th_vernier[0]);
+			ref[4 * i + 1] = sc.Actuators.getLevel(&sc, sc.th_vernier[1]);
+			ref[4 * i + 2] = sc.Actuators.getLevel(&sc, sc.th_vernier[2]);
+			ref[4 * i + 3] = dir.x;
+		}
+	}
+	double tRef = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	printf("%-24s %12.4g evals/s\n", "AutoPilot::vernierControl", n * reps / tRef);
+
+	AutoPilotBatch batch;
+	AutoPilotBatch::Isa best = batch.getIsa();
+	bool ok = true;
+	for (int isa = AutoPilotBatch::ISA_SCALAR; isa <= best; isa++) {
+		if (!batch.setIsa((AutoPilotBatch::Isa)isa)) continue;
+		auto t1 = std::chrono::steady_clock::now();
+		for (int r = 0; r < reps; r++) batch.vernierControl(states);
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+
+		double err = 0;
+		for (size_t i = 0; i < n; i++) {
+			err = max(err, fabs(states.Level0[i] - ref[4 * i]));
+			err = max(err, fabs(states.Level1[i] - ref[4 * i + 1]));
+			err = max(err, fabs(states.Level2[i] - ref[4 * i + 2]));
+			err = max(err, fabs(states.SinAlpha[i] - ref[4 * i + 3]));
+		}
+		ok = ok && err <= tolerance;
+		char name[32];
+		sprintf(name, "batch %s", AutoPilotBatch::isaName((AutoPilotBatch::Isa)isa));
+		printf("%-24s %12.4g evals/s   speedup %6.1fx   max error %.3g\n", name, n * reps / t, tRef / t, err);
+	}
+	if (!ok) printf("Batched results differ from the scalar path by more than %g\n", tolerance);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// CheckpointCheck.cpp
+// Check of descent checkpoints and scenario persistence: forks must
+// finish exactly as the descent they were taken from, the autopilot
+// state must survive a scenario save and load, and forking from a
+// post-coast checkpoint is timed against flying from the start
+//
+// ==============================================================
+
+#include "HeadlessDescent.h"
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+static void flyTo(HeadlessDescent& d, double t)
+// Fly a descent up to the first frame at or after t
+{
+	while (!d.finished() && d.simTime() < t) {
+		d.preStep();
+		d.advance();
+	}
+}
+
+static bool same(DescentResult const& a, DescentResult const& b)
+// Bit-identical touchdown
+{
+	return a.touchdown == b.touchdown && a.simTime == b.simTime && a.vertSpeed == b.vertSpeed &&
+		a.horizSpeed == b.horizSpeed && a.tilt == b.tilt && a.rate == b.rate && a.vernierProp == b.vernierProp &&
+		a.retroProp == b.retroProp && a.mode == b.mode && a.staging == b.staging;
+}
+
+static std::string savedState(Surveyor& sc)
+// The vessel's own scenario lines
+{
+	std::string text;
+	FILE* f = tmpfile();
+	if (!f) return text;
+	sc.clbkSaveState(f);
+	rewind(f);
+	char line[256];
+	while (fgets(line, sizeof(line), f)) text += line;
+	fclose(f);
+	return text;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	int runs = 20;
+	double branch = 380;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--scenario" && more) scenario = argv[++i];
+		else if (arg == "--runs" && more) runs = atoi(argv[++i]);
+		else if (arg == "--branch" && more) branch = atof(argv[++i]);
+		else {
+			printf("Usage: CheckpointCheck [--scenario FILE] [--runs N] [--branch T]\n");
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	ScenarioState init;
+	if (!loadScenario(scenario, init)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	bool ok = true;
+
+	// Forks taken in each mode, on the true state and on the sensor models, with dispersed engines and site
+	VesselDispersion disp;
+	disp.retroThrustScale = 1.01;
+	disp.vernierThrustScale = 0.98;
+	disp.elevation = 300;
+	double const at[] = { 5, 100, 390, 420, 600 };
+	printf("%-8s %8s  %-24s %6s  %10s %10s  %s\n", "Sensors", "Fork [s]", "Mode", "Stage", "Touchdown", "Speed", "Result");
+	for (int sensors = 0; sensors < 2; sensors++) {
+		DescentConfig dc;
+		dc.options.Sensors = sensors;
+		DescentResult whole = HeadlessDescent(init, disp, dc).run();
+		for (double t : at) {
+			DescentCheckpoint c;
+			{
+				HeadlessDescent d(init, disp, dc);
+				flyTo(d, t);
+				d.checkpoint(c);
+			}
+			DescentResult fork = HeadlessDescent(c, disp, dc).run();
+			bool match = same(whole, fork);
+			ok = ok && match;
+			printf("%-8s %8.2f  %-24s %6d  %10.3f %10.4f  %s\n", sensors ? "on" : "off", c.simTime,
+				AutoPilotModeNames[c.vessel.AutoFlight.getMode()], c.vessel.status, fork.simTime, fork.vertSpeed,
+				match ? "identical" : "DIFFERS");
+		}
+	}
+
+	// Save the scenario state mid-burn, load it into a new vessel, and save it again
+	{
+		DescentConfig dc;
+		HeadlessDescent d(init, VesselDispersion(), dc);
+		flyTo(d, 420);
+		std::string saved = savedState(d.vessel());
+		Surveyor loaded(0, 1);
+		loaded.clbkSetClassCaps(0);
+		FILE* f = tmpfile();
+		if (f) {
+			fputs(saved.c_str(), f);
+			rewind(f);
+			loaded.clbkLoadStateEx(f, 0);
+			fclose(f);
+		}
+		std::string again = savedState(loaded);
+		bool match = saved == again && loaded.GetAutoPilot().getMode() == d.vessel().GetAutoPilot().getMode() &&
+			loaded.GetStagingStatus() == d.vessel().GetStagingStatus();
+		ok = ok && match;
+		printf("\nScenario state at %.2f s:\n%s", d.simTime(), saved.c_str());
+		printf("Loaded and saved again: %s\n", match ? "identical" : "DIFFERS");
+	}
+
+	// Fork a batch from one post-coast checkpoint, against flying each run from the scenario state
+	{
+		DescentConfig dc;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < runs; i++) HeadlessDescent(init, VesselDispersion(), dc).run();
+		double whole = seconds(start);
+
+		start = std::chrono::steady_clock::now();
+		DescentCheckpoint c;
+		{
+			HeadlessDescent d(init, VesselDispersion(), dc);
+			flyTo(d, branch);
+			d.checkpoint(c);
+		}
+		double coast = seconds(start);
+		for (int i = 0; i < runs; i++) HeadlessDescent(c, VesselDispersion(), dc).run();
+		double forked = seconds(start);
+		printf("\n%d descents from the scenario state: %8.3f s\n", runs, whole);
+		printf("%d forks from %.0f s, with the coast: %8.3f s (coast %.3f s), %.2fx faster\n", runs, c.simTime, forked,
+			coast, forked > 0 ? whole / forked : 0.0);
+		printf("Checkpoint size: %zu bytes\n", sizeof(DescentCheckpoint) +
+			c.propellant.size() * sizeof(double) + c.level.size() * (sizeof(double) + sizeof(VECTOR3)));
+	}
+
+	printf("\n%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// CoastCheck.cpp
+// Check of the coast fast-forward: the analytic two-body and
+// torque-free propagation must agree with the frame by frame
+// integrator, and descents that coast must touch down as those
+// flown frame by frame, in a fraction of the frames
+//
+// ==============================================================
+
+#include "HeadlessDescent.h"
+#include "TerrainModels.h"
+#include <chrono>
+#include <cstdlib>
+#include <string>
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	int runs = 20;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--scenario" && more) scenario = argv[++i];
+		else if (arg == "--runs" && more) runs = atoi(argv[++i]);
+		else {
+			printf("Usage: CoastCheck [--scenario FILE] [--runs N]\n");
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	ScenarioState init;
+	if (!loadScenario(scenario, init)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	bool ok = true;
+
+	// Coast against 0.02 s integrator steps over 400 s, for the descent's rectilinear orbit, a low circular orbit, an
+	// eccentric orbit and a hyperbolic flyby, each with the vessel tumbling
+	{
+		struct Orbit { const char* name; VECTOR3 r, v; };
+		double const vc = sqrt(MOON_MU / 1837400);
+		Orbit const orbits[] = {
+			{ "Scenario", init.rpos, init.rvel },
+			{ "Circular", _V(1837400, 0, 0), _V(0, vc, 0) },
+			{ "Eccentric", _V(1837400, 0, 0), _V(0, 1.2 * vc, 0.3 * vc) },
+			{ "Hyperbolic", _V(1837400, 0, 0), _V(-300, 1.6 * vc, 0) }
+		};
+		double const duration = 400, dt = 0.02;
+		printf("%-12s %14s %14s %14s\n", "Orbit", "Position [m]", "Velocity [m/s]", "Attitude [rad]");
+		for (Orbit const& o : orbits) {
+			StubVessel a;
+			a.emptyMass = 1000;
+			a.pmi = _V(0.5, 0.5, 0.5);
+			a.rpos = o.r;
+			a.rvel = o.v;
+			a.rot = LunarDynamics::rotationFromArot(init.arot);
+			a.avel = _V(0.01, -0.02, 0.005);
+			StubVessel b = a;
+			LunarDynamics dynamics;
+			for (int i = 0; i < (int)(duration / dt + 0.5); i++) dynamics.step(a, dt);
+			dynamics.coast(b, duration);
+			double dr = length(a.rpos - b.rpos), dv = length(a.rvel - b.rvel);
+			double da = 0;
+			for (int i = 0; i < 9; i++) da = max(da, fabs(a.rot.data[i] - b.rot.data[i]));
+			bool match = dr < 1e-3 && dv < 1e-5 && da < 1e-9;
+			ok = ok && match;
+			printf("%-12s %14.3e %14.3e %14.3e  %s\n", o.name, dr, dv, da, match ? "agree" : "DIFFER");
+		}
+	}
+
+	// Descents flown frame by frame and coasting, over flat sites and terrain
+	{
+		SyntheticTerrain source;
+		TerrainService terrain(source);
+		printf("\n%-8s %10s %10s %10s %10s %10s %10s %10s  %s\n", "Terrain", "Frames", "Coasting", "Coast [s]",
+			"Touchdown", "Speed", "Time [s]", "Speedup", "Result");
+		for (int t = 0; t < 2; t++) {
+			DescentConfig dc;
+			if (t) dc.terrain = &terrain;
+			DescentConfig cc = dc;
+			cc.coast = true;
+			long frames[2] = { 0, 0 };
+			double coastTime = 0, time[2] = { 0, 0 };
+			bool match = true;
+			DescentResult last;
+			for (int i = 0; i < runs; i++) {
+				VesselDispersion disp;
+				disp.retroThrustScale = 1 + 0.002 * (i - runs / 2);
+				disp.vernierThrustScale = 1 - 0.001 * (i - runs / 2);
+				disp.elevation = 50.0 * i;
+				auto start = std::chrono::steady_clock::now();
+				DescentResult flown = HeadlessDescent(init, disp, dc).run();
+				time[0] += seconds(start);
+				start = std::chrono::steady_clock::now();
+				DescentResult coasted = HeadlessDescent(init, disp, cc).run();
+				time[1] += seconds(start);
+				frames[0] += flown.steps;
+				frames[1] += coasted.steps;
+				coastTime += coasted.coastTime;
+				match = match && flown.touchdown == coasted.touchdown && flown.simTime == coasted.simTime &&
+					flown.mode == coasted.mode && flown.staging == coasted.staging &&
+					fabs(flown.vertSpeed - coasted.vertSpeed) < 1e-3 && fabs(flown.vernierProp - coasted.vernierProp) < 1e-3;
+				last = coasted;
+			}
+			match = match && coastTime > 0;
+			ok = ok && match;
+			printf("%-8s %10ld %10ld %10.1f %10.3f %10.4f %10.3f %9.2fx  %s\n", t ? "on" : "off", frames[0], frames[1],
+				coastTime / runs, last.simTime, last.vertSpeed, time[1], time[1] > 0 ? time[0] / time[1] : 0.0,
+				match ? "same" : "DIFFERS");
+		}
+	}
+
+	printf("\n%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ControllerCheck.cpp
+// Check of the real-time controller thread: flies the end of the
+// nominal descent with the autopilot on its own thread, paced in
+// wall clock time, with steady frames and with frames of random
+// length, and reports its tick timing against the frame-driven
+// autopilot
+//
+// ==============================================================
+
+#include "HeadlessDescent.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+
+const double CONTROLLER_CHECK_PACE = 5;      // Simulated seconds per wall clock second of the paced descents
+const double CONTROLLER_CHECK_BRANCH = 560;  // Simulated time the paced descents start from [s]
+
+// A descent flown from the checkpoint
+struct PacedDescent {
+	DescentResult result;
+	ControllerStats stats = ControllerStats();
+	bool haveStats = false;
+	double span = 0;      // Simulated time flown to the last statistics [s]
+	long frames = 0;
+};
+
+static PacedDescent fly(DescentCheckpoint const& from, DescentConfig const& dc, double maxDt, uint64_t seed)
+// Fly the descent from the checkpoint, held to dc.pace if it is set. With maxDt, each frame's length is drawn between
+// dc.dt and maxDt, as a simulator's is under an uneven graphics load.
+{
+	PacedDescent f;
+	HeadlessDescent descent(from, VesselDispersion(), dc);
+	std::mt19937_64 rng(seed);
+	std::uniform_real_distribution<double> length(dc.dt, maxDt > dc.dt ? maxDt : dc.dt);
+	ControllerThread const* controller = descent.vessel().GetController();
+	auto start = std::chrono::steady_clock::now();
+	double t0 = descent.simTime();
+	while (!descent.finished()) {
+		if (maxDt > dc.dt) descent.setFrameLength(length(rng));
+		descent.preStep();
+		descent.advance();
+		f.frames++;
+		if (dc.pace > 0) {
+			std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>((descent.simTime() - t0) / dc.pace)));
+		}
+
+		// The statistics are published every CONTROLLER_STATS_INTERVAL; keep the last before touchdown
+		if (controller && controller->stats(f.stats)) f.haveStats = true;
+	}
+	if (f.haveStats) f.span = f.stats.SimT - t0;
+	f.result = descent.result();
+	return f;
+}
+
+static void report(PacedDescent const* f, char const* const* names, int n)
+// Print the outcome and the timing of each descent side by side
+{
+	printf("%-36s", "");
+	for (int k = 0; k < n; k++) printf(" %14s", names[k]);
+	printf("\n");
+	auto row = [&](char const* label, char const* fmt, double (*value)(PacedDescent const&)) {
+		printf("%-36s", label);
+		for (int k = 0; k < n; k++) printf(fmt, value(f[k]));
+		printf("\n");
+	};
+	row("touchdown speed (m/s)", " %14.3f", [](PacedDescent const& d) { return d.result.vertSpeed; });
+	row("vernier propellant left (kg)", " %14.3f", [](PacedDescent const& d) { return d.result.vernierProp; });
+	row("frames", " %14.0f", [](PacedDescent const& d) { return (double)d.frames; });
+	row("tick rate, wall clock (Hz)", " %14.1f", [](PacedDescent const& d) { return d.stats.Rate; });
+	row("ticks", " %14.0f", [](PacedDescent const& d) { return (double)d.stats.Ticks; });
+	row("ticks per simulated second", " %14.2f", [](PacedDescent const& d) { return d.span > 0 ? d.stats.Ticks / d.span : 0; });
+	row("overruns", " %14.0f", [](PacedDescent const& d) { return (double)d.stats.Overruns; });
+	row("releases dropped", " %14.0f", [](PacedDescent const& d) { return (double)d.stats.Skipped; });
+	row("frames taken", " %14.0f", [](PacedDescent const& d) { return (double)d.stats.Frames; });
+	row("tick lateness, mean (us)", " %14.1f", [](PacedDescent const& d) { return 1e6 * d.stats.LatenessMean; });
+	row("tick lateness, p50 (us)", " %14.1f", [](PacedDescent const& d) { return 1e6 * d.stats.LatenessP50; });
+	row("tick lateness, p99 (us)", " %14.1f", [](PacedDescent const& d) { return 1e6 * d.stats.LatenessP99; });
+	row("tick lateness, max (us)", " %14.1f", [](PacedDescent const& d) { return 1e6 * d.stats.LatenessMax; });
+	row("tick time, mean (us)", " %14.1f", [](PacedDescent const& d) { return 1e6 * d.stats.ComputeMean; });
+	row("tick time, max (us)", " %14.1f", [](PacedDescent const& d) { return 1e6 * d.stats.ComputeMax; });
+	row("frame age at tick, mean (ms)", " %14.3f", [](PacedDescent const& d) { return 1e3 * d.stats.FrameAgeMean; });
+	row("frame age at tick, max (ms)", " %14.3f", [](PacedDescent const& d) { return 1e3 * d.stats.FrameAgeMax; });
+	row("commands taken", " %14.0f", [](PacedDescent const& d) { return (double)d.stats.Applied; });
+	row("command age when taken, mean (ms)", " %14.3f", [](PacedDescent const& d) { return 1e3 * d.stats.CommandAgeMean; });
+	row("command age when taken, max (ms)", " %14.3f", [](PacedDescent const& d) { return 1e3 * d.stats.CommandAgeMax; });
+	row("pinned", " %14.0f", [](PacedDescent const& d) { return d.stats.Pinned ? 1.0 : 0.0; });
+}
+
+int main(int argc, char* argv[])
+{
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	double pace = CONTROLLER_CHECK_PACE;
+	double branch = CONTROLLER_CHECK_BRANCH;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--scenario" && more) scenario = argv[++i];
+		else if (arg == "--pace" && more) pace = atof(argv[++i]);
+		else if (arg == "--branch" && more) branch = atof(argv[++i]);
+		else {
+			printf("Usage: ControllerCheck [--scenario FILE] [--pace X] [--branch T]\n");
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	ScenarioState init;
+	if (!loadScenario(scenario, init)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+
+	// Fly the nominal descent up to the branch on the frame-driven autopilot
+	DescentCheckpoint from;
+	{
+		HeadlessDescent descent(init, VesselDispersion(), DescentConfig());
+		while (!descent.finished() && descent.simTime() < branch) {
+			descent.preStep();
+			descent.advance();
+		}
+		descent.checkpoint(from);
+	}
+
+	// The rest of it frame-driven, then on the controller thread: sleeping to each release with steady frames and
+	// with uneven ones, and with a busy-wait on a pinned core if there is a core to spare
+	DescentConfig frameDriven;
+	DescentConfig realTime;
+	realTime.options.RealTimeController = 1;
+	realTime.pace = pace;
+	DescentConfig spinning = realTime;
+	spinning.options.ControllerSpin = 2e-4;
+	spinning.options.ControllerCpu = 1;
+	bool spare = std::thread::hardware_concurrency() > 1;
+
+	PacedDescent f[4];
+	char const* names[4] = { "Frame-driven", "Steady", "Uneven", "Spin, pinned" };
+	f[0] = fly(from, frameDriven, 0, 1);
+	f[1] = fly(from, realTime, 0, 1);
+	f[2] = fly(from, realTime, 5 * realTime.dt, 2);
+	if (spare) f[3] = fly(from, spinning, 0, 1);
+	printf("Descent from %.0f s, paced at %.1f simulated seconds per second\n\n", from.simTime, pace);
+	report(f, names, spare ? 4 : 3);
+
+	// The controller lands as the frame-driven autopilot does, and ticks at its rate in simulated time with few
+	// releases dropped
+	bool ok = f[0].result.touchdown && f[0].result.vertSpeed < 5;
+	for (int k = 1; k < (spare ? 4 : 3); k++) {
+		ok = ok && f[k].result.touchdown && f[k].result.vertSpeed < 5 && f[k].haveStats &&
+			f[k].stats.Ticks >= 0.9 * realTime.params.RateLoopRate * f[k].span &&
+			f[k].stats.Skipped <= 0.1 * f[k].stats.Ticks;
+	}
+	if (spare) ok = ok && f[3].stats.Pinned;
+
+	printf("\n%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// DescentCheck.cpp
+// Check of the powered descent optimizer: flies the nominal descent
+// on its profiles and on the closed-form final descent law, times
+// its solves and the frame path calls, and compares the propellant
+// of dispersed descents flown with each
+//
+// ==============================================================
+
+#include "MonteCarlo.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+const double DESCENT_CHECK_PACE = 20; // Simulated seconds per wall clock second of the threaded descent
+
+// Solves made along one descent
+struct SolveStats {
+	std::vector<double> times; // Wall clock time of each solve [s]
+	long iterations = 0;
+	int feasible = 0;
+	double gap = 0;            // Largest relaxation gap [N]
+	double firstPropellant = 0; // Propellant of the first profile [kg]
+
+	void add(DescentProfile const& p)
+	{
+		if (times.empty()) firstPropellant = p.Propellant;
+		times.push_back(p.SolveTime);
+		iterations += p.Iterations;
+		if (p.Feasible) {
+			feasible++;
+			gap = max(gap, p.Gap);
+		}
+	}
+	double percentile(double q) const
+	{
+		if (times.empty()) return 0;
+		std::vector<double> t = times;
+		std::sort(t.begin(), t.end());
+		return t[std::min(t.size() - 1, (size_t)(q * (t.size() - 1) + 0.5))];
+	}
+};
+
+// A descent flown to touchdown, with the vernier propellant at the start of FINAL_DESCENT
+struct FlownDescent {
+	DescentResult result;
+	double finalProp = 0;  // Vernier propellant at the start of FINAL_DESCENT [kg]
+	SolveStats solves;
+};
+
+static FlownDescent fly(ScenarioState const& init, VesselDispersion const& disp, DescentConfig const& dc, double pace = 0)
+// Fly a descent, recording each new profile the autopilot can read. With pace, FINAL_DESCENT is held to that many
+// simulated seconds per wall clock second, so the optimizer thread has the time it would have in a simulator.
+{
+	FlownDescent f;
+	HeadlessDescent descent(init, disp, dc);
+	Surveyor& sc = descent.vessel();
+	bool final = false;
+	double lastT = -1, finalT = 0;
+	auto finalWall = std::chrono::steady_clock::now();
+	while (!descent.finished()) {
+		descent.preStep();
+		if (!final && sc.GetAutoPilot().getMode() == FINAL_DESCENT) {
+			final = true;
+			f.finalProp = sc.GetPropellantMass(sc.ph_vernier);
+			finalT = descent.simTime();
+			finalWall = std::chrono::steady_clock::now();
+		}
+		if (final && pace > 0) {
+			std::this_thread::sleep_until(finalWall + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>((descent.simTime() - finalT) / pace)));
+		}
+		DescentProfile p;
+		if (sc.Descents.latest(p) && p.SimT != lastT) {
+			lastT = p.SimT;
+			f.solves.add(p);
+		}
+		descent.advance();
+	}
+	f.result = descent.result();
+	return f;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	int runs = 100;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--scenario" && more) scenario = argv[++i];
+		else if (arg == "--runs" && more) runs = atoi(argv[++i]);
+		else {
+			printf("Usage: DescentCheck [--scenario FILE] [--runs N]\n");
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	ScenarioState init;
+	if (!loadScenario(scenario, init)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	bool ok = true;
+	DescentConfig closed, convex;
+	convex.options.ConvexDescent = 1;
+	convex.lockstep = true;
+
+	// The nominal descent with each law, the optimizer's solved in the frame after each request
+	{
+		FlownDescent a = fly(init, VesselDispersion(), closed);
+		FlownDescent b = fly(init, VesselDispersion(), convex);
+		printf("%-44s %12s %12s\n", "Nominal descent", "Closed-form", "Optimizer");
+		printf("%-44s %12.3f %12.3f\n", "touchdown speed (m/s)", a.result.vertSpeed, b.result.vertSpeed);
+		printf("%-44s %12.3f %12.3f\n", "vernier propellant left (kg)", a.result.vernierProp, b.result.vernierProp);
+		printf("%-44s %12.3f %12.3f\n", "final descent propellant (kg)", a.finalProp - a.result.vernierProp,
+			b.finalProp - b.result.vernierProp);
+		printf("%-44s %12s %12.3f\n", "first profile's propellant (kg)", "", b.solves.firstPropellant);
+		printf("%-44s %12s %12d\n", "profiles", "", (int)b.solves.times.size());
+		printf("%-44s %12s %12d\n", "feasible profiles", "", b.solves.feasible);
+		printf("%-44s %12s %12.1f\n", "iterations per solve, mean", "",
+			b.solves.times.empty() ? 0.0 : (double)b.solves.iterations / b.solves.times.size());
+		printf("%-44s %12s %12.3f\n", "solve time, median (ms)", "", 1e3 * b.solves.percentile(0.5));
+		printf("%-44s %12s %12.3f\n", "solve time, p95 (ms)", "", 1e3 * b.solves.percentile(0.95));
+		printf("%-44s %12s %12.3f\n", "solve time, max (ms)", "", 1e3 * b.solves.percentile(1));
+		printf("%-44s %12s %12.2e\n", "relaxation gap, max (N)", "", b.solves.gap);
+		ok = ok && b.result.touchdown && b.result.vertSpeed < 5 && b.solves.feasible > 0 &&
+			b.result.vernierProp > a.result.vernierProp && b.solves.gap < 1e-3 * VERNIER_THRUST;
+	}
+
+	// Cost of the frame path calls: a request, and a read of the latest profile
+	{
+		DescentChannel channel;
+		DescentProblem in = DescentProblem();
+		DescentProfile out = DescentProfile();
+		long const calls = 1000000;
+		auto t0 = std::chrono::steady_clock::now();
+		for (long i = 0; i < calls; i++) {
+			in.SimT = (double)i;
+			channel.submit(in);
+		}
+		double perSubmit = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / calls;
+		DescentOptimizer::serve(channel);
+		t0 = std::chrono::steady_clock::now();
+		double sink = 0;
+		for (long i = 0; i < calls; i++) {
+			channel.latest(out);
+			sink += out.SimT;
+		}
+		double perLatest = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / calls;
+		printf("\n%-44s %12.1f\n", "request, frame path (ns)", 1e9 * perSubmit);
+		printf("%-44s %12.1f\n", "read of the latest profile, frame path (ns)", 1e9 * perLatest + 0 * sink);
+	}
+
+	// The nominal descent with the optimizer thread, FINAL_DESCENT paced at DESCENT_CHECK_PACE: the autopilot flies
+	// whatever profile has arrived
+	{
+		DescentConfig async = convex;
+		async.lockstep = false;
+		FlownDescent f = fly(init, VesselDispersion(), async, DESCENT_CHECK_PACE);
+		printf("%-44s %12d\n", "profiles read with the optimizer thread", (int)f.solves.times.size());
+		printf("%-44s %12.3f\n", "touchdown speed, optimizer thread (m/s)", f.result.vertSpeed);
+		printf("%-44s %12.3f\n", "vernier propellant left, thread (kg)", f.result.vernierProp);
+		ok = ok && f.result.touchdown && f.result.vertSpeed < 5 && f.solves.feasible > 0;
+	}
+
+	// Dispersed descents with each law
+	{
+		MonteCarloConfig mc;
+		mc.runs = runs;
+		mc.nominal = init;
+		printf("\n%-12s %10s %10s %14s %14s %14s\n", "Law", "Landed", "Crashed", "Speed p50", "Prop left", "Prop left p50");
+		MonteCarloSummary s[2];
+		for (int k = 0; k < 2; k++) {
+			mc.descent = k ? convex : closed;
+			MonteCarlo engine(mc);
+			s[k] = engine.summarize(engine.run());
+			printf("%-12s %9.1f%% %10d %14.3f %14.3f %14.3f\n", k ? "Optimizer" : "Closed-form", 100.0 * s[k].landed / max(s[k].runs, 1),
+				s[k].crashed, s[k].vertSpeed.p50, s[k].vernierProp.mean, s[k].vernierProp.p50);
+		}
+		ok = ok && s[1].landed >= s[0].landed && s[1].vernierProp.mean > s[0].vernierProp.mean;
+	}
+
+	printf("\n%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// DynamicsCheck.cpp
+// Accuracy and cost of the headless integrators: along the nominal
+// descent, each frame is integrated with the fixed RK4 step and the
+// adaptive Dormand-Prince integrator at several tolerances and frame
+// lengths, against a tight-tolerance reference
+//
+// ==============================================================
+
+#include "HeadlessDescent.h"
+#include <cstdlib>
+#include <string>
+
+// Error of one integration against the reference
+struct FrameError {
+	double position = 0;   // Largest position error [m]
+	double velocity = 0;   // Largest velocity error [m/s]
+	long evaluations = 0;  // Derivative evaluations
+	long frames = 0;       // Frames integrated
+
+	void add(StubVessel const& a, StubVessel const& ref, long n)
+	{
+		position = max(position, length(a.rpos - ref.rpos));
+		velocity = max(velocity, length(a.rvel - ref.rvel));
+		evaluations += n;
+		frames++;
+	}
+};
+
+int main(int argc, char* argv[])
+{
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--scenario" && more) scenario = argv[++i];
+		else {
+			printf("Usage: DynamicsCheck [--scenario FILE]\n");
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	ScenarioState init;
+	if (!loadScenario(scenario, init)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	bool ok = true;
+
+	// Fly the nominal descent, and integrate the state and commands of every frame over each frame length, holding
+	// the commands. The reference splits each frame into REFERENCE_PARTS calls at a tight tolerance. Touchdown ends
+	// the frame early, so only frames that run their full length are compared.
+	double const lengths[] = { 0.02, 0.1, 0.5 };
+	double const tolerances[] = { 1e-6, 1e-9 };
+	double const reference = 1e-13;
+	int const REFERENCE_PARTS = 64;
+	FrameError rk4[3], dopri[3][2];
+	{
+		DescentConfig dc;
+		HeadlessDescent d(init, VesselDispersion(), dc);
+		long frame = 0;
+		while (!d.finished()) {
+			d.preStep();
+			StubVessel const s = d.vessel().Stub();
+			for (int l = 0; l < 3; l++) {
+				// Longer frames from every fifth frame only, to keep the run short
+				if (l > 0 && frame % 5 != 0) continue;
+				double dt = lengths[l], ran;
+				StubVessel ref = s;
+				LunarDynamics exact;
+				bool touchdown = false;
+				for (int p = 0; p < REFERENCE_PARTS && !touchdown; p++) touchdown = exact.integrate(ref, dt / REFERENCE_PARTS, reference, ran);
+				if (touchdown) continue;
+
+				StubVessel a = s;
+				LunarDynamics fixed;
+				fixed.step(a, dt);
+				rk4[l].add(a, ref, fixed.evaluations());
+				for (int t = 0; t < 2; t++) {
+					StubVessel b = s;
+					LunarDynamics adaptive;
+					adaptive.integrate(b, dt, tolerances[t], ran);
+					dopri[l][t].add(b, ref, adaptive.evaluations());
+				}
+			}
+			d.advance();
+			frame++;
+		}
+	}
+	printf("%-10s %-18s %14s %14s %12s\n", "Frame [s]", "Integrator", "Position [m]", "Velocity [m/s]", "Evals/frame");
+	for (int l = 0; l < 3; l++) {
+		printf("%-10.2f %-18s %14.3e %14.3e %12.2f\n", lengths[l], "RK4", rk4[l].position, rk4[l].velocity,
+			(double)rk4[l].evaluations / rk4[l].frames);
+		for (int t = 0; t < 2; t++) {
+			FrameError const& e = dopri[l][t];
+			char name[32];
+			snprintf(name, sizeof(name), "DOPRI5 tol %.0e", tolerances[t]);
+			printf("%-10.2f %-18s %14.3e %14.3e %12.2f\n", lengths[l], name, e.position, e.velocity,
+				(double)e.evaluations / e.frames);
+		}
+	}
+	// The adaptive integrator holds its error to the tolerance at every frame length
+	for (int l = 0; l < 3; l++) ok = ok && dopri[l][1].position < 1e-3 && dopri[l][1].velocity < 1e-4;
+
+	// An unpowered minute of the descent's coast, in one call, against the analytic coast
+	{
+		StubVessel a;
+		a.emptyMass = 1000;
+		a.pmi = _V(0.5, 0.5, 0.5);
+		a.rpos = init.rpos;
+		a.rvel = init.rvel;
+		a.rot = LunarDynamics::rotationFromArot(init.arot);
+		a.avel = _V(0.001, 0, -0.002);
+		StubVessel b = a;
+		LunarDynamics adaptive, analytic;
+		double ran;
+		adaptive.integrate(a, 60, 1e-9, ran);
+		analytic.coast(b, 60);
+		double dr = length(a.rpos - b.rpos);
+		bool match = dr < 1e-3;
+		ok = ok && match;
+		printf("\n60 s coast: %ld steps, %ld rejected, %ld evaluations; %.3e m from the analytic coast  %s\n",
+			adaptive.steps(), adaptive.rejected(), adaptive.evaluations(), dr, match ? "agree" : "DIFFER");
+	}
+
+	// Touchdown located on the dense output, at two tolerances and frame lengths
+	{
+		DescentConfig dc;
+		dc.tolerance = 1e-12;
+		DescentResult fine = HeadlessDescent(init, VesselDispersion(), dc).run();
+		dc.tolerance = 1e-6;
+		DescentResult coarse = HeadlessDescent(init, VesselDispersion(), dc).run();
+		dc.tolerance = 0;
+		DescentResult fixed = HeadlessDescent(init, VesselDispersion(), dc).run();
+		bool match = fine.touchdown && coarse.touchdown && fabs(fine.simTime - coarse.simTime) < 1e-6;
+		ok = ok && match;
+		printf("\nTouchdown at %.6f s (tolerance 1e-12), %.6f s (1e-6), first frame below the surface %.2f s (RK4)  %s\n",
+			fine.simTime, coarse.simTime, fixed.simTime, match ? "agree" : "DIFFER");
+	}
+
+	printf("\n%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
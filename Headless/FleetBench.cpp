@@ -0,0 +1,135 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// FleetBench.cpp
+// Scaling benchmark of the autopilot manager: flies fleets of
+// 1 to 1000 dispersed Surveyors in one simulation, with every
+// batch on the calling thread and then on the thread pool, and
+// checks that both give the same flights
+//
+// ==============================================================
+
+#include "MonteCarlo.h"
+#include "AutoPilotManager.h"
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+
+// Settings for one fleet flight
+struct FleetConfig {
+	double dt = 0.02;      // Frame length [s]
+	double warmup = 12;    // Untimed flight first, to get every autopilot past IDLE [s]
+	double seconds = 20;   // Timed flight [s]
+	unsigned threads = 0;  // Worker threads for the pool runs, 0 for all cores
+	MonteCarlo* draws = 0; // Dispersed initial states
+};
+
+// Timing and end state of one fleet flight
+struct FleetResult {
+	long frames = 0;                 // Timed frames
+	double preStepTime = 0;          // Wall time in clbkPreStep over the timed frames [s]
+	std::vector<VECTOR3> positions;  // Position of each vessel at the end
+};
+
+static FleetResult flyFleet(int vessels, unsigned threads, size_t threshold, FleetConfig const& cfg)
+// Fly a fleet in lockstep, as Orbiter would: every vessel's clbkPreStep, then the dynamics of every vessel
+{
+	AutoPilotManager& manager = AutoPilotManager::current();
+	manager.setThreads(threads);
+	manager.setParallelThreshold(threshold);
+
+	DescentConfig dc;
+	dc.dt = cfg.dt;
+	std::vector<std::unique_ptr<HeadlessDescent>> fleet;
+	for (int i = 0; i < vessels; i++) {
+		ScenarioState init;
+		VesselDispersion disp;
+		cfg.draws->draw(i, init, disp);
+		fleet.emplace_back(new HeadlessDescent(init, disp, dc, StubHandle(i)));
+	}
+	oapiSetFocusObject(StubHandle(0));
+
+	FleetResult r;
+	long warmup = lround(cfg.warmup / cfg.dt), frames = lround((cfg.warmup + cfg.seconds) / cfg.dt);
+	for (long f = 0; f < frames; f++) {
+		auto t0 = std::chrono::steady_clock::now();
+		for (auto& d : fleet) d->preStep();
+		if (f >= warmup) {
+			r.preStepTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+			r.frames++;
+		}
+		for (auto& d : fleet) d->advance();
+	}
+	for (auto& d : fleet) r.positions.push_back(d->vessel().Stub().rpos);
+	return r;
+}
+
+static void usage()
+{
+	printf("Usage: FleetBench [options]\n"
+		"  --max N           largest fleet, from the series 1, 3, 10, 30, ... (default 1000)\n"
+		"  --seconds S       timed flight per fleet (default 20)\n"
+		"  --warmup S        untimed flight before timing (default 12)\n"
+		"  --dt S            frame length in seconds (default 0.02)\n"
+		"  --threads N       worker threads for the pool runs, 0 for all cores (default 0)\n"
+		"  --scenario FILE   Orbiter scenario with the nominal state\n"
+		"                    (default Scenarios/Surveyor/SurveyorLanding.scn)\n"
+		"Exits with status 1 if a pool run flies differently from the same fleet on one thread.\n");
+}
+
+int main(int argc, char* argv[])
+{
+	FleetConfig cfg;
+	int maxVessels = 1000;
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--max" && more) maxVessels = atoi(argv[++i]);
+		else if (arg == "--seconds" && more) cfg.seconds = atof(argv[++i]);
+		else if (arg == "--warmup" && more) cfg.warmup = atof(argv[++i]);
+		else if (arg == "--dt" && more) cfg.dt = atof(argv[++i]);
+		else if (arg == "--threads" && more) cfg.threads = (unsigned)atoi(argv[++i]);
+		else if (arg == "--scenario" && more) scenario = argv[++i];
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	MonteCarloConfig mc;
+	if (!loadScenario(scenario, mc.nominal)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	MonteCarlo draws(mc);
+	cfg.draws = &draws;
+
+	unsigned threads = cfg.threads ? cfg.threads : std::max(1u, std::thread::hardware_concurrency());
+	printf("%8s %8s %8s %12s %14s %14s\n", "vessels", "batch", "threads", "ms/frame", "ns/vessel-step", "vessel-steps/s");
+	bool ok = true;
+	for (int n = 1; n <= maxVessels; n = (n % 3 == 0 ? n / 3 * 10 : n * 3)) {
+		// One thread for every batch, then the manager's own choice, which uses the pool from its threshold
+		FleetResult serial = flyFleet(n, 1, AUTOPILOT_PARALLEL_THRESHOLD, cfg);
+		FleetResult pool = flyFleet(n, threads, AUTOPILOT_PARALLEL_THRESHOLD, cfg);
+		FleetResult const* runs[2] = { &serial, &pool };
+		for (int k = 0; k < 2; k++) {
+			FleetResult const& r = *runs[k];
+			bool parallel = k == 1 && n >= (int)AUTOPILOT_PARALLEL_THRESHOLD && threads > 1;
+			double steps = (double)r.frames * n;
+			printf("%8d %8s %8u %12.4f %14.1f %14.4g\n", n, k == 0 ? "serial" : "manager", parallel ? threads : 1,
+				1e3 * r.preStepTime / r.frames, 1e9 * r.preStepTime / steps, steps / r.preStepTime);
+		}
+		for (int i = 0; i < n; i++) {
+			VECTOR3 d = serial.positions[i] - pool.positions[i];
+			if (d.x != 0 || d.y != 0 || d.z != 0) {
+				fprintf(stderr, "Fleet of %d: vessel %d flew differently on the pool\n", n, i);
+				ok = false;
+				break;
+			}
+		}
+	}
+	return ok ? 0 : 1;
+}
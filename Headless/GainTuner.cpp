@@ -0,0 +1,153 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// GainTuner.cpp
+// Parallel Latin hypercube search over the autopilot parameters
+//
+// ==============================================================
+
+#include "GainTuner.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+const TunedParameter GainTuner::Parameters[] = {
+	{ "Kp_wx", &AutoPilotParams::Kp_wx, 100, 1600, true },
+	{ "Kp_wy", &AutoPilotParams::Kp_wy, 100, 1600, true },
+	{ "Kp_wz", &AutoPilotParams::Kp_wz, 100, 1600, true },
+	{ "RateDeadband", &AutoPilotParams::RateDeadband, 1e-5, 1e-3, true },
+	{ "Kp_ang", &AutoPilotParams::Kp_ang, 0.1, 2, true },
+	{ "AngleDeadband", &AutoPilotParams::AngleDeadband, 0.002, 0.05, true },
+	{ "RateLimit", &AutoPilotParams::RateLimit, 0.005, 0.08, true },
+	{ "RetroIgnitionDelay", &AutoPilotParams::RetroIgnitionDelay, 3, 11, false },
+	{ "GuidanceAltitude", &AutoPilotParams::GuidanceAltitude, 10000, 30000, false },
+	{ "TerminalAltitude", &AutoPilotParams::TerminalAltitude, 150, 1500, true },
+	{ "ApproachSpeed", &AutoPilotParams::ApproachSpeed, 20, 100, false },
+	{ "TerminalSpeed", &AutoPilotParams::TerminalSpeed, 0.5, 3, false }
+};
+const int GainTuner::PARAMETERS = sizeof(Parameters) / sizeof(Parameters[0]);
+
+// Position of a value in its range, in [0, 1]
+static double toUnit(TunedParameter const& tp, double x)
+{
+	return tp.logScale ? log(x / tp.lower) / log(tp.upper / tp.lower) : (x - tp.lower) / (tp.upper - tp.lower);
+}
+
+static double fromUnit(TunedParameter const& tp, double u)
+{
+	return tp.logScale ? tp.lower * pow(tp.upper / tp.lower, u) : tp.lower + u * (tp.upper - tp.lower);
+}
+
+// Lower bound on an atomic double
+static void lowerTo(std::atomic<double>& a, double x)
+{
+	double cur = a.load();
+	while (x < cur && !a.compare_exchange_weak(cur, x));
+}
+
+GainTuner::GainTuner(TunerConfig const& cfg)
+	: Config(cfg), Scenarios(cfg.scenario)
+{
+}
+
+double GainTuner::descentCost(ScenarioState const& init, DescentResult const& r) const
+// Cost of one descent
+{
+	CostWeights const& w = Config.weights;
+	LandingCriteria const& c = Config.scenario.criteria;
+	if (!r.touchdown) return w.timeout;
+
+	double used = (init.prpLevel[0] * VERNIER_PROP_MASS - r.vernierProp) / VERNIER_PROP_MASS;
+	double cost = w.propellant * used + w.vertSpeed * pow(r.vertSpeed / c.vertSpeed, 2) +
+		w.horizSpeed * pow(r.horizSpeed / c.horizSpeed, 2) + w.attitude * pow(r.tilt / c.tilt, 2);
+	if (r.vertSpeed > c.vertSpeed || r.horizSpeed > c.horizSpeed || r.tilt > c.tilt) cost += w.crash;
+	return cost;
+}
+
+double GainTuner::evaluate(AutoPilotParams const& p, int firstScenario, int count, double bound, int& flown) const
+// Mean cost of a parameter set over count scenarios. Stops early, returning a partial mean, once the
+// mean is certain to exceed bound.
+{
+	DescentConfig dc = Config.scenario.descent;
+	dc.params = p;
+	double sum = 0;
+	for (flown = 0; flown < count; ) {
+		ScenarioState init;
+		VesselDispersion disp;
+		Scenarios.draw(firstScenario + flown, init, disp);
+		HeadlessDescent descent(init, disp, dc);
+		sum += descentCost(init, descent.run());
+		flown++;
+		if (sum > bound * count) break;
+	}
+	return sum / flown;
+}
+
+CandidateResult GainTuner::run(FILE* log)
+// Tune the parameters, starting from the design values
+{
+	auto start = std::chrono::steady_clock::now();
+	std::mt19937_64 rng(Config.seed);
+	std::uniform_real_distribution<double> U(0.0, 1.0);
+
+	// The design parameters are the first incumbent, so the result is never worse on the tuning scenarios
+	CandidateResult best;
+	best.cost = evaluate(best.params, 0, Config.scenarios, 1e300, best.flown);
+	if (log) fprintf(log, "Design parameters: cost %.4f over %d scenarios\n", best.cost, Config.scenarios);
+
+	WorkStealingPool pool(Config.threads);
+	double width = 1;
+	for (int round = 0; round < Config.rounds; round++, width *= Config.shrink) {
+		// Latin hypercube in the unit box of the given width about the incumbent: every parameter
+		// gets one sample in each of the N strata, with the strata shuffled independently per parameter
+		int n = Config.candidates;
+		std::vector<CandidateResult> cand(n);
+		std::vector<int> strata(n);
+		for (int k = 0; k < PARAMETERS; k++) {
+			TunedParameter const& tp = Parameters[k];
+			double centre = toUnit(tp, best.params.*tp.member);
+			double lo = min(max(centre - width / 2, 0), 1 - width);
+			for (int i = 0; i < n; i++) strata[i] = i;
+			std::shuffle(strata.begin(), strata.end(), rng);
+			for (int i = 0; i < n; i++) {
+				double u = lo + width * (strata[i] + U(rng)) / n;
+				cand[i].params.*tp.member = fromUnit(tp, u);
+			}
+		}
+		for (int i = 0; i < n; i++) {
+			// Parameters that are not tuned keep the incumbent's values
+			AutoPilotParams p = best.params;
+			for (int k = 0; k < PARAMETERS; k++) p.*Parameters[k].member = cand[i].params.*Parameters[k].member;
+
+			// Keep the design gap between retro ignition and the end of RETRO_DESCENT, so the mode never
+			// changes while the retro is still burning
+			AutoPilotParams design;
+			p.RetroEndTime = p.RetroIgnitionDelay + (design.RetroEndTime - design.RetroIgnitionDelay);
+			cand[i].params = p;
+		}
+
+		// Fly the candidates; the bound only ever tightens, so an abandoned candidate was truly worse
+		std::atomic<double> bound(best.cost);
+		std::atomic<int> abandoned(0);
+		pool.parallelFor(0, n, 1, [&](size_t i) {
+			CandidateResult& c = cand[i];
+			c.cost = evaluate(c.params, 0, Config.scenarios, bound.load(), c.flown);
+			c.abandoned = c.flown < Config.scenarios;
+			if (c.abandoned) abandoned++;
+			else lowerTo(bound, c.cost);
+		});
+
+		for (CandidateResult const& c : cand) {
+			if (!c.abandoned && c.cost < best.cost) best = c;
+		}
+		if (log) {
+			double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			fprintf(log, "Round %d: box width %.3f, %d of %d candidates abandoned early, best cost %.4f (%.1f s)\n",
+				round + 1, width, abandoned.load(), n, best.cost, t);
+		}
+	}
+	return best;
+}
@@ -0,0 +1,70 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// GainTuner.h
+// Declarations for tuning the autopilot parameters over headless descents
+//
+// ==============================================================
+
+#pragma once
+
+#include "MonteCarlo.h"
+#include <atomic>
+
+// One tuned parameter and its search range. Log-scaled ranges are sampled uniformly in the logarithm.
+struct TunedParameter {
+	const char* name;
+	double AutoPilotParams::* member;
+	double lower, upper;
+	bool logScale;
+};
+
+// Weights of the cost of one descent. A landing within the criteria costs the propellant used
+// (fraction of a full vernier load) plus the squared touchdown errors, each normalised by its limit.
+struct CostWeights {
+	double propellant = 1;     // Vernier propellant used
+	double vertSpeed = 1;      // (descent rate / limit)^2
+	double horizSpeed = 1;     // (horizontal speed / limit)^2
+	double attitude = 1;       // (tilt / limit)^2
+	double crash = 10;         // Added when touchdown is outside the landing criteria
+	double timeout = 20;       // Cost of a run that never touches down
+};
+
+// Tuner settings
+struct TunerConfig {
+	int candidates = 128;      // Parameter sets per round
+	int rounds = 4;            // Latin hypercube rounds; each one searches a smaller box about the best so far
+	double shrink = 0.5;       // Box width of each round relative to the previous one
+	int scenarios = 16;        // Dispersed descents every candidate is flown on
+	int validation = 64;       // Held-out descents for comparing the tuned and design parameters
+	uint64_t seed = 1;         // Seed for the search and the scenario draws
+	unsigned threads = 0;      // Worker threads, 0 for all cores
+	MonteCarloConfig scenario; // Nominal state, dispersions, descent settings and landing criteria
+	CostWeights weights;       // Cost function
+};
+
+// Cost of one parameter set
+struct CandidateResult {
+	AutoPilotParams params;
+	double cost = 0;           // Mean cost over the scenarios flown
+	int flown = 0;             // Scenarios flown before the candidate finished or was abandoned
+	bool abandoned = false;    // Stopped early because it could no longer beat the best candidate
+};
+
+// Gain tuner class declaration. Candidates are drawn by Latin hypercube sampling and flown in
+// parallel on the work-stealing pool, each on the same dispersed scenarios. Costs are never negative,
+// so a candidate is abandoned as soon as its partial sum shows it cannot beat the best complete candidate.
+class GainTuner {
+public:
+	GainTuner(TunerConfig const& cfg);
+	CandidateResult run(FILE* log);
+	double evaluate(AutoPilotParams const& p, int firstScenario, int count, double bound, int& flown) const;
+	double descentCost(ScenarioState const& init, DescentResult const& r) const;
+	static const TunedParameter Parameters[];
+	static const int PARAMETERS;
+private:
+	TunerConfig Config;       // Tuner settings
+	MonteCarlo Scenarios;     // Draws the dispersed scenarios
+};
@@ -0,0 +1,347 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// HeadlessDescent.cpp
+// Runs one Surveyor descent against the headless dynamics model. Each frame follows
+// Orbiter's order: clbkPreStep sees the state at SimT, then the state is advanced by SimDT.
+//
+// ==============================================================
+
+#include "HeadlessDescent.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+bool loadScenario(const char* path, ScenarioState& state)
+// Read the initial state of the first Surveyor in an Orbiter scenario file. Fields that are
+// not present keep their current values; lines Orbiter would pass to the vessel are kept in
+// vesselState. Returns false if no Surveyor was found.
+{
+	std::ifstream file(path);
+	if (!file) return false;
+
+	std::string line;
+	bool inShip = false, found = false;
+	while (std::getline(file, line)) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		std::istringstream in(line);
+		std::string key;
+		in >> key;
+		if (key == "Date") {
+			std::string mjd;
+			in >> mjd >> state.mjd;
+		}
+		else if (!inShip && !found && key.find(":Surveyor") != std::string::npos) {
+			inShip = found = true;
+		}
+		else if (inShip && key == "END") {
+			inShip = false;
+		}
+		else if (inShip && key == "RPOS") {
+			in >> state.rpos.x >> state.rpos.y >> state.rpos.z;
+		}
+		else if (inShip && key == "RVEL") {
+			in >> state.rvel.x >> state.rvel.y >> state.rvel.z;
+		}
+		else if (inShip && (key == "AROT" || key == "VROT")) {
+			VECTOR3 a;
+			in >> a.x >> a.y >> a.z;
+			(key == "AROT" ? state.arot : state.vrot) = a * RAD;
+		}
+		else if (inShip && key == "PRPLEVEL") {
+			std::string entry;
+			while (in >> entry) {
+				int idx;
+				double level;
+				if (sscanf(entry.c_str(), "%d:%lf", &idx, &level) == 2 && idx >= 0 && idx < 3) state.prpLevel[idx] = level;
+			}
+		}
+		else if (inShip) {
+			// The vessel's own state, such as the autopilot's
+			state.vesselState += line + "\n";
+		}
+	}
+	return found;
+}
+
+HeadlessDescent::HeadlessDescent(ScenarioState const& init, VesselDispersion const& disp, DescentConfig const& cfg, OBJHANDLE hVessel)
+	: Vessel(hVessel, 1), Config(cfg), SimT(0), MJD(init.mjd), Steps(0), CoastTime(0), CoastEnd(0), Touchdown(false)
+{
+	// Apply the scenario state
+	build(disp);
+	StubVessel& s = Vessel.Stub();
+	s.rpos = init.rpos;
+	s.rvel = init.rvel;
+	s.rot = LunarDynamics::rotationFromArot(init.arot);
+	s.avel = init.vrot;
+	Vessel.SetPropellantMass(Vessel.ph_vernier, init.prpLevel[0] * VERNIER_PROP_MASS);
+	Vessel.SetPropellantMass(Vessel.ph_rcs, init.prpLevel[1] * RCS_PROP_MASS);
+	Vessel.SetPropellantMass(Vessel.ph_retro, init.prpLevel[2] * RETRO_PROP_MASS);
+	updateElevation();
+
+	// Then the vessel's own saved state, which Orbiter passes to clbkLoadStateEx
+	if (!init.vesselState.empty()) {
+		FILE* f = tmpfile();
+		if (f) {
+			fputs(init.vesselState.c_str(), f);
+			rewind(f);
+			Vessel.clbkLoadStateEx(f, 0);
+			fclose(f);
+		}
+	}
+	open();
+}
+
+HeadlessDescent::HeadlessDescent(DescentCheckpoint const& from, VesselDispersion const& disp, DescentConfig const& cfg, OBJHANDLE hVessel)
+	: Vessel(hVessel, 1), Config(cfg), SimT(from.simTime), MJD(from.mjd), Steps(0), CoastTime(0), CoastEnd(from.simTime), Touchdown(false)
+{
+	// Fork a descent from a checkpoint: the vessel is built afresh with this run's dispersions, then given the
+	// checkpoint's state. Steps and thruster writes count from the fork.
+	build(disp);
+	StubVessel& s = Vessel.Stub();
+	s.rpos = from.rpos;
+	s.rvel = from.rvel;
+	s.rot = from.rot;
+	s.avel = from.avel;
+	s.emptyMass = from.emptyMass;
+	for (size_t i = 0; i < s.propellants.size() && i < from.propellant.size(); i++) s.propellants[i].mass = from.propellant[i];
+	for (size_t i = 0; i < s.thrusters.size() && i < from.level.size(); i++) {
+		s.thrusters[i].level = from.level[i];
+		s.thrusters[i].dir = from.dir[i];
+	}
+	updateElevation();
+	Vessel.RestoreSnapshot(from.vessel);
+	Vessel.SetAutoPilotParams(Config.params);
+	Vessel.SetAutoPilotOptions(Config.options);
+	Touchdown = LunarDynamics::touchdownHeight(s) <= 0;
+	open();
+}
+
+void HeadlessDescent::build(VesselDispersion const& disp)
+// Build the vessel exactly as Orbiter would, then fly it with the requested autopilot parameters and dispersions
+{
+	Vessel.clbkSetClassCaps(0);
+	Vessel.SetAutoPilotParams(Config.params);
+	Vessel.SetAutoPilotOptions(Config.options);
+	AutoPilotOptions const& o = Config.options;
+	if (o.Sensors != 0) Vessel.SetSensors(true, Config.sensorSeed);
+	Vessel.SetPredictor(o.Predictor != 0 || o.PredictedIgnition != 0);
+	Vessel.SetOptimizer(o.ConvexDescent != 0 && !Config.lockstep);
+	Vessel.SetController(o.RealTimeController != 0);
+
+	// Site elevation. Terrain replaces it; the autopilot then reads it through the cache.
+	StubVessel& s = Vessel.Stub();
+	s.bodyRadius = MOON_RADIUS;
+	s.elevation = disp.elevation;
+	if (Config.terrain) Vessel.SetTerrain(Config.terrain);
+
+	// Thrust dispersions
+	s.thrusters[StubIndex(Vessel.th_retro)].maxth *= disp.retroThrustScale;
+	for (int i = 0; i < 3; i++) s.thrusters[StubIndex(Vessel.th_vernier[i])].maxth *= disp.vernierThrustScale;
+}
+
+void HeadlessDescent::open()
+// Start the requested telemetry. It is opened here rather than in clbkPostCreation, so only requested runs write files.
+{
+	if (!Config.telemetryPath.empty()) Vessel.Telemetry.open(Config.telemetryPath.c_str(), Vessel.GetName());
+	if (!Config.busName.empty() && !Vessel.Bus.open(Config.busName.c_str())) {
+		fprintf(stderr, "Could not create the telemetry bus %s\n", Config.busName.c_str());
+	}
+}
+
+void HeadlessDescent::checkpoint(DescentCheckpoint& c) const
+// Save the descent between frames, after advance() and before the next preStep(), for forks to resume from
+{
+	StubVessel const& s = Vessel.Stub();
+	c.simTime = SimT;
+	c.mjd = MJD;
+	c.rpos = s.rpos;
+	c.rvel = s.rvel;
+	c.rot = s.rot;
+	c.avel = s.avel;
+	c.emptyMass = s.emptyMass;
+	c.propellant.resize(s.propellants.size());
+	for (size_t i = 0; i < s.propellants.size(); i++) c.propellant[i] = s.propellants[i].mass;
+	c.level.resize(s.thrusters.size());
+	c.dir.resize(s.thrusters.size());
+	for (size_t i = 0; i < s.thrusters.size(); i++) {
+		c.level[i] = s.thrusters[i].level;
+		c.dir[i] = s.thrusters[i].dir;
+	}
+	Vessel.SaveSnapshot(c.vessel);
+}
+
+DescentResult HeadlessDescent::run()
+// Fly the descent until touchdown or the time limit, held back to the requested pace
+{
+	auto start = std::chrono::steady_clock::now();
+	while (!finished()) {
+		if (Config.coast && coast() && finished()) break;
+		preStep();
+		advance();
+		if (Config.pace > 0) std::this_thread::sleep_until(start + std::chrono::duration<double>(SimT / Config.pace));
+	}
+	return result();
+}
+
+void HeadlessDescent::updateElevation()
+// Set the true terrain elevation below the vessel from the terrain source, bypassing the cache
+{
+	if (!Config.terrain) return;
+	double lng, lat, rad;
+	Vessel.GetEquPos(lng, lat, rad);
+	Vessel.Stub().elevation = Config.terrain->source().elevation(lng, lat);
+}
+
+void HeadlessDescent::preStep()
+// Orbiter's clbkPreStep for the current frame. In a fleet, call this for every vessel before advancing any of them.
+{
+	oapiSetTimeAcceleration(Config.pace > 0 ? Config.pace : 1);
+	Vessel.clbkPreStep(SimT, Config.dt, MJD);
+	if (Config.lockstep) DescentOptimizer::serve(Vessel.Descents);
+}
+
+bool HeadlessDescent::advance()
+// Advance the dynamics over the current frame. Returns true once a touchdown point reaches the surface.
+{
+	double dt = Config.dt;
+	if (Config.tolerance > 0) {
+		// The adaptive integrator stops at the moment of touchdown
+		Touchdown = Dynamics.integrate(Vessel.Stub(), Config.dt, Config.tolerance, dt);
+	}
+	else Dynamics.step(Vessel.Stub(), dt);
+	SimT += dt;
+	MJD += dt / 86400.0;
+	Steps++;
+	updateElevation();
+	Touchdown = Touchdown || LunarDynamics::touchdownHeight(Vessel.Stub()) <= 0;
+	return Touchdown;
+}
+
+bool HeadlessDescent::quiet(StubVessel const& s) const
+// True if the autopilot would hold every thruster off with the vessel in state s: in IDLE, or in HOLD_FOR_RETRO above
+// RetroAltitude with the attitude error and angular velocity inside their deadbands
+{
+	AutoPilot const& ap = Vessel.GetAutoPilot();
+	if (ap.getMode() == IDLE) return true;
+	AutoPilotParams const& p = ap.getParams();
+
+	// Radar altitude, as the autopilot sees it
+	double elevation = s.elevation;
+	if (Config.terrain) {
+		double rl = length(s.rpos);
+		elevation = Config.terrain->elevation(atan2(s.rpos.y, s.rpos.x), asin(s.rpos.z / rl));
+	}
+	if (length(s.rpos) - s.bodyRadius - elevation <= p.RetroAltitude) return false;
+
+	// Attitude error and angular velocity, as in AutoPilot::vernierControl
+	Quaternion q = shortestArc(_V(0, 0, 1), -tmul(s.rot, s.rvel));
+	double halfDeadband = sin(0.5 * min(p.AngleDeadband, PI));
+	if (lengthSq(q.x, q.y, q.z) >= halfDeadband * halfDeadband) return false;
+	return lengthSq(s.avel) < p.RateDeadband * p.RateDeadband;
+}
+
+bool HeadlessDescent::coast()
+/* Skip ahead, between frames, over the frames in which the autopilot would leave every thruster off. The vessel then
+   moves in a two-body orbit and rotates torque-free, which the dynamics propagate in one step. The coast is tested
+   every COAST_SAMPLE_INTERVAL seconds and its end bisected: in HOLD_FOR_RETRO it ends as the vessel reaches
+   RetroAltitude or leaves the attitude or rate deadband, and in IDLE two autopilot updates before the mode timer runs
+   out. It stops on a frame boundary before that, and the frames from there on are flown as usual, so the autopilot
+   makes every transition on the same update as it would without coasting. Returns true if a coast was taken. */
+{
+	StubVessel& v = Vessel.Stub();
+	AutoPilot const& ap = Vessel.GetAutoPilot();
+	AutoPilotParams const& p = ap.getParams();
+	AutoPilotOptions const& o = ap.getOptions();
+	if (o.Sensors != 0 || o.Predictor != 0 || o.PredictedIgnition != 0 || o.RealTimeController != 0) return false;
+
+	// The mode timer only advances at autopilot updates, so fly one update interval after each coast to bring it up to
+	// date. The timer then runs out no sooner than IdleTime - Timer after the current time, less an interval.
+	double interval = Config.dt;
+	if (p.RateLoopRate > 0) interval = max(interval, 1 / (p.GuidanceRate > 0 ? min(p.GuidanceRate, p.RateLoopRate) : p.RateLoopRate));
+	if (SimT < CoastEnd + interval) return false;
+	if (ap.getMode() != IDLE && ap.getMode() != HOLD_FOR_RETRO) return false;
+	for (StubThruster const& th : v.thrusters) {
+		if (th.level != 0) return false;
+	}
+	if (!quiet(v)) return false;
+
+	double limit = Config.maxSimTime;
+	if (ap.getMode() == IDLE) limit = min(limit, SimT + p.IdleTime - ap.getTimer() - 2 * interval);
+
+	// Find the end of the coast
+	StubVessel s = v;
+	double t = SimT;
+	while (t < limit) {
+		double h = min(COAST_SAMPLE_INTERVAL, limit - t);
+		StubVessel n = s;
+		Dynamics.coast(n, h);
+		if (quiet(n)) {
+			s = n;
+			t += h;
+			continue;
+		}
+		double lo = 0, hi = h;
+		while (hi - lo > COAST_EVENT_TOLERANCE) {
+			double mid = 0.5 * (lo + hi);
+			n = s;
+			Dynamics.coast(n, mid);
+			if (quiet(n)) lo = mid;
+			else hi = mid;
+		}
+		t += lo;
+		break;
+	}
+
+	// Coast whole frames, advancing the clock as the frames would
+	double const dt = Config.dt;
+	long frames = (long)floor((t - SimT) / dt);
+	if (frames * dt < COAST_MIN_TIME) return false;
+	Dynamics.coast(v, frames * dt);
+	for (long i = 0; i < frames; i++) {
+		SimT += dt;
+		MJD += dt / 86400.0;
+	}
+	CoastTime += frames * dt;
+	CoastEnd = SimT;
+	updateElevation();
+	return true;
+}
+
+bool HeadlessDescent::finished() const
+// True after touchdown or at the time limit
+{
+	return Touchdown || SimT >= Config.maxSimTime;
+}
+
+DescentResult HeadlessDescent::result()
+// Outcome of the descent so far. Closes the telemetry file and bus.
+{
+	StubVessel& s = Vessel.Stub();
+	DescentResult result;
+	result.touchdown = Touchdown;
+	result.steps = Steps;
+	result.coastTime = CoastTime;
+
+	// Touchdown state relative to the local vertical
+	VECTOR3 up = unit(s.rpos);
+	double vr = dotp(s.rvel, up);
+	VECTOR3 roll = _V(s.rot.m13, s.rot.m23, s.rot.m33);
+	result.simTime = SimT;
+	result.vertSpeed = -vr;
+	result.horizSpeed = length(s.rvel - up * vr);
+	result.tilt = acos(min(max(dotp(roll, up), -1), 1));
+	result.rate = length(s.avel);
+	result.vernierProp = Vessel.GetPropellantMass(Vessel.ph_vernier);
+	result.retroProp = Vessel.GetPropellantMass(Vessel.ph_retro);
+	result.mode = Vessel.GetAutoPilotMode();
+	result.staging = Vessel.GetStagingStatus();
+	result.thrusterWrites = s.setLevelCalls + s.setDirCalls;
+	result.thrusterReads = s.getLevelCalls;
+	Vessel.Telemetry.close();
+	Vessel.Bus.close();
+	return result;
+}
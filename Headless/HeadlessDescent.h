@@ -0,0 +1,127 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// HeadlessDescent.h
+// Declarations for running a single Surveyor descent without Orbiter
+//
+// ==============================================================
+
+#pragma once
+
+#include "Surveyor.h"
+#include "LunarDynamics.h"
+#include "TerrainService.h"
+#include <string>
+#include <vector>
+
+// Coast fast-forward (see HeadlessDescent::coast)
+const double COAST_SAMPLE_INTERVAL = 1;     // Interval at which a coast is tested for its end [s]
+const double COAST_EVENT_TOLERANCE = 1e-3;  // Width to which the end of a coast is bisected [s]
+const double COAST_MIN_TIME = 1;            // Shortest coast worth taking [s]
+
+// Initial vessel state, as read from an Orbiter scenario file
+struct ScenarioState {
+	VECTOR3 rpos = { 2737400, 0, 0 };                  // Position relative to the Moon [m]
+	VECTOR3 rvel = { -2130, 0, 0 };                    // Velocity relative to the Moon [m/s]
+	VECTOR3 arot = { -156.754 * RAD, 10.546 * RAD, -48.492 * RAD }; // Orientation [rad]
+	VECTOR3 vrot = { 0, 0, 0 };                        // Angular velocity, Orbiter convention [rad/s]
+	double prpLevel[3] = { 1, 1, 1 };                  // Propellant levels (vernier, RCS, retro)
+	double mjd = 51970.7044621982;                     // Scenario date
+	std::string vesselState;                           // The Surveyor's scenario lines, for clbkLoadStateEx
+};
+
+bool loadScenario(const char* path, ScenarioState& state);
+
+// Perturbations applied to one vessel after its class caps are set up
+struct VesselDispersion {
+	double retroThrustScale = 1;   // Scale on retro thrust
+	double vernierThrustScale = 1; // Scale on vernier thrust
+	double elevation = 0;          // Terrain elevation at the landing site [m]
+};
+
+// Settings for a single descent
+struct DescentConfig {
+	double dt = 0.02;          // Frame length [s]
+	double tolerance = 0;      // Relative error per step of the adaptive integrator, or 0 for one RK4 step per frame
+	double maxSimTime = 3000;  // Abort the run after this much simulated time [s]
+	std::string telemetryPath; // Record flight telemetry to this file, if not empty
+	AutoPilotParams params;    // Autopilot gains and thresholds, in place of Config/Surveyor/AutoPilot.cfg
+	AutoPilotOptions options;  // Autopilot feature switches, in place of Config/Surveyor/AutoPilot.cfg. Telemetry is not
+	                           // used: telemetryPath records instead.
+	TerrainService* terrain = 0; // Terrain under the vessel and its radar altitude, or null for the flat dispersed elevation
+	uint64_t sensorSeed = 1;   // Seed of the radar noise and initial navigation error, with options.Sensors
+	bool lockstep = false;     // With options.ConvexDescent, solve each descent optimizer request at the end of the frame
+	                           // that makes it, instead of on the optimizer thread, so the descent repeats exactly
+	std::string busName;       // Publish to the live telemetry bus under this name, if not empty
+	double pace = 0;           // Simulated seconds per wall clock second, or 0 to run as fast as possible. It is the time
+	                           // acceleration the real-time controller thread of options.RealTimeController runs at.
+	bool coast = false;        // Skip the frames in which the autopilot holds every thruster off (not with sensors, the
+	                           // predictor or the real-time controller). Telemetry and the bus have no rows for the
+	                           // skipped frames.
+};
+
+// State of a descent between two frames, from which any number of descents can be forked. It holds only what changes
+// in flight: forks build their vessel afresh, then apply their own dispersions and settings. Sensors, the sensor seed
+// and the navigation filter are the checkpoint's.
+struct DescentCheckpoint {
+	double simTime = 0;             // Simulation time [s]
+	double mjd = 0;                 // Simulation date
+	VECTOR3 rpos, rvel, avel;       // Kinematic state (see StubVessel)
+	MATRIX3 rot;
+	double emptyMass = 0;           // Empty mass [kg]
+	std::vector<double> propellant; // Propellant masses [kg]
+	std::vector<double> level;      // Thruster levels
+	std::vector<VECTOR3> dir;       // Thruster directions
+	SurveyorSnapshot vessel;        // Autopilot, navigation and staging state
+};
+
+// Outcome of a single descent
+struct DescentResult {
+	bool touchdown = false;     // True if a touchdown point reached the surface before the time limit
+	double simTime = 0;         // Simulated time at the end of the run [s]
+	double vertSpeed = 0;       // Descent rate at touchdown [m/s]
+	double horizSpeed = 0;      // Horizontal speed at touchdown [m/s]
+	double tilt = 0;            // Angle between roll axis and local vertical at touchdown [rad]
+	double rate = 0;            // Angular rate magnitude at touchdown [rad/s]
+	double vernierProp = 0;     // Vernier propellant remaining [kg]
+	double retroProp = 0;       // Retro propellant remaining [kg]
+	AutoPilotStatus mode = IDLE; // Autopilot mode at the end of the run
+	int staging = 0;            // Staging status at the end of the run
+	long steps = 0;             // Number of frames simulated
+	double coastTime = 0;       // Simulated time skipped by coasting [s]
+	long thrusterWrites = 0;    // SetThrusterLevel and SetThrusterDir calls made by the module
+	long thrusterReads = 0;     // GetThrusterLevel and GetThrusterGroupLevel calls made by the module
+};
+
+// Headless descent class declaration
+class HeadlessDescent {
+public:
+	HeadlessDescent(ScenarioState const& init, VesselDispersion const& disp, DescentConfig const& cfg, OBJHANDLE hVessel = 0);
+	HeadlessDescent(DescentCheckpoint const& from, VesselDispersion const& disp, DescentConfig const& cfg, OBJHANDLE hVessel = 0);
+	DescentResult run();
+	void preStep();
+	bool advance();
+	bool finished() const;
+	DescentResult result();
+	void checkpoint(DescentCheckpoint& c) const;
+	double simTime() const { return SimT; }
+	void setFrameLength(double dt) { Config.dt = dt; }
+	Surveyor& vessel() { return Vessel; }
+private:
+	void build(VesselDispersion const& disp);
+	void open();
+	void updateElevation();
+	bool coast();
+	bool quiet(StubVessel const& s) const;
+	Surveyor Vessel;      // Vessel under test, running the flight autopilot
+	LunarDynamics Dynamics; // Physics stand-in for Orbiter
+	DescentConfig Config; // Run settings
+	double SimT;          // Simulation time [s]
+	double MJD;           // Simulation date
+	long Steps;           // Frames simulated
+	double CoastTime;     // Simulated time skipped by coasting [s]
+	double CoastEnd;      // Time the last coast ended, or the descent started [s]
+	bool Touchdown;       // A touchdown point has reached the surface
+};
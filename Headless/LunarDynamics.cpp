@@ -0,0 +1,407 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// LunarDynamics.cpp
+// Implementation of the headless 6-DOF lunar dynamics model
+//
+// ==============================================================
+
+#include "LunarDynamics.h"
+
+// Dormand-Prince 5(4) pair: nodes, stage coefficients, error weights (fifth less fourth order solution) and the
+// weights of the fourth order dense output, as given by Hairer, Norsett and Wanner
+static const double DP_C[7] = { 0, 1.0 / 5, 3.0 / 10, 4.0 / 5, 8.0 / 9, 1, 1 };
+static const double DP_A[7][6] = {
+	{ 0 },
+	{ 1.0 / 5 },
+	{ 3.0 / 40, 9.0 / 40 },
+	{ 44.0 / 45, -56.0 / 15, 32.0 / 9 },
+	{ 19372.0 / 6561, -25360.0 / 2187, 64448.0 / 6561, -212.0 / 729 },
+	{ 9017.0 / 3168, -355.0 / 33, 46732.0 / 5247, 49.0 / 176, -5103.0 / 18656 },
+	{ 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84 }
+};
+static const double DP_E[7] = { 71.0 / 57600, 0, -71.0 / 16695, 71.0 / 1920, -17253.0 / 339200, 22.0 / 525, -1.0 / 40 };
+static const double DP_D[7] = { -12715105075.0 / 11282082432, 0, 87487479700.0 / 32700410799, -10690763975.0 / 1880347072,
+	701980252875.0 / 199316789632, -1453857185.0 / 822651844, 69997945.0 / 29380423 };
+
+LunarDynamics::LunarDynamics(double mu)
+	: Mu(mu), Evaluations(0), Steps(0), Rejected(0)
+{
+}
+
+void LunarDynamics::thrustForces(StubVessel& v, double const dt, VECTOR3& F, VECTOR3& M, double& dm)
+// Sum thrust force and moment in the vessel frame for the current thruster levels, and draw the
+// propellant burned over dt. A thruster whose resource runs dry only delivers the impulse the
+// remaining propellant can provide.
+{
+	F = _V(0, 0, 0);
+	M = _V(0, 0, 0);
+	dm = 0;
+
+	// Propellant demand over dt for each resource
+	double demand[8] = { 0 };
+	for (StubThruster const& th : v.thrusters) {
+		if (th.level > 0 && th.prop >= 0 && th.isp > 0) demand[th.prop] += th.level * th.maxth / th.isp * dt;
+	}
+
+	// Fraction of demand each resource can satisfy
+	double supply[8];
+	for (size_t i = 0; i < v.propellants.size(); i++) {
+		supply[i] = demand[i] > 0 ? min(v.propellants[i].mass / demand[i], 1) : 1;
+		double burned = demand[i] * supply[i];
+		v.propellants[i].mass = max(v.propellants[i].mass - burned, 0);
+		dm += burned;
+	}
+
+	for (StubThruster const& th : v.thrusters) {
+		if (th.level <= 0) continue;
+		double f = th.level * th.maxth * (th.prop >= 0 ? supply[th.prop] : 1);
+		VECTOR3 Fi = th.dir * f;
+		F += Fi;
+		M += crossp(th.pos, Fi);
+	}
+}
+
+void LunarDynamics::step(StubVessel& v, double const dt)
+// Advance the vessel state by dt with the thruster commands held constant over the step
+{
+	// Mass at the start of the step, and thrust over the step
+	double m0 = v.emptyMass;
+	for (StubPropellant const& p : v.propellants) m0 += p.mass;
+	VECTOR3 F, M;
+	double dm;
+	thrustForces(v, dt, F, M, dm);
+	double m = m0 - 0.5 * dm; // Mid-step mass
+
+	// Translational motion: RK4 on position and velocity under point-mass gravity plus thrust,
+	// with thrust fixed in the inertial frame over the step
+	VECTOR3 aT = mul(v.rot, F) / m;
+	auto accel = [&](VECTOR3 const& r) {
+		double rl = length(r);
+		return r * (-Mu / (rl * rl * rl)) + aT;
+	};
+	VECTOR3 r = v.rpos, u = v.rvel;
+	VECTOR3 k1r = u, k1v = accel(r);
+	VECTOR3 k2r = u + k1v * (0.5 * dt), k2v = accel(r + k1r * (0.5 * dt));
+	VECTOR3 k3r = u + k2v * (0.5 * dt), k3v = accel(r + k2r * (0.5 * dt));
+	VECTOR3 k4r = u + k3v * dt, k4v = accel(r + k3r * dt);
+	v.rpos = r + (k1r + k2r * 2 + k3r * 2 + k4r) * (dt / 6);
+	v.rvel = u + (k1v + k2v * 2 + k3v * 2 + k4v) * (dt / 6);
+	Evaluations += 4;
+
+	rotate(v, M, m, dt);
+}
+
+bool LunarDynamics::integrate(StubVessel& v, double const dt, double const tolerance, double& advanced)
+/* Advance the vessel by dt with the thruster commands held constant, by the Dormand-Prince 5(4) pair with step size
+   control, holding each step's error estimate to tolerance relative to the size of each state component, or absolute
+   below 1. Unlike step(), the thrust turns with the vessel and the mass falls continuously. The frame is split where a
+   propellant resource runs dry, and integration stops where a touchdown point reaches the surface, located on the
+   dense output. Returns true at touchdown, with advanced set to its time; otherwise advanced is dt. */
+{
+	double t = 0;
+	double h = dt; // Step length to try
+	for (;;) {
+		// Thrust, moment and propellant flow of the thrusters that still have propellant
+		VECTOR3 F = _V(0, 0, 0), M = _V(0, 0, 0);
+		double rate[8] = { 0 };
+		for (StubThruster const& th : v.thrusters) {
+			if (th.level <= 0 || (th.prop >= 0 && !(v.propellants[th.prop].mass > 0))) continue;
+			VECTOR3 Fi = th.dir * (th.level * th.maxth);
+			F += Fi;
+			M += crossp(th.pos, Fi);
+			if (th.prop >= 0 && th.isp > 0) rate[th.prop] += th.level * th.maxth / th.isp;
+		}
+
+		// Run to the end of the frame, or until the first resource runs dry
+		double span = dt - t, mdot = 0;
+		int dry = -1;
+		for (size_t i = 0; i < v.propellants.size(); i++) {
+			mdot += rate[i];
+			if (rate[i] > 0 && v.propellants[i].mass < rate[i] * span) {
+				span = v.propellants[i].mass / rate[i];
+				dry = (int)i;
+			}
+		}
+		double ran;
+		bool touchdown = segment(v, F, M, mdot, span, tolerance, h, ran);
+		for (size_t i = 0; i < v.propellants.size(); i++) {
+			v.propellants[i].mass = max(v.propellants[i].mass - rate[i] * ran, 0);
+		}
+		t += ran;
+		if (touchdown || dry < 0) {
+			advanced = touchdown ? t : dt;
+			return touchdown;
+		}
+		v.propellants[dry].mass = 0;
+	}
+}
+
+bool LunarDynamics::segment(StubVessel& v, VECTOR3 const& F, VECTOR3 const& M, double const mdot, double const span,
+	double const tolerance, double& h, double& advanced)
+// Integrate the kinematic state over span under a constant thrust F and moment M in the vessel frame and a constant
+// mass flow mdot, starting with steps of h and leaving h at the length to try next. Returns true if a touchdown point
+// reached the surface, with advanced set to the time of touchdown; otherwise advanced is span.
+{
+	// State: position, velocity, rotation matrix by rows, angular velocity by the right-hand rule and mass
+	double y[DYNAMICS_STATE];
+	double m0 = v.emptyMass;
+	for (StubPropellant const& p : v.propellants) m0 += p.mass;
+	for (int i = 0; i < 3; i++) {
+		y[i] = v.rpos.data[i];
+		y[3 + i] = v.rvel.data[i];
+		y[15 + i] = -v.avel.data[i];
+	}
+	for (int i = 0; i < 9; i++) y[6 + i] = v.rot.data[i];
+	y[18] = m0;
+
+	// Point-mass gravity plus thrust, R' = R [w]x, Euler's equations with the inertia scaled by mass, and mass flow
+	auto f = [&](double const* s, double* ds) {
+		VECTOR3 r = _V(s[0], s[1], s[2]), w = _V(s[15], s[16], s[17]);
+		MATRIX3 R;
+		for (int i = 0; i < 9; i++) R.data[i] = s[6 + i];
+		double rl = length(r);
+		VECTOR3 a = r * (-Mu / (rl * rl * rl)) + mul(R, F) / s[18];
+		for (int i = 0; i < 3; i++) {
+			VECTOR3 row = crossp(_V(s[6 + 3 * i], s[7 + 3 * i], s[8 + 3 * i]), w);
+			ds[i] = s[3 + i];
+			ds[3 + i] = a.data[i];
+			ds[6 + 3 * i] = row.x;
+			ds[7 + 3 * i] = row.y;
+			ds[8 + 3 * i] = row.z;
+		}
+		VECTOR3 I = v.pmi * s[18];
+		VECTOR3 t = M - crossp(w, _V(I.x * w.x, I.y * w.y, I.z * w.z));
+		ds[15] = t.x / I.x;
+		ds[16] = t.y / I.y;
+		ds[17] = t.z / I.z;
+		ds[18] = -mdot;
+		Evaluations++;
+	};
+
+	// Height of the lowest touchdown point above the terrain, as touchdownHeight()
+	auto height = [&](double const* s) {
+		VECTOR3 r = _V(s[0], s[1], s[2]);
+		double hmin = length(r) - v.bodyRadius - v.elevation;
+		for (VECTOR3 const& p : v.touchdown) {
+			VECTOR3 q = _V(s[6] * p.x + s[7] * p.y + s[8] * p.z, s[9] * p.x + s[10] * p.y + s[11] * p.z,
+				s[12] * p.x + s[13] * p.y + s[14] * p.z);
+			hmin = min(hmin, length(r + q) - v.bodyRadius - v.elevation);
+		}
+		return hmin;
+	};
+
+	double k[7][DYNAMICS_STATE], y1[DYNAMICS_STATE], ys[DYNAMICS_STATE], ye[DYNAMICS_STATE];
+	f(y, k[0]);
+	double t = 0;
+	bool touchdown = false;
+	advanced = span;
+	while (t < span) {
+		bool last = h >= span - t;
+		double hs = last ? span - t : h;
+
+		// Stages; the last is evaluated at the fifth order solution, and is the first stage of the next step
+		for (int s = 1; s < 7; s++) {
+			for (int i = 0; i < DYNAMICS_STATE; i++) {
+				double sum = 0;
+				for (int j = 0; j < s; j++) sum += DP_A[s][j] * k[j][i];
+				ys[i] = y[i] + hs * sum;
+			}
+			f(ys, k[s]);
+		}
+		for (int i = 0; i < DYNAMICS_STATE; i++) y1[i] = ys[i];
+
+		// RMS error estimate over the components, each against tolerance times its size or 1
+		double err = 0;
+		for (int i = 0; i < DYNAMICS_STATE; i++) {
+			double e = 0;
+			for (int j = 0; j < 7; j++) e += DP_E[j] * k[j][i];
+			double scale = tolerance * max(max(fabs(y[i]), fabs(y1[i])), 1);
+			err += (hs * e / scale) * (hs * e / scale);
+		}
+		err = sqrt(err / DYNAMICS_STATE);
+		double factor = err > 0 ? min(max(0.9 * pow(err, -0.2), 0.2), 5) : 5;
+		if (err > 1 && hs > DYNAMICS_MIN_STEP) {
+			Rejected++;
+			h = hs * min(factor, 1);
+			continue;
+		}
+		Steps++;
+		h = last ? max(h, hs * factor) : hs * factor;
+
+		if (height(y1) <= 0) {
+			// Touchdown within the step: bisect on the dense output for the first point at or below the surface
+			double lo = 0, hi = 1;
+			for (int n = 0; n < DYNAMICS_EVENT_ITERATIONS; n++) {
+				double th = 0.5 * (lo + hi);
+				for (int i = 0; i < DYNAMICS_STATE; i++) {
+					double diff = y1[i] - y[i], b = hs * k[0][i] - diff, d = 0;
+					for (int j = 0; j < 7; j++) d += DP_D[j] * k[j][i];
+					ys[i] = y[i] + th * (diff + (1 - th) * (b + th * (diff - hs * k[6][i] - b + (1 - th) * hs * d)));
+				}
+				if (height(ys) <= 0) {
+					hi = th;
+					for (int i = 0; i < DYNAMICS_STATE; i++) ye[i] = ys[i];
+				}
+				else lo = th;
+			}
+			if (hi == 1) {
+				for (int i = 0; i < DYNAMICS_STATE; i++) ye[i] = y1[i];
+			}
+			advanced = t + hi * hs;
+			for (int i = 0; i < DYNAMICS_STATE; i++) y[i] = ye[i];
+			touchdown = true;
+			break;
+		}
+		for (int i = 0; i < DYNAMICS_STATE; i++) {
+			y[i] = y1[i];
+			k[0][i] = k[6][i];
+		}
+		t = last ? span : t + hs;
+	}
+
+	// Store the state, re-orthonormalising the rotation
+	v.rpos = _V(y[0], y[1], y[2]);
+	v.rvel = _V(y[3], y[4], y[5]);
+	v.avel = _V(-y[15], -y[16], -y[17]);
+	VECTOR3 cx = unit(_V(y[6], y[9], y[12]));
+	VECTOR3 cy = _V(y[7], y[10], y[13]);
+	cy = unit(cy - cx * dotp(cx, cy));
+	VECTOR3 cz = crossp(cx, cy);
+	v.rot = _M(cx.x, cy.x, cz.x, cx.y, cy.y, cz.y, cx.z, cy.z, cz.z);
+	return touchdown;
+}
+
+void LunarDynamics::coast(StubVessel& v, double const dt) const
+// Advance the vessel by dt with every thruster off: two-body motion, and torque-free rotation in steps of at most
+// COAST_ROTATION_STEP
+{
+	VECTOR3 r, u;
+	kepler(v.rpos, v.rvel, dt, r, u);
+	v.rpos = r;
+	v.rvel = u;
+	double m = v.emptyMass;
+	for (StubPropellant const& p : v.propellants) m += p.mass;
+	int n = (int)ceil(dt / COAST_ROTATION_STEP);
+	for (int i = 0; i < n; i++) rotate(v, _V(0, 0, 0), m, dt / n);
+}
+
+static void stumpff(double z, double& C, double& S)
+// Stumpff functions C(z) and S(z), by their series near z = 0
+{
+	if (z > 1e-6) {
+		double s = sqrt(z);
+		C = (1 - cos(s)) / z;
+		S = (s - sin(s)) / (s * z);
+	}
+	else if (z < -1e-6) {
+		double s = sqrt(-z);
+		C = (cosh(s) - 1) / -z;
+		S = (sinh(s) - s) / (s * -z);
+	}
+	else {
+		C = 1.0 / 2 - z / 24 + z * z / 720;
+		S = 1.0 / 6 - z / 120 + z * z / 5040;
+	}
+}
+
+void LunarDynamics::kepler(VECTOR3 const& r0, VECTOR3 const& v0, double const dt, VECTOR3& r, VECTOR3& v) const
+// Two-body position and velocity dt after (r0, v0), by the universal variable form of Kepler's equation, which holds
+// for elliptic, parabolic, hyperbolic and rectilinear orbits alike
+{
+	double sqmu = sqrt(Mu);
+	double r0l = length(r0);
+	double sigma = dotp(r0, v0) / sqmu;
+	double alpha = 2 / r0l - dotp(v0, v0) / Mu; // Reciprocal semi-major axis
+
+	// Newton's method on the universal anomaly chi. The derivative of the time equation is the radius, which is
+	// positive, so the iteration is well behaved from the short arc guess.
+	double chi = sqmu * dt / r0l;
+	double C = 0.5, S = 1.0 / 6;
+	for (int i = 0; i < 50; i++) {
+		double chi2 = chi * chi;
+		double z = alpha * chi2;
+		stumpff(z, C, S);
+		double t = sigma * chi2 * C + (1 - alpha * r0l) * chi2 * chi * S + r0l * chi;
+		double rl = sigma * chi * (1 - z * S) + (1 - alpha * r0l) * chi2 * C + r0l;
+		double step = (t - sqmu * dt) / rl;
+		chi -= step;
+		if (fabs(step) <= 1e-13 * (1 + fabs(chi))) break;
+	}
+	double chi2 = chi * chi;
+	stumpff(alpha * chi2, C, S);
+
+	// Lagrange coefficients
+	double f = 1 - chi2 * C / r0l;
+	double g = dt - chi2 * chi * S / sqmu;
+	r = r0 * f + v0 * g;
+	double rl = length(r);
+	double fdot = sqmu / (rl * r0l) * (alpha * chi2 * chi * S - chi);
+	double gdot = 1 - chi2 * C / rl;
+	v = r0 * fdot + v0 * gdot;
+}
+
+void LunarDynamics::rotate(StubVessel& v, VECTOR3 const& M, double const m, double const dt)
+// Advance the angular velocity and attitude by dt under the moment M, at mass m
+{
+	// Rotational motion. The dynamics use the right-hand rule (w' = I^-1 (M - w x Iw) with M = r x F),
+	// while Orbiter reports angular velocity with the opposite sign, so the stored rate is negated.
+	VECTOR3 I = v.pmi * m;
+	VECTOR3 w0 = -v.avel;
+	auto wdot = [&](VECTOR3 const& w) {
+		VECTOR3 Iw = _V(I.x * w.x, I.y * w.y, I.z * w.z);
+		VECTOR3 t = M - crossp(w, Iw);
+		return _V(t.x / I.x, t.y / I.y, t.z / I.z);
+	};
+	VECTOR3 a1 = wdot(w0);
+	VECTOR3 a2 = wdot(w0 + a1 * (0.5 * dt));
+	VECTOR3 a3 = wdot(w0 + a2 * (0.5 * dt));
+	VECTOR3 a4 = wdot(w0 + a3 * dt);
+	VECTOR3 w1 = w0 + (a1 + a2 * 2 + a3 * 2 + a4) * (dt / 6);
+
+	// Attitude: rotate by the mid-step rate using Rodrigues' formula, R <- R exp([w dt]x)
+	VECTOR3 wm = (w0 + w1) * 0.5;
+	double th = length(wm) * dt;
+	if (th > 0) {
+		VECTOR3 k = unit(wm);
+		double s = sin(th), c = 1 - cos(th);
+		MATRIX3 E = _M(1 - c * (k.y * k.y + k.z * k.z), -s * k.z + c * k.x * k.y, s * k.y + c * k.x * k.z,
+			s * k.z + c * k.x * k.y, 1 - c * (k.x * k.x + k.z * k.z), -s * k.x + c * k.y * k.z,
+			-s * k.y + c * k.x * k.z, s * k.x + c * k.y * k.z, 1 - c * (k.x * k.x + k.y * k.y));
+		MATRIX3 R = v.rot, N;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				N.data[3 * i + j] = R.data[3 * i] * E.data[j] + R.data[3 * i + 1] * E.data[3 + j] + R.data[3 * i + 2] * E.data[6 + j];
+
+		// Re-orthonormalise the columns to stop drift
+		VECTOR3 cx = unit(_V(N.m11, N.m21, N.m31));
+		VECTOR3 cy = _V(N.m12, N.m22, N.m32);
+		cy = unit(cy - cx * dotp(cx, cy));
+		VECTOR3 cz = crossp(cx, cy);
+		v.rot = _M(cx.x, cy.x, cz.x, cx.y, cy.y, cz.y, cx.z, cy.z, cz.z);
+	}
+	v.avel = -w1;
+}
+
+double LunarDynamics::touchdownHeight(StubVessel const& v)
+// Height of the lowest touchdown point above the terrain
+{
+	double h = length(v.rpos) - v.bodyRadius - v.elevation;
+	for (VECTOR3 const& p : v.touchdown) {
+		h = min(h, length(v.rpos + mul(v.rot, p)) - v.bodyRadius - v.elevation);
+	}
+	return h;
+}
+
+MATRIX3 LunarDynamics::rotationFromArot(VECTOR3 const& arot)
+// Vessel to inertial rotation matrix from Orbiter's scenario Euler angles (radians)
+{
+	double sx = sin(arot.x), cx = cos(arot.x);
+	double sy = sin(arot.y), cy = cos(arot.y);
+	double sz = sin(arot.z), cz = cos(arot.z);
+	return _M(cy * cz, sx * sy * cz - cx * sz, cx * sy * cz + sx * sz,
+		cy * sz, sx * sy * sz + cx * cz, cx * sy * sz - sx * cz,
+		-sy, sx * cy, cx * cy);
+}
@@ -0,0 +1,50 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// LunarDynamics.h
+// 6-DOF rigid-body model of a vessel near the Moon, used in place of
+// Orbiter for headless runs of the Surveyor autopilot
+//
+// ==============================================================
+
+#pragma once
+
+#include "orbitersdk.h"
+
+// Lunar environment, matching Orbiter's Moon
+const double MOON_RADIUS = 1737400;      // Mean radius [m]
+const double MOON_MU = 6.67259e-11 * 7.349e22; // Gravitational parameter [m^3/s^2]
+
+// Longest rotation step of a coast; torque-free rotation is exact at any step for a spherical inertia tensor [s]
+const double COAST_ROTATION_STEP = 1;
+
+// Adaptive integration (see LunarDynamics::integrate)
+const int DYNAMICS_STATE = 19;          // Position, velocity, rotation matrix, angular velocity and mass
+const double DYNAMICS_MIN_STEP = 1e-9;  // Steps this short are taken whatever their error estimate [s]
+const int DYNAMICS_EVENT_ITERATIONS = 60; // Bisections of the dense output that locate touchdown
+
+// Dynamics model class declaration
+class LunarDynamics {
+public:
+	LunarDynamics(double mu = MOON_MU);
+	void step(StubVessel& v, double const dt);
+	bool integrate(StubVessel& v, double const dt, double const tolerance, double& advanced);
+	void coast(StubVessel& v, double const dt) const;
+	void kepler(VECTOR3 const& r0, VECTOR3 const& v0, double const dt, VECTOR3& r, VECTOR3& v) const;
+	static double touchdownHeight(StubVessel const& v);
+	static MATRIX3 rotationFromArot(VECTOR3 const& arot);
+	long evaluations() const { return Evaluations; }
+	long steps() const { return Steps; }
+	long rejected() const { return Rejected; }
+private:
+	void thrustForces(StubVessel& v, double const dt, VECTOR3& F, VECTOR3& M, double& dm);
+	static void rotate(StubVessel& v, VECTOR3 const& M, double const m, double const dt);
+	bool segment(StubVessel& v, VECTOR3 const& F, VECTOR3 const& M, double const mdot, double const span,
+		double const tolerance, double& h, double& advanced);
+	double Mu; // Gravitational parameter of the reference body
+	long Evaluations; // Derivative evaluations by step() and integrate()
+	long Steps; // Steps taken by integrate()
+	long Rejected; // Steps integrate() rejected on their error estimate
+};
@@ -0,0 +1,203 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// MonteCarlo.cpp
+// Implementation of the Monte Carlo descent engine
+//
+// ==============================================================
+
+#include "MonteCarlo.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+
+MonteCarlo::MonteCarlo(MonteCarloConfig const& cfg)
+	: Config(cfg), WallTime(0)
+{
+}
+
+void MonteCarlo::draw(int index, ScenarioState& init, VesselDispersion& disp) const
+// Draw the dispersed initial state for one run. The generator is seeded from the base seed and
+// the run index only, so results do not depend on the thread that picks the run up.
+{
+	init = Config.nominal;
+	disp = VesselDispersion();
+	if (!Config.disperse) return;
+
+	std::seed_seq seq{ (uint32_t)Config.seed, (uint32_t)(Config.seed >> 32), (uint32_t)index };
+	std::mt19937_64 rng(seq);
+	std::normal_distribution<double> N(0.0, 1.0);
+	DispersionConfig const& d = Config.dispersion;
+
+	// Local frame at the initial position: radial, and two horizontal directions
+	VECTOR3 up = unit(init.rpos);
+	VECTOR3 e1 = fabs(up.z) < 0.9 ? unit(crossp(up, _V(0, 0, 1))) : unit(crossp(up, _V(1, 0, 0)));
+	VECTOR3 e2 = crossp(up, e1);
+
+	// Position
+	init.rpos += up * (d.altitude * N(rng)) + e1 * (d.position * N(rng)) + e2 * (d.position * N(rng));
+
+	// Velocity magnitude, and direction tilted about a random axis normal to it
+	double speed = length(init.rvel);
+	VECTOR3 vhat = init.rvel / speed;
+	VECTOR3 p1 = fabs(vhat.z) < 0.9 ? unit(crossp(vhat, _V(0, 0, 1))) : unit(crossp(vhat, _V(1, 0, 0)));
+	VECTOR3 p2 = crossp(vhat, p1);
+	double psi = 2 * PI * std::uniform_real_distribution<double>(0, 1)(rng);
+	double tilt = d.flightPath * N(rng);
+	VECTOR3 dir = vhat * cos(tilt) + (p1 * cos(psi) + p2 * sin(psi)) * sin(tilt);
+	init.rvel = dir * (speed + d.speed * N(rng));
+
+	// Orientation and angular velocity
+	init.arot += _V(N(rng), N(rng), N(rng)) * d.attitude;
+	init.vrot += _V(N(rng), N(rng), N(rng)) * d.rate;
+
+	// Vernier and RCS propellant loads, capped at full tanks. The retro stays as loaded, since
+	// Surveyor treats a retro tank below 99.9% as a lit motor and stages the AMR.
+	for (int i = 0; i < 2; i++) init.prpLevel[i] = min(init.prpLevel[i] * (1 + d.propellant * N(rng)), 1);
+
+	// Engine performance and terrain
+	disp.retroThrustScale = 1 + d.retroThrust * N(rng);
+	disp.vernierThrustScale = 1 + d.vernierThrust * N(rng);
+	disp.elevation = d.elevation * N(rng);
+}
+
+std::vector<RunResult> MonteCarlo::run()
+// Fly every run of the batch on the work-stealing pool
+{
+	std::vector<RunResult> results(Config.runs);
+	auto start = std::chrono::steady_clock::now();
+
+	// Coast to the branch point once, rather than in every run
+	DescentCheckpoint branch;
+	bool fork = Config.branchTime > 0;
+	if (fork) {
+		HeadlessDescent coast(Config.nominal, VesselDispersion(), Config.descent);
+		while (!coast.finished() && coast.simTime() < Config.branchTime) {
+			coast.preStep();
+			coast.advance();
+		}
+		coast.checkpoint(branch);
+	}
+
+	{
+		WorkStealingPool pool(Config.threads);
+		pool.parallelFor(0, Config.runs, 4, [&](size_t i) {
+			ScenarioState init;
+			VesselDispersion disp;
+			draw((int)i, init, disp);
+
+			DescentConfig dc = Config.descent;
+			dc.sensorSeed = Config.seed * 0x9E3779B97F4A7C15ull + i;
+			if (!Config.telemetryDir.empty()) {
+				char name[32];
+				sprintf(name, "/run%05d.tlm", (int)i);
+				dc.telemetryPath = Config.telemetryDir + name;
+			}
+			if (Config.publish) {
+				char name[32];
+				sprintf(name, "run%05d", (int)i);
+				dc.busName = name;
+			}
+
+			std::unique_ptr<HeadlessDescent> descent(fork ? new HeadlessDescent(branch, disp, dc) : new HeadlessDescent(init, disp, dc));
+			RunResult& r = results[i];
+			r.index = (int)i;
+			r.descent = descent->run();
+			LandingCriteria const& c = Config.criteria;
+			r.landed = r.descent.touchdown && r.descent.vertSpeed <= c.vertSpeed &&
+				r.descent.horizSpeed <= c.horizSpeed && r.descent.tilt <= c.tilt;
+		});
+	}
+	WallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return results;
+}
+
+static Statistic statistic(std::vector<double> x)
+// Summary statistics of a sample
+{
+	Statistic s;
+	if (x.empty()) return s;
+	std::sort(x.begin(), x.end());
+	double sum = 0, sumSq = 0;
+	for (double v : x) {
+		sum += v;
+		sumSq += v * v;
+	}
+	size_t n = x.size();
+	s.mean = sum / n;
+	s.stddev = n > 1 ? sqrt(max((sumSq - sum * s.mean) / (n - 1), 0)) : 0;
+	s.min = x.front();
+	s.max = x.back();
+	s.p50 = x[(n - 1) / 2];
+	s.p95 = x[std::min(n - 1, (size_t)ceil(0.95 * n) - 1)];
+	return s;
+}
+
+MonteCarloSummary MonteCarlo::summarize(std::vector<RunResult> const& results) const
+// Landing statistics over the runs that reached the surface
+{
+	MonteCarloSummary s;
+	std::vector<double> vs, hs, tilt, prop, t;
+	for (RunResult const& r : results) {
+		s.runs++;
+		s.steps += r.descent.steps;
+		s.thrusterWrites += r.descent.thrusterWrites;
+		s.thrusterReads += r.descent.thrusterReads;
+		if (!r.descent.touchdown) {
+			s.timedOut++;
+			continue;
+		}
+		if (r.landed) s.landed++;
+		else s.crashed++;
+		vs.push_back(r.descent.vertSpeed);
+		hs.push_back(r.descent.horizSpeed);
+		tilt.push_back(r.descent.tilt * DEG);
+		prop.push_back(r.descent.vernierProp);
+		t.push_back(r.descent.simTime);
+	}
+	s.vertSpeed = statistic(vs);
+	s.horizSpeed = statistic(hs);
+	s.tilt = statistic(tilt);
+	s.vernierProp = statistic(prop);
+	s.simTime = statistic(t);
+	s.wallTime = WallTime;
+	return s;
+}
+
+void MonteCarlo::printSummary(MonteCarloSummary const& s, FILE* out)
+// Human-readable batch summary
+{
+	fprintf(out, "Runs: %d   Landed: %d (%.1f%%)   Crashed: %d   Timed out: %d\n",
+		s.runs, s.landed, s.runs ? 100.0 * s.landed / s.runs : 0.0, s.crashed, s.timedOut);
+	fprintf(out, "%-26s %10s %10s %10s %10s %10s %10s\n", "", "mean", "stddev", "min", "p50", "p95", "max");
+	auto row = [out](const char* name, Statistic const& x) {
+		fprintf(out, "%-26s %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", name, x.mean, x.stddev, x.min, x.p50, x.p95, x.max);
+	};
+	row("Vertical speed [m/s]", s.vertSpeed);
+	row("Horizontal speed [m/s]", s.horizSpeed);
+	row("Tilt [deg]", s.tilt);
+	row("Vernier propellant [kg]", s.vernierProp);
+	row("Descent time [s]", s.simTime);
+	fprintf(out, "Wall time: %.2f s   Frames: %ld   Frames/s: %.3g   Thruster writes/frame: %.2f   reads/frame: %.2f\n",
+		s.wallTime, s.steps, s.wallTime > 0 ? s.steps / s.wallTime : 0.0, s.steps ? (double)s.thrusterWrites / s.steps : 0.0,
+		s.steps ? (double)s.thrusterReads / s.steps : 0.0);
+}
+
+bool MonteCarlo::writeCsv(std::vector<RunResult> const& results, const char* path)
+// One line per run
+{
+	FILE* f = fopen(path, "w");
+	if (!f) return false;
+	fprintf(f, "run,landed,touchdown,sim_time,vert_speed,horiz_speed,tilt_deg,rate,vernier_prop,retro_prop,mode,staging,steps\n");
+	for (RunResult const& r : results) {
+		DescentResult const& d = r.descent;
+		fprintf(f, "%d,%d,%d,%.3f,%.4f,%.4f,%.4f,%.6f,%.4f,%.4f,%d,%d,%ld\n", r.index, r.landed, d.touchdown,
+			d.simTime, d.vertSpeed, d.horizSpeed, d.tilt * DEG, d.rate, d.vernierProp, d.retroProp, d.mode, d.staging, d.steps);
+	}
+	fclose(f);
+	return true;
+}
@@ -0,0 +1,89 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// MonteCarlo.h
+// Dispersed batch descents across all cores, with landing statistics
+//
+// ==============================================================
+
+#pragma once
+
+#include "HeadlessDescent.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One-sigma dispersions about the scenario state
+struct DispersionConfig {
+	double altitude = 5000;       // Initial altitude [m]
+	double position = 5000;       // Initial horizontal position [m]
+	double speed = 10;            // Initial speed [m/s]
+	double flightPath = 0.5 * RAD; // Initial velocity direction [rad]
+	double attitude = 30 * RAD;   // Initial orientation, about a random axis [rad]
+	double rate = 0.2 * RAD;      // Initial angular velocity, per axis [rad/s]
+	double propellant = 0.005;    // Vernier and RCS propellant load, fraction of nominal
+	double retroThrust = 0.01;    // Retro thrust, fraction of nominal
+	double vernierThrust = 0.02;  // Vernier thrust, fraction of nominal
+	double elevation = 500;       // Landing site elevation [m]
+};
+
+// Touchdown limits for a run to count as a landing
+struct LandingCriteria {
+	double vertSpeed = 5.0;       // Maximum descent rate [m/s]
+	double horizSpeed = 2.0;      // Maximum horizontal speed [m/s]
+	double tilt = 15 * RAD;       // Maximum roll axis tilt from vertical [rad]
+};
+
+// Batch settings
+struct MonteCarloConfig {
+	int runs = 1000;              // Number of descents
+	uint64_t seed = 1;            // Base seed; run i always draws the same dispersions
+	unsigned threads = 0;         // Worker threads, 0 for all cores
+	bool disperse = true;         // False flies every run from the nominal state
+	ScenarioState nominal;        // Nominal initial state
+	DispersionConfig dispersion;  // Dispersions about the nominal state
+	DescentConfig descent;        // Per-descent settings
+	LandingCriteria criteria;     // Touchdown limits
+	std::string telemetryDir;     // Write a telemetry file per run to this directory, if not empty
+	bool publish = false;         // Publish each run to a live telemetry bus named runNNNNN
+	double branchTime = 0;        // Fly the nominal state to this time once, and fork every run from there, with only
+	                              // the engine and terrain dispersions; 0 flies every run from the scenario state [s]
+};
+
+// Result of one run in the batch
+struct RunResult {
+	int index;
+	bool landed;
+	DescentResult descent;
+};
+
+// Distribution of one touchdown quantity over the batch
+struct Statistic {
+	double mean = 0, stddev = 0, min = 0, p50 = 0, p95 = 0, max = 0;
+};
+
+// Batch summary
+struct MonteCarloSummary {
+	int runs = 0, landed = 0, crashed = 0, timedOut = 0;
+	Statistic vertSpeed, horizSpeed, tilt, vernierProp, simTime;
+	double wallTime = 0;          // Wall-clock time for the batch [s]
+	long steps = 0;               // Frames simulated over the batch
+	long thrusterWrites = 0;      // Thruster level and direction calls into the host over the batch
+	long thrusterReads = 0;       // Thruster and thruster group level reads from the host over the batch
+};
+
+// Monte Carlo engine class declaration
+class MonteCarlo {
+public:
+	MonteCarlo(MonteCarloConfig const& cfg);
+	std::vector<RunResult> run();
+	void draw(int index, ScenarioState& init, VesselDispersion& disp) const;
+	MonteCarloSummary summarize(std::vector<RunResult> const& results) const;
+	static void printSummary(MonteCarloSummary const& s, FILE* out);
+	static bool writeCsv(std::vector<RunResult> const& results, const char* path);
+private:
+	MonteCarloConfig Config; // Batch settings
+	double WallTime;         // Wall-clock time of the last run() [s]
+};
@@ -0,0 +1,125 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// NavigationCheck.cpp
+// Check of the navigation filter: counts heap allocations made by
+// navigation updates, which must be none, times an update against
+// NAV_STEP_BUDGET, and measures the estimate error on a scripted
+// final descent flown through the radar models
+//
+// ==============================================================
+
+#include "Navigation.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+
+// Every allocation in the process goes through these, so a count taken around a loop covers all it calls
+static std::atomic<long> Allocations(0);
+
+void* operator new(size_t size)
+{
+	Allocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// Scripted descent: straight down at a constant deceleration, with the roll axis tilted off the vertical
+struct ScriptedDescent {
+	double h0 = 14000;  // Initial radar altitude [m]
+	double v0 = 180;    // Initial descent rate [m/s]
+	double decel = 1.1; // Deceleration [m/s^2]
+	double tilt = 10 * RAD; // Roll axis tilt from the vertical [rad]
+
+	double altitude(double t) const { return h0 - v0 * t + 0.5 * decel * t * t; }
+	double rate(double t) const { return v0 - decel * t; }
+};
+
+static void truth(ScriptedDescent const& d, double t, double mass, StateFrame& sf, VECTOR3& thrust)
+// True state frame at time t, and the thrust that flies it
+{
+	// Vessel frame: y axis north, roll axis up and tilted towards the east by tilt
+	double c = cos(d.tilt), s = sin(d.tilt);
+	sf.Horizon = _M(c, 0, s, -s, 0, c, 0, 1, 0);
+	sf.SimT = t;
+	sf.Altitude = d.altitude(t);
+	sf.SurfaceElevation = 0;
+	sf.RadarAltitude = sf.Altitude;
+	sf.Mass = mass;
+	sf.Airspeed = tmul(sf.Horizon, _V(0, -d.rate(t), 0));
+
+	// Thrust holding the deceleration against gravity, straight up
+	thrust = tmul(sf.Horizon, _V(0, mass * (g + d.decel), 0));
+}
+
+int main(int argc, char* argv[])
+{
+	long steps = argc > 1 ? atol(argv[1]) : 1000000;
+	bool ok = true;
+	ScriptedDescent d;
+	double dt = 0.02, mass = 600;
+	double duration = d.v0 / d.decel - 5;
+
+	// Accuracy over the scripted descent, after the filter has had 10 s to converge
+	Navigation nav;
+	nav.reset(7);
+	double sumV = 0, sumH = 0, maxV = 0, maxH = 0;
+	long n = 0;
+	for (double t = 0; t < duration; t += dt) {
+		StateFrame sf;
+		VECTOR3 thrust;
+		truth(d, t, mass, sf, thrust);
+		VECTOR3 v = sf.Airspeed;
+		double h = sf.RadarAltitude;
+		nav.update(sf, thrust, false);
+		if (t < 10) continue;
+		double ev = length(sf.Airspeed - v), eh = fabs(sf.Altitude - sf.SurfaceElevation - h);
+		sumV += ev * ev;
+		sumH += eh * eh;
+		maxV = max(maxV, ev);
+		maxH = max(maxH, eh);
+		n++;
+	}
+	printf("%-40s %12.3f\n", "velocity error, RMS (m/s)", sqrt(sumV / n));
+	printf("%-40s %12.3f\n", "velocity error, max (m/s)", maxV);
+	printf("%-40s %12.3f\n", "altitude error, RMS (m)", sqrt(sumH / n));
+	printf("%-40s %12.3f\n", "altitude error, max (m)", maxH);
+	printf("%-40s %12d\n", "measurements rejected", nav.rejected());
+	if (!(sqrt(sumV / n) < 1 && sqrt(sumH / n) < 20)) ok = false;
+
+	// Allocations and time per update over a long run of updates, cycling through the descent
+	StateFrame frames[256];
+	VECTOR3 thrusts[256];
+	for (int i = 0; i < 256; i++) truth(d, i * duration / 256, mass, frames[i], thrusts[i]);
+	nav.reset(11);
+	long before = Allocations.load();
+	auto t0 = std::chrono::steady_clock::now();
+	for (long k = 0; k < steps; k++) {
+		StateFrame sf = frames[k & 255];
+		sf.SimT = k * dt;
+		nav.update(sf, thrusts[k & 255], false);
+	}
+	double perStep = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / steps;
+	long allocations = Allocations.load() - before;
+	printf("%-40s %12ld\n", "heap allocations in updates", allocations);
+	printf("%-40s %12.1f\n", "update time (ns)", 1e9 * perStep);
+	printf("%-40s %12.1f\n", "update budget (ns)", 1e9 * NAV_STEP_BUDGET);
+	if (allocations != 0 || perStep > NAV_STEP_BUDGET) ok = false;
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
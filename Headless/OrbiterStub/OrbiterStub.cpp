@@ -0,0 +1,335 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// OrbiterStub.cpp
+// Implementation of the headless stand-in for the Orbiter vessel API.
+// Calls only read and write the StubVessel state; the dynamics are
+// advanced separately by the headless simulation.
+//
+// ==============================================================
+
+#include "orbitersdk.h"
+#include <cctype>
+
+char* oapiDebugString()
+{
+	// One buffer per thread so concurrent headless runs do not interleave their output
+	static thread_local char DebugString[512];
+	return DebugString;
+}
+
+void oapiWriteLog(char* line)
+{
+	// The headless tools have no Orbiter.log; log lines go to stderr
+	fprintf(stderr, "%s\n", line);
+}
+
+FILEHANDLE oapiOpenFile(const char* fname, FileAccessMode mode, PathRoot root)
+{
+	static const char* Roots[] = { "", "Config/", "Scenarios/", "Textures/", "Textures2/", "Meshes/", "Modules/" };
+	std::string path = std::string(Roots[root]) + fname;
+	return fopen(path.c_str(), mode == FILE_OUT ? "w" : mode == FILE_APP ? "a" : "r");
+}
+
+void oapiCloseFile(FILEHANDLE f, FileAccessMode mode)
+{
+	if (f) fclose((FILE*)f);
+}
+
+bool oapiReadItem_float(FILEHANDLE f, char* item, double& val)
+{
+	// Search the whole file for an "item = value" line, ignoring case and ';' comments, as Orbiter does
+	FILE* file = (FILE*)f;
+	if (!file) return false;
+	rewind(file);
+	char line[256];
+	size_t n = strlen(item);
+	while (fgets(line, sizeof(line), file)) {
+		char* p = line;
+		while (*p == ' ' || *p == '\t') p++;
+		if (*p == ';') continue;
+		size_t i = 0;
+		while (i < n && tolower((unsigned char)p[i]) == tolower((unsigned char)item[i])) i++;
+		if (i < n) continue;
+		p += n;
+		while (*p == ' ' || *p == '\t') p++;
+		if (*p != '=') continue;
+		return sscanf(p + 1, "%lf", &val) == 1;
+	}
+	return false;
+}
+
+bool oapiReadScenario_nextline(FILEHANDLE scn, char*& line)
+{
+	// Next line of the vessel's block, without its line end or leading blanks; false at END or the end of the file
+	static thread_local char buffer[512];
+	FILE* file = (FILE*)scn;
+	if (!file || !fgets(buffer, sizeof(buffer), file)) return false;
+	buffer[strcspn(buffer, "\r\n")] = 0;
+	line = buffer;
+	while (*line == ' ' || *line == '\t') line++;
+	return strcmp(line, "END") != 0;
+}
+
+void oapiWriteScenario_string(FILEHANDLE scn, char* item, char* string)
+{
+	if (scn) fprintf((FILE*)scn, "  %s %s\n", item, string);
+}
+
+void oapiWriteScenario_int(FILEHANDLE scn, char* item, int i)
+{
+	if (scn) fprintf((FILE*)scn, "  %s %d\n", item, i);
+}
+
+OBJHANDLE oapiCreateVessel(const char* name, const char* classname, const VESSELSTATUS& status)
+{
+	// Jettisoned stages are not simulated headless
+	return 0;
+}
+
+// Vessel with the input focus, per thread like the debug string
+static thread_local OBJHANDLE FocusObject = 0;
+
+OBJHANDLE oapiGetFocusObject()
+{
+	return FocusObject;
+}
+
+OBJHANDLE oapiSetFocusObject(OBJHANDLE hVessel)
+{
+	OBJHANDLE prev = FocusObject;
+	FocusObject = hVessel;
+	return prev;
+}
+
+// Simulated seconds per wall clock second, per thread like the focus vessel, so each paced descent sets its own
+static thread_local double TimeAcceleration = 1;
+
+double oapiGetTimeAcceleration()
+{
+	return TimeAcceleration;
+}
+
+void oapiSetTimeAcceleration(double warp)
+{
+	TimeAcceleration = warp;
+}
+
+double oapiSurfaceElevation(OBJHANDLE hPlanet, double lng, double lat)
+{
+	// No planetary elevation data headless; terrain comes from a TerrainSource
+	return 0;
+}
+
+VESSEL::VESSEL(OBJHANDLE hVessel, int fmodel)
+	: handle(hVessel)
+{
+	stub.name = "Surveyor";
+}
+
+VESSEL::~VESSEL()
+{
+}
+
+const char* VESSEL::GetName() const
+{
+	return stub.name.c_str();
+}
+
+void VESSEL::GetStatus(VESSELSTATUS& status) const
+{
+	memset(&status, 0, sizeof(status));
+	status.rpos = stub.rpos;
+	status.rvel = stub.rvel;
+	status.vrot = stub.avel;
+	status.status = 0;
+}
+
+void VESSEL::Local2Rel(const VECTOR3& local, VECTOR3& rel) const
+{
+	rel = stub.rpos + mul(stub.rot, local);
+}
+
+void VESSEL::ParseScenarioLineEx(char* line, void* status) const
+{
+	// The headless tools apply the default vessel state (position, velocity, propellant) from the scenario themselves
+}
+
+void VESSEL2::clbkLoadStateEx(FILEHANDLE scn, void* status)
+{
+	char* line;
+	while (oapiReadScenario_nextline(scn, line)) ParseScenarioLineEx(line, status);
+}
+
+void VESSEL::SetSize(double size) const { stub.size = size; }
+void VESSEL::SetPMI(const VECTOR3& pmi) const { stub.pmi = pmi; }
+void VESSEL::SetCrossSections(const VECTOR3& cs) const {}
+void VESSEL::SetRotDrag(const VECTOR3& rd) const {}
+void VESSEL::SetSurfaceFrictionCoeff(double mu_lng, double mu_lat) const {}
+void VESSEL::SetCameraOffset(const VECTOR3& co) const {}
+
+void VESSEL::SetTouchdownPoints(const VECTOR3& pt1, const VECTOR3& pt2, const VECTOR3& pt3) const
+{
+	stub.touchdown.assign({ pt1, pt2, pt3 });
+}
+
+void VESSEL::SetEmptyMass(double m) const { stub.emptyMass = m; }
+double VESSEL::GetEmptyMass() const { return stub.emptyMass; }
+
+double VESSEL::GetMass() const
+{
+	double m = stub.emptyMass;
+	for (const StubPropellant& p : stub.propellants) m += p.mass;
+	return m;
+}
+
+double VESSEL::GetAltitude() const
+{
+	// Altitude above the mean radius of the reference body
+	return length(stub.rpos) - stub.bodyRadius;
+}
+
+double VESSEL::GetSurfaceElevation() const
+{
+	return stub.elevation;
+}
+
+OBJHANDLE VESSEL::GetSurfaceRef() const
+{
+	// No body handles headless; terrain comes from a TerrainSource
+	return 0;
+}
+
+void VESSEL::GetEquPos(double& longitude, double& latitude, double& radius) const
+{
+	// The Moon does not rotate headless, so the body frame is the inertial frame
+	radius = length(stub.rpos);
+	longitude = atan2(stub.rpos.y, stub.rpos.x);
+	latitude = radius > 0 ? asin(stub.rpos.z / radius) : 0;
+}
+
+void VESSEL::HorizonRot(const VECTOR3& loc, VECTOR3& hor) const
+{
+	// Local horizon frame: x east, y up, z north. Over a pole, east is taken along the inertial y axis.
+	VECTOR3 up = unit(stub.rpos);
+	VECTOR3 east = crossp(_V(0, 0, 1), up);
+	east = length(east) > 1e-12 ? unit(east) : _V(0, 1, 0);
+	VECTOR3 north = crossp(up, east);
+	VECTOR3 g = mul(stub.rot, loc);
+	hor = _V(dotp(g, east), dotp(g, up), dotp(g, north));
+}
+
+bool VESSEL::GetAirspeedVector(REFFRAME frame, VECTOR3& v) const
+{
+	// The Moon has no atmosphere and rotates slowly, so airspeed is the body-relative velocity
+	if (frame == FRAME_LOCAL) v = tmul(stub.rot, stub.rvel);
+	else if (frame == FRAME_HORIZON) {
+		// Local horizon frame, as in HorizonRot
+		VECTOR3 up = unit(stub.rpos);
+		VECTOR3 east = crossp(_V(0, 0, 1), up);
+		east = length(east) > 1e-12 ? unit(east) : _V(0, 1, 0);
+		VECTOR3 north = crossp(up, east);
+		v = _V(dotp(stub.rvel, east), dotp(stub.rvel, up), dotp(stub.rvel, north));
+	}
+	else v = stub.rvel;
+	return true;
+}
+
+void VESSEL::GetAngularVel(VECTOR3& avel) const
+{
+	avel = stub.avel;
+}
+
+PROPELLANT_HANDLE VESSEL::CreatePropellantResource(double maxmass, double mass, double efficiency) const
+{
+	StubPropellant p = { maxmass, mass < 0 ? maxmass : mass };
+	stub.propellants.push_back(p);
+	return StubHandle((int)stub.propellants.size() - 1);
+}
+
+double VESSEL::GetPropellantMass(PROPELLANT_HANDLE ph) const
+{
+	return stub.propellants[StubIndex(ph)].mass;
+}
+
+void VESSEL::SetPropellantMass(PROPELLANT_HANDLE ph, double mass) const
+{
+	stub.propellants[StubIndex(ph)].mass = mass;
+}
+
+THRUSTER_HANDLE VESSEL::CreateThruster(const VECTOR3& pos, const VECTOR3& dir, double maxth0, PROPELLANT_HANDLE hp, double isp0, double isp_ref, double p_ref) const
+{
+	StubThruster th = { pos, unit(dir), maxth0, isp0, 0.0, hp ? StubIndex(hp) : -1 };
+	stub.thrusters.push_back(th);
+	return StubHandle((int)stub.thrusters.size() - 1);
+}
+
+THGROUP_HANDLE VESSEL::CreateThrusterGroup(THRUSTER_HANDLE* th, int nth, THGROUP_TYPE thgt) const
+{
+	if (thgt > THGROUP_ATT_BACK) return 0;
+	std::vector<int>& group = stub.groups[thgt];
+	group.clear();
+	for (int i = 0; i < nth; i++) group.push_back(StubIndex(th[i]));
+	return StubHandle(thgt);
+}
+
+unsigned int VESSEL::AddExhaust(THRUSTER_HANDLE th, double lscale, double wscale, SURFHANDLE tex) const
+{
+	return 0;
+}
+
+void VESSEL::SetThrusterLevel(THRUSTER_HANDLE th, double level) const
+{
+	stub.setLevelCalls++;
+	stub.thrusters[StubIndex(th)].level = min(max(level, 0), 1);
+}
+
+double VESSEL::GetThrusterLevel(THRUSTER_HANDLE th) const
+{
+	stub.getLevelCalls++;
+	return stub.thrusters[StubIndex(th)].level;
+}
+
+void VESSEL::SetThrusterDir(THRUSTER_HANDLE th, const VECTOR3& dir) const
+{
+	// Orbiter normalises the direction internally
+	stub.setDirCalls++;
+	stub.thrusters[StubIndex(th)].dir = unit(dir);
+}
+
+void VESSEL::GetThrusterDir(THRUSTER_HANDLE th, VECTOR3& dir) const
+{
+	dir = stub.thrusters[StubIndex(th)].dir;
+}
+
+void VESSEL::GetThrusterRef(THRUSTER_HANDLE th, VECTOR3& pos) const
+{
+	pos = stub.thrusters[StubIndex(th)].pos;
+}
+
+double VESSEL::GetThrusterMax0(THRUSTER_HANDLE th) const
+{
+	return stub.thrusters[StubIndex(th)].maxth;
+}
+
+double VESSEL::GetThrusterGroupLevel(THGROUP_TYPE thgt) const
+{
+	// Mean level of the group; there is no manual input headless, so this is the module's own commands
+	stub.getLevelCalls++;
+	if (thgt > THGROUP_ATT_BACK || stub.groups[thgt].empty()) return 0;
+	double level = 0;
+	for (int i : stub.groups[thgt]) level += stub.thrusters[i].level;
+	return level / stub.groups[thgt].size();
+}
+
+unsigned int VESSEL::AddMesh(const char* meshname, const VECTOR3* ofs) const
+{
+	return 0;
+}
+
+bool VESSEL::ClearMeshes() const
+{
+	return true;
+}
@@ -0,0 +1,272 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// orbitersdk.h
+// Minimal stand-in for the Orbiter SDK header, used to build the
+// Surveyor module sources on Linux without an Orbiter install.
+// Only the parts of the API used by Surveyor are declared. The
+// vessel state that Orbiter would own is kept in VESSEL::Stub so
+// the headless dynamics model can read thruster commands and
+// write back the propagated state.
+//
+// ==============================================================
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------------
+// Basic types
+// --------------------------------------------------------------
+typedef uint32_t DWORD;
+typedef void* OBJHANDLE;
+typedef void* THRUSTER_HANDLE;
+typedef void* PROPELLANT_HANDLE;
+typedef void* THGROUP_HANDLE;
+typedef void* SURFHANDLE;
+typedef void* FILEHANDLE;
+typedef void* HINSTANCE;
+
+#define DLLCLBK extern "C"
+
+const double PI = 3.14159265358979;
+const double RAD = PI / 180.0;
+const double DEG = 180.0 / PI;
+
+// The Windows headers pulled in by the real SDK provide min and max. These overloads
+// cover the mixed double/int calls made by the module without clashing with <algorithm>.
+inline double min(double a, double b) { return a < b ? a : b; }
+inline double max(double a, double b) { return a > b ? a : b; }
+
+// --------------------------------------------------------------
+// Vector and matrix types
+// --------------------------------------------------------------
+typedef union {
+	double data[3];
+	struct { double x, y, z; };
+} VECTOR3;
+
+typedef union {
+	double data[9];
+	struct { double m11, m12, m13, m21, m22, m23, m31, m32, m33; };
+} MATRIX3;
+
+inline VECTOR3 _V(double x, double y, double z)
+{
+	VECTOR3 v = { x, y, z };
+	return v;
+}
+
+inline VECTOR3 operator+ (const VECTOR3& a, const VECTOR3& b) { return _V(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline VECTOR3 operator- (const VECTOR3& a, const VECTOR3& b) { return _V(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline VECTOR3 operator- (const VECTOR3& a) { return _V(-a.x, -a.y, -a.z); }
+inline VECTOR3 operator* (const VECTOR3& a, const double f) { return _V(a.x * f, a.y * f, a.z * f); }
+inline VECTOR3 operator/ (const VECTOR3& a, const double f) { return _V(a.x / f, a.y / f, a.z / f); }
+inline VECTOR3& operator+= (VECTOR3& a, const VECTOR3& b) { a.x += b.x; a.y += b.y; a.z += b.z; return a; }
+inline VECTOR3& operator-= (VECTOR3& a, const VECTOR3& b) { a.x -= b.x; a.y -= b.y; a.z -= b.z; return a; }
+inline VECTOR3& operator*= (VECTOR3& a, const double f) { a.x *= f; a.y *= f; a.z *= f; return a; }
+inline double dotp(const VECTOR3& a, const VECTOR3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline VECTOR3 crossp(const VECTOR3& a, const VECTOR3& b) { return _V(a.y * b.z - b.y * a.z, a.z * b.x - b.z * a.x, a.x * b.y - b.x * a.y); }
+inline double length(const VECTOR3& a) { return sqrt(a.x * a.x + a.y * a.y + a.z * a.z); }
+inline VECTOR3 unit(const VECTOR3& a) { return a / length(a); }
+
+inline MATRIX3 _M(double m11, double m12, double m13, double m21, double m22, double m23, double m31, double m32, double m33)
+{
+	MATRIX3 m = { m11, m12, m13, m21, m22, m23, m31, m32, m33 };
+	return m;
+}
+inline VECTOR3 mul(const MATRIX3& A, const VECTOR3& b)
+{
+	return _V(A.m11 * b.x + A.m12 * b.y + A.m13 * b.z, A.m21 * b.x + A.m22 * b.y + A.m23 * b.z, A.m31 * b.x + A.m32 * b.y + A.m33 * b.z);
+}
+inline VECTOR3 tmul(const MATRIX3& A, const VECTOR3& b)
+{
+	return _V(A.m11 * b.x + A.m21 * b.y + A.m31 * b.z, A.m12 * b.x + A.m22 * b.y + A.m32 * b.z, A.m13 * b.x + A.m23 * b.y + A.m33 * b.z);
+}
+
+// --------------------------------------------------------------
+// Enumerations and structures
+// --------------------------------------------------------------
+enum REFFRAME { FRAME_GLOBAL, FRAME_LOCAL, FRAME_REFLOCAL, FRAME_HORIZON };
+
+enum THGROUP_TYPE {
+	THGROUP_MAIN, THGROUP_RETRO, THGROUP_HOVER,
+	THGROUP_ATT_PITCHUP, THGROUP_ATT_PITCHDOWN, THGROUP_ATT_YAWLEFT, THGROUP_ATT_YAWRIGHT,
+	THGROUP_ATT_BANKLEFT, THGROUP_ATT_BANKRIGHT, THGROUP_ATT_RIGHT, THGROUP_ATT_LEFT,
+	THGROUP_ATT_UP, THGROUP_ATT_DOWN, THGROUP_ATT_FORWARD, THGROUP_ATT_BACK,
+	THGROUP_USER = 0x40
+};
+
+typedef struct {
+	VECTOR3 pos;
+	double stiffness;
+	double damping;
+	double mu;
+	double mu_lng;
+} TOUCHDOWNVTX;
+
+typedef struct {
+	VECTOR3 rpos, rvel, vrot, arot;
+	double fuel, eng_main, eng_hovr;
+	OBJHANDLE rbody, base;
+	int port;
+	DWORD status;
+} VESSELSTATUS;
+
+#define OAPI_KEY_L 0x26
+#define KEYMOD_SHIFT(buf) ((buf[0x2A] & 0x80) || (buf[0x36] & 0x80))
+
+// Configuration files. Paths are relative to the working directory, which stands in for the Orbiter folder.
+enum FileAccessMode { FILE_IN, FILE_OUT, FILE_APP, FILE_IN_ZEROONFAIL };
+enum PathRoot { ROOT, CONFIG, SCENARIOS, TEXTURES, TEXTURES2, MESHES, MODULES };
+FILEHANDLE oapiOpenFile(const char* fname, FileAccessMode mode, PathRoot root = ROOT);
+void oapiCloseFile(FILEHANDLE f, FileAccessMode mode);
+bool oapiReadItem_float(FILEHANDLE f, char* item, double& val);
+
+// Scenario files. A vessel's block is read line by line up to its END line; items are written one per line.
+bool oapiReadScenario_nextline(FILEHANDLE scn, char*& line);
+void oapiWriteScenario_string(FILEHANDLE scn, char* item, char* string);
+void oapiWriteScenario_int(FILEHANDLE scn, char* item, int i);
+
+char* oapiDebugString();
+void oapiWriteLog(char* line);
+OBJHANDLE oapiCreateVessel(const char* name, const char* classname, const VESSELSTATUS& status);
+OBJHANDLE oapiGetFocusObject();
+OBJHANDLE oapiSetFocusObject(OBJHANDLE hVessel);
+double oapiGetTimeAcceleration();
+void oapiSetTimeAcceleration(double warp);
+double oapiSurfaceElevation(OBJHANDLE hPlanet, double lng, double lat);
+
+// --------------------------------------------------------------
+// Headless vessel state owned by the stand-in
+// --------------------------------------------------------------
+struct StubThruster {
+	VECTOR3 pos;     // Position in vessel frame [m]
+	VECTOR3 dir;     // Unit thrust direction in vessel frame
+	double maxth;    // Maximum thrust [N]
+	double isp;      // Fuel-specific impulse [m/s]
+	double level;    // Commanded thrust level [0..1]
+	int prop;        // Propellant resource index, or -1
+};
+
+struct StubPropellant {
+	double maxmass;  // Capacity [kg]
+	double mass;     // Current mass [kg]
+};
+
+struct StubVessel {
+	std::string name;
+	std::vector<StubThruster> thrusters;
+	std::vector<StubPropellant> propellants;
+	std::vector<int> groups[THGROUP_ATT_BACK + 1]; // Thruster indices per standard group
+	std::vector<VECTOR3> touchdown;                 // Touchdown points in vessel frame [m]
+	double emptyMass = 0;
+	double size = 1;
+	VECTOR3 pmi = { 1, 1, 1 };
+
+	// Kinematic state written by the dynamics model
+	VECTOR3 rpos = { 0, 0, 0 };    // Position relative to the reference body, inertial frame [m]
+	VECTOR3 rvel = { 0, 0, 0 };    // Velocity relative to the reference body, inertial frame [m/s]
+	MATRIX3 rot = { 1, 0, 0, 0, 1, 0, 0, 0, 1 }; // Vessel to inertial frame rotation
+	VECTOR3 avel = { 0, 0, 0 };    // Angular velocity in vessel frame, Orbiter sign convention [rad/s]
+	double bodyRadius = 1737400;   // Mean radius of the reference body [m]
+	double elevation = 0;          // Surface elevation below the vessel [m]
+
+	// Calls made by the module into the stand-in, for checking host traffic
+	long setLevelCalls = 0;        // SetThrusterLevel
+	long setDirCalls = 0;          // SetThrusterDir
+	long getLevelCalls = 0;        // GetThrusterLevel and GetThrusterGroupLevel
+};
+
+// Handles are 1-based indices into the owning vessel's tables, so they stay valid when the
+// tables grow and never collide with a null handle
+inline int StubIndex(void* h) { return (int)(uintptr_t)h - 1; }
+inline void* StubHandle(int i) { return (void*)(uintptr_t)(i + 1); }
+
+// --------------------------------------------------------------
+// Vessel classes
+// --------------------------------------------------------------
+class VESSEL {
+public:
+	VESSEL(OBJHANDLE hVessel, int fmodel = 1);
+	virtual ~VESSEL();
+
+	OBJHANDLE GetHandle() const { return handle; }
+	const char* GetName() const;
+	void GetStatus(VESSELSTATUS& status) const;
+	void Local2Rel(const VECTOR3& local, VECTOR3& rel) const;
+	void ParseScenarioLineEx(char* line, void* status) const;
+
+	// Physical parameters
+	void SetSize(double size) const;
+	void SetPMI(const VECTOR3& pmi) const;
+	void SetCrossSections(const VECTOR3& cs) const;
+	void SetRotDrag(const VECTOR3& rd) const;
+	void SetSurfaceFrictionCoeff(double mu_lng, double mu_lat) const;
+	void SetTouchdownPoints(const VECTOR3& pt1, const VECTOR3& pt2, const VECTOR3& pt3) const;
+	void SetCameraOffset(const VECTOR3& co) const;
+	void SetEmptyMass(double m) const;
+	double GetEmptyMass() const;
+	double GetMass() const;
+
+	// Flight state
+	double GetAltitude() const;
+	double GetSurfaceElevation() const;
+	OBJHANDLE GetSurfaceRef() const;
+	void GetEquPos(double& longitude, double& latitude, double& radius) const;
+	void HorizonRot(const VECTOR3& loc, VECTOR3& hor) const;
+	bool GetAirspeedVector(REFFRAME frame, VECTOR3& v) const;
+	void GetAngularVel(VECTOR3& avel) const;
+
+	// Propellant resources
+	PROPELLANT_HANDLE CreatePropellantResource(double maxmass, double mass = -1.0, double efficiency = 1.0) const;
+	double GetPropellantMass(PROPELLANT_HANDLE ph) const;
+	void SetPropellantMass(PROPELLANT_HANDLE ph, double mass) const;
+
+	// Thrusters
+	THRUSTER_HANDLE CreateThruster(const VECTOR3& pos, const VECTOR3& dir, double maxth0, PROPELLANT_HANDLE hp = 0, double isp0 = 0.0, double isp_ref = 0.0, double p_ref = 101.4e3) const;
+	THGROUP_HANDLE CreateThrusterGroup(THRUSTER_HANDLE* th, int nth, THGROUP_TYPE thgt) const;
+	unsigned int AddExhaust(THRUSTER_HANDLE th, double lscale, double wscale, SURFHANDLE tex = 0) const;
+	void SetThrusterLevel(THRUSTER_HANDLE th, double level) const;
+	double GetThrusterLevel(THRUSTER_HANDLE th) const;
+	void SetThrusterDir(THRUSTER_HANDLE th, const VECTOR3& dir) const;
+	void GetThrusterDir(THRUSTER_HANDLE th, VECTOR3& dir) const;
+	void GetThrusterRef(THRUSTER_HANDLE th, VECTOR3& pos) const;
+	double GetThrusterMax0(THRUSTER_HANDLE th) const;
+	double GetThrusterGroupLevel(THGROUP_TYPE thgt) const;
+
+	// Visuals
+	unsigned int AddMesh(const char* meshname, const VECTOR3* ofs = 0) const;
+	bool ClearMeshes() const;
+
+	// Headless access to the state Orbiter would otherwise own
+	StubVessel& Stub() const { return stub; }
+
+protected:
+	OBJHANDLE handle;
+	mutable StubVessel stub;
+};
+
+class VESSEL2 : public VESSEL {
+public:
+	VESSEL2(OBJHANDLE hVessel, int fmodel = 1) : VESSEL(hVessel, fmodel) {}
+	virtual void clbkSetClassCaps(FILEHANDLE cfg) {}
+	virtual void clbkPostCreation() {}
+	virtual void clbkSaveState(FILEHANDLE scn) {}
+	virtual void clbkLoadStateEx(FILEHANDLE scn, void* status);
+	virtual void clbkPreStep(double SimT, double SimDT, double MJD) {}
+	virtual void clbkPostStep(double SimT, double SimDT, double MJD) {}
+	virtual int clbkConsumeBufferedKey(DWORD key, bool down, char* kstate) { return 0; }
+};
+
+class VESSEL3 : public VESSEL2 {
+public:
+	VESSEL3(OBJHANDLE hVessel, int fmodel = 1) : VESSEL2(hVessel, fmodel) {}
+};
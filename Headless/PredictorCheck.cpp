@@ -0,0 +1,189 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// PredictorCheck.cpp
+// Check of the trajectory predictor: compares its predictions with
+// the nominal descent as flown, times a prediction and the frame path
+// calls, and flies the descent with the predictor thread running and
+// with the predicted ignition time
+//
+// ==============================================================
+
+#include "HeadlessDescent.h"
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Events of a flown descent
+struct FlownEvents {
+	double ignitionTime = 0, burnoutTime = 0, burnoutAltitude = 0, burnoutVr = 0, burnoutVh = 0;
+	DescentResult result;
+};
+
+static void radarState(StubVessel const& s, double& altitude, double& vr, double& vh)
+// Height above terrain and vertical and horizontal surface relative velocity of the true state
+{
+	VECTOR3 up = unit(s.rpos);
+	altitude = length(s.rpos) - MOON_RADIUS - s.elevation;
+	vr = dotp(s.rvel, up);
+	vh = length(s.rvel - up * vr);
+}
+
+static FlownEvents fly(ScenarioState const& init, DescentConfig const& dc, double const* at, size_t count,
+	std::vector<Prediction>& predictions)
+// Fly a descent, predicting synchronously at the given times, and record its retro ignition and burnout
+{
+	HeadlessDescent descent(init, VesselDispersion(), dc);
+	Surveyor& sc = descent.vessel();
+	FlownEvents e;
+	size_t next = 0;
+	double lastRetro = RETRO_PROP_MASS, t = 0;
+	while (!descent.finished()) {
+		descent.preStep();
+		if (next < count && t >= at[next]) {
+			PredictionInput in;
+			sc.MakePredictionInput(in, t);
+			Prediction p;
+			TrajectoryPredictor::predict(in, p);
+			predictions.push_back(p);
+			next++;
+		}
+		descent.advance();
+		t += dc.dt;
+
+		// The retro mass falls from the step it is lit, and the retro case goes at burnout
+		StubVessel const& s = sc.Stub();
+		double retro = sc.GetPropellantMass(sc.ph_retro);
+		if (e.ignitionTime == 0 && retro < lastRetro) e.ignitionTime = t - dc.dt;
+		if (e.burnoutTime == 0 && lastRetro > 0 && retro <= 0) {
+			e.burnoutTime = t;
+			radarState(s, e.burnoutAltitude, e.burnoutVr, e.burnoutVh);
+		}
+		lastRetro = retro;
+	}
+	e.result = descent.result();
+	return e;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	if (argc > 2 && std::string(argv[1]) == "--scenario") scenario = argv[2];
+	ScenarioState init;
+	if (!loadScenario(scenario, init)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	bool ok = true;
+	DescentConfig dc;
+
+	// Predictions from points along the nominal descent, against the descent as flown. The vessel samples the
+	// predictor's inputs only with the predictor on.
+	DescentConfig sampled = dc;
+	sampled.options.Predictor = 1;
+	double const at[] = { 20, 100, 200, 300, 400, 430, 460, 500, 600, 650 };
+	size_t const points = sizeof(at) / sizeof(at[0]);
+	std::vector<Prediction> p;
+	FlownEvents flown = fly(init, sampled, at, points, p);
+	printf("Flown: ignition %.2f s, burnout %.2f s at %.0f m, %.1f m/s down, %.1f m/s across; touchdown %.2f s at %.2f m/s\n\n",
+		flown.ignitionTime, flown.burnoutTime, flown.burnoutAltitude, -flown.burnoutVr, flown.burnoutVh,
+		flown.result.simTime, sqrt(flown.result.vertSpeed * flown.result.vertSpeed + flown.result.horizSpeed * flown.result.horizSpeed));
+	printf("%8s %10s %10s %10s %10s %10s %10s %12s\n", "from (s)", "ignition", "burnout", "alt (m)", "speed", "impact",
+		"speed", "optimal ign");
+	double maxBurnoutAlt = 0, maxImpactT = 0;
+	for (size_t i = 0; i < p.size(); i++) {
+		printf("%8.0f", p[i].SimT);
+		if (p[i].Burnout) {
+			double dAlt = p[i].BurnoutAltitude - flown.burnoutAltitude;
+			double speed = sqrt(p[i].BurnoutVerticalSpeed * p[i].BurnoutVerticalSpeed + p[i].BurnoutHorizontalSpeed * p[i].BurnoutHorizontalSpeed);
+			double flownSpeed = sqrt(flown.burnoutVr * flown.burnoutVr + flown.burnoutVh * flown.burnoutVh);
+			printf(" %+10.2f %+10.2f %+10.0f %+10.2f", p[i].IgnitionTime - flown.ignitionTime,
+				p[i].BurnoutTime - flown.burnoutTime, dAlt, speed - flownSpeed);
+			maxBurnoutAlt = fmax(maxBurnoutAlt, fabs(dAlt));
+		}
+		else printf(" %10s %10s %10s %10s", "-", "-", "-", "-");
+		if (p[i].Impact) {
+			printf(" %+10.2f %10.2f", p[i].ImpactTime - flown.result.simTime, p[i].ImpactSpeed);
+			maxImpactT = fmax(maxImpactT, fabs(p[i].ImpactTime - flown.result.simTime));
+		}
+		else printf(" %10s %10s", "-", "-");
+		if (p[i].Optimal) printf(" %12.2f", p[i].OptimalIgnitionTime);
+		printf("\n");
+	}
+	printf("\n%-44s %12.1f\n", "burnout altitude error, max (m)", maxBurnoutAlt);
+	printf("%-44s %12.2f\n", "touchdown time error, max (s)", maxImpactT);
+	if (!(maxBurnoutAlt < 500 && maxImpactT < 5)) ok = false;
+
+	// Cost of a prediction on the predictor thread, and of the calls on the frame path
+	{
+		HeadlessDescent descent(init, VesselDispersion(), sampled);
+		descent.preStep();
+		PredictionInput in;
+		descent.vessel().MakePredictionInput(in, 0);
+		Prediction out;
+		int const n = 20;
+		auto t0 = std::chrono::steady_clock::now();
+		for (int i = 0; i < n; i++) TrajectoryPredictor::predict(in, out);
+		double perPrediction = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / n;
+
+		PredictionChannel channel;
+		long const calls = 1000000;
+		t0 = std::chrono::steady_clock::now();
+		for (long i = 0; i < calls; i++) {
+			in.SimT = (double)i;
+			channel.submit(in);
+		}
+		double perSubmit = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / calls;
+		t0 = std::chrono::steady_clock::now();
+		double sink = 0;
+		for (long i = 0; i < calls; i++) {
+			channel.latest(out);
+			sink += out.SimT;
+		}
+		double perLatest = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() / calls;
+		printf("%-44s %12.2f\n", "prediction from the start of the descent (ms)", 1e3 * perPrediction);
+		printf("%-44s %12.1f\n", "request, frame path (ns)", 1e9 * perSubmit);
+		printf("%-44s %12.1f\n", "read of the latest result, frame path (ns)", 1e9 * perLatest + 0 * sink);
+	}
+
+	// The same descent with the predictor thread running: the autopilot reads results but flies the fixed rule, so it
+	// lands as it does without the predictor
+	{
+		DescentResult off = HeadlessDescent(init, VesselDispersion(), dc).run();
+		HeadlessDescent descent(init, VesselDispersion(), sampled);
+		Surveyor& sc = descent.vessel();
+		long results = 0;
+		double lastT = -1;
+		while (!descent.finished()) {
+			descent.preStep();
+			Prediction q;
+			if (sc.Predictions.latest(q) && q.SimT != lastT) {
+				results++;
+				lastT = q.SimT;
+			}
+			descent.advance();
+		}
+		DescentResult r = descent.result();
+		printf("%-44s %12ld\n", "results read with the predictor thread", results);
+		printf("%-44s %12.3f\n", "touchdown speed, predictor thread (m/s)", r.vertSpeed);
+		if (results == 0 || r.vertSpeed != off.vertSpeed || r.vertSpeed != flown.result.vertSpeed) ok = false;
+	}
+
+	// The descent with RETRO_DESCENT started by the predicted optimal ignition time
+	{
+		DescentConfig predicted = dc;
+		predicted.options.PredictedIgnition = 1;
+		std::vector<Prediction> none;
+		FlownEvents e = fly(init, predicted, 0, 0, none);
+		printf("%-44s %12.2f\n", "predicted ignition: ignition (s)", e.ignitionTime);
+		printf("%-44s %12.0f\n", "predicted ignition: burnout altitude (m)", e.burnoutAltitude);
+		printf("%-44s %12.0f\n", "BurnoutAltitude (m)", predicted.params.BurnoutAltitude);
+		printf("%-44s %12.3f\n", "predicted ignition: touchdown speed (m/s)", e.result.vertSpeed);
+		if (!e.result.touchdown || fabs(e.burnoutAltitude - predicted.params.BurnoutAltitude) > 500) ok = false;
+	}
+
+	printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
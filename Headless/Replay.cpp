@@ -0,0 +1,97 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Replay.cpp
+// Replays recorded flights through the autopilot and compares the
+// thruster commands with the recorded ones
+//
+// ==============================================================
+
+#include "Replay.h"
+#include <chrono>
+#include <cstring>
+
+ReplayResult Replay::run(TelemetryReader const& tlm) const
+// Replay every record of a telemetry file
+{
+	ReplayResult result;
+	auto start = std::chrono::steady_clock::now();
+
+	// Stand-in vessel providing the thruster handles and actuator buffer the autopilot writes to, and an autopilot
+	// with the same parameters and guidance table as a vessel created now
+	Surveyor sc(0, 1);
+	sc.clbkSetClassCaps(0);
+	AutoPilot ap = sc.GetAutoPilot();
+	ControlScheduler sched;
+	StateFrame sf;
+	memset(&sf, 0, sizeof(sf));
+
+	double r[TLM_COLUMNS];
+	for (uint64_t k = 0; k < tlm.records(); k++) {
+		tlm.read(k, r);
+
+		// Rebuild the state frame from the recorded sensor inputs, as SampleState derives it. The empty mass is that of
+		// the staging the retro propellant implies, which the flight's staging sequence follows from a consistent start.
+		sf.SimT = r[TLM_SIMT];
+		sf.SimDT = r[TLM_SIMDT];
+		sf.Airspeed = _V(r[TLM_VX], r[TLM_VY], r[TLM_VZ]);
+		sf.AngularVel = _V(r[TLM_WX], r[TLM_WY], r[TLM_WZ]);
+		sf.Altitude = r[TLM_ALTITUDE];
+		sf.SurfaceElevation = r[TLM_ELEVATION];
+		sf.PropVernier = r[TLM_PROP_VERNIER];
+		sf.PropRCS = r[TLM_PROP_RCS];
+		sf.PropRetro = r[TLM_PROP_RETRO];
+		sf.EmptyMass = Surveyor::CalcEmptyMass(sf.PropRetro);
+		sf.Pitch = r[TLM_PITCH];
+		sf.Yaw = r[TLM_YAW];
+		sf.Roll = r[TLM_ROLL];
+		memcpy(sf.Horizon.data, &r[TLM_HORIZON_11], sizeof(sf.Horizon.data));
+		sc.CompleteState(sf);
+
+		sched.step(&sc, ap, sf);
+		sc.Actuators.flush(&sc);
+
+		bool allocation = ap.getOptions().ControlAllocation != 0;
+		double out[REPLAY_OUTPUTS] = {
+			(double)ap.getMode(),
+			sc.Actuators.getLevel(&sc, sc.th_vernier[0]),
+			sc.Actuators.getLevel(&sc, sc.th_vernier[1]),
+			sc.Actuators.getLevel(&sc, sc.th_vernier[2]),
+			ap.getAlpha(),
+			sc.Actuators.getLevel(&sc, sc.th_retro)
+		};
+		for (int i = 0; i < 6; i++) out[6 + i] = allocation ? sc.Actuators.getLevel(&sc, sc.th_rcs[i]) : 0;
+		for (int i = 0; i < REPLAY_OUTPUTS; i++) {
+			double recorded = r[ReplayColumns[i]];
+			double err = fabs(out[i] - recorded);
+			bool same = Config.tolerance > 0 ? err <= Config.tolerance : memcmp(&out[i], &recorded, sizeof(double)) == 0;
+			if (err > result.maxError[i] || err != err) result.maxError[i] = err;
+			if (same) continue;
+			if ((int)result.first.size() < Config.maxReport) {
+				ReplayMismatch m = { k, sf.SimT, ReplayColumns[i], recorded, out[i] };
+				result.first.push_back(m);
+			}
+			result.mismatches++;
+		}
+		result.records++;
+	}
+
+	result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+void Replay::printResult(std::string const& name, ReplayResult const& r, FILE* out)
+// Print the comparison of one recording
+{
+	fprintf(out, "%s: %llu records, %llu mismatches, %.3g records/s\n", name.c_str(),
+		(unsigned long long)r.records, (unsigned long long)r.mismatches, r.wallTime > 0 ? r.records / r.wallTime : 0.0);
+	fprintf(out, "  max error:");
+	for (int i = 0; i < REPLAY_OUTPUTS; i++) fprintf(out, " %s %.3g", TelemetryColumnNames[ReplayColumns[i]], r.maxError[i]);
+	fprintf(out, "\n");
+	for (ReplayMismatch const& m : r.first) {
+		fprintf(out, "  record %llu  SimT %.3f  %-9s recorded %.17g  replayed %.17g\n", (unsigned long long)m.record, m.simT,
+			TelemetryColumnNames[m.column], m.recorded, m.replayed);
+	}
+}
@@ -0,0 +1,57 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Replay.h
+// Declarations for replaying recorded flights through the autopilot
+//
+// ==============================================================
+
+#pragma once
+
+#include "Surveyor.h"
+#include "TelemetryReader.h"
+#include <string>
+#include <vector>
+
+// Autopilot outputs compared against the recording
+const int REPLAY_OUTPUTS = 12;
+const int ReplayColumns[REPLAY_OUTPUTS] = { TLM_MODE, TLM_VERNIER_1, TLM_VERNIER_2, TLM_VERNIER_3, TLM_ALPHA, TLM_RETRO,
+	TLM_RCS_1, TLM_RCS_2, TLM_RCS_3, TLM_RCS_4, TLM_RCS_5, TLM_RCS_6 };
+
+// Settings for a replay
+struct ReplayConfig {
+	double tolerance = 0;  // Largest accepted absolute difference; 0 requires bit-identical outputs
+	int maxReport = 10;    // Mismatches kept in the result for printing
+};
+
+// One replayed output that differs from the recording
+struct ReplayMismatch {
+	uint64_t record;   // Record index
+	double simT;       // Simulation time of the record [s]
+	int column;        // TelemetryColumn of the output
+	double recorded;   // Recorded value
+	double replayed;   // Value produced by the replay
+};
+
+// Outcome of replaying one recording
+struct ReplayResult {
+	uint64_t records = 0;                       // Records replayed
+	uint64_t mismatches = 0;                    // Outputs outside the tolerance
+	double maxError[REPLAY_OUTPUTS] = { 0 };    // Largest absolute difference per output
+	std::vector<ReplayMismatch> first;          // First mismatches, up to ReplayConfig::maxReport
+	double wallTime = 0;                        // Time taken [s]
+};
+
+// Replay class declaration. The recorded sensor inputs of each step are fed to AutoPilot::autopilotUpdate
+// on a stand-in Surveyor, as fast as the processor allows, and the thruster commands it produces are
+// compared with the recorded commands.
+class Replay {
+public:
+	explicit Replay(ReplayConfig const& cfg) : Config(cfg) {}
+	ReplayResult run(TelemetryReader const& tlm) const;
+	static void printResult(std::string const& name, ReplayResult const& r, FILE* out);
+private:
+	ReplayConfig Config;
+};
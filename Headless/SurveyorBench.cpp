@@ -0,0 +1,309 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// SurveyorBench.cpp
+// Benchmark suite for the autopilot hot path: micro benchmarks of
+// the control routines on random vehicle states, and a macro
+// benchmark of the full descent from SurveyorLanding.scn. Results
+// can be written as CSV and compared with an earlier run to catch
+// performance regressions.
+//
+// ==============================================================
+
+#include "HeadlessDescent.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+
+// Random vehicle states cycled through by the micro benchmarks
+const size_t BENCH_STATES = 1024;
+
+// Suite settings
+struct BenchConfig {
+	double minTime = 0.1;        // Shortest timed trial of a micro benchmark [s]
+	int trials = 5;              // Trials per micro benchmark; the fastest is reported
+	int descents = 5;            // Descents flown by the macro benchmark, one per trial
+	double dt = 0.02;            // Frame length of the macro benchmark [s]
+	std::string filter;          // Run only benchmarks whose name contains this
+	ScenarioState scenario;      // Initial state of the macro benchmark
+};
+
+// Result of one benchmark
+struct BenchResult {
+	std::string name;            // Benchmark name
+	std::string kind;            // "micro" or "macro"
+	long long ops = 0;           // Operations timed per trial
+	double nsPerOp = 0;          // Time per operation in the fastest trial [ns]
+	double opsPerSec = 0;        // Operations per second in the fastest trial
+};
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+template <class F>
+static BenchResult runMicro(char const* name, BenchConfig const& cfg, F op)
+// Time op(i) over the state set. The repetition count is doubled until one pass takes minTime, then the
+// fastest of the trials is reported, as the one least disturbed by the rest of the machine.
+{
+	long long reps = 1;
+	for (;;) {
+		auto t0 = std::chrono::steady_clock::now();
+		for (long long r = 0; r < reps; r++) for (size_t i = 0; i < BENCH_STATES; i++) op(i);
+		if (seconds(t0) >= cfg.minTime || reps >= (1LL << 30)) break;
+		reps *= 2;
+	}
+
+	std::vector<double> t(cfg.trials);
+	for (double& ti : t) {
+		auto t0 = std::chrono::steady_clock::now();
+		for (long long r = 0; r < reps; r++) for (size_t i = 0; i < BENCH_STATES; i++) op(i);
+		ti = seconds(t0);
+	}
+	std::sort(t.begin(), t.end());
+
+	BenchResult b;
+	b.name = name;
+	b.kind = "micro";
+	b.ops = reps * (long long)BENCH_STATES;
+	b.nsPerOp = 1e9 * t[0] / b.ops;
+	b.opsPerSec = b.ops / t[0];
+	return b;
+}
+
+static bool selected(BenchConfig const& cfg, char const* name)
+{
+	return cfg.filter.empty() || std::string(name).find(cfg.filter) != std::string::npos;
+}
+
+static void microBenchmarks(BenchConfig const& cfg, std::vector<BenchResult>& results)
+// Control routines on random states covering the final descent: attitude errors from the deadband to
+// saturation, radar altitudes up to GuidanceAltitude, and the lander's mass range
+{
+	Surveyor sc(0, 1);
+	sc.clbkSetClassCaps(0);
+	AutoPilotParams params;
+
+	std::mt19937_64 rng(42);
+	std::normal_distribution<double> N(0.0, 1.0);
+	std::uniform_real_distribution<double> U(0.0, 1.0);
+	std::vector<StateFrame> states(BENCH_STATES);
+	std::vector<VECTOR3> omegaD(BENCH_STATES);
+	std::vector<double> level(BENCH_STATES);
+	for (size_t i = 0; i < BENCH_STATES; i++) {
+		StateFrame& sf = states[i];
+		memset(&sf, 0, sizeof(sf));
+		double ang = pow(10.0, -3.5 + 4 * U(rng));
+		double psi = 2 * PI * U(rng);
+		double speed = 1 + 500 * U(rng);
+		sf.Airspeed = _V(sin(ang) * cos(psi), sin(ang) * sin(psi), -cos(ang)) * speed;
+		sf.AngularVel = _V(N(rng), N(rng), N(rng)) * pow(10.0, -5 + 3 * U(rng));
+		sf.SurfaceElevation = 500 * N(rng);
+		sf.Altitude = sf.SurfaceElevation + params.ShutdownAltitude + (params.GuidanceAltitude - params.ShutdownAltitude) * U(rng);
+		sf.PropVernier = VERNIER_PROP_MASS * U(rng);
+		sf.PropRCS = RCS_PROP_MASS * U(rng);
+		sf.EmptyMass = Surveyor::CalcEmptyMass(sf.PropRetro);
+		sc.CompleteState(sf);
+		omegaD[i] = _V(N(rng), N(rng), N(rng)) * 0.01;
+		level[i] = U(rng) < 0.3 ? 0.0 : U(rng);
+	}
+
+	AutoPilot ap;
+	ap.setParams(params);
+	if (selected(cfg, "vernierControl")) {
+		results.push_back(runMicro("vernierControl", cfg, [&](size_t i) { ap.vernierControl(&sc, states[i], level[i]); }));
+	}
+	if (selected(cfg, "angularVelocityController")) {
+		results.push_back(runMicro("angularVelocityController", cfg, [&](size_t i) {
+			ap.angularVelocityController(&sc, omegaD[i], states[i].AngularVel, level[i]);
+		}));
+	}
+	if (selected(cfg, "finalDescent/formula")) {
+		ap.setGuidance(0);
+		results.push_back(runMicro("finalDescent/formula", cfg, [&](size_t i) { ap.finalDescent(&sc, states[i]); }));
+	}
+	if (selected(cfg, "finalDescent/table")) {
+		GuidanceTable table;
+		if (table.open("Config/Surveyor/FinalDescent.gdt") && table.matches(params)) {
+			ap.setGuidance(&table);
+			results.push_back(runMicro("finalDescent/table", cfg, [&](size_t i) { ap.finalDescent(&sc, states[i]); }));
+			ap.setGuidance(0);
+		}
+		else {
+			fprintf(stderr, "Skipping finalDescent/table: Config/Surveyor/FinalDescent.gdt is missing or out of date\n");
+		}
+	}
+	if (selected(cfg, "CalcEmptyMass")) {
+		std::vector<double> retro(BENCH_STATES);
+		for (double& r : retro) r = U(rng) < 0.2 ? RETRO_PROP_MASS : RETRO_PROP_MASS * U(rng) * U(rng);
+		volatile double sink = 0;
+		results.push_back(runMicro("CalcEmptyMass", cfg, [&](size_t i) { sink = sink + sc.CalcEmptyMass(retro[i]); }));
+	}
+	if (selected(cfg, "printDebugString")) {
+		results.push_back(runMicro("printDebugString", cfg, [&](size_t i) { ap.printDebugString(&sc, states[i], "Final descent"); }));
+	}
+	if (selected(cfg, "navigation/update")) {
+		// Roll axis up, so the radar beams see the surface below GuidanceAltitude
+		Navigation nav;
+		nav.reset(1);
+		long long step = 0;
+		MATRIX3 horizon = _M(1, 0, 0, 0, 0, 1, 0, 1, 0);
+		VECTOR3 thrust = _V(0, 0, 3 * VERNIER_THRUST * 0.6);
+		results.push_back(runMicro("navigation/update", cfg, [&](size_t i) {
+			StateFrame sf = states[i];
+			sf.SimT = 0.02 * ++step;
+			sf.Horizon = horizon;
+			nav.update(sf, thrust, false);
+		}));
+	}
+	if (selected(cfg, "telemetryBus/publish")) {
+		TelemetryBus bus;
+		if (bus.open("SurveyorBench")) {
+			TelemetryBusSample s = TelemetryBusSample();
+			results.push_back(runMicro("telemetryBus/publish", cfg, [&](size_t i) {
+				s.SimT = states[i].SimT;
+				s.Altitude = states[i].Altitude;
+				bus.publish(s);
+			}));
+		}
+	}
+}
+
+static void macroBenchmarks(BenchConfig const& cfg, std::vector<BenchResult>& results)
+// The nominal descent from 1000 km to touchdown, timed per frame. The micro benchmark vessel is gone by
+// now, so the autopilot manager only steps the descending vessel.
+{
+	if (!selected(cfg, "descent")) return;
+	DescentConfig dc;
+	dc.dt = cfg.dt;
+	std::vector<double> t(cfg.descents);
+	long steps = 0;
+	for (double& ti : t) {
+		HeadlessDescent descent(cfg.scenario, VesselDispersion(), dc);
+		auto t0 = std::chrono::steady_clock::now();
+		DescentResult r = descent.run();
+		ti = seconds(t0) / r.steps;
+		steps = r.steps;
+		if (!r.touchdown) fprintf(stderr, "Warning: the benchmark descent timed out at %.0f s\n", r.simTime);
+	}
+	std::sort(t.begin(), t.end());
+
+	char name[32];
+	sprintf(name, "descent/dt%g", cfg.dt);
+	BenchResult b;
+	b.name = name;
+	b.kind = "macro";
+	b.ops = steps;
+	b.nsPerOp = 1e9 * t[0];
+	b.opsPerSec = 1 / t[0];
+	results.push_back(b);
+}
+
+static bool writeCsv(std::vector<BenchResult> const& results, char const* path)
+{
+	FILE* f = fopen(path, "w");
+	if (!f) return false;
+	fprintf(f, "benchmark,kind,ops,ns_per_op,ops_per_s\n");
+	for (BenchResult const& b : results) fprintf(f, "%s,%s,%lld,%.4f,%.6g\n", b.name.c_str(), b.kind.c_str(), b.ops, b.nsPerOp, b.opsPerSec);
+	return fclose(f) == 0;
+}
+
+static bool readCsv(char const* path, std::map<std::string, double>& nsPerOp)
+// Time per operation of each benchmark in a file written by writeCsv
+{
+	std::ifstream in(path);
+	if (!in) return false;
+	std::string line;
+	std::getline(in, line);
+	while (std::getline(in, line)) {
+		std::istringstream row(line);
+		std::string name, kind, ops, ns;
+		if (std::getline(row, name, ',') && std::getline(row, kind, ',') && std::getline(row, ops, ',') && std::getline(row, ns, ',')) {
+			nsPerOp[name] = atof(ns.c_str());
+		}
+	}
+	return true;
+}
+
+static void usage()
+{
+	printf("Usage: SurveyorBench [options]\n"
+		"  --filter TEXT     run only benchmarks whose name contains TEXT\n"
+		"  --min-time S      shortest timed trial of a micro benchmark (default 0.1)\n"
+		"  --trials N        trials per micro benchmark, fastest reported (default 5)\n"
+		"  --descents N      descents flown by the macro benchmark, fastest reported (default 5)\n"
+		"  --dt S            frame length of the macro benchmark (default 0.02)\n"
+		"  --scenario FILE   Orbiter scenario for the macro benchmark\n"
+		"                    (default Scenarios/Surveyor/SurveyorLanding.scn)\n"
+		"  --csv FILE        write the results to FILE\n"
+		"  --baseline FILE   compare with results written by an earlier --csv run\n"
+		"  --tolerance X     slowdown allowed against the baseline, as a fraction (default 0.1)\n"
+		"Exits with status 1 if a benchmark is slower than the baseline by more than the tolerance.\n");
+}
+
+int main(int argc, char* argv[])
+{
+	BenchConfig cfg;
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	const char* csv = 0;
+	const char* baseline = 0;
+	double tolerance = 0.1;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--filter" && more) cfg.filter = argv[++i];
+		else if (arg == "--min-time" && more) cfg.minTime = atof(argv[++i]);
+		else if (arg == "--trials" && more) cfg.trials = std::max(1, atoi(argv[++i]));
+		else if (arg == "--descents" && more) cfg.descents = std::max(1, atoi(argv[++i]));
+		else if (arg == "--dt" && more) cfg.dt = atof(argv[++i]);
+		else if (arg == "--scenario" && more) scenario = argv[++i];
+		else if (arg == "--csv" && more) csv = argv[++i];
+		else if (arg == "--baseline" && more) baseline = argv[++i];
+		else if (arg == "--tolerance" && more) tolerance = atof(argv[++i]);
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	std::map<std::string, double> base;
+	if (baseline && !readCsv(baseline, base)) {
+		fprintf(stderr, "Could not read %s\n", baseline);
+		return 1;
+	}
+	if (!loadScenario(scenario, cfg.scenario)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+
+	std::vector<BenchResult> results;
+	microBenchmarks(cfg, results);
+	macroBenchmarks(cfg, results);
+
+	bool ok = true;
+	printf("%-28s %6s %14s %14s %10s\n", "Benchmark", "kind", "ns/op", "ops/s", "vs base");
+	for (BenchResult const& b : results) {
+		printf("%-28s %6s %14.2f %14.4g", b.name.c_str(), b.kind.c_str(), b.nsPerOp, b.opsPerSec);
+		std::map<std::string, double>::const_iterator it = base.find(b.name);
+		if (it != base.end() && it->second > 0) {
+			double change = b.nsPerOp / it->second - 1;
+			bool slower = change > tolerance;
+			printf(" %+9.1f%%%s", 100 * change, slower ? "  REGRESSION" : "");
+			if (slower) ok = false;
+		}
+		printf("\n");
+	}
+
+	if (csv && !writeCsv(results, csv)) {
+		fprintf(stderr, "Could not write %s\n", csv);
+		return 1;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// SurveyorGuidance.cpp
+// Offline generator for the final descent guidance table
+//
+// ==============================================================
+
+#include "GuidanceFormat.h"
+#include "AutoPilotParams.h"
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+/* Each table node holds the constant vernier thrust level that takes the lander from the node's state to
+   the target speed within AimFraction of its altitude. The lander is taken to fly straight down with the
+   thrust opposing its velocity, as the autopilot keeps it, and its mass falls as propellant is burnt.
+   With a = F / m0 and r = F / (Isp m0), the speed and distance travelled after a time t are
+
+     v(t) = v0 + g t + Isp ln(1 - r t)
+     s(t) = v0 t + g t^2 / 2 - (Isp / r) ((1 - r t) ln(1 - r t) + r t)
+
+   The speed at the aim point falls monotonically with the thrust level, so the level is found by bisection. */
+
+// Constant thrust burn straight down
+struct Burn {
+	double v0;   // Initial descent speed [m/s]
+	double a;    // Initial thrust acceleration [m/s^2]
+	double r;    // Initial mass flow per unit mass [1/s]
+	double ve;   // Exhaust velocity [m/s]
+	double g;    // Gravity [m/s^2]
+
+	double speed(double t) const
+	{
+		return v0 + g * t + ve * log1p(-r * t);
+	}
+
+	double distance(double t) const
+	{
+		double x = r * t;
+		// (1 - x) ln(1 - x) + x, by its series when x is too small for the closed form to be accurate
+		double y = x < 1e-3 ? x * x * (0.5 + x * (1.0 / 6 + x / 12)) : (1 - x) * log1p(-x) + x;
+		return v0 * t + 0.5 * g * t * t - (r > 0 ? ve * y / r : 0);
+	}
+};
+
+// Speed after descending a distance d, or 0 if the lander stops first
+static double speedAfter(Burn const& b, double d)
+{
+	// Bisect for the end of the interval in which the lander is still moving and short of d. At t = 0
+	// a lander at rest is moving if gravity exceeds the thrust.
+	auto moving = [&](double t) {
+		return b.r * t < 0.999 && b.distance(t) < d && (t > 0 ? b.speed(t) > 0 : b.v0 > 0 || b.g > b.a);
+	};
+	if (!moving(0)) return d > 0 ? 0 : b.v0;
+	double lo = 0, hi = 1;
+	while (moving(hi) && hi < 1e6) {
+		lo = hi;
+		hi *= 2;
+	}
+	for (int i = 0; i < 100 && hi - lo > 1e-9 * hi; i++) {
+		double mid = 0.5 * (lo + hi);
+		if (moving(mid)) lo = mid;
+		else hi = mid;
+	}
+	return max(b.speed(hi), 0);
+}
+
+// Constant thrust level, as a fraction of the total vernier thrust, that reaches speed vf after descending d
+static double solveLevel(GuidanceFileHeader const& h, double d, double v0, double m0, double vf)
+{
+	Burn b = { v0, 0, 0, h.Isp, h.Gravity };
+	auto endSpeed = [&](double level) {
+		b.a = level * h.Thrust / m0;
+		b.r = b.a / h.Isp;
+		return speedAfter(b, d);
+	};
+	if (endSpeed(0) <= vf) return 0;
+	if (endSpeed(1) >= vf) return 1;
+	double lo = 0, hi = 1;
+	for (int i = 0; i < 40; i++) {
+		double mid = 0.5 * (lo + hi);
+		if (endSpeed(mid) > vf) lo = mid;
+		else hi = mid;
+	}
+	return 0.5 * (lo + hi);
+}
+
+static void usage()
+{
+	printf("Usage: SurveyorGuidance [options]\n"
+		"  --out FILE          table file (default Config/Surveyor/FinalDescent.gdt)\n"
+		"  --params FILE       autopilot parameters with the target speeds (default: design values)\n"
+		"  --altitudes N       altitude nodes (default 96)\n"
+		"  --speeds N          descent speed nodes (default 96)\n"
+		"  --masses N          mass nodes (default 4)\n"
+		"  --max-altitude M    altitude of the last node (default 30000)\n"
+		"  --max-speed V       speed of the last node (default 500)\n"
+		"  --aim F             fraction of the altitude in which to reach the target speed (default 0.45)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	AutoPilotParams params;
+	const char* out = "Config/Surveyor/FinalDescent.gdt";
+
+	GuidanceFileHeader h = {};
+	memcpy(h.Magic, GDT_MAGIC, sizeof(GDT_MAGIC));
+	h.Version = GDT_VERSION;
+	h.Altitudes = 96;
+	h.Speeds = 96;
+	h.Masses = 4;
+	h.MaxAltitude = 30000;
+	h.MaxSpeed = 500;
+	h.MinMass = LANDER_EMPTY_MASS;
+	h.MaxMass = LANDER_EMPTY_MASS + VERNIER_PROP_MASS + RCS_PROP_MASS;
+	h.AimFraction = 0.45;
+	h.Thrust = 3 * VERNIER_THRUST;
+	h.Isp = VERNIER_ISP;
+	h.Gravity = g;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--out" && more) out = argv[++i];
+		else if (arg == "--altitudes" && more) h.Altitudes = (uint32_t)atoi(argv[++i]);
+		else if (arg == "--speeds" && more) h.Speeds = (uint32_t)atoi(argv[++i]);
+		else if (arg == "--masses" && more) h.Masses = (uint32_t)atoi(argv[++i]);
+		else if (arg == "--max-altitude" && more) h.MaxAltitude = atof(argv[++i]);
+		else if (arg == "--max-speed" && more) h.MaxSpeed = atof(argv[++i]);
+		else if (arg == "--aim" && more) h.AimFraction = atof(argv[++i]);
+		else if (arg == "--params" && more) {
+			FILEHANDLE f = oapiOpenFile(argv[++i], FILE_IN_ZEROONFAIL);
+			if (!f) {
+				fprintf(stderr, "Could not read %s\n", argv[i]);
+				return 1;
+			}
+			params.read(f);
+			oapiCloseFile(f, FILE_IN);
+		}
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	if (h.Altitudes < 2 || h.Speeds < 2 || h.Masses < 2 || !(h.MaxAltitude > 0) || !(h.MaxSpeed > 0) ||
+		!(h.AimFraction > 0 && h.AimFraction <= 1)) {
+		usage();
+		return 1;
+	}
+	h.TargetSpeed[GDT_APPROACH] = params.ApproachSpeed;
+	h.TargetSpeed[GDT_TERMINAL] = params.TerminalSpeed;
+
+	// Solve every node, in file order
+	auto start = std::chrono::steady_clock::now();
+	std::vector<float> levels((size_t)GDT_TARGETS * h.Masses * h.Speeds * h.Altitudes);
+	size_t n = 0;
+	for (int target = 0; target < GDT_TARGETS; target++) {
+		for (uint32_t im = 0; im < h.Masses; im++) {
+			double m = h.MinMass + (h.MaxMass - h.MinMass) * im / (h.Masses - 1);
+			for (uint32_t iv = 0; iv < h.Speeds; iv++) {
+				double sv = (double)iv / (h.Speeds - 1);
+				double v = h.MaxSpeed * sv * sv;
+				for (uint32_t ia = 0; ia < h.Altitudes; ia++) {
+					double s = (double)ia / (h.Altitudes - 1);
+					double altitude = h.MaxAltitude * s * s;
+					levels[n++] = (float)solveLevel(h, h.AimFraction * altitude, v, m, h.TargetSpeed[target]);
+				}
+			}
+		}
+	}
+	double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	FILE* f = fopen(out, "wb");
+	if (!f) {
+		fprintf(stderr, "Could not write %s\n", out);
+		return 1;
+	}
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(levels.data(), sizeof(float), levels.size(), f) == levels.size();
+	ok = fclose(f) == 0 && ok;
+	if (!ok) {
+		fprintf(stderr, "Could not write %s\n", out);
+		return 1;
+	}
+	printf("Solved %zu nodes in %.2f s: %u altitudes to %.0f m, %u speeds to %.0f m/s, %u masses %.2f-%.2f kg\n",
+		levels.size(), t, h.Altitudes, h.MaxAltitude, h.Speeds, h.MaxSpeed, h.Masses, h.MinMass, h.MaxMass);
+	printf("Target speeds %g and %g m/s within %g of the altitude; wrote %s\n",
+		h.TargetSpeed[GDT_APPROACH], h.TargetSpeed[GDT_TERMINAL], h.AimFraction, out);
+	return 0;
+}
@@ -0,0 +1,117 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// SurveyorMC.cpp
+// Command line front end for the headless Monte Carlo descent engine
+//
+// ==============================================================
+
+#include "MonteCarlo.h"
+#include "Profiler.h"
+#include "TerrainModels.h"
+#include <cstdlib>
+#include <memory>
+
+static void usage()
+{
+	printf("Usage: SurveyorMC [options]\n"
+		"  --runs N          number of descents (default 1000)\n"
+		"  --threads N       worker threads, 0 for all cores (default 0)\n"
+		"  --seed N          base random seed (default 1)\n"
+		"  --dt S            frame length in seconds (default 0.02)\n"
+		"  --tolerance TOL   integrate each frame with the adaptive Dormand-Prince integrator to relative\n"
+		"                    error TOL per step, instead of one RK4 step\n"
+		"  --scenario FILE   Orbiter scenario with the initial state\n"
+		"                    (default Scenarios/Surveyor/SurveyorLanding.scn)\n"
+		"  --nominal         fly every run from the undispersed state\n"
+		"  --branch T        fly the undispersed state to T seconds once, and fork every run from there;\n"
+		"                    only the engine and terrain dispersions apply\n"
+		"  --csv FILE        write per-run results to FILE\n"
+		"  --telemetry DIR   record each run to DIR/runNNNNN.tlm\n"
+		"  --params FILE     autopilot parameters, as written by SurveyorTune\n"
+		"  --terrain SOURCE  fly over terrain instead of a dispersed flat site elevation:\n"
+		"                    'synthetic' for procedural terrain, or a DEM file\n"
+		"  --sensors         fly on the radar models and navigation filter instead of the true state\n"
+		"  --coast           skip the frames in which every thruster is off, propagating the orbit in one step\n"
+		"  --lockstep        solve descent optimizer requests (ConvexDescent) in the frame they are made\n"
+		"  --bus             publish each run to a live telemetry bus named runNNNNN, for SurveyorMonitor\n"
+		"  --pace X          fly X simulated seconds per second, 0 for as fast as possible (default 0)\n");
+}
+
+int main(int argc, char* argv[])
+{
+	MonteCarloConfig cfg;
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	const char* csv = 0;
+	const char* terrain = 0;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--runs" && more) cfg.runs = atoi(argv[++i]);
+		else if (arg == "--threads" && more) cfg.threads = (unsigned)atoi(argv[++i]);
+		else if (arg == "--seed" && more) cfg.seed = strtoull(argv[++i], 0, 10);
+		else if (arg == "--dt" && more) cfg.descent.dt = atof(argv[++i]);
+		else if (arg == "--tolerance" && more) cfg.descent.tolerance = atof(argv[++i]);
+		else if (arg == "--scenario" && more) scenario = argv[++i];
+		else if (arg == "--csv" && more) csv = argv[++i];
+		else if (arg == "--telemetry" && more) cfg.telemetryDir = argv[++i];
+		else if (arg == "--params" && more) {
+			FILEHANDLE f = oapiOpenFile(argv[++i], FILE_IN_ZEROONFAIL);
+			if (!f) {
+				fprintf(stderr, "Could not read %s\n", argv[i]);
+				return 1;
+			}
+			cfg.descent.params.read(f);
+			cfg.descent.options.read(f);
+			oapiCloseFile(f, FILE_IN);
+		}
+		else if (arg == "--terrain" && more) terrain = argv[++i];
+		else if (arg == "--nominal") cfg.disperse = false;
+		else if (arg == "--branch" && more) cfg.branchTime = atof(argv[++i]);
+		else if (arg == "--sensors") cfg.descent.options.Sensors = 1;
+		else if (arg == "--coast") cfg.descent.coast = true;
+		else if (arg == "--lockstep") cfg.descent.lockstep = true;
+		else if (arg == "--bus") cfg.publish = true;
+		else if (arg == "--pace" && more) cfg.descent.pace = atof(argv[++i]);
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	if (!loadScenario(scenario, cfg.nominal)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+
+	// One terrain cache for the whole batch
+	std::unique_ptr<TerrainSource> source;
+	std::unique_ptr<TerrainService> service;
+	if (terrain) {
+		if (std::string(terrain) == "synthetic") source.reset(new SyntheticTerrain());
+		else {
+			DemTerrain* dem = new DemTerrain();
+			source.reset(dem);
+			if (!dem->open(terrain)) {
+				fprintf(stderr, "Could not read %s\n", terrain);
+				return 1;
+			}
+		}
+		service.reset(new TerrainService(*source));
+		cfg.descent.terrain = service.get();
+	}
+
+	MonteCarlo mc(cfg);
+	std::vector<RunResult> results = mc.run();
+	MonteCarlo::printSummary(mc.summarize(results), stdout);
+	if (service) printf("Terrain tiles loaded %zu, cache misses %llu\n", service->tiles(), service->misses());
+	PROFILE_REPORT();
+
+	if (csv && !MonteCarlo::writeCsv(results, csv)) {
+		fprintf(stderr, "Could not write %s\n", csv);
+		return 1;
+	}
+	return 0;
+}
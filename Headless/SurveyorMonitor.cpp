@@ -0,0 +1,112 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// SurveyorMonitor.cpp
+// Sample consumer of the live telemetry bus: follows one vessel and
+// prints its state as it flies
+//
+// ==============================================================
+
+#include "TelemetryBusReader.h"
+#include "AutoPilotModes.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+static void usage()
+{
+	printf("Usage: SurveyorMonitor VESSEL [options]\n"
+		"  --history         start with the oldest sample still on the bus rather than the next one\n"
+		"  --every N         print every Nth sample (default 50)\n"
+		"  --csv             print samples as CSV\n"
+		"  --wait S          wait up to S seconds for the vessel's bus to appear (default 10)\n"
+		"  --poll MS         time between polls of the bus (default 20)\n");
+}
+
+static void printSample(TelemetryBusSample const& s, bool csv)
+{
+	if (csv) {
+		printf("%.3f,%d,%d,%.3f,%.3f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.5f,%.4f,%.3f,%.3f,%.3f\n", s.SimT, s.Mode,
+			s.Status, s.Altitude, s.RadarAltitude, s.Velocity[0], s.Velocity[1], s.Velocity[2], s.Speed, s.Vernier[0],
+			s.Vernier[1], s.Vernier[2], s.Alpha, s.Retro, s.PropVernier, s.PropRetro, s.Mass);
+		return;
+	}
+	const char* mode = s.Mode >= 0 && s.Mode < AUTOPILOT_MODES ? AutoPilotModeNames[s.Mode] : "?";
+	printf("%9.2f  %-24s %d  %11.1f %10.1f  %8.2f  %5.3f %5.3f %5.3f  %5.3f\n", s.SimT, mode, s.Status, s.Altitude,
+		s.RadarAltitude, s.Speed, s.Vernier[0], s.Vernier[1], s.Vernier[2], s.Retro);
+}
+
+int main(int argc, char* argv[])
+{
+	const char* vessel = 0;
+	bool history = false, csv = false;
+	int every = 50;
+	double wait = 10, poll = 20;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--history") history = true;
+		else if (arg == "--csv") csv = true;
+		else if (arg == "--every" && more) every = atoi(argv[++i]);
+		else if (arg == "--wait" && more) wait = atof(argv[++i]);
+		else if (arg == "--poll" && more) poll = atof(argv[++i]);
+		else if (arg[0] != '-' && !vessel) vessel = argv[i];
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	if (!vessel) {
+		usage();
+		return 1;
+	}
+	if (every < 1) every = 1;
+
+	// The bus appears when the vessel is created
+	TelemetryBusReader bus;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(wait);
+	while (!bus.open(vessel, history)) {
+		if (std::chrono::steady_clock::now() >= deadline) {
+			fprintf(stderr, "No telemetry bus for %s\n", vessel);
+			return 1;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	fprintf(stderr, "Following %s from sample %llu\n", bus.vessel(), (unsigned long long)bus.position());
+	if (csv) printf("SimT,Mode,Status,Altitude,RadarAltitude,Vx,Vy,Vz,Speed,Vernier1,Vernier2,Vernier3,Alpha,Retro,"
+		"PropVernier,PropRetro,Mass\n");
+	else printf("%9s  %-24s %s  %11s %10s  %8s  %-17s  %s\n", "SimT", "Mode", "S", "Altitude", "Radar alt", "Speed",
+		"Verniers", "Retro");
+
+	// Drain the bus on every poll, until the writer closes it
+	TelemetryBusSample s;
+	uint64_t samples = 0, lost = 0;
+	bool printedLast = false;
+	for (;;) {
+		bool live = bus.live();
+		while (bus.read(s)) {
+			printedLast = samples % every == 0;
+			if (printedLast) printSample(s, csv);
+			samples++;
+		}
+		if (bus.lost() > lost) {
+			fprintf(stderr, "Overrun: %llu samples lost\n", (unsigned long long)(bus.lost() - lost));
+			lost = bus.lost();
+		}
+		if (!live) break;
+		std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(poll));
+	}
+
+	// Always show where the vessel ended up
+	if (samples > 0 && !printedLast) printSample(s, csv);
+	fflush(stdout);
+	fprintf(stderr, "Bus closed: %llu samples read, %llu lost in %llu overruns\n", (unsigned long long)samples,
+		(unsigned long long)bus.lost(), (unsigned long long)bus.overruns());
+	return 0;
+}
@@ -0,0 +1,79 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// SurveyorReplay.cpp
+// Command line front end for regression checking the autopilot
+// against a library of recorded flights
+//
+// ==============================================================
+
+#include "Replay.h"
+#include "ThreadPool.h"
+#include <cstdlib>
+
+static void usage()
+{
+	printf("Usage: SurveyorReplay [options] FILE.tlm...\n"
+		"  --tolerance X     accept outputs within X of the recording (default 0: bit-identical)\n"
+		"  --max-report N    mismatches listed per file (default 10)\n"
+		"  --threads N       worker threads, 0 for all cores (default 0)\n"
+		"Exits with status 1 if any file differs from its recording or cannot be read.\n");
+}
+
+int main(int argc, char* argv[])
+{
+	ReplayConfig cfg;
+	unsigned threads = 0;
+	std::vector<std::string> files;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--tolerance" && more) cfg.tolerance = atof(argv[++i]);
+		else if (arg == "--max-report" && more) cfg.maxReport = atoi(argv[++i]);
+		else if (arg == "--threads" && more) threads = (unsigned)atoi(argv[++i]);
+		else if (arg.compare(0, 2, "--") == 0) {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+		else files.push_back(arg);
+	}
+	if (files.empty()) {
+		usage();
+		return 1;
+	}
+
+	// Each recording replays independently, so the library is spread over the pool
+	Replay replay(cfg);
+	std::vector<ReplayResult> results(files.size());
+	std::vector<const char*> unreadable(files.size(), (const char*)0);
+	{
+		WorkStealingPool pool(threads);
+		pool.parallelFor(0, files.size(), 1, [&](size_t i) {
+			TelemetryReader tlm;
+			if (!tlm.open(files[i].c_str())) {
+				unreadable[i] = tlm.error();
+				return;
+			}
+			results[i] = replay.run(tlm);
+		});
+	}
+
+	int failed = 0;
+	uint64_t records = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		if (unreadable[i]) {
+			printf("%s: could not read telemetry: %s\n", files[i].c_str(), unreadable[i]);
+			failed++;
+			continue;
+		}
+		Replay::printResult(files[i], results[i], stdout);
+		records += results[i].records;
+		if (results[i].mismatches) failed++;
+	}
+	printf("%d of %d recordings match, %llu records replayed\n", (int)files.size() - failed, (int)files.size(),
+		(unsigned long long)records);
+	return failed ? 1 : 0;
+}
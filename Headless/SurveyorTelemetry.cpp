@@ -0,0 +1,168 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// SurveyorTelemetry.cpp
+// Command line tool to summarise telemetry files or export them to CSV
+//
+// ==============================================================
+
+#include "TelemetryReader.h"
+#include "AutoPilotModes.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static void usage()
+{
+	printf("Usage: SurveyorTelemetry FILE [options]\n"
+		"  --csv FILE        export records to FILE ('-' for stdout) instead of printing a summary\n"
+		"  --from T          start at simulation time T (default: first record)\n"
+		"  --to T            stop after simulation time T (default: last record)\n"
+		"  --every N         keep every Nth record when exporting (default 1)\n"
+		"  --columns A,B,... export only these columns (default all)\n");
+}
+
+// Column indices from a comma separated list of names
+static bool parseColumns(const char* list, std::vector<int>& cols)
+{
+	cols.clear();
+	std::string s = list;
+	size_t start = 0;
+	while (start <= s.size()) {
+		size_t end = s.find(',', start);
+		if (end == std::string::npos) end = s.size();
+		std::string name = s.substr(start, end - start);
+		int c = 0;
+		while (c < TLM_COLUMNS && name != TelemetryColumnNames[c]) c++;
+		if (c == TLM_COLUMNS) {
+			fprintf(stderr, "Unknown column %s\n", name.c_str());
+			return false;
+		}
+		cols.push_back(c);
+		start = end + 1;
+	}
+	return true;
+}
+
+static void exportCsv(TelemetryReader const& tlm, uint64_t first, uint64_t last, int every, std::vector<int> const& cols, FILE* out)
+{
+	for (size_t i = 0; i < cols.size(); i++) fprintf(out, "%s%s", i ? "," : "", TelemetryColumnNames[cols[i]]);
+	fprintf(out, "\n");
+	double r[TLM_COLUMNS];
+	for (uint64_t k = first; k < last; k += every) {
+		tlm.read(k, r);
+		for (size_t i = 0; i < cols.size(); i++) fprintf(out, "%s%.17g", i ? "," : "", r[cols[i]]);
+		fprintf(out, "\n");
+	}
+}
+
+static void printSummary(TelemetryReader const& tlm, uint64_t first, uint64_t last)
+{
+	printf("Vessel: %s   Records: %llu of %llu   Time: %.3f to %.3f s\n", tlm.vessel(),
+		(unsigned long long)(last - first), (unsigned long long)tlm.records(),
+		tlm.value(first, TLM_SIMT), tlm.value(last - 1, TLM_SIMT));
+
+	// Column statistics, scanning one column of one block at a time
+	double lo[TLM_COLUMNS], hi[TLM_COLUMNS], sum[TLM_COLUMNS];
+	double modeTime[AUTOPILOT_MODES] = { 0 };
+	for (int c = 0; c < TLM_COLUMNS; c++) {
+		lo[c] = 1e308;
+		hi[c] = -1e308;
+		sum[c] = 0;
+	}
+	for (uint64_t b = first / TLM_BLOCK_RECORDS; b * TLM_BLOCK_RECORDS < last; b++) {
+		uint64_t base = b * TLM_BLOCK_RECORDS;
+		uint32_t count;
+		tlm.column(b, 0, count);
+		uint32_t i0 = first > base ? (uint32_t)(first - base) : 0;
+		uint32_t i1 = last - base < count ? (uint32_t)(last - base) : count;
+		for (int c = 0; c < TLM_COLUMNS; c++) {
+			const double* x = tlm.column(b, c, count);
+			for (uint32_t i = i0; i < i1; i++) {
+				if (x[i] < lo[c]) lo[c] = x[i];
+				if (x[i] > hi[c]) hi[c] = x[i];
+				sum[c] += x[i];
+			}
+		}
+		const double* mode = tlm.column(b, TLM_MODE, count);
+		const double* dt = tlm.column(b, TLM_SIMDT, count);
+		for (uint32_t i = i0; i < i1; i++) {
+			int m = (int)mode[i];
+			if (m >= 0 && m < AUTOPILOT_MODES) modeTime[m] += dt[i];
+		}
+	}
+
+	printf("\n%-24s %12s\n", "Autopilot mode", "time [s]");
+	for (int m = 0; m < AUTOPILOT_MODES; m++) {
+		if (modeTime[m] > 0) printf("%-24s %12.3f\n", AutoPilotModeNames[m], modeTime[m]);
+	}
+
+	printf("\n%-16s %14s %14s %14s %14s %14s\n", "Column", "first", "last", "min", "mean", "max");
+	for (int c = 0; c < TLM_COLUMNS; c++) {
+		printf("%-16s %14.6g %14.6g %14.6g %14.6g %14.6g\n", TelemetryColumnNames[c],
+			tlm.value(first, c), tlm.value(last - 1, c), lo[c], sum[c] / (last - first), hi[c]);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2 || argv[1][0] == '-') {
+		usage();
+		return argc < 2 ? 1 : strcmp(argv[1], "--help") != 0;
+	}
+	const char* path = argv[1];
+	const char* csv = 0;
+	double from = -1e308, to = 1e308;
+	int every = 1;
+	std::vector<int> cols;
+	for (int c = 0; c < TLM_COLUMNS; c++) cols.push_back(c);
+
+	for (int i = 2; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--csv" && more) csv = argv[++i];
+		else if (arg == "--from" && more) from = atof(argv[++i]);
+		else if (arg == "--to" && more) to = atof(argv[++i]);
+		else if (arg == "--every" && more) every = atoi(argv[++i]);
+		else if (arg == "--columns" && more) {
+			if (!parseColumns(argv[++i], cols)) return 1;
+		}
+		else {
+			usage();
+			return 1;
+		}
+	}
+	if (every < 1) every = 1;
+
+	TelemetryReader tlm;
+	if (!tlm.open(path)) {
+		fprintf(stderr, "Could not read telemetry from %s: %s\n", path, tlm.error());
+		return 1;
+	}
+
+	// Record range [first, last) from the time index
+	uint64_t first = tlm.seek(from);
+	uint64_t last = to < 1e308 ? tlm.seek(to) : tlm.records();
+	while (last < tlm.records() && tlm.value(last, TLM_SIMT) <= to) last++;
+	if (first >= last) {
+		fprintf(stderr, "No records between %g and %g s\n", from, to);
+		return 1;
+	}
+
+	if (!csv) {
+		printSummary(tlm, first, last);
+		return 0;
+	}
+	FILE* out = strcmp(csv, "-") == 0 ? stdout : fopen(csv, "w");
+	if (!out) {
+		fprintf(stderr, "Could not write %s\n", csv);
+		return 1;
+	}
+	exportCsv(tlm, first, last, every, cols, out);
+	if (out != stdout) fclose(out);
+	return 0;
+}
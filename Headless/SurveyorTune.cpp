@@ -0,0 +1,87 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// SurveyorTune.cpp
+// Command line front end for the autopilot gain tuner
+//
+// ==============================================================
+
+#include "GainTuner.h"
+#include <cstdlib>
+
+static void usage()
+{
+	printf("Usage: SurveyorTune [options]\n"
+		"  --candidates N    parameter sets per round (default 128)\n"
+		"  --rounds N        search rounds, each about the best set so far (default 4)\n"
+		"  --scenarios N     dispersed descents per candidate (default 16)\n"
+		"  --validation N    held-out descents to compare tuned and design sets (default 64)\n"
+		"  --seed N          seed for the search and the dispersions (default 1)\n"
+		"  --threads N       worker threads, 0 for all cores (default 0)\n"
+		"  --dt S            frame length in seconds (default 0.02)\n"
+		"  --scenario FILE   Orbiter scenario with the initial state\n"
+		"                    (default Scenarios/Surveyor/SurveyorLanding.scn)\n"
+		"  --out FILE        tuned parameter file (default AutoPilot.cfg); install it as\n"
+		"                    <OrbiterRoot>/Config/Surveyor/AutoPilot.cfg\n");
+}
+
+int main(int argc, char* argv[])
+{
+	TunerConfig cfg;
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+	const char* out = "AutoPilot.cfg";
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--candidates" && more) cfg.candidates = atoi(argv[++i]);
+		else if (arg == "--rounds" && more) cfg.rounds = atoi(argv[++i]);
+		else if (arg == "--scenarios" && more) cfg.scenarios = atoi(argv[++i]);
+		else if (arg == "--validation" && more) cfg.validation = atoi(argv[++i]);
+		else if (arg == "--seed" && more) cfg.seed = strtoull(argv[++i], 0, 10);
+		else if (arg == "--threads" && more) cfg.threads = (unsigned)atoi(argv[++i]);
+		else if (arg == "--dt" && more) cfg.scenario.descent.dt = atof(argv[++i]);
+		else if (arg == "--scenario" && more) scenario = argv[++i];
+		else if (arg == "--out" && more) out = argv[++i];
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+	if (cfg.candidates < 1 || cfg.scenarios < 1) {
+		usage();
+		return 1;
+	}
+
+	if (!loadScenario(scenario, cfg.scenario.nominal)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	cfg.scenario.seed = cfg.seed;
+
+	GainTuner tuner(cfg);
+	CandidateResult best = tuner.run(stdout);
+
+	// Compare on descents the search never saw
+	if (cfg.validation > 0) {
+		int flown;
+		int first = 1 << 20;
+		double design = tuner.evaluate(AutoPilotParams(), first, cfg.validation, 1e300, flown);
+		double tuned = tuner.evaluate(best.params, first, cfg.validation, 1e300, flown);
+		printf("Validation over %d held-out descents: design cost %.4f, tuned cost %.4f\n", cfg.validation, design, tuned);
+	}
+
+	FILE* f = fopen(out, "w");
+	if (!f) {
+		fprintf(stderr, "Could not write %s\n", out);
+		return 1;
+	}
+	fprintf(f, "; Surveyor autopilot parameters tuned by SurveyorTune\n");
+	fprintf(f, "; %d rounds of %d candidates over %d scenarios, seed %llu, cost %.6f\n", cfg.rounds, cfg.candidates,
+		cfg.scenarios, (unsigned long long)cfg.seed, best.cost);
+	best.params.write(f);
+	fclose(f);
+	best.params.write(stdout);
+	return 0;
+}
@@ -0,0 +1,88 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryBusReader.cpp
+// Read access to the live telemetry bus published by TelemetryBus
+//
+// ==============================================================
+
+#include "TelemetryBusReader.h"
+#include <cstring>
+
+bool TelemetryBusReader::open(const char* vessel, bool history)
+// Map a vessel's bus and check its layout. Reading starts with the next sample published, or with the oldest one
+// still in the ring if history is set. Fails if the vessel has no bus, or it is still being set up.
+{
+	close();
+	char name[64];
+	TelemetryBusName(vessel, name, sizeof(name));
+	if (!Memory.openShared(name)) return false;
+	TelemetryBusHeader const* h = header();
+	if (Memory.size() < TBUS_BYTES || h->Version.load(std::memory_order_acquire) != TBUS_VERSION ||
+		memcmp(h->Magic, TBUS_MAGIC, sizeof(h->Magic)) != 0 || h->Slots != TBUS_SLOTS ||
+		h->SlotBytes != sizeof(TelemetryBusSlot) || h->SampleBytes != sizeof(TelemetryBusSample)) {
+		close();
+		return false;
+	}
+	Slots = (TelemetryBusSlot const*)(Memory.data() + sizeof(TelemetryBusHeader));
+	Next = h->Published.load(std::memory_order_acquire);
+	if (history) Next = Next >= TBUS_SLOTS ? Next - TBUS_SLOTS + 1 : 0;
+	Lost = 0;
+	Overruns = 0;
+	return true;
+}
+
+void TelemetryBusReader::close()
+// Unmap the bus
+{
+	Memory.close();
+	Slots = 0;
+}
+
+bool TelemetryBusReader::live() const
+// True while the writer has the bus open. A closed bus can still be read to the end.
+{
+	return header()->Live.load(std::memory_order_acquire) != 0;
+}
+
+const char* TelemetryBusReader::vessel() const
+// Name of the publishing vessel
+{
+	return header()->Vessel;
+}
+
+bool TelemetryBusReader::read(TelemetryBusSample& sample)
+// Copy the next sample. Returns false if the writer has not published it yet.
+{
+	uint64_t words[TBUS_SAMPLE_WORDS];
+	for (;;) {
+		uint64_t published = header()->Published.load(std::memory_order_acquire);
+		if (Next >= published) return false;
+
+		// The slot after the newest sample may already be getting overwritten: skip to the one after it
+		if (published - Next >= TBUS_SLOTS) {
+			uint64_t oldest = published - TBUS_SLOTS + 1;
+			Lost += oldest - Next;
+			Overruns++;
+			Next = oldest;
+		}
+
+		// Copy the sample, then check that the slot held it throughout
+		TelemetryBusSlot const& slot = Slots[Next & (TBUS_SLOTS - 1)];
+		uint64_t before = slot.Sequence.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < TBUS_SAMPLE_WORDS; i++) words[i] = slot.Words[i].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t after = slot.Sequence.load(std::memory_order_relaxed);
+		if (before == 2 * Next + 2 && after == before) break;
+
+		// Overwritten while we were copying it
+		Lost++;
+		Overruns++;
+		Next++;
+	}
+	memcpy(&sample, words, sizeof(sample));
+	Next++;
+	return true;
+}
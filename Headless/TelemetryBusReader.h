@@ -0,0 +1,37 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryBusReader.h
+// Read access to the live telemetry bus published by TelemetryBus
+//
+// ==============================================================
+
+#pragma once
+
+#include "TelemetryBusFormat.h"
+#include "MappedFile.h"
+
+// Follows a vessel's telemetry bus from another process. read() returns the samples in order; samples the writer
+// overwrote before they were read are skipped and counted by lost(). The reader never writes to the bus, so any
+// number of readers can follow one vessel.
+class TelemetryBusReader {
+public:
+	bool open(const char* vessel, bool history = false);
+	void close();
+	bool isOpen() const { return Memory.isOpen(); }
+	bool read(TelemetryBusSample& sample);
+	bool live() const;
+	const char* vessel() const;
+	uint64_t position() const { return Next; }
+	uint64_t lost() const { return Lost; }
+	uint64_t overruns() const { return Overruns; }
+private:
+	TelemetryBusHeader const* header() const { return (TelemetryBusHeader const*)Memory.data(); }
+	MappedFile Memory;                  // Mapped bus
+	TelemetryBusSlot const* Slots = 0;  // Ring of samples
+	uint64_t Next = 0;                  // Number of the next sample to read
+	uint64_t Lost = 0;                  // Samples overwritten before they were read
+	uint64_t Overruns = 0;              // Times the writer got ahead of the reader
+};
@@ -0,0 +1,126 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryReader.cpp
+// Read access to telemetry files written by TelemetryRecorder
+//
+// ==============================================================
+
+#include "TelemetryReader.h"
+#include <cstring>
+
+bool TelemetryReader::open(const char* path)
+// Map a telemetry file and check its layout. Blocks beyond the end of a truncated file are ignored. On failure,
+// error() says why.
+{
+	close();
+	if (!File.openRead(path)) return fail("could not open the file");
+	TelemetryFileHeader const* h = (TelemetryFileHeader const*)File.data();
+	if (File.size() < TLM_HEADER_BYTES || memcmp(h->Magic, TLM_MAGIC, sizeof(h->Magic)) != 0) {
+		return fail("not a telemetry file");
+	}
+	if (h->Version < TLM_VERSION) {
+		return fail("recorded by an older version, without the attitude input, horizon frame and RCS columns; record it again");
+	}
+	if (h->Version != TLM_VERSION || h->Columns != TLM_COLUMNS || h->BlockRecords != TLM_BLOCK_RECORDS ||
+		h->BlockBytes != TLM_BLOCK_BYTES) {
+		return fail("recorded by a newer version, or with another layout");
+	}
+
+	uint64_t available = (File.size() - TLM_HEADER_BYTES) / TLM_BLOCK_BYTES;
+	Blocks = h->Blocks < available ? h->Blocks : available;
+
+	// Every block but the last is full
+	Records = 0;
+	if (Blocks > 0) Records = (Blocks - 1) * TLM_BLOCK_RECORDS + block(Blocks - 1)->Count;
+	return true;
+}
+
+void TelemetryReader::close()
+// Unmap the file
+{
+	File.close();
+	Blocks = 0;
+	Records = 0;
+	Error = "";
+}
+
+bool TelemetryReader::fail(const char* why)
+// Close the file and keep the reason open() failed
+{
+	close();
+	Error = why;
+	return false;
+}
+
+const char* TelemetryReader::vessel() const
+// Name of the recorded vessel
+{
+	return ((TelemetryFileHeader const*)File.data())->Vessel;
+}
+
+double TelemetryReader::startTime() const
+// SimT of the first record
+{
+	return Blocks ? block(0)->FirstT : 0;
+}
+
+double TelemetryReader::endTime() const
+// SimT of the last record
+{
+	return Blocks ? block(Blocks - 1)->LastT : 0;
+}
+
+TelemetryBlockHeader const* TelemetryReader::block(uint64_t b) const
+// Header of block b
+{
+	return (TelemetryBlockHeader const*)(File.data() + TLM_HEADER_BYTES + b * TLM_BLOCK_BYTES);
+}
+
+const double* TelemetryReader::column(uint64_t b, int c, uint32_t& count) const
+// Values of one column in block b, for scanning a quantity without decoding whole records
+{
+	TelemetryBlockHeader const* h = block(b);
+	count = h->Count;
+	return (const double*)(h + 1) + (size_t)c * TLM_BLOCK_RECORDS;
+}
+
+double TelemetryReader::value(uint64_t record, int c) const
+// One value of a record
+{
+	uint32_t count;
+	return column(record / TLM_BLOCK_RECORDS, c, count)[record % TLM_BLOCK_RECORDS];
+}
+
+void TelemetryReader::read(uint64_t record, double values[TLM_COLUMNS]) const
+// All values of a record
+{
+	uint32_t count;
+	const double* base = column(record / TLM_BLOCK_RECORDS, 0, count) + record % TLM_BLOCK_RECORDS;
+	for (int c = 0; c < TLM_COLUMNS; c++) values[c] = base[(size_t)c * TLM_BLOCK_RECORDS];
+}
+
+uint64_t TelemetryReader::seek(double simT) const
+// Index of the first record at or after simT, or records() if there is none. Binary search over the
+// block headers picks the block, then binary search over its SimT column picks the record.
+{
+	uint64_t lo = 0, hi = Blocks;
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		if (block(mid)->LastT < simT) lo = mid + 1;
+		else hi = mid;
+	}
+	if (lo == Blocks) return Records;
+
+	uint32_t count;
+	const double* t = column(lo, TLM_SIMT, count);
+	uint32_t a = 0, b = count;
+	while (a < b) {
+		uint32_t mid = a + (b - a) / 2;
+		if (t[mid] < simT) a = mid + 1;
+		else b = mid;
+	}
+	return lo * TLM_BLOCK_RECORDS + a;
+}
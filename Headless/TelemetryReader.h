@@ -0,0 +1,40 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryReader.h
+// Read access to telemetry files written by TelemetryRecorder
+//
+// ==============================================================
+
+#pragma once
+
+#include "TelemetryFormat.h"
+#include "MappedFile.h"
+
+// Memory-mapped telemetry file. Records are addressed by their index in the file;
+// seek() finds the record at a simulation time in O(log n).
+class TelemetryReader {
+public:
+	bool open(const char* path);
+	void close();
+	bool isOpen() const { return File.isOpen(); }
+	const char* error() const { return Error; }
+	uint64_t records() const { return Records; }
+	uint64_t blocks() const { return Blocks; }
+	const char* vessel() const;
+	double startTime() const;
+	double endTime() const;
+	double value(uint64_t record, int column) const;
+	void read(uint64_t record, double values[TLM_COLUMNS]) const;
+	uint64_t seek(double simT) const;
+	const double* column(uint64_t block, int column, uint32_t& count) const;
+private:
+	TelemetryBlockHeader const* block(uint64_t b) const;
+	bool fail(const char* why);
+	MappedFile File;      // Mapped telemetry file
+	const char* Error = ""; // Why the last open() failed
+	uint64_t Blocks = 0;  // Complete blocks in the file
+	uint64_t Records = 0; // Records in the complete blocks
+};
@@ -0,0 +1,180 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TerrainBench.cpp
+// Benchmark of the terrain elevation cache: lookup cost against the
+// terrain source, interpolation error, and tile coverage and cache
+// misses over a descent. Also checks that the descent flies the
+// same whether or not the prefetch thread has loaded its tiles.
+//
+// ==============================================================
+
+#include "HeadlessDescent.h"
+#include "TerrainModels.h"
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+
+// Random points cycled through by the lookup benchmarks
+const size_t TERRAIN_BENCH_POINTS = 4096;
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+template <class F>
+static double timeLookups(std::vector<double> const& lng, std::vector<double> const& lat, long long lookups, F f)
+// Mean time of f(lng, lat) over the point set [ns]
+{
+	volatile double sink = 0;
+	auto t0 = std::chrono::steady_clock::now();
+	for (long long n = 0; n < lookups; n++) {
+		size_t i = (size_t)n % lng.size();
+		sink = sink + f(lng[i], lat[i]);
+	}
+	return 1e9 * seconds(t0) / lookups;
+}
+
+static void warm(TerrainService& service, double lng, double lat, double halfWidth)
+// Request every tile over a box, and wait for the prefetch thread to load them
+{
+	double step = PI / (1 << service.level()) / 2;
+	for (double y = lat - halfWidth; y <= lat + halfWidth; y += step) {
+		for (double x = lng - halfWidth; x <= lng + halfWidth; x += step) {
+			while (!service.prefetch(x, y, 0, 0)) std::this_thread::yield();
+		}
+	}
+	for (size_t last = (size_t)-1; last != service.tiles();) {
+		last = service.tiles();
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+}
+
+static DescentResult fly(ScenarioState const& init, TerrainService& service, double dt, VECTOR3& rpos)
+{
+	DescentConfig dc;
+	dc.dt = dt;
+	dc.terrain = &service;
+	HeadlessDescent d(init, VesselDispersion(), dc);
+	DescentResult r = d.run();
+	rpos = d.vessel().Stub().rpos;
+	return r;
+}
+
+static void usage()
+{
+	printf("Usage: TerrainBench [options]\n"
+		"  --lookups N       timed lookups per benchmark (default 2000000)\n"
+		"  --width RAD       half width of the lookup box around the landing site (default 0.01)\n"
+		"  --level L         quadtree level of the cached tiles (default %d)\n"
+		"  --dt S            frame length of the descent in seconds (default 0.02)\n"
+		"  --dem FILE        also write the synthetic terrain over the box to a DEM file and time it\n"
+		"  --scenario FILE   Orbiter scenario with the nominal state\n"
+		"                    (default Scenarios/Surveyor/SurveyorLanding.scn)\n"
+		"Exits with status 1 if the descent depends on how far the prefetch thread has got.\n",
+		TERRAIN_DEFAULT_LEVEL);
+}
+
+int main(int argc, char* argv[])
+{
+	long long lookups = 2000000;
+	double width = 0.01;
+	int level = TERRAIN_DEFAULT_LEVEL;
+	double dt = 0.02;
+	const char* dem = 0;
+	const char* scenario = "Scenarios/Surveyor/SurveyorLanding.scn";
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool more = i + 1 < argc;
+		if (arg == "--lookups" && more) lookups = atoll(argv[++i]);
+		else if (arg == "--width" && more) width = atof(argv[++i]);
+		else if (arg == "--level" && more) level = atoi(argv[++i]);
+		else if (arg == "--dt" && more) dt = atof(argv[++i]);
+		else if (arg == "--dem" && more) dem = argv[++i];
+		else if (arg == "--scenario" && more) scenario = argv[++i];
+		else {
+			usage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	ScenarioState init;
+	if (!loadScenario(scenario, init)) {
+		fprintf(stderr, "Could not read a Surveyor from %s, using the built-in landing scenario\n", scenario);
+	}
+	double r0 = length(init.rpos);
+	double lng0 = atan2(init.rpos.y, init.rpos.x), lat0 = asin(init.rpos.z / r0);
+
+	// Lookup points over the box around the landing site
+	std::mt19937_64 rng(42);
+	std::uniform_real_distribution<double> U(-width, width);
+	std::vector<double> lng(TERRAIN_BENCH_POINTS), lat(TERRAIN_BENCH_POINTS);
+	for (size_t i = 0; i < TERRAIN_BENCH_POINTS; i++) {
+		lng[i] = lng0 + U(rng);
+		lat[i] = lat0 + U(rng);
+	}
+
+	SyntheticTerrain synthetic;
+	bool ok = true;
+	printf("%-40s %12s\n", "benchmark", "ns/lookup");
+	{
+		TerrainService cold(synthetic, level);
+		double direct = timeLookups(lng, lat, lookups, [&](double x, double y) { return synthetic.elevation(x, y); });
+		printf("%-40s %12.1f\n", "synthetic source", direct);
+		double miss = timeLookups(lng, lat, lookups, [&](double x, double y) { return cold.elevation(x, y); });
+		printf("%-40s %12.1f\n", "cache, no tiles loaded", miss);
+	}
+
+	TerrainService service(synthetic, level);
+	warm(service, lng0, lat0, width);
+	double hit = timeLookups(lng, lat, lookups, [&](double x, double y) { return service.elevation(x, y); });
+	printf("%-40s %12.1f\n", "cache, tiles loaded", hit);
+
+	if (dem) {
+		double spacing = PI / (1 << level) / (TERRAIN_TILE_SAMPLES - 1);
+		uint32_t n = (uint32_t)ceil(2 * width / spacing) + 1;
+		DemTerrain file;
+		if (!DemTerrain::write(dem, synthetic, lng0 - width, lat0 - width, spacing, n, n) || !file.open(dem)) {
+			fprintf(stderr, "Could not write %s\n", dem);
+			return 1;
+		}
+		double t = timeLookups(lng, lat, lookups, [&](double x, double y) { return file.elevation(x, y); });
+		printf("%-40s %12.1f\n", "DEM file source", t);
+	}
+
+	// Interpolation error of the cached tiles against the source
+	double maxErr = 0, sumSq = 0;
+	for (size_t i = 0; i < TERRAIN_BENCH_POINTS; i++) {
+		double e = fabs(service.elevation(lng[i], lat[i]) - synthetic.elevation(lng[i], lat[i]));
+		maxErr = max(maxErr, e);
+		sumSq += e * e;
+	}
+	printf("%-40s %12.3f\n", "interpolation error, RMS (m)", sqrt(sumSq / TERRAIN_BENCH_POINTS));
+	printf("%-40s %12.3f\n", "interpolation error, max (m)", maxErr);
+	printf("%-40s %12zu\n", "tiles loaded", service.tiles());
+
+	// The nominal descent, first with the prefetch thread starting from an empty cache, then with every tile it
+	// needs already loaded. Both must fly identically.
+	TerrainService fresh(synthetic, level);
+	VECTOR3 posFresh, posWarm;
+	DescentResult r = fly(init, fresh, dt, posFresh);
+	unsigned long long misses = fresh.misses();
+	size_t tiles = fresh.tiles();
+	fly(init, fresh, dt, posWarm);
+	printf("%-40s %12.3f\n", "descent, touchdown speed (m/s)", r.vertSpeed);
+	printf("%-40s %12ld\n", "descent, frames", r.steps);
+	printf("%-40s %12zu\n", "descent, tiles loaded", tiles);
+	printf("%-40s %12llu\n", "descent, cache misses", misses);
+	printf("%-40s %12.4f\n", "descent, misses per frame", (double)misses / r.steps);
+	VECTOR3 d = posFresh - posWarm;
+	if (d.x != 0 || d.y != 0 || d.z != 0) {
+		fprintf(stderr, "The descent flew differently with the tiles loaded\n");
+		ok = false;
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TerrainModels.cpp
+// Procedural terrain and DEM file terrain sources
+//
+// ==============================================================
+
+#include "TerrainModels.h"
+#include <cmath>
+#include <cstring>
+
+// Noise octaves of the synthetic terrain
+static const struct {
+	double wavelength; // [m]
+	double amplitude;  // [m]
+} Octaves[] = {
+	{ 50000, 1500 },
+	{ 20000, 500 },
+	{ 8000, 160 },
+	{ 3500, 60 },
+	{ 1500, 20 },
+};
+
+static double lattice(uint32_t seed, int64_t i, int64_t j, int64_t k)
+// Value in [-1, 1] at an integer lattice point
+{
+	uint64_t h = (uint64_t)i * 0x9E3779B97F4A7C15ull ^ (uint64_t)j * 0xC2B2AE3D27D4EB4Full ^
+		(uint64_t)k * 0x165667B19E3779F9ull ^ seed;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return (double)(h >> 11) * (2.0 / 9007199254740992.0) - 1;
+}
+
+static double fade(double t)
+// Quintic blend, with zero first and second derivative at the lattice points
+{
+	return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+static double valueNoise(uint32_t seed, double x, double y, double z)
+// Smooth noise in [-1, 1], blending the lattice values around a point
+{
+	double fx = floor(x), fy = floor(y), fz = floor(z);
+	int64_t i = (int64_t)fx, j = (int64_t)fy, k = (int64_t)fz;
+	double u = fade(x - fx), v = fade(y - fy), w = fade(z - fz);
+	double c[2];
+	for (int dk = 0; dk < 2; dk++) {
+		double a = lattice(seed, i, j, k + dk) + (lattice(seed, i + 1, j, k + dk) - lattice(seed, i, j, k + dk)) * u;
+		double b = lattice(seed, i, j + 1, k + dk) + (lattice(seed, i + 1, j + 1, k + dk) - lattice(seed, i, j + 1, k + dk)) * u;
+		c[dk] = a + (b - a) * v;
+	}
+	return c[0] + (c[1] - c[0]) * w;
+}
+
+SyntheticTerrain::SyntheticTerrain(uint32_t seed, double radius)
+	: Seed(seed), Radius(radius)
+{
+}
+
+double SyntheticTerrain::elevation(double lng, double lat) const
+{
+	// Noise over the surface point in metres, so the terrain has no seam or pole singularity
+	double x = Radius * cos(lat) * cos(lng), y = Radius * cos(lat) * sin(lng), z = Radius * sin(lat);
+	double h = 0;
+	for (size_t o = 0; o < sizeof(Octaves) / sizeof(Octaves[0]); o++) {
+		double s = 1 / Octaves[o].wavelength;
+		h += Octaves[o].amplitude * valueNoise(Seed + (uint32_t)o * 0x632BE5ABu, x * s, y * s, z * s);
+	}
+	return h;
+}
+
+DemTerrain::DemTerrain(void)
+	: Height(0), Columns(0), Rows(0), MinLng(0), MinLat(0), Scale(0)
+{
+}
+
+bool DemTerrain::open(const char* path)
+// Map a DEM file. Fails, leaving the terrain closed, if the file is missing, malformed or truncated.
+{
+	Height = 0;
+	File.close();
+	if (!File.openRead(path)) return false;
+
+	DemFileHeader const& h = *(DemFileHeader const*)File.data();
+	if (File.size() < sizeof(DemFileHeader) || memcmp(h.Magic, DEM_MAGIC, sizeof(DEM_MAGIC)) != 0 ||
+		h.Version != DEM_VERSION || h.Columns < 2 || h.Rows < 2 || !(h.Spacing > 0) ||
+		File.size() < sizeof(DemFileHeader) + (size_t)h.Columns * h.Rows * sizeof(float)) {
+		File.close();
+		return false;
+	}
+
+	Columns = h.Columns;
+	Rows = h.Rows;
+	MinLng = h.MinLng;
+	MinLat = h.MinLat;
+	Scale = 1 / h.Spacing;
+	Height = (float const*)(File.data() + sizeof(DemFileHeader));
+	return true;
+}
+
+double DemTerrain::elevation(double lng, double lat) const
+{
+	// Fractional node coordinates, clamped to the grid. The last cell includes its upper edge.
+	double x = fmin(fmax((lng - MinLng) * Scale, 0), Columns - 1.0);
+	double y = fmin(fmax((lat - MinLat) * Scale, 0), Rows - 1.0);
+	uint32_t i = (uint32_t)fmin(x, Columns - 2.0), j = (uint32_t)fmin(y, Rows - 2.0);
+	double fx = x - i, fy = y - j;
+
+	float const* h = Height + (size_t)j * Columns + i;
+	double h0 = h[0] + (h[1] - (double)h[0]) * fx;
+	double h1 = h[Columns] + (h[Columns + 1] - (double)h[Columns]) * fx;
+	return h0 + (h1 - h0) * fy;
+}
+
+bool DemTerrain::write(const char* path, TerrainSource const& source, double minLng, double minLat, double spacing,
+	uint32_t columns, uint32_t rows)
+// Sample a terrain source onto a DEM file
+{
+	MappedFile f;
+	size_t size = sizeof(DemFileHeader) + (size_t)columns * rows * sizeof(float);
+	if (!f.create(path, size)) return false;
+
+	DemFileHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.Magic, DEM_MAGIC, sizeof(DEM_MAGIC));
+	h.Version = DEM_VERSION;
+	h.Columns = columns;
+	h.Rows = rows;
+	h.MinLng = minLng;
+	h.MinLat = minLat;
+	h.Spacing = spacing;
+	memcpy(f.data(), &h, sizeof(h));
+
+	float* height = (float*)(f.data() + sizeof(DemFileHeader));
+	for (uint32_t j = 0; j < rows; j++) {
+		for (uint32_t i = 0; i < columns; i++) {
+			height[(size_t)j * columns + i] = (float)source.elevation(minLng + i * spacing, minLat + j * spacing);
+		}
+	}
+	f.close(size);
+	return true;
+}
@@ -0,0 +1,60 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TerrainModels.h
+// Terrain sources for headless runs: procedural lunar terrain and
+// gridded elevation model files
+//
+// ==============================================================
+
+#pragma once
+
+#include "TerrainService.h"
+#include "MappedFile.h"
+
+/* Rolling terrain from smooth value noise over the sphere. Octaves run from 50 km to 1.5 km wavelength, with
+   amplitudes falling from 1.5 km to 20 m, so slopes stay within what the landing legs tolerate. The same seed
+   always gives the same terrain. */
+class SyntheticTerrain : public TerrainSource {
+public:
+	explicit SyntheticTerrain(uint32_t seed = 1, double radius = 1737400);
+	double elevation(double lng, double lat) const;
+private:
+	uint32_t Seed;  // Noise seed
+	double Radius;  // Body radius the wavelengths are measured on [m]
+};
+
+const char DEM_MAGIC[8] = { 'S', 'V', 'Y', 'D', 'E', 'M', '\r', '\n' };
+const uint32_t DEM_VERSION = 1;
+
+/* A DEM file is a header followed by a grid of float elevations over a longitude and latitude box, longitude
+   varying fastest: Height[row][column]. */
+struct DemFileHeader {
+	char Magic[8];       // DEM_MAGIC
+	uint32_t Version;    // DEM_VERSION
+	uint32_t Columns;    // Longitude nodes
+	uint32_t Rows;       // Latitude nodes
+	uint32_t Reserved;   // Zero
+	double MinLng;       // Longitude of the first column [rad]
+	double MinLat;       // Latitude of the first row [rad]
+	double Spacing;      // Node spacing in longitude and latitude [rad]
+};
+
+// Elevation from a memory-mapped DEM file, bilinear between nodes. Outside the grid the edge values continue.
+class DemTerrain : public TerrainSource {
+public:
+	DemTerrain(void);
+	bool open(const char* path);
+	bool isOpen() const { return Height != 0; }
+	double elevation(double lng, double lat) const;
+	static bool write(const char* path, TerrainSource const& source, double minLng, double minLat, double spacing,
+		uint32_t columns, uint32_t rows);
+private:
+	MappedFile File;        // Mapped DEM file
+	float const* Height;    // Elevation grid [m]
+	uint32_t Columns, Rows; // Grid size
+	double MinLng, MinLat;  // Grid origin [rad]
+	double Scale;           // Nodes per radian
+};
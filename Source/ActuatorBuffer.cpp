@@ -0,0 +1,154 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ActuatorBuffer.cpp
+// Write-coalescing thruster command buffer
+//
+// ==============================================================
+
+#include "ActuatorBuffer.h"
+#include "Profiler.h"
+
+ActuatorBuffer::ActuatorBuffer(void)
+// Command buffer constructor
+{
+	Count = 0;
+}
+
+ActuatorBuffer::Slot* ActuatorBuffer::find(THRUSTER_HANDLE th, bool create)
+// Slot for a thruster, optionally added on first use. Surveyor has few enough thrusters for a linear search.
+{
+	for (int i = 0; i < Count; i++) {
+		if (Slots[i].Thruster == th) return &Slots[i];
+	}
+	if (!create || Count == ACTUATOR_SLOTS) return 0;
+
+	Slot& s = Slots[Count++];
+	s.Thruster = th;
+	s.Level = s.SentLevel = 0;
+	s.Dir = s.SentDir = _V(0, 0, 1);
+	s.LevelPending = s.DirPending = s.LevelSent = s.DirSent = s.LevelMoved = false;
+	return &s;
+}
+
+void ActuatorBuffer::setLevel(THRUSTER_HANDLE th, double level)
+// Command a thrust level
+{
+	Slot* s = find(th, true);
+	if (!s) return;
+	s->Level = level;
+	s->LevelPending = true;
+}
+
+void ActuatorBuffer::setDir(THRUSTER_HANDLE th, VECTOR3 const & dir)
+// Command a thrust direction
+{
+	Slot* s = find(th, true);
+	if (!s) return;
+	s->Dir = dir;
+	s->DirPending = true;
+}
+
+double ActuatorBuffer::getLevel(VESSEL const * v, THRUSTER_HANDLE th) const
+// Latest commanded thrust level, falling back to Orbiter for thrusters the buffer knows nothing about
+{
+	for (int i = 0; i < Count; i++) {
+		Slot const & s = Slots[i];
+		if (s.Thruster != th) continue;
+		if (s.LevelPending) return s.Level;
+		if (s.LevelSent) return s.SentLevel;
+		break;
+	}
+	PROFILE_API("GetThrusterLevel");
+	return v->GetThrusterLevel(th);
+}
+
+void ActuatorBuffer::getDir(VESSEL const * v, THRUSTER_HANDLE th, VECTOR3& dir) const
+// Latest commanded thrust direction, falling back to Orbiter for thrusters the buffer knows nothing about
+{
+	for (int i = 0; i < Count; i++) {
+		Slot const & s = Slots[i];
+		if (s.Thruster != th) continue;
+		if (s.DirPending) { dir = s.Dir; return; }
+		if (s.DirSent) { dir = s.SentDir; return; }
+		break;
+	}
+	PROFILE_API("GetThrusterDir");
+	v->GetThrusterDir(th, dir);
+}
+
+void ActuatorBuffer::track(VESSEL const * v, THRUSTER_HANDLE th)
+// Start tracking a thruster with the level and direction Orbiter currently has for it
+{
+	Slot* s = find(th, true);
+	if (!s) return;
+	PROFILE_API("GetThrusterLevel");
+	s->SentLevel = v->GetThrusterLevel(th);
+	PROFILE_API("GetThrusterDir");
+	v->GetThrusterDir(th, s->SentDir);
+	s->LevelSent = s->DirSent = true;
+}
+
+void ActuatorBuffer::invalidate(THRUSTER_HANDLE th)
+// Forget what was last sent for a thruster that was set outside the buffer
+{
+	Slot* s = find(th, false);
+	if (!s) return;
+	s->LevelSent = false;
+	s->DirSent = false;
+}
+
+bool ActuatorBuffer::checkGroup(THRUSTER_HANDLE const * th, int n, double level)
+// Compare the level of a thruster group, as sampled from Orbiter, with the mean of the levels last sent to its
+// thrusters. If they differ, the throttle, the attitude keys or the joystick set the group, and
+// the next flush resends the levels written to its thrusters. Returns true if the group moved.
+{
+	Slot* slot[ACTUATOR_SLOTS];
+	double sent = 0;
+	if (n <= 0 || n > ACTUATOR_SLOTS) return false;
+	for (int i = 0; i < n; i++) {
+		slot[i] = find(th[i], false);
+		if (!slot[i] || !slot[i]->LevelSent) return false;
+		sent += slot[i]->SentLevel;
+	}
+	if (fabs(sent / n - level) <= ACTUATOR_LEVEL_TOL) return false;
+	for (int i = 0; i < n; i++) slot[i]->LevelMoved = true;
+	return true;
+}
+
+int ActuatorBuffer::flush(VESSEL const * v)
+// Send the commands that changed since the last flush, and the levels written to thrusters that were moved outside
+// the buffer. Returns the number of Orbiter calls made.
+{
+	int calls = 0;
+	for (int i = 0; i < Count; i++) {
+		Slot& s = Slots[i];
+		if (s.LevelPending) {
+			// Orbiter clamps the level it stores, and SentLevel is kept as Orbiter has it
+			double level = min(max(s.Level, 0), 1);
+			if (s.LevelMoved || !s.LevelSent || fabs(level - s.SentLevel) > ACTUATOR_LEVEL_TOL) {
+				PROFILE_API("SetThrusterLevel");
+				v->SetThrusterLevel(s.Thruster, s.Level);
+				s.SentLevel = level;
+				s.LevelSent = true;
+				calls++;
+			}
+			s.LevelPending = false;
+		}
+		s.LevelMoved = false;
+		if (s.DirPending) {
+			if (!s.DirSent || fabs(s.Dir.x - s.SentDir.x) > ACTUATOR_DIR_TOL || fabs(s.Dir.y - s.SentDir.y) > ACTUATOR_DIR_TOL ||
+				fabs(s.Dir.z - s.SentDir.z) > ACTUATOR_DIR_TOL) {
+				PROFILE_API("SetThrusterDir");
+				v->SetThrusterDir(s.Thruster, s.Dir);
+				s.SentDir = s.Dir;
+				s.DirSent = true;
+				calls++;
+			}
+			s.DirPending = false;
+		}
+	}
+	return calls;
+}
@@ -0,0 +1,60 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ActuatorBuffer.h
+// Header file with the declaration of the thruster command buffer
+//
+// ==============================================================
+
+#pragma once
+
+#include "SurveyorConstants.h"
+
+// Number of thrusters the buffer can track
+const int ACTUATOR_SLOTS = 16;
+
+// Changes smaller than these are not sent to Orbiter
+const double ACTUATOR_LEVEL_TOL = 1e-6; // Thrust level
+const double ACTUATOR_DIR_TOL = 1e-9;   // Thrust direction, per component
+
+// Thruster command buffer. Vessel and autopilot code write thrust levels and directions into the
+// buffer during a time step; the last write to each thruster wins. flush() is called once at the
+// end of clbkPreStep and only calls Orbiter for thrusters whose command differs from the value
+// last sent. Surveyor tracks the retro, the verniers and the RCS jets; the jets are commanded
+// through the buffer only under control allocation. Their directions are only set through the
+// buffer; code that sets one directly must call invalidate() so the next flush resends it. Their
+// levels are not: the verniers are in THGROUP_MAIN and the jets in the attitude groups, so the
+// throttle keys, the attitude keys and the joystick set them too. The vessel passes the group
+// levels it samples each step to checkGroup(), and the levels written to a group that moved are
+// resent, so the autopilot's commands replace manual ones. Reads of a thruster that was passed to
+// track() never call Orbiter, so the autopilot can run on a worker thread.
+class ActuatorBuffer {
+public:
+	ActuatorBuffer(void);
+	void setLevel(THRUSTER_HANDLE th, double level);
+	void setDir(THRUSTER_HANDLE th, VECTOR3 const & dir);
+	double getLevel(VESSEL const * v, THRUSTER_HANDLE th) const;
+	void getDir(VESSEL const * v, THRUSTER_HANDLE th, VECTOR3& dir) const;
+	void track(VESSEL const * v, THRUSTER_HANDLE th);
+	void invalidate(THRUSTER_HANDLE th);
+	bool checkGroup(THRUSTER_HANDLE const * th, int n, double level);
+	int flush(VESSEL const * v);
+private:
+	struct Slot {
+		THRUSTER_HANDLE Thruster; // Thruster tracked by this slot
+		double Level;             // Latest commanded level
+		double SentLevel;         // Level last sent to Orbiter, clamped to [0, 1] as Orbiter stores it
+		VECTOR3 Dir;              // Latest commanded direction
+		VECTOR3 SentDir;          // Direction last sent to Orbiter
+		bool LevelPending;        // Level written since the last flush
+		bool DirPending;          // Direction written since the last flush
+		bool LevelSent;           // SentLevel is valid
+		bool LevelMoved;          // Orbiter's level was changed outside the buffer since the last flush
+		bool DirSent;             // SentDir is valid
+	};
+	Slot* find(THRUSTER_HANDLE th, bool create);
+	Slot Slots[ACTUATOR_SLOTS]; // Tracked thrusters
+	int Count;                  // Number of slots in use
+};
@@ -0,0 +1,95 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AttitudeMath.h
+// Inline vector and quaternion helpers for the attitude controller.
+// Rotations are carried as unit quaternions built with the half-angle
+// construction, so the attitude error needs one square root per step
+// and no inverse trigonometric call, and stays finite when the
+// velocity lies along the roll axis.
+//
+// ==============================================================
+
+#pragma once
+
+#include "orbitersdk.h"
+
+// Largest sin(angle / 2) for which rotationScale uses its series
+const double ATTITUDE_SERIES_RANGE = 0.1;
+
+// Coefficients of 2 asin(h) / h in powers of h^2, accurate to below 1e-16 relative for h <= ATTITUDE_SERIES_RANGE
+const int ATTITUDE_SERIES_TERMS = 8;
+const double ATTITUDE_SERIES[ATTITUDE_SERIES_TERMS] = {
+	1, 1.0 / 6.0, 3.0 / 40.0, 5.0 / 112.0, 35.0 / 1152.0, 63.0 / 2816.0, 231.0 / 13312.0, 143.0 / 10240.0 };
+
+// Rotation as a quaternion: w = cos(angle / 2), (x, y, z) = sin(angle / 2) times the unit axis
+struct Quaternion {
+	double w, x, y, z;
+};
+
+inline double rsqrt(double x)
+// Reciprocal square root: normalisations multiply by this rather than dividing component by component
+{
+	return 1 / sqrt(x);
+}
+
+constexpr double lengthSq(double x, double y, double z)
+{
+	return x * x + y * y + z * z;
+}
+
+inline double lengthSq(VECTOR3 const & v)
+{
+	return lengthSq(v.x, v.y, v.z);
+}
+
+inline Quaternion shortestArc(VECTOR3 const & a, VECTOR3 const & b)
+// Smallest rotation taking the direction of a onto the direction of b. (|a||b| + a.b, a x b) is the rotation scaled
+// by 2 |a||b| cos(angle / 2), so normalising it gives the half angle without trigonometry. Opposite vectors turn half
+// a revolution about an axis normal to a; a zero vector gives no rotation.
+{
+	double ab = sqrt(lengthSq(a) * lengthSq(b));
+	VECTOR3 c = crossp(a, b);
+	double w = ab + dotp(a, b);
+	double n2 = w * w + lengthSq(c);
+	if (n2 > 0) {
+		double s = rsqrt(n2);
+		Quaternion q = { w * s, c.x * s, c.y * s, c.z * s };
+		return q;
+	}
+	if (ab > 0) {
+		// Opposite: the axis is a crossed with the coordinate axis it is least aligned with
+		VECTOR3 e = fabs(a.x) <= fabs(a.y) && fabs(a.x) <= fabs(a.z) ? _V(1, 0, 0) : fabs(a.y) <= fabs(a.z) ? _V(0, 1, 0) : _V(0, 0, 1);
+		VECTOR3 n = crossp(a, e);
+		double s = rsqrt(lengthSq(n));
+		Quaternion q = { 0, n.x * s, n.y * s, n.z * s };
+		return q;
+	}
+	Quaternion q = { 1, 0, 0, 0 };
+	return q;
+}
+
+inline double rotationScale(Quaternion const & q)
+// Rotation angle over sin(angle / 2), which takes the vector part of q to the rotation vector. Even in sin(angle / 2),
+// so it is evaluated as a series near zero, where the ratio of the two is ill-conditioned.
+{
+	// A negative w is the same rotation as -q, the long way round
+	double sign = q.w < 0 ? -1 : 1;
+	double h2 = lengthSq(q.x, q.y, q.z);
+	if (h2 <= ATTITUDE_SERIES_RANGE * ATTITUDE_SERIES_RANGE) {
+		double p = ATTITUDE_SERIES[ATTITUDE_SERIES_TERMS - 1];
+		for (int i = ATTITUDE_SERIES_TERMS - 2; i >= 0; i--) p = ATTITUDE_SERIES[i] + h2 * p;
+		return sign * 2 * p;
+	}
+	double h = sqrt(h2);
+	return sign * 2 * atan2(h, fabs(q.w)) / h;
+}
+
+inline VECTOR3 rotationVector(Quaternion const & q)
+// Rotation angle times the unit axis
+{
+	double k = rotationScale(q);
+	return _V(q.x * k, q.y * k, q.z * k);
+}
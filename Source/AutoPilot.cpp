@@ -12,40 +12,206 @@
 #include <cstdlib>
 #include <algorithm>
 
+// Rounding allowance on the mode timer [s]
+const double TIMER_TOLERANCE = 1e-9;
+
 AutoPilot::AutoPilot(void)
 // Autopilot constructor
 {
-	// Initialize proportional gains for angular velocity controller (inner loop of attitude control system)
-	Kp_w.x = 400;
-	Kp_w.y = 400;
-	Kp_w.z = 400;
-
-	// Initialize gains for angle error controller (outer loop of attitude control system)
-	Kp_ang = 0.5;
+	// Gains and thresholds start at their design values (see AutoPilotParams), until tuned values are set
+
+	// Initialize controller outputs
+	VernierThrustLevel = _V(0, 0, 0);
+	for (int i = 0; i < ALLOCATOR_RCS; i++) RcsLevel[i] = 0;
+	SinAlpha = 0;
+	CosAlpha = 1;
+	updateThresholds();
+	OmegaD = _V(0, 0, 0);
+	SteadyLevel = 0;
+	RateLoopActive = false;
+
+	// No guidance table until one is set
+	Guidance = 0;
+	UseGuidance = false;
 
 	// Initialize autopilot mode
 	Mode = IDLE;
 
 	// Initialize timer
 	Timer = 0;
+
+	// Print the debug string, unless another vessel owns it
+	DebugOutput = true;
 }
 
 void AutoPilot::idleVernierThrusters(Surveyor* sc)
 // Set the vernier thrust levels to 0, and set vernier thruster 1 thrust vector angle to 0
 {
 	// Set all vernier thrust levels to 0
-	sc->SetThrusterLevel(sc->th_vernier[0], 0);
-	sc->SetThrusterLevel(sc->th_vernier[1], 0);
-	sc->SetThrusterLevel(sc->th_vernier[2], 0);
+	sc->Actuators.setLevel(sc->th_vernier[0], 0);
+	sc->Actuators.setLevel(sc->th_vernier[1], 0);
+	sc->Actuators.setLevel(sc->th_vernier[2], 0);
 
 	// Set thrust vector angle of vernier thruster 1 to 0
-	sc->SetThrusterDir(sc->th_vernier[0], _V(0, 0, 1));
+	SinAlpha = 0;
+	CosAlpha = 1;
+	sc->Actuators.setDir(sc->th_vernier[0], _V(0, 0, 1));
+
+	// Under control allocation the RCS jets are the autopilot's too
+	if (Options.ControlAllocation != 0) {
+		for (int i = 0; i < ALLOCATOR_RCS; i++) {
+			RcsLevel[i] = 0;
+			sc->Actuators.setLevel(sc->th_rcs[i], 0);
+		}
+	}
+
+	// Nothing for the angular velocity loop to do until vernierControl is called again
+	RateLoopActive = false;
+}
+
+void AutoPilot::setVernierThrusters(Surveyor* sc)
+// Send the vernier thrust levels and vernier thruster 1 thrust vector angle calculated by the angular velocity controller
+{
+	// Set the vernier thrust levels to the value specified by the controller
+	sc->Actuators.setLevel(sc->th_vernier[0], VernierThrustLevel.x);
+	sc->Actuators.setLevel(sc->th_vernier[1], VernierThrustLevel.y);
+	sc->Actuators.setLevel(sc->th_vernier[2], VernierThrustLevel.z);
+
+	// Set the vernier thruster 1 thrust vector angle to the desired angle specified by the controller
+	sc->Actuators.setDir(sc->th_vernier[0], _V(SinAlpha, 0, CosAlpha));
+
+	// Set the RCS jet levels, under control allocation
+	if (Options.ControlAllocation != 0) {
+		for (int i = 0; i < ALLOCATOR_RCS; i++) sc->Actuators.setLevel(sc->th_rcs[i], RcsLevel[i]);
+	}
+}
+
+void AutoPilot::rateLoopUpdate(Surveyor* sc, StateFrame const & sf)
+// Angular velocity loop update between autopilot updates, with the desired angular velocity and steady state thrust level
+// held from the last one. Called by ControlScheduler when the rate loop runs faster than the guidance loop.
+{
+	if (!RateLoopActive) return;
+	angularVelocityController(sc, OmegaD, sf.AngularVel, SteadyLevel);
+	setVernierThrusters(sc);
+}
+
+AutoPilotStatus AutoPilot::getMode() const
+// Current autopilot mode
+{
+	return Mode;
+}
+
+double AutoPilot::getTimer() const
+// Time spent in the current mode, for the modes that time themselves [s]
+{
+	return Timer;
+}
+
+GuidanceTable const * AutoPilot::getGuidance() const
+// Final descent guidance table in use, or null for the constant mass thrust law
+{
+	return UseGuidance ? Guidance : 0;
+}
+
+double AutoPilot::getAlpha() const
+// Current vernier thruster 1 thrust vector angle. The controller only keeps its sine and cosine.
+{
+	return atan2(SinAlpha, CosAlpha);
+}
+
+void AutoPilot::setParams(AutoPilotParams const & params)
+// Replace the gains and thresholds
+{
+	Params = params;
+	UseGuidance = Guidance && Guidance->matches(Params);
+	updateThresholds();
+}
+
+void AutoPilot::updateThresholds()
+// Attitude error thresholds expressed on sin(angle / 2), the vector part magnitude of the error quaternion, and the
+// thrust vector angle limit on its sine, so the controller compares them without inverse trigonometry. Half the
+// saturation angle can exceed a quarter turn for a small Kp_ang, in which case the rate never saturates.
+{
+	HalfDeadband = sin(0.5 * min(Params.AngleDeadband, PI));
+	double halfSat = 0.5 * Params.RateLimit / Params.Kp_ang;
+	HalfSaturation = halfSat < 0.5 * PI ? sin(halfSat) : 2;
+	SinAlphaLimit = sin(min(Params.AlphaLimit, 0.5 * PI));
+}
+
+void AutoPilot::setDebugOutput(bool enable)
+// Turn the debug string on or off. Orbiter has one debug string, so with several Surveyors only one may write it.
+{
+	DebugOutput = enable;
+}
+
+void AutoPilot::saveState(FILEHANDLE scn) const
+// Write the mode, timer and last commands to a scenario file, so a saved flight resumes where it left off
+{
+	char buf[256];
+	oapiWriteScenario_int(scn, "AP_MODE", Mode);
+	sprintf(buf, "%.17g", Timer);
+	oapiWriteScenario_string(scn, "AP_TIMER", buf);
+	sprintf(buf, "%.17g %.17g %.17g", VernierThrustLevel.x, VernierThrustLevel.y, VernierThrustLevel.z);
+	oapiWriteScenario_string(scn, "AP_VERNIER", buf);
+	sprintf(buf, "%.17g", getAlpha());
+	oapiWriteScenario_string(scn, "AP_ALPHA", buf);
+}
+
+bool AutoPilot::loadStateLine(char const* line)
+// Read one scenario line written by saveState. Returns false if the line is not autopilot state.
+{
+	int mode;
+	double alpha;
+	if (sscanf(line, "AP_MODE %d", &mode) == 1) {
+		if (mode >= 0 && mode < AUTOPILOT_MODES) Mode = (AutoPilotStatus)mode;
+		return true;
+	}
+	if (sscanf(line, "AP_TIMER %lf", &Timer) == 1) return true;
+	if (sscanf(line, "AP_VERNIER %lf %lf %lf", &VernierThrustLevel.x, &VernierThrustLevel.y, &VernierThrustLevel.z) == 3) return true;
+	if (sscanf(line, "AP_ALPHA %lf", &alpha) == 1) {
+		SinAlpha = sin(alpha);
+		CosAlpha = cos(alpha);
+		return true;
+	}
+	return false;
+}
+
+AutoPilotParams const & AutoPilot::getParams() const
+// Current gains and thresholds
+{
+	return Params;
+}
+
+void AutoPilot::setOptions(AutoPilotOptions const & options)
+// Replace the feature switches. The vessel starts and stops the worker threads they need.
+{
+	Options = options;
+}
+
+AutoPilotOptions const & AutoPilot::getOptions() const
+// Current feature switches
+{
+	return Options;
+}
+
+void AutoPilot::setAllocator(ControlAllocator const & allocator)
+// Replace the control allocator, rebuilt for a new configuration
+{
+	Allocator = allocator;
 }
 
-double AutoPilot::radarAltitude(Surveyor* sc)
-// Radar altimeter
+ControlAllocator const & AutoPilot::getAllocator() const
+// Current control allocator
 {
-	return sc->GetAltitude() - sc->GetSurfaceElevation();
+	return Allocator;
+}
+
+void AutoPilot::setGuidance(GuidanceTable const * table)
+// Use a final descent guidance table, if it was solved for the current target speeds. Null reverts to the
+// constant mass thrust law.
+{
+	Guidance = table;
+	UseGuidance = Guidance && Guidance->matches(Params);
 }
 
 void AutoPilot::updateTimer(double const dt)
@@ -54,228 +220,300 @@ void AutoPilot::updateTimer(double const dt)
 	Timer += dt;
 }
 
-void AutoPilot::autopilotUpdate(Surveyor* sc, double const& SimT, double const& dt)
-// Autopilot loop called in each orbiter time step
+bool AutoPilot::timerReached(double const t) const
+// True once the timer has reached t seconds. The timer is a sum of time steps, so a step that should land exactly on t
+// may fall short by rounding; TIMER_TOLERANCE absorbs that.
+{
+	return Timer >= t - TIMER_TOLERANCE;
+}
+
+/* Mode sequence. Each mode's transitions are tested in order at every guidance update; their thresholds are autopilot
+   parameters, so they come from Config/Surveyor/AutoPilot.cfg. A preempting transition is tested before the mode's
+   action, which does not run on the update it is taken; the others after it. The timer restarts on every transition,
+   and runs only in timed modes. The new mode's action first runs at the next update. */
+const AutoPilot::ModeTransition AutoPilot::ModeTransitions[] = {
+	// IDLE: after IdleTime
+	{ &AutoPilot::timerGuard, &AutoPilotParams::IdleTime, true, HOLD_FOR_RETRO },
+	// HOLD_FOR_RETRO: at RetroAltitude, or at the predicted ignition time
+	{ &AutoPilot::retroIgnitionGuard, &AutoPilotParams::RetroAltitude, false, RETRO_DESCENT },
+	// RETRO_DESCENT: RetroEndTime after entering it
+	{ &AutoPilot::timerGuard, &AutoPilotParams::RetroEndTime, false, FINAL_DESCENT },
+	// FINAL_DESCENT: at ShutdownAltitude
+	{ &AutoPilot::altitudeGuard, &AutoPilotParams::ShutdownAltitude, true, SHUTDOWN }
+};
+
+const AutoPilot::ModeSpec AutoPilot::ModeTable[AUTOPILOT_MODES] = {
+	// Entry, action, exit, timed, transitions
+	{ 0, &AutoPilot::idleControl, 0, true, 0, 1 },                       // IDLE
+	{ 0, &AutoPilot::holdForRetroDescent, 0, false, 1, 1 },              // HOLD_FOR_RETRO
+	{ 0, &AutoPilot::retroDescent, &AutoPilot::retroExit, true, 2, 1 },  // RETRO_DESCENT
+	{ 0, &AutoPilot::finalDescent, 0, false, 3, 1 },                     // FINAL_DESCENT
+	{ 0, &AutoPilot::shutdown, 0, false, 4, 0 }                          // SHUTDOWN
+};
+
+void AutoPilot::autopilotUpdate(Surveyor* sc, StateFrame const& sf)
+// Autopilot loop called at each guidance update, with the vessel state sampled for that update
 {
-	// Declare character vector representing autopilot mode that will be printed in the debug string
-	char ModeString[24];
+	PROFILE_SCOPE(PROFILE_AUTOPILOT);
 
-	// Call autopilot routine based on mode, and fill out ModeString appropriately
-	switch (Mode)
-	{
-	case IDLE:
-		strncpy(ModeString, "Idle", 24);
-		idleControl(sc, dt);
-		break;
-	case HOLD_FOR_RETRO:
-		strncpy(ModeString, "Hold for retro ignition", 24);
-		holdForRetroDescent(sc);
-		break;
-	case RETRO_DESCENT:
-		strncpy(ModeString, "Initial descent", 24);
-		retroDescent(sc, dt);
-		break;
-	case FINAL_DESCENT:
-		strncpy(ModeString, "Final descent", 24);
-		finalDescent(sc);
-		break;
-	case SHUTDOWN:
-		strncpy(ModeString, "Shutdown", 24);
-		shutdown(sc);
-		break;
-	default:
-		strncpy(ModeString, "Unknown", 24);
-		vernierControl(sc, 0);
+	// The debug string shows the mode this update ran in
+	AutoPilotStatus mode = Mode;
+
+	// Run the mode's action unless a preempting transition is taken, then test the others
+	if (!takeTransition(sc, sf, true)) {
+		ModeSpec const & m = ModeTable[Mode];
+		(this->*m.Action)(sc, sf);
+		if (!takeTransition(sc, sf, false) && m.Timed) updateTimer(sf.SimDT);
 	}
 
 	// Print debug string
-	VECTOR3 v;
-	bool status = sc->GetAirspeedVector(FRAME_LOCAL, v);
-	sprintf(oapiDebugString(), "Autopilot mode: %s   Altitude: %f m   Velocity: %f m/s   Vernier thrust levels: %f, %f, %f   Retro thrust level: %f",
-		ModeString,
-		radarAltitude(sc),
-		sqrt(pow(v.x, 2) + pow(v.y, 2) + pow(v.z, 2)),
-		sc->GetThrusterLevel(sc->th_vernier[0]), sc->GetThrusterLevel(sc->th_vernier[1]), sc->GetThrusterLevel(sc->th_vernier[2]),
-		sc->GetThrusterLevel(sc->th_retro));
+	if (DebugOutput) printDebugString(sc, sf, AutoPilotModeNames[mode]);
 }
 
-void AutoPilot::idleControl(Surveyor* sc, double const & dt)
-// Autopilot routine for IDLE mode. This is the initial mode, and lasts for 10 seconds. All thrusters are left at idle.
+bool AutoPilot::takeTransition(Surveyor* sc, StateFrame const & sf, bool preempt)
+// Take the first of the current mode's preempting (or other) transitions whose guard passes. Returns true if one was taken.
 {
-	// Once the timer ticks to 10, advance autopilot mode to HOLD_FOR_RETRO, reset timer, and return
-	if (Timer >= 10)
-	{
-		Mode = HOLD_FOR_RETRO;
+	ModeSpec const & m = ModeTable[Mode];
+	for (int i = m.First; i < m.First + m.Count; i++) {
+		ModeTransition const & t = ModeTransitions[i];
+		if (t.Preempt != preempt || !(this->*t.Guard)(sc, sf, Params.*t.Threshold)) continue;
+		if (m.Exit) (this->*m.Exit)(sc, sf);
+		Mode = t.Next;
 		Timer = 0;
-		return;
+		if (ModeTable[Mode].Entry) (this->*ModeTable[Mode].Entry)(sc, sf);
+		return true;
 	}
+	return false;
+}
+
+bool AutoPilot::timerGuard(Surveyor*, StateFrame const &, double t) const
+// The mode timer has reached t seconds
+{
+	return timerReached(t);
+}
+
+bool AutoPilot::altitudeGuard(Surveyor*, StateFrame const & sf, double altitude) const
+// The height above terrain is at or below altitude
+{
+	return sf.RadarAltitude <= altitude;
+}
+
+bool AutoPilot::retroIgnitionGuard(Surveyor* sc, StateFrame const & sf, double altitude) const
+// With PredictedIgnition, the trajectory predictor's optimal ignition time replaces the altitude rule once a prediction is
+// available: RETRO_DESCENT begins RetroIgnitionDelay (7 seconds) before it. Otherwise it begins at altitude.
+{
+	Prediction p;
+	if (Options.PredictedIgnition != 0 && sc->Predictions.latest(p) && p.Optimal) {
+		return sf.SimT + Params.RetroIgnitionDelay >= p.OptimalIgnitionTime;
+	}
+	return sf.RadarAltitude <= altitude;
+}
+
+void AutoPilot::printDebugString(Surveyor* sc, StateFrame const & sf, char const* mode) const
+// Write the autopilot mode, altitude, velocity and thrust levels to the Orbiter debug string
+{
+	PROFILE_SCOPE(PROFILE_DEBUG_STRING);
+	PROFILE_API("oapiDebugString");
+	sprintf(oapiDebugString(), "Autopilot mode: %s   Altitude: %f m   Velocity: %f m/s   Vernier thrust levels: %f, %f, %f   Retro thrust level: %f",
+		mode,
+		sf.RadarAltitude,
+		sf.Speed,
+		sc->Actuators.getLevel(sc, sc->th_vernier[0]), sc->Actuators.getLevel(sc, sc->th_vernier[1]), sc->Actuators.getLevel(sc, sc->th_vernier[2]),
+		sc->Actuators.getLevel(sc, sc->th_retro));
+}
+
+void AutoPilot::idleControl(Surveyor* sc, StateFrame const &)
+// Autopilot routine for IDLE mode. This is the initial mode, and lasts for IdleTime (10 seconds). All thrusters are left at idle.
+{
+	PROFILE_SCOPE(PROFILE_IDLE);
 
 	// Idle vernier thrusters
 	idleVernierThrusters(sc);
-
-	// Advance timer by the orbiter-specified time step dt
-	updateTimer(dt);
 }
 
-void AutoPilot::holdForRetroDescent(Surveyor* sc)
+void AutoPilot::holdForRetroDescent(Surveyor* sc, StateFrame const & sf)
 /* Autopilot routine for HOLD_FOR_RETRO mode.The vernier thrusters are used to
-   orient the spacecraft opposite to surface relative velocity vector.*/
+   orient the spacecraft opposite to surface relative velocity vector. The mode ends at RetroAltitude (110 km), or
+   with PredictedIgnition at the trajectory predictor's optimal ignition time.*/
 {
-	// Height above terrain
-	double altitude = radarAltitude(sc);
+	PROFILE_SCOPE(PROFILE_HOLD_FOR_RETRO);
 
 	// Set vernier thrust levels. The steady state thrust level is 0.
-	vernierControl(sc, 0);
-
-	// If altitude goes below 110 km, advance autopilot mode to RETRO_DESCENT
-	if (altitude <= 110000) Mode = RETRO_DESCENT;
+	vernierControl(sc, sf, 0);
 }
 
-void AutoPilot::retroDescent(Surveyor* sc, double const& dt)
+void AutoPilot::retroDescent(Surveyor* sc, StateFrame const & sf)
 /* Autopilot routine for RETRO_DESCENT mode. The timer starts to run at the beginning of this mode.
    After 7 seconds have elapsed, the retro rocket is ignited, which burns at maximum thrust until
    the propellant is exhausted. All this time, the vernier thrusters are used for keepimg the spacecraft
-   oriented opposite to surface relative velocity.*/
+   oriented opposite to surface relative velocity. The retro rocket propellant will be exhausted after 40 seconds
+   from ignition; the mode ends one more second later (RetroEndTime, 48 seconds from the start of this mode).*/
 {
-	// After 7 seconds have elapsed since the beginning of this mode, fire the retro rocket.
-	if (Timer >= 7)
+	PROFILE_SCOPE(PROFILE_RETRO_DESCENT);
+
+	// After RetroIgnitionDelay (7 seconds) has elapsed since the beginning of this mode, fire the retro rocket.
+	if (timerReached(Params.RetroIgnitionDelay))
 	{
 		// Keep the retro thrust level at maximum.
-		sc->SetThrusterLevel(sc->th_retro, 1);
+		sc->Actuators.setLevel(sc->th_retro, 1);
 
 		// Use the vernier thrusters only to keep the spacecraft oriented opposite to surface relative velocity.
 		// THe steady state thrust level is 0.
-		vernierControl(sc, 0);
-	}
-
-	// The retro rocket propellant will be exhausted after 40 seconds from ignition. Wait for one
-	// more second, and then advance the autopilot mode to FINAL_DESCENT. Reset the timer.
-	if (Timer >= 48)
-	{
-		sc->SetThrusterLevel(sc->th_retro, 0);
-		Timer = 0;
-		Mode = FINAL_DESCENT;
+		vernierControl(sc, sf, 0);
 	}
+}
 
-	// Advance the timer by the orbiter-specified time step dt.
-	updateTimer(dt);
+void AutoPilot::retroExit(Surveyor* sc, StateFrame const &)
+// Leaving RETRO_DESCENT: the retro rocket is shut off
+{
+	sc->Actuators.setLevel(sc->th_retro, 0);
 }
 
-void AutoPilot::finalDescent(Surveyor* sc)
+void AutoPilot::finalDescent(Surveyor* sc, StateFrame const & sf)
 /* Autopilot routine for FINAL_DESCENT mode. Keep the vernier thrusters at idle until descending below 20 km,
    except for keepimg the spacecraft oriented opposite to surface relative velocity. After this, they are used
    for both slowing down and keeping the spacecraft oriented opposite to the surface relative velocity. The
    desired thrust level is updated at each time step as a constant value that will provide the desired velocity
-   at 0 m altitude. The approach is naiive, as it assumes the instantaneous mass to be constant at each uptate.
-   TODO: Derive analytical expression for this desired thrust by accounting decreasing mass.
-   This mode ends when the altitude is 4 meters. */
+   at 0 m altitude. When a guidance table is loaded, the level is interpolated from thrust levels solved offline
+   for the decreasing mass (see SurveyorGuidance); otherwise the mass is assumed constant at each update.
+   With ConvexDescent, the thrust vector is taken instead from the descent optimizer's latest fuel-optimal profile
+   whenever one covers the update, braking at full thrust while the profile needs more than the planned thrust bound,
+   and the laws above fly until the first arrives, if the optimizer falls behind, or if the problem becomes infeasible.
+   This mode ends when the altitude is ShutdownAltitude (4 meters). */
 {
+	PROFILE_SCOPE(PROFILE_FINAL_DESCENT);
+
 	// Height above terrain
-	double altitude = radarAltitude(sc);
+	double altitude = sf.RadarAltitude;
+
+	// Thrust of the descent optimizer's profile, vessel frame
+	VECTOR3 thrust;
 
-	if (altitude <= 4.0)
-	// If altitude is less than or equal to 4 m, advance the autopilot mode to SHUTDOWN, and return.
+	if (Options.ConvexDescent != 0 && profileThrust(sc, sf, thrust))
+		// Point the verniers along the planned thrust and hold its magnitude. The profile already spends its time
+		// coasting above the altitude where braking must begin.
 	{
-		Mode = SHUTDOWN;
+		vernierControl(sc, sf, length(thrust) / (3 * VERNIER_THRUST), thrust);
 	}
-	else if (altitude > 20000)
-		// If the altitude is greater than 20 km, set the steady state thrust level of the vernier thrusters to 0, but
+	else if (altitude > Params.GuidanceAltitude)
+		// If the altitude is greater than GuidanceAltitude (20 km), set the steady state thrust level of the vernier thrusters to 0, but
 		// continue to use them to keep the spacecraft oriented opposite to surface relative velocity vector.
 	{
-		vernierControl(sc, 0);
+		vernierControl(sc, sf, 0);
+	}
+	else if (UseGuidance)
+		// Look up the vernier thrust level for the desired final velocity, accounting for the propellant burnt on the way,
+		// while simultaneously using it to keep the spacecraft oriented opposite to surface relative velocity vector.
+	{
+		GuidanceTarget target = altitude <= Params.TerminalAltitude ? GDT_TERMINAL : GDT_APPROACH;
+		vernierControl(sc, sf, Guidance->level(target, altitude, sf.Speed, sf.Mass));
 	}
 	else
 		// Calculate the vernier thrust level for a desired final velocity, while simultaneously using it to keep the
 		// spacecraft oriented opposite to surface relative velocity vector.
 	{
-		// Obtain current mass
-		double m = sc->GetMass();
-
-		// Obtain current surface relative velocity vector
-		VECTOR3 u;
-		bool status = sc->GetAirspeedVector(FRAME_LOCAL, u);
+		// Current mass
+		double m = sf.Mass;
 
 		// Current surface relative velocity magnitude squared
-		double uSq = pow(u.x, 2) + pow(u.y, 2) + pow(u.z, 2);
+		double uSq = sf.SpeedSq;
 
-		// Set the final desired velocity magnitude to 1 m/s if the altitude is less than 500 ft, and 50 m/s otherwise.
+		// Set the final desired velocity magnitude to TerminalSpeed (1 m/s) if the altitude is less than TerminalAltitude (500 m),
+		// and ApproachSpeed (50 m/s) otherwise.
 		double vSq;
-		if (altitude <= 500)
+		if (altitude <= Params.TerminalAltitude)
 		{
-			vSq = 1.0;
+			vSq = Params.TerminalSpeed * Params.TerminalSpeed;
 		}
 		else
 		{
-			vSq = 50 * 50;
+			vSq = Params.ApproachSpeed * Params.ApproachSpeed;
 		}
 		// Required thrust assuming constant gravity, mass, and a flight path angle of -90 degrees
 		double F = (m * g) - (m * (vSq - uSq) / altitude);
 
 		// Set the vernier thrust levels
-		vernierControl(sc, min(max(F / (3 * VERNIER_THRUST), 0), 1));
+		vernierControl(sc, sf, min(max(F / (3 * VERNIER_THRUST), 0), 1));
 	}
 }
 
-void AutoPilot::shutdown(Surveyor* sc)
+void AutoPilot::shutdown(Surveyor* sc, StateFrame const &)
 // Autopilot routine for SHUTDOWN mode. The vernier thrusters and vernier thruster 1 thrust vector angle are set to 0.
 {
+	PROFILE_SCOPE(PROFILE_SHUTDOWN);
+
 	// Idle vernier thrusters
 	idleVernierThrusters(sc);
 }
 
-void AutoPilot::vernierControl(Surveyor* sc, double const & thrustLevel)
+void AutoPilot::vernierControl(Surveyor* sc, StateFrame const & sf, double const & thrustLevel)
 // Controller for vernier thrusters to maintain the specified steady state thrust level, while also keeping the spacecraft
 // oriented retrograde with respect to the surface relative velocity vector
 {
-	// Get the current surface relative velocity vector
-	REFFRAME frame = FRAME_LOCAL;
-	VECTOR3 v;
-	bool status = sc->GetAirspeedVector(frame, v);
-
-	// Get the current angular velocity vector
-	VECTOR3 w;
-	sc->GetAngularVel(w);
+	vernierControl(sc, sf, thrustLevel, -sf.Airspeed);
+}
 
-	// Calculate the unit vector in the body frame of the spacecraft about which the spacecraft must be rotated to get to the
-	// desired orientation. This calculates as the unit vector of the cross product between the roll axis (z axis) and the 
-	// negative surface relative velocity vector
-	VECTOR3 lambda;
-	lambda.x = -(-v.y / sqrt(pow(v.x, 2) + pow(v.y, 2)));
-	lambda.y = (-v.x / sqrt(pow(v.x, 2) + pow(v.y, 2)));
-	lambda.z = 0;
+void AutoPilot::vernierControl(Surveyor* sc, StateFrame const & sf, double const & thrustLevel, VECTOR3 const & thrustDir)
+// Controller for vernier thrusters to maintain the specified steady state thrust level, while also keeping the roll axis,
+// along which the verniers thrust, pointed along thrustDir in the vessel frame
+{
+	// Current angular velocity vector
+	VECTOR3 const & w = sf.AngularVel;
 
-	// Calculate the angle by which the spacecraft must be rotated about lambda to get to the desired orientation
-	double ang = acos((-v.z) / sqrt(pow(v.x, 2) + pow(v.y, 2) + pow(v.z, 2)));
+	// Rotation that takes the roll axis (z axis) onto the desired thrust direction. Its vector part is sin(ang / 2) times
+	// the unit vector lambda about which the spacecraft must be rotated to get to the desired orientation, ang being the
+	// angle of that rotation.
+	Quaternion q = shortestArc(_V(0, 0, 1), thrustDir);
+	double h = sqrt(lengthSq(q.x, q.y, q.z));
 
 	// Calculate the desired angular velocity vector for the inner control loop that drives the angular velocity vector to the desired value
 	VECTOR3 omega_d;
-	if (ang < 0.01)
-	// If ang is less than 0.01 radians, and hence, inside the deadband, the desired angular velocity is 0
+	if (h < HalfDeadband)
+	// If ang is less than AngleDeadband (0.01 radians), and hence, inside the deadband, the desired angular velocity is 0
 	{
 		omega_d = { 0,0,0 };
 	}
+	else if (h >= HalfSaturation)
+	// If the proportional command Kp_ang * ang would exceed RateLimit (0.02 rad/s), command RateLimit about lambda
+	{
+		double k = -Params.RateLimit / h;
+		omega_d = { q.x * k, q.y * k, q.z * k };
+	}
 	else
-	// If ang is outside the deadband, ang is driven towards by a proportional controller
+	// Otherwise ang is driven towards 0 by a proportional controller acting on the rotation vector ang * lambda
 	{
-		// Outer loop for driving ang towards 0, which commands the desired angular velocity magnitude, and limit the magnitude
-		// to 0.02 rad/s
-		double omega_d_mag = -min(Kp_ang * ang, 0.02);
-
-		// Construct the desired angular velocity vector
-		omega_d = { lambda.x * omega_d_mag, lambda.y * omega_d_mag, lambda.z * omega_d_mag };
+		double k = -Params.Kp_ang * rotationScale(q);
+		omega_d = { q.x * k, q.y * k, q.z * k };
 	}
 
+	// Hold the angular velocity loop inputs for rate loop updates until the next call
+	OmegaD = omega_d;
+	SteadyLevel = thrustLevel;
+	RateLoopActive = true;
+
 	// Call angular velocity controller to calculate the desired thrust level for each vernier thruster, and the desired thrust vector
 	// for vernier thruster 1
 	angularVelocityController(sc, omega_d, w, thrustLevel);
+	setVernierThrusters(sc);
+}
 
-	// Set the vernier thrust levels to the value specified by the controller
-	sc->SetThrusterLevel(sc->th_vernier[0], VernierThrustLevel.x);
-	sc->SetThrusterLevel(sc->th_vernier[1], VernierThrustLevel.y);
-	sc->SetThrusterLevel(sc->th_vernier[2], VernierThrustLevel.z);
-
-	// Set the vernier thruster 1 thrust vector angle to the desired angle specified by the controller
-	sc->SetThrusterDir(sc->th_vernier[0], _V(sin(Alpha), 0, cos(Alpha)));
+bool AutoPilot::profileThrust(Surveyor* sc, StateFrame const & sf, VECTOR3 & thrust) const
+// Vernier thrust of the descent optimizer's latest profile at this update, in the vessel frame [N]. The profile is read
+// without waiting for the optimizer; returns false if no feasible profile younger than DESCENT_MAX_AGE covers the
+// update. A profile that needs the reserve thrust bound means thrust or mass errors have pushed the descent past the
+// planned one, so the verniers brake at full thrust against the velocity until the planned bound suffices again.
+{
+	DescentProfile p;
+	if (!sc->Descents.latest(p) || !p.Feasible) return false;
+	double t = sf.SimT - p.SimT;
+	if (t < 0 || t >= p.Duration || t > DESCENT_MAX_AGE) return false;
+	if (p.Reserve) {
+		thrust = -sf.Airspeed * (3 * VERNIER_THRUST / sf.Speed);
+		return true;
+	}
+	int k = min((int)(t / p.Duration * DESCENT_NODES), DESCENT_NODES - 1);
+	thrust = tmul(sf.Horizon, p.Thrust[k]);
+	return true;
 }
 
 void AutoPilot::angularVelocityController(Surveyor* sc, VECTOR3 const omega_d, VECTOR3 const omega, double const & thrustLevel)
@@ -285,15 +523,28 @@ void AutoPilot::angularVelocityController(Surveyor* sc, VECTOR3 const omega_d, V
 	// Angular velocity vector error
 	VECTOR3 OmegaError = { omega.x - omega_d.x , omega.y - omega_d.y , omega.z - omega_d.z };
 
-	if (sqrt(pow(OmegaError.x, 2) + pow(OmegaError.y, 2) + pow(OmegaError.z, 2)) < 0.0001)
-	// If the angular velocity vector error magnitude is less than 0.0001 rad/s, do not attempt to modify the angular velocity
+	if (lengthSq(OmegaError) < Params.RateDeadband * Params.RateDeadband)
+	// If the angular velocity vector error magnitude is less than RateDeadband (0.0001 rad/s), do not attempt to modify the angular velocity
 	// further as it is inside the angular velocity deadband. Accordingly, just set the thrusters to the specified steady
 	// state thrust level, and vernier thruster 1 thrust vector angle to 0.
 	{
 		VernierThrustLevel.x = thrustLevel;
 		VernierThrustLevel.y = thrustLevel;
 		VernierThrustLevel.z = thrustLevel;
-		Alpha = 0;
+		SinAlpha = 0;
+		CosAlpha = 1;
+		for (int i = 0; i < ALLOCATOR_RCS; i++) RcsLevel[i] = 0;
+	}
+	else if (Options.ControlAllocation != 0 && Allocator.configured())
+	// Under control allocation, spread the same moments over the verniers and the vernier 1 gimbal, with the thrust of
+	// the clipped steady state level, and hand what they cannot deliver to the RCS jets
+	{
+		VECTOR3 M = { Params.Kp_wx * OmegaError.x, Params.Kp_wy * OmegaError.y, Params.Kp_wz * OmegaError.z };
+		double level = min(max(thrustLevel, 0.05), 0.95);
+		double v[3];
+		Allocator.allocate(M, 3 * VERNIER_THRUST * level, level * SinAlphaLimit, SinAlphaLimit, v, SinAlpha, RcsLevel);
+		CosAlpha = sqrt(1 - SinAlpha * SinAlpha);
+		VernierThrustLevel = _V(v[0], v[1], v[2]);
 	}
 	else
 	// If the angular velocity error is outside the deadband, calculate the thrust levels and thrust vector angle to drive the
@@ -309,17 +560,19 @@ void AutoPilot::angularVelocityController(Surveyor* sc, VECTOR3 const omega_d, V
 		F1 = VERNIER_THRUST*min(max(thrustLevel, 0.05), 0.95);
 
 		// Calculate the desired moments based on a proportional controller to drive the angular velocity vector to 0.
-		M.x = Kp_w.x * OmegaError.x;
-		M.y = Kp_w.y * OmegaError.y;
-		M.z = Kp_w.z * OmegaError.z;
+		M.x = Params.Kp_wx * OmegaError.x;
+		M.y = Params.Kp_wy * OmegaError.y;
+		M.z = Params.Kp_wz * OmegaError.z;
 
-		// Based on the desired roll moment and vernier thruster 1 thrust level, calculate the thrust vector angle
-		Alpha = min(max(asin(-(M.z / (VERNIER_RAD * F1))), -5 * PI / 180), 5 * PI / 180);
+		// Based on the desired roll moment and vernier thruster 1 thrust level, calculate the sine of the thrust vector angle, limited to
+		// the sine of AlphaLimit. Only the sine and cosine are needed, so the angle itself is never formed.
+		SinAlpha = min(max(-(M.z / (VERNIER_RAD * F1)), -SinAlphaLimit), SinAlphaLimit);
+		CosAlpha = sqrt(1 - SinAlpha * SinAlpha);
 
 		// Based on the desired pitch and yaw moments, vernier 1 thrust level, and vernier 1 thrust vector angle, calculate the desired
 		// vernier 2 and 3 thrust levels
-		F2 = ((F1 * cos(Alpha)) - (M.x / VERNIER_RAD)) - ((1 / sqrt(3)) * ((VERNIER_STA * F1 * sin(Alpha)) - M.y) / VERNIER_RAD);
-		F3 = ((F1 * cos(Alpha)) - (M.x / VERNIER_RAD)) + ((1 / sqrt(3)) * ((VERNIER_STA * F1 * sin(Alpha)) - M.y) / VERNIER_RAD);
+		F2 = ((F1 * CosAlpha) - (M.x / VERNIER_RAD)) - ((1 / sqrt(3)) * ((VERNIER_STA * F1 * SinAlpha) - M.y) / VERNIER_RAD);
+		F3 = ((F1 * CosAlpha) - (M.x / VERNIER_RAD)) + ((1 / sqrt(3)) * ((VERNIER_STA * F1 * SinAlpha) - M.y) / VERNIER_RAD);
 
 		// Clip the thrust levels to between 0 and 1
 		VernierThrustLevel.x = min(max(F1 / VERNIER_THRUST, 0), 1);
@@ -0,0 +1,235 @@
+// ==============================================================
+//                  ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotBatch.cpp
+// Batched autopilot kernel: structure-of-arrays storage, scalar and SSE2
+// kernels, and instruction set dispatch. The AVX2 kernel is compiled in
+// AutoPilotBatchAVX2.cpp with AVX2 code generation enabled.
+//
+// ==============================================================
+
+#include "AutoPilotBatchKernel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BATCH_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Widest vector the kernels use, in doubles. Batches are padded to a multiple of this.
+const size_t BATCH_LANES = 4;
+
+void VernierBatch::resize(size_t n)
+// Set the number of vehicles. Padding lanes hold a benign retrograde state.
+{
+	Count = n;
+	size_t padded = (n + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+	std::vector<double>* arrays[] = { &Vx, &Vy, &Vz, &Wx, &Wy, &Wz, &OmegaDx, &OmegaDy, &OmegaDz,
+		&ThrustLevel, &Level0, &Level1, &Level2, &SinAlpha };
+	for (std::vector<double>* a : arrays) a->resize(padded, 0.0);
+	for (size_t i = n; i < padded; i++) Vz[i] = -1.0;
+}
+
+void VernierBatch::set(size_t i, VECTOR3 const& v, VECTOR3 const& w, double thrustLevel)
+// Load the state of vehicle i
+{
+	Vx[i] = v.x;
+	Vy[i] = v.y;
+	Vz[i] = v.z;
+	Wx[i] = w.x;
+	Wy[i] = w.y;
+	Wz[i] = w.z;
+	ThrustLevel[i] = thrustLevel;
+}
+
+// --------------------------------------------------------------
+// Scalar lanes
+// --------------------------------------------------------------
+struct BatchScalar {
+	typedef double T;
+	typedef bool M;
+	enum { W = 1 };
+	static T load(const double* p) { return *p; }
+	static void store(double* p, T a) { *p = a; }
+	static T set1(double a) { return a; }
+	static T add(T a, T b) { return a + b; }
+	static T sub(T a, T b) { return a - b; }
+	static T mul(T a, T b) { return a * b; }
+	static T div(T a, T b) { return a / b; }
+	static T sqrt(T a) { return ::sqrt(a); }
+	static T abs(T a) { return fabs(a); }
+	static T min(T a, T b) { return a < b ? a : b; }
+	static T max(T a, T b) { return a > b ? a : b; }
+	static M lt(T a, T b) { return a < b; }
+	static M le(T a, T b) { return a <= b; }
+	static M gt(T a, T b) { return a > b; }
+	static M andm(M a, M b) { return a && b; }
+	static T blend(M m, T a, T b) { return m ? a : b; }
+	static T rotationScale(T w, T x, T y) { Quaternion q = { w, x, y, 0 }; return ::rotationScale(q); }
+};
+
+bool vernierKernelScalar(VernierGains const& g, VernierBatch& b, bool outerLoop)
+{
+	vernierKernel<BatchScalar>(g, b, outerLoop);
+	return true;
+}
+
+// --------------------------------------------------------------
+// SSE2 lanes. min and max keep the operand order of the scalar path,
+// so a NaN in the first operand yields the second, as in the scalar code.
+// --------------------------------------------------------------
+#ifdef BATCH_HAVE_SSE2
+struct BatchSSE2 {
+	typedef __m128d T;
+	typedef __m128d M;
+	enum { W = 2 };
+	static T load(const double* p) { return _mm_loadu_pd(p); }
+	static void store(double* p, T a) { _mm_storeu_pd(p, a); }
+	static T set1(double a) { return _mm_set1_pd(a); }
+	static T add(T a, T b) { return _mm_add_pd(a, b); }
+	static T sub(T a, T b) { return _mm_sub_pd(a, b); }
+	static T mul(T a, T b) { return _mm_mul_pd(a, b); }
+	static T div(T a, T b) { return _mm_div_pd(a, b); }
+	static T sqrt(T a) { return _mm_sqrt_pd(a); }
+	static T abs(T a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+	static T min(T a, T b) { return _mm_min_pd(a, b); }
+	static T max(T a, T b) { return _mm_max_pd(a, b); }
+	static M lt(T a, T b) { return _mm_cmplt_pd(a, b); }
+	static M le(T a, T b) { return _mm_cmple_pd(a, b); }
+	static M gt(T a, T b) { return _mm_cmpgt_pd(a, b); }
+	static M andm(M a, M b) { return _mm_and_pd(a, b); }
+	static T blend(M m, T a, T b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+	static T rotationScale(T, T x, T y) { return batchRotationSeries<BatchSSE2>(add(mul(x, x), mul(y, y))); }
+};
+
+bool vernierKernelSSE2(VernierGains const& g, VernierBatch& b, bool outerLoop)
+{
+	vernierKernel<BatchSSE2>(g, b, outerLoop);
+	return true;
+}
+#else
+bool vernierKernelSSE2(VernierGains const& g, VernierBatch& b, bool outerLoop)
+{
+	return false;
+}
+#endif
+
+// --------------------------------------------------------------
+// Batched autopilot
+// --------------------------------------------------------------
+AutoPilotBatch::AutoPilotBatch(void)
+// Batched autopilot constructor
+{
+	// Same gains and limits as the scalar autopilot's design values
+	AutoPilotParams p;
+	Gains.Kp_w[0] = p.Kp_wx;
+	Gains.Kp_w[1] = p.Kp_wy;
+	Gains.Kp_w[2] = p.Kp_wz;
+	Gains.Kp_ang = p.Kp_ang;
+	Gains.AngleDeadband = p.AngleDeadband;
+	Gains.RateLimit = p.RateLimit;
+	Gains.RateDeadband = p.RateDeadband;
+	Gains.AlphaLimit = p.AlphaLimit;
+
+	// Use the widest instruction set that is both compiled in and supported by the processor
+	Active = ISA_SCALAR;
+	for (int isa = detectIsa(); isa > ISA_SCALAR; isa--) {
+		if (setIsa((Isa)isa)) break;
+	}
+}
+
+bool AutoPilotBatch::setIsa(Isa isa)
+// Select the kernel. Returns false, leaving the selection unchanged, if the kernel was not compiled in.
+{
+	VernierBatch empty;
+	bool available = false;
+	switch (isa) {
+	case ISA_SCALAR:
+		available = true;
+		break;
+	case ISA_SSE2:
+		available = vernierKernelSSE2(Gains, empty, true);
+		break;
+	case ISA_AVX2:
+		available = vernierKernelAVX2(Gains, empty, true);
+		break;
+	}
+	if (available) Active = isa;
+	return available;
+}
+
+void AutoPilotBatch::setGains(VernierGains const& g)
+// Replace the controller gains and limits
+{
+	Gains = g;
+}
+
+void AutoPilotBatch::vernierControl(VernierBatch& b) const
+// Attitude and thrust control for every vehicle, from its velocity, angular velocity and steady state thrust level
+{
+	run(b, true);
+}
+
+void AutoPilotBatch::angularVelocityController(VernierBatch& b) const
+// Angular velocity loop only, from the desired angular velocities in b.OmegaD
+{
+	run(b, false);
+}
+
+void AutoPilotBatch::run(VernierBatch& b, bool outerLoop) const
+{
+	// The vector kernels evaluate rotationScale by its series, which needs the attitude error saturation
+	// half-angle to stay within its range. Other gains take the scalar kernel.
+	double halfSat = 0.5 * Gains.RateLimit / Gains.Kp_ang;
+	bool seriesValid = halfSat < 0.5 * PI && sin(halfSat) <= ATTITUDE_SERIES_RANGE;
+	Isa isa = seriesValid ? Active : ISA_SCALAR;
+
+	switch (isa) {
+	case ISA_AVX2:
+		vernierKernelAVX2(Gains, b, outerLoop);
+		break;
+	case ISA_SSE2:
+		vernierKernelSSE2(Gains, b, outerLoop);
+		break;
+	default:
+		vernierKernelScalar(Gains, b, outerLoop);
+	}
+}
+
+AutoPilotBatch::Isa AutoPilotBatch::detectIsa()
+// Widest instruction set supported by the processor and operating system
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) return ISA_AVX2;
+	if (__builtin_cpu_supports("sse2")) return ISA_SSE2;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int r[4];
+	__cpuid(r, 0);
+	int maxLeaf = r[0];
+	__cpuid(r, 1);
+	bool sse2 = (r[3] >> 26) & 1;
+	bool osxsave = (r[2] >> 27) & 1;
+	bool avx = (r[2] >> 28) & 1;
+	if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+		__cpuidex(r, 7, 0);
+		if ((r[1] >> 5) & 1) return ISA_AVX2;
+	}
+	if (sse2) return ISA_SSE2;
+#endif
+	return ISA_SCALAR;
+}
+
+const char* AutoPilotBatch::isaName(Isa isa)
+{
+	switch (isa) {
+	case ISA_SSE2: return "SSE2";
+	case ISA_AVX2: return "AVX2";
+	default: return "scalar";
+	}
+}
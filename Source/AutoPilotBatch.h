@@ -0,0 +1,72 @@
+// ==============================================================
+//                  ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotBatch.h
+// Header file with declarations for the batched autopilot kernel, which
+// evaluates AutoPilot::vernierControl and AutoPilot::angularVelocityController
+// for many vehicle states at once
+//
+// ==============================================================
+
+#pragma once
+
+#include "Surveyor.h"
+#include <vector>
+
+// Vehicle states for the batched kernel, stored as structure of arrays. The arrays are padded
+// to a whole number of vector lanes, so the kernel never needs a scalar remainder loop.
+struct VernierBatch {
+	std::vector<double> Vx, Vy, Vz;             // Surface relative velocity, vessel frame [m/s]
+	std::vector<double> Wx, Wy, Wz;             // Angular velocity, vessel frame [rad/s]
+	std::vector<double> OmegaDx, OmegaDy, OmegaDz; // Desired angular velocity, input to angularVelocityController only [rad/s]
+	std::vector<double> ThrustLevel;            // Steady state thrust level
+	std::vector<double> Level0, Level1, Level2; // Thrust levels of th_vernier[0], [1] and [2]
+	std::vector<double> SinAlpha;               // Sine of the thrust vector angle for vernier thruster 1
+
+	void resize(size_t n);
+	size_t size() const { return Count; }
+	size_t paddedSize() const { return Vx.size(); }
+	void set(size_t i, VECTOR3 const& v, VECTOR3 const& w, double thrustLevel);
+
+private:
+	size_t Count = 0; // Number of vehicles in the batch
+};
+
+// Gains and limits shared by every vehicle in the batch
+struct VernierGains {
+	double Kp_w[3];        // Proportional gain for angular velocity loop
+	double Kp_ang;         // Proportional gain for angle error loop
+	double AngleDeadband;  // Attitude error deadband [rad]
+	double RateLimit;      // Desired angular velocity limit [rad/s]
+	double RateDeadband;   // Angular velocity error deadband [rad/s]
+	double AlphaLimit;     // Vernier 1 thrust vector angle limit [rad]
+};
+
+// Batched autopilot class declaration
+class AutoPilotBatch {
+public:
+	// Instruction sets the kernel is compiled for
+	enum Isa { ISA_SCALAR, ISA_SSE2, ISA_AVX2 };
+
+	AutoPilotBatch(void);
+	void vernierControl(VernierBatch& b) const;
+	void angularVelocityController(VernierBatch& b) const;
+	void setGains(VernierGains const& g);
+	VernierGains const& getGains() const { return Gains; }
+	bool setIsa(Isa isa);
+	Isa getIsa() const { return Active; }
+	static Isa detectIsa();
+	static const char* isaName(Isa isa);
+private:
+	void run(VernierBatch& b, bool outerLoop) const;
+	VernierGains Gains; // Controller gains, identical to the scalar autopilot
+	Isa Active;         // Instruction set in use
+};
+
+// Kernel entry points, one per instruction set. Each returns false if that instruction set
+// was not available when the module was compiled.
+bool vernierKernelScalar(VernierGains const& g, VernierBatch& b, bool outerLoop);
+bool vernierKernelSSE2(VernierGains const& g, VernierBatch& b, bool outerLoop);
+bool vernierKernelAVX2(VernierGains const& g, VernierBatch& b, bool outerLoop);
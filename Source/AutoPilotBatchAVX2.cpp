@@ -0,0 +1,53 @@
+// ==============================================================
+//                  ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotBatchAVX2.cpp
+// AVX2 instantiation of the batched vernier controller. This file is
+// compiled with AVX2 code generation (/arch:AVX2 or -mavx2), and is only
+// called after AutoPilotBatch::detectIsa has confirmed processor support.
+//
+// ==============================================================
+
+#include "AutoPilotBatchKernel.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+// AVX2 lanes. min and max keep the operand order of the scalar path,
+// so a NaN in the first operand yields the second, as in the scalar code.
+struct BatchAVX2 {
+	typedef __m256d T;
+	typedef __m256d M;
+	enum { W = 4 };
+	static T load(const double* p) { return _mm256_loadu_pd(p); }
+	static void store(double* p, T a) { _mm256_storeu_pd(p, a); }
+	static T set1(double a) { return _mm256_set1_pd(a); }
+	static T add(T a, T b) { return _mm256_add_pd(a, b); }
+	static T sub(T a, T b) { return _mm256_sub_pd(a, b); }
+	static T mul(T a, T b) { return _mm256_mul_pd(a, b); }
+	static T div(T a, T b) { return _mm256_div_pd(a, b); }
+	static T sqrt(T a) { return _mm256_sqrt_pd(a); }
+	static T abs(T a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+	static T min(T a, T b) { return _mm256_min_pd(a, b); }
+	static T max(T a, T b) { return _mm256_max_pd(a, b); }
+	static M lt(T a, T b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	static M le(T a, T b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+	static M gt(T a, T b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	static M andm(M a, M b) { return _mm256_and_pd(a, b); }
+	static T blend(M m, T a, T b) { return _mm256_blendv_pd(b, a, m); }
+	static T rotationScale(T, T x, T y) { return batchRotationSeries<BatchAVX2>(add(mul(x, x), mul(y, y))); }
+};
+
+bool vernierKernelAVX2(VernierGains const& g, VernierBatch& b, bool outerLoop)
+{
+	vernierKernel<BatchAVX2>(g, b, outerLoop);
+	return true;
+}
+#else
+bool vernierKernelAVX2(VernierGains const& g, VernierBatch& b, bool outerLoop)
+{
+	return false;
+}
+#endif
@@ -0,0 +1,122 @@
+// ==============================================================
+//                  ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotBatchKernel.h
+// Vector-width independent body of the batched vernier controller. It is
+// instantiated once per instruction set with a small wrapper type V that
+// provides the lane type T, the comparison mask type M and the arithmetic.
+// The per-vehicle deadband branches of the scalar autopilot become masked
+// blends. The attitude error is the half-angle quaternion of AttitudeMath.h,
+// so no lane needs an inverse trigonometric call and every lane stays
+// finite with the velocity along the roll axis.
+//
+// ==============================================================
+
+#pragma once
+
+#include "AutoPilotBatch.h"
+#include "AttitudeMath.h"
+
+template <class V>
+inline typename V::T batchRotationSeries(typename V::T h2)
+// rotationScale of a quaternion with w >= 0 and h2 = sin(angle / 2)^2 within the series range, on its coefficients
+{
+	typedef typename V::T T;
+	T p = V::set1(ATTITUDE_SERIES[ATTITUDE_SERIES_TERMS - 1]);
+	for (int i = ATTITUDE_SERIES_TERMS - 2; i >= 0; i--) p = V::add(V::set1(ATTITUDE_SERIES[i]), V::mul(h2, p));
+	return V::mul(V::set1(2.0), p);
+}
+
+template <class V>
+void vernierKernel(VernierGains const& g, VernierBatch& b, bool outerLoop)
+// Batched equivalent of AutoPilot::vernierControl (outerLoop true) or
+// AutoPilot::angularVelocityController with the desired rates in b.OmegaD (outerLoop false)
+{
+	typedef typename V::T T;
+	typedef typename V::M M;
+
+	const T zero = V::set1(0.0);
+	const T one = V::set1(1.0);
+	const T negKpAng = V::set1(-g.Kp_ang);
+	const T negRateLimit = V::set1(-g.RateLimit);
+	const T rateDeadband2 = V::set1(g.RateDeadband * g.RateDeadband);
+	const T kpx = V::set1(g.Kp_w[0]), kpy = V::set1(g.Kp_w[1]), kpz = V::set1(g.Kp_w[2]);
+	const T thrust = V::set1(VERNIER_THRUST);
+	const T invThrust = V::set1(1 / VERNIER_THRUST);
+	const T rad = V::set1(VERNIER_RAD);
+	const T invRad = V::set1(1 / VERNIER_RAD);
+	const T sta = V::set1(VERNIER_STA);
+	const T invSqrt3 = V::set1(1 / sqrt(3.0));
+	const T levelMin = V::set1(0.05), levelMax = V::set1(0.95);
+
+	// Thresholds on sin(ang / 2) and the gimbal limit on its sine, as AutoPilot::updateThresholds sets them
+	double halfSat = 0.5 * g.RateLimit / g.Kp_ang;
+	const T hDeadband = V::set1(sin(0.5 * min(g.AngleDeadband, PI)));
+	const T hSaturate = V::set1(halfSat < 0.5 * PI ? sin(halfSat) : 2);
+	const T sinAlphaLimit = V::set1(sin(min(g.AlphaLimit, 0.5 * PI)));
+
+	for (size_t i = 0; i < b.paddedSize(); i += V::W) {
+		T odx, ody, odz = zero;
+		if (outerLoop) {
+			T vx = V::load(&b.Vx[i]), vy = V::load(&b.Vy[i]), vz = V::load(&b.Vz[i]);
+
+			// shortestArc from the roll axis to the negative velocity: (|v| - vz, vy, -vx, 0), normalised. With the
+			// velocity along the roll axis it is half a revolution about y, and with no velocity no rotation.
+			T v2 = V::add(V::add(V::mul(vx, vx), V::mul(vy, vy)), V::mul(vz, vz));
+			T w = V::sub(V::sqrt(v2), vz);
+			T n2 = V::add(V::mul(w, w), V::add(V::mul(vy, vy), V::mul(vx, vx)));
+			T s = V::div(one, V::sqrt(n2));
+			M opposite = V::le(n2, zero);
+			M moving = V::gt(v2, zero);
+			T qw = V::blend(opposite, V::blend(moving, zero, one), V::mul(w, s));
+			T qx = V::blend(opposite, zero, V::mul(vy, s));
+			T qy = V::blend(opposite, V::blend(moving, one, zero), V::mul(V::sub(zero, vx), s));
+			T h = V::sqrt(V::add(V::mul(qx, qx), V::mul(qy, qy)));
+
+			// Outer loop: RateLimit about the axis when saturated, otherwise proportional on the rotation vector, with
+			// a deadband around the desired attitude
+			M deadband = V::lt(h, hDeadband);
+			M saturated = V::le(hSaturate, h);
+			T k = V::blend(saturated, V::div(negRateLimit, h), V::mul(negKpAng, V::rotationScale(qw, qx, qy)));
+			odx = V::blend(deadband, zero, V::mul(qx, k));
+			ody = V::blend(deadband, zero, V::mul(qy, k));
+		}
+		else {
+			odx = V::load(&b.OmegaDx[i]);
+			ody = V::load(&b.OmegaDy[i]);
+			odz = V::load(&b.OmegaDz[i]);
+		}
+
+		// Angular velocity error
+		T ex = V::sub(V::load(&b.Wx[i]), odx);
+		T ey = V::sub(V::load(&b.Wy[i]), ody);
+		T ez = V::sub(V::load(&b.Wz[i]), odz);
+		M rateHold = V::lt(V::add(V::add(V::mul(ex, ex), V::mul(ey, ey)), V::mul(ez, ez)), rateDeadband2);
+
+		// Thruster 1 level, clipped to leave control margin on the others, and desired moments
+		T level = V::load(&b.ThrustLevel[i]);
+		T F1 = V::mul(thrust, V::min(V::max(level, levelMin), levelMax));
+		T Mx = V::mul(kpx, ex), My = V::mul(kpy, ey), Mz = V::mul(kpz, ez);
+
+		// Sine of the thrust vector angle for the roll moment, limited to the sine of the gimbal limit
+		T sinA = V::min(V::max(V::sub(zero, V::div(Mz, V::mul(rad, F1))), V::sub(zero, sinAlphaLimit)), sinAlphaLimit);
+		T cosA = V::sqrt(V::sub(one, V::mul(sinA, sinA)));
+
+		// Thruster 2 and 3 thrust for the pitch and yaw moments
+		T common = V::sub(V::mul(F1, cosA), V::mul(Mx, invRad));
+		T diff = V::mul(V::mul(invSqrt3, V::sub(V::mul(V::mul(sta, F1), sinA), My)), invRad);
+		T F2 = V::sub(common, diff);
+		T F3 = V::add(common, diff);
+
+		// Clip to between 0 and 1, or hold the steady state level inside the rate deadband
+		T l0 = V::min(V::max(V::mul(F1, invThrust), zero), one);
+		T l1 = V::min(V::max(V::mul(F3, invThrust), zero), one);
+		T l2 = V::min(V::max(V::mul(F2, invThrust), zero), one);
+		V::store(&b.Level0[i], V::blend(rateHold, level, l0));
+		V::store(&b.Level1[i], V::blend(rateHold, level, l1));
+		V::store(&b.Level2[i], V::blend(rateHold, level, l2));
+		V::store(&b.SinAlpha[i], V::blend(rateHold, zero, sinA));
+	}
+}
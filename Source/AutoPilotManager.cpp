@@ -0,0 +1,128 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotManager.cpp
+// Per-frame batching of the autopilots of all Surveyors
+//
+// ==============================================================
+
+#include "AutoPilotManager.h"
+#include "Surveyor.h"
+
+AutoPilotManager::AutoPilotManager(void)
+	: Threads(0), ParallelThreshold(AUTOPILOT_PARALLEL_THRESHOLD), HaveBatch(false), BatchT(0)
+{
+}
+
+AutoPilotManager::~AutoPilotManager()
+{
+}
+
+AutoPilotManager& AutoPilotManager::current()
+// Manager for the vessels simulated on this thread
+{
+	static thread_local AutoPilotManager manager;
+	return manager;
+}
+
+void AutoPilotManager::add(Surveyor* sc)
+// Register a vessel; its autopilot joins the batch from the next frame
+{
+	Vessels.push_back(sc);
+}
+
+void AutoPilotManager::remove(Surveyor* sc)
+// Unregister a vessel. The worker threads are stopped with the last vessel, while the simulation is
+// still running, rather than when the module is unloaded.
+{
+	for (size_t i = 0; i < Vessels.size(); i++) {
+		if (Vessels[i] != sc) continue;
+		Vessels[i] = Vessels.back();
+		Vessels.pop_back();
+		break;
+	}
+	if (Vessels.empty()) {
+		Pool.reset();
+		Predictor.reset();
+		Optimizer.reset();
+		Terrain.reset();
+		TerrainSource.reset();
+	}
+}
+
+TrajectoryPredictor& AutoPilotManager::predictor()
+// Trajectory predictor shared by the vessels, started on first use and stopped with the last vessel
+{
+	if (!Predictor) Predictor.reset(new TrajectoryPredictor());
+	return *Predictor;
+}
+
+DescentOptimizer& AutoPilotManager::optimizer()
+// Descent optimizer shared by the vessels, started on first use and stopped with the last vessel
+{
+	if (!Optimizer) Optimizer.reset(new DescentOptimizer());
+	return *Optimizer;
+}
+
+TerrainService* AutoPilotManager::terrain(OBJHANDLE hBody)
+// Terrain cache of a body shared by the vessels, built on first use and dropped with the last vessel. The cache
+// covers one body: returns null for any other, whose vessels keep Orbiter's surface elevation.
+{
+	if (!hBody) return 0;
+	if (!Terrain) {
+		TerrainSource.reset(new OrbiterTerrain(hBody));
+		Terrain.reset(new TerrainService(*TerrainSource));
+	}
+	return TerrainSource->body() == hBody ? Terrain.get() : 0;
+}
+
+void AutoPilotManager::setThreads(unsigned threads)
+// Worker threads for parallel batches: 0 for one per core, 1 to run every batch on the calling thread
+{
+	if (threads != Threads) Pool.reset();
+	Threads = threads;
+}
+
+void AutoPilotManager::setParallelThreshold(size_t vessels)
+// Smallest batch spread over the worker threads
+{
+	ParallelThreshold = vessels;
+}
+
+void AutoPilotManager::preStep(Surveyor* sc, double SimT, double SimDT)
+// Called from each vessel's clbkPreStep: runs the frame's batch on the first call of a frame, and the
+// calling vessel on its own if it was not in the batch
+{
+	if (!HaveBatch || SimT != BatchT) runBatch(SimT, SimDT);
+	if (!sc->AutoPilotDone(SimT)) {
+		sc->PrepareStep(SimT, SimDT, sc->GetHandle() == oapiGetFocusObject() || Vessels.size() <= 1);
+		sc->RunAutoPilot();
+	}
+}
+
+void AutoPilotManager::runBatch(double SimT, double SimDT)
+// Sample and run every registered vessel for the frame starting at SimT
+{
+	HaveBatch = true;
+	BatchT = SimT;
+	size_t n = Vessels.size();
+	if (n == 0) return;
+
+	// Sampling and staging call Orbiter, so they stay on this thread. Only the focus vessel writes the debug
+	// string, unless it is the only Surveyor.
+	OBJHANDLE focus = oapiGetFocusObject();
+	for (size_t i = 0; i < n; i++) Vessels[i]->PrepareStep(SimT, SimDT, n == 1 || Vessels[i]->GetHandle() == focus);
+
+	if (n >= ParallelThreshold && Threads != 1) {
+		if (!Pool) Pool.reset(new WorkStealingPool(Threads));
+		if (Pool->size() > 1) {
+			// A few chunks per worker, so stealing evens out vessels in costlier modes
+			size_t grain = std::max<size_t>(1, n / (4 * Pool->size()));
+			Pool->parallelFor(0, n, grain, [this](size_t i) { Vessels[i]->RunAutoPilot(); });
+			return;
+		}
+	}
+	for (size_t i = 0; i < n; i++) Vessels[i]->RunAutoPilot();
+}
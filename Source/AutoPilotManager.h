@@ -0,0 +1,62 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotManager.h
+// Header file for the per-frame autopilot manager shared by all Surveyors
+//
+// ==============================================================
+
+#pragma once
+
+#include "ThreadPool.h"
+#include "TrajectoryPredictor.h"
+#include "DescentOptimizer.h"
+#include "TerrainService.h"
+#include <memory>
+#include <vector>
+
+class Surveyor;
+
+// Batches with at least this many vessels are spread over worker threads
+const size_t AUTOPILOT_PARALLEL_THRESHOLD = 32;
+
+/* Runs the autopilots of every Surveyor in the simulation as one batch per frame. The first clbkPreStep of a frame
+   hands the batch to the manager, which samples the state and applies staging for every vessel on the calling
+   thread, since those call Orbiter, then runs their autopilots. The autopilots only read the state frame and write
+   the vessel's own actuator buffer, so a large batch is spread over a thread pool. Each vessel sends its commands in
+   its own clbkPreStep, as before. A vessel that was not in the frame's batch, such as one created during the
+   frame, runs on its own.
+
+   Orbiter makes every vessel callback on its main thread, so current() is the manager for the whole scenario.
+   Headless simulations running on separate threads each get their own. */
+class AutoPilotManager {
+public:
+	AutoPilotManager(void);
+	~AutoPilotManager();
+	static AutoPilotManager& current();
+	void add(Surveyor* sc);
+	void remove(Surveyor* sc);
+	void preStep(Surveyor* sc, double SimT, double SimDT);
+	void setThreads(unsigned threads);
+	void setParallelThreshold(size_t vessels);
+	TrajectoryPredictor& predictor();
+	DescentOptimizer& optimizer();
+	TerrainService* terrain(OBJHANDLE hBody);
+	size_t size() const { return Vessels.size(); }
+private:
+	AutoPilotManager(AutoPilotManager const&);
+	AutoPilotManager& operator=(AutoPilotManager const&);
+	void runBatch(double SimT, double SimDT);
+	std::vector<Surveyor*> Vessels;        // Registered vessels
+	std::unique_ptr<WorkStealingPool> Pool; // Worker threads, started with the first parallel batch
+	std::unique_ptr<TrajectoryPredictor> Predictor; // Predictor thread, started for the first vessel that uses it
+	std::unique_ptr<DescentOptimizer> Optimizer; // Descent optimizer thread, started for the first vessel that uses it
+	std::unique_ptr<OrbiterTerrain> TerrainSource; // Orbiter's elevation of the body the terrain cache covers
+	std::unique_ptr<TerrainService> Terrain; // Terrain cache, built for the first vessel that uses it
+	unsigned Threads;                       // Worker threads to start, 0 for one per core
+	size_t ParallelThreshold;               // Smallest batch run on the pool
+	bool HaveBatch;                         // BatchT holds the time of a batch
+	double BatchT;                          // Frame time of the last batch [s]
+};
@@ -0,0 +1,20 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotModes.h
+// Header file defining the autopilot modes and their names
+//
+// ==============================================================
+
+#pragma once
+
+// Autopilot modes, in the order they are flown
+enum AutoPilotStatus { IDLE, HOLD_FOR_RETRO, RETRO_DESCENT, FINAL_DESCENT, SHUTDOWN };
+const int AUTOPILOT_MODES = SHUTDOWN + 1;
+
+// Display name of each mode, indexed by AutoPilotStatus, for the debug string and the telemetry tools
+static const char* const AutoPilotModeNames[AUTOPILOT_MODES] = {
+	"Idle", "Hold for retro ignition", "Initial descent", "Final descent", "Shutdown"
+};
@@ -0,0 +1,36 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotOptions.cpp
+// Reading the autopilot feature switches
+//
+// ==============================================================
+
+#include "AutoPilotOptions.h"
+
+const AutoPilotOptionInfo AutoPilotOptionTable[] = {
+	{ "Sensors", &AutoPilotOptions::Sensors },
+	{ "Predictor", &AutoPilotOptions::Predictor },
+	{ "PredictedIgnition", &AutoPilotOptions::PredictedIgnition },
+	{ "ControlAllocation", &AutoPilotOptions::ControlAllocation },
+	{ "ConvexDescent", &AutoPilotOptions::ConvexDescent },
+	{ "RealTimeController", &AutoPilotOptions::RealTimeController },
+	{ "ControllerSpin", &AutoPilotOptions::ControllerSpin },
+	{ "ControllerCpu", &AutoPilotOptions::ControllerCpu },
+	{ "Telemetry", &AutoPilotOptions::Telemetry },
+	{ "Terrain", &AutoPilotOptions::Terrain }
+};
+const int AUTOPILOT_OPTIONS = sizeof(AutoPilotOptionTable) / sizeof(AutoPilotOptionTable[0]);
+
+int AutoPilotOptions::read(FILEHANDLE f)
+// Read the options present in an Orbiter configuration file; the others keep their values.
+// Returns the number of options read.
+{
+	int n = 0;
+	for (int i = 0; i < AUTOPILOT_OPTIONS; i++) {
+		if (oapiReadItem_float(f, (char*)AutoPilotOptionTable[i].Name, this->*AutoPilotOptionTable[i].Member)) n++;
+	}
+	return n;
+}
@@ -0,0 +1,40 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotOptions.h
+// Header file defining the switches of the optional autopilot
+// features
+//
+// ==============================================================
+
+#pragma once
+
+#include "SurveyorConstants.h"
+
+// Switches of the optional features and their settings, which are not tuned. They are read from
+// Config/Surveyor/AutoPilot.cfg when the vessel is created, next to the gains of AutoPilotParams,
+// as "Name = value" lines using the member names below. A switch is on if it is not 0.
+struct AutoPilotOptions {
+	double Sensors = 0;                // Fly on the radar models and navigation filter instead of the true state (see Navigation)
+	double Predictor = 0;              // Run the trajectory predictor (see TrajectoryPredictor)
+	double PredictedIgnition = 0;      // Enter RETRO_DESCENT at the predicted optimal ignition time, not at RetroAltitude; runs the predictor
+	double ControlAllocation = 0;      // Allocate the angular velocity loop's moments over the verniers and RCS jets (see ControlAllocator)
+	double ConvexDescent = 0;          // Fly FINAL_DESCENT on the descent optimizer's fuel-optimal thrust profile (see DescentOptimizer)
+	double RealTimeController = 0;     // Run the autopilot on its own thread at RateLoopRate in wall clock time (see ControllerThread)
+	double ControllerSpin = 0;         // Time before each tick the controller thread busy-waits instead of sleeping [s]
+	double ControllerCpu = -1;         // Core the controller thread is pinned to, or -1 to leave it to the scheduler
+	double Telemetry = 0;              // Record the flight to TELEMETRY_DIRECTORY (see TelemetryRecorder)
+	double Terrain = 0;                // Read the terrain elevation through the manager's tiled cache of Orbiter's (see TerrainService)
+
+	int read(FILEHANDLE f);
+};
+
+// Name and member of each option, in file order
+struct AutoPilotOptionInfo {
+	const char* Name;
+	double AutoPilotOptions::* Member;
+};
+extern const AutoPilotOptionInfo AutoPilotOptionTable[];
+extern const int AUTOPILOT_OPTIONS;
@@ -0,0 +1,56 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotParams.cpp
+// Reading and writing autopilot parameter files
+//
+// ==============================================================
+
+#include "AutoPilotParams.h"
+
+const AutoPilotParamInfo AutoPilotParamTable[] = {
+	{ "Kp_wx", &AutoPilotParams::Kp_wx },
+	{ "Kp_wy", &AutoPilotParams::Kp_wy },
+	{ "Kp_wz", &AutoPilotParams::Kp_wz },
+	{ "RateDeadband", &AutoPilotParams::RateDeadband },
+	{ "AlphaLimit", &AutoPilotParams::AlphaLimit },
+	{ "Kp_ang", &AutoPilotParams::Kp_ang },
+	{ "AngleDeadband", &AutoPilotParams::AngleDeadband },
+	{ "RateLimit", &AutoPilotParams::RateLimit },
+	{ "IdleTime", &AutoPilotParams::IdleTime },
+	{ "RetroAltitude", &AutoPilotParams::RetroAltitude },
+	{ "RetroIgnitionDelay", &AutoPilotParams::RetroIgnitionDelay },
+	{ "RetroEndTime", &AutoPilotParams::RetroEndTime },
+	{ "BurnoutAltitude", &AutoPilotParams::BurnoutAltitude },
+	{ "GuidanceAltitude", &AutoPilotParams::GuidanceAltitude },
+	{ "TerminalAltitude", &AutoPilotParams::TerminalAltitude },
+	{ "ApproachSpeed", &AutoPilotParams::ApproachSpeed },
+	{ "TerminalSpeed", &AutoPilotParams::TerminalSpeed },
+	{ "ShutdownAltitude", &AutoPilotParams::ShutdownAltitude },
+	{ "RateLoopRate", &AutoPilotParams::RateLoopRate },
+	{ "GuidanceRate", &AutoPilotParams::GuidanceRate },
+	{ "ConvexMaxLevel", &AutoPilotParams::ConvexMaxLevel },
+	{ "ConvexTiltLimit", &AutoPilotParams::ConvexTiltLimit }
+};
+const int AUTOPILOT_PARAMS = sizeof(AutoPilotParamTable) / sizeof(AutoPilotParamTable[0]);
+
+int AutoPilotParams::read(FILEHANDLE f)
+// Read the parameters present in an Orbiter configuration file; the others keep their values.
+// Returns the number of parameters read.
+{
+	int n = 0;
+	for (int i = 0; i < AUTOPILOT_PARAMS; i++) {
+		if (oapiReadItem_float(f, (char*)AutoPilotParamTable[i].Name, this->*AutoPilotParamTable[i].Member)) n++;
+	}
+	return n;
+}
+
+void AutoPilotParams::write(FILE* out) const
+// Write every parameter as a "Name = value" line, with enough digits to read back exactly
+{
+	for (int i = 0; i < AUTOPILOT_PARAMS; i++) {
+		fprintf(out, "%s = %.17g\n", AutoPilotParamTable[i].Name, this->*AutoPilotParamTable[i].Member);
+	}
+}
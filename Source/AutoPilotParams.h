@@ -0,0 +1,67 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// AutoPilotParams.h
+// Header file defining the tunable autopilot gains and thresholds
+//
+// ==============================================================
+
+#pragma once
+
+#include "SurveyorConstants.h"
+#include <cstdio>
+
+// Gains, limits and mode switching thresholds used by the autopilot. The defaults are the
+// values the autopilot was designed with. Tuned values are read from Config/Surveyor/AutoPilot.cfg
+// when the vessel is created, as "Name = value" lines using the member names below. The switches of
+// the optional features are AutoPilotOptions.
+struct AutoPilotParams {
+	// Angular velocity loop (inner loop of the attitude control system)
+	double Kp_wx = 400;                // Proportional gain, x axis
+	double Kp_wy = 400;                // Proportional gain, y axis
+	double Kp_wz = 400;                // Proportional gain, z (roll) axis
+	double RateDeadband = 0.0001;      // Angular velocity error deadband [rad/s]
+	double AlphaLimit = 5 * PI / 180;  // Vernier 1 thrust vector angle limit [rad]
+
+	// Angle error loop (outer loop of the attitude control system)
+	double Kp_ang = 0.5;               // Proportional gain
+	double AngleDeadband = 0.01;       // Attitude error deadband [rad]
+	double RateLimit = 0.02;           // Desired angular velocity limit [rad/s]
+
+	// Mode sequencing
+	double IdleTime = 10;              // Time spent in IDLE [s]
+	double RetroAltitude = 110000;     // Altitude that starts RETRO_DESCENT [m]
+	double RetroIgnitionDelay = 7;     // Retro ignition, time after entering RETRO_DESCENT [s]
+	double RetroEndTime = 48;          // Switch to FINAL_DESCENT, time after entering RETRO_DESCENT [s]
+
+	// Retro ignition from the trajectory predictor, with PredictedIgnition (see TrajectoryPredictor)
+	double BurnoutAltitude = 25000;    // Retro burnout height above terrain the optimal ignition time aims for [m]
+
+	// Final descent guidance
+	double GuidanceAltitude = 20000;   // Altitude below which the verniers brake [m]
+	double TerminalAltitude = 500;     // Altitude below which the target speed is TerminalSpeed [m]
+	double ApproachSpeed = 50;         // Speed to aim for at the surface while above TerminalAltitude [m/s]
+	double TerminalSpeed = 1;          // Speed to aim for at the surface once below TerminalAltitude [m/s]
+	double ShutdownAltitude = 4;       // Altitude at which the verniers shut down [m]
+
+	// Loop rates (see ControlScheduler). A RateLoopRate of 0 runs the whole autopilot once per frame.
+	double RateLoopRate = 50;          // Angular velocity loop rate [Hz]
+	double GuidanceRate = 10;          // Mode sequencing, guidance and angle error loop rate [Hz]
+
+	// Powered descent optimizer, with ConvexDescent (see DescentOptimizer)
+	double ConvexMaxLevel = 0.8;       // Highest vernier level the profile plans, leaving the rest for attitude control
+	double ConvexTiltLimit = 20 * PI / 180; // Largest angle of the planned thrust from the vertical [rad]
+
+	int read(FILEHANDLE f);
+	void write(FILE* out) const;
+};
+
+// Name and member of each parameter, in file order
+struct AutoPilotParamInfo {
+	const char* Name;
+	double AutoPilotParams::* Member;
+};
+extern const AutoPilotParamInfo AutoPilotParamTable[];
+extern const int AUTOPILOT_PARAMS;
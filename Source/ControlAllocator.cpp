@@ -0,0 +1,166 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ControlAllocator.cpp
+// Cached pseudo-inverse control allocation with redistribution
+// of saturated effectors
+//
+// ==============================================================
+
+#include "ControlAllocator.h"
+
+template <int N>
+static Matrix<N, N> invert(Matrix<N, N> a)
+// Inverse of a small symmetric positive definite matrix, by Gauss-Jordan elimination with partial pivoting
+{
+	Matrix<N, N> b = Matrix<N, N>::identity();
+	for (int c = 0; c < N; c++) {
+		int p = c;
+		for (int i = c + 1; i < N; i++) if (fabs(a(i, c)) > fabs(a(p, c))) p = i;
+		for (int j = 0; j < N; j++) {
+			double t = a(c, j); a(c, j) = a(p, j); a(p, j) = t;
+			t = b(c, j); b(c, j) = b(p, j); b(p, j) = t;
+		}
+		double k = 1 / a(c, c);
+		for (int j = 0; j < N; j++) {
+			a(c, j) *= k;
+			b(c, j) *= k;
+		}
+		for (int i = 0; i < N; i++) {
+			if (i == c) continue;
+			double f = a(i, c);
+			for (int j = 0; j < N; j++) {
+				a(i, j) -= f * a(c, j);
+				b(i, j) -= f * b(c, j);
+			}
+		}
+	}
+	return b;
+}
+
+template <int R, int C>
+static Matrix<C, R> pseudoInverse(Matrix<R, C> B, bool const free[C])
+// Damped pseudo-inverse B'(B B' + lambda I)^-1 over the columns of B marked free; the other effectors get zero rows
+{
+	for (int j = 0; j < C; j++) if (!free[j]) for (int i = 0; i < R; i++) B(i, j) = 0;
+	Matrix<R, R> A = B * transpose(B);
+	double trace = 0;
+	for (int i = 0; i < R; i++) trace += A(i, i);
+	if (!(trace > 0)) return Matrix<C, R>::zero();
+	for (int i = 0; i < R; i++) A(i, i) += ALLOCATOR_DAMPING * trace;
+	return transpose(B) * invert(A);
+}
+
+template <int R, int C>
+static void redistribute(Matrix<R, C> const& B, Matrix<C, R> const& P, Vector<R> const& d, double const lo[C],
+	double const hi[C], Vector<C>& u)
+// Effector levels u within [lo, hi] for the demand d, by redistributed pseudo-inverse: the cached pseudo-inverse P
+// gives the first solution, and each effector it puts past a bound is fixed there while the others are re-solved
+{
+	bool free[C];
+	Vector<C> fixed = Vector<C>::zero();
+	for (int j = 0; j < C; j++) free[j] = true;
+	Matrix<C, R> Pf = P;
+	Vector<C> x = Vector<C>::zero();
+	for (int pass = 0; pass < ALLOCATOR_ITERATIONS; pass++) {
+		// Least squares solution for the free effectors, of the demand the fixed ones leave
+		x = Pf * (d - B * fixed);
+		bool clipped = false, any = false;
+		for (int j = 0; j < C; j++) {
+			if (!free[j]) continue;
+			if (x(j, 0) < lo[j] || x(j, 0) > hi[j]) {
+				fixed(j, 0) = x(j, 0) < lo[j] ? lo[j] : hi[j];
+				free[j] = false;
+				clipped = true;
+			}
+			else any = true;
+		}
+		if (!clipped || !any) break;
+		if (pass + 1 < ALLOCATOR_ITERATIONS) Pf = pseudoInverse(B, free);
+	}
+	// Effectors still free keep the last solution, which put them within their bounds
+	for (int j = 0; j < C; j++) u(j, 0) = free[j] ? x(j, 0) : fixed(j, 0);
+}
+
+ControlAllocator::ControlAllocator(void)
+{
+	Primary = Matrix<4, ALLOCATOR_PRIMARY>::zero();
+	PrimaryInverse = Matrix<ALLOCATOR_PRIMARY, 4>::zero();
+	Rcs = Matrix<3, ALLOCATOR_RCS>::zero();
+	RcsInverse = Matrix<ALLOCATOR_RCS, 3>::zero();
+	for (int i = 0; i < ALLOCATOR_RCS; i++) RcsMoment[i] = _V(0, 0, 0);
+	RcsMinMoment = 0;
+	Configuration = -1;
+}
+
+void ControlAllocator::configure(VECTOR3 const vernierPos[3], double vernierThrust, VECTOR3 const rcsPos[ALLOCATOR_RCS],
+	VECTOR3 const rcsDir[ALLOCATOR_RCS], double const rcsThrust[ALLOCATOR_RCS], int configuration)
+// Build the effectiveness matrices and their pseudo-inverses from the thruster geometry. The verniers thrust along
+// +z, and the vernier 1 gimbal swings its thrust towards +x. Moments follow the right-hand rule.
+{
+	for (int j = 0; j < ALLOCATOR_PRIMARY; j++) {
+		VECTOR3 F = j < 3 ? _V(0, 0, vernierThrust) : _V(vernierThrust, 0, 0);
+		VECTOR3 M = crossp(vernierPos[j < 3 ? j : 0], F);
+		Primary(0, j) = M.x;
+		Primary(1, j) = M.y;
+		Primary(2, j) = M.z;
+		Primary(3, j) = ALLOCATOR_THRUST_WEIGHT * F.z;
+	}
+	RcsMinMoment = 0;
+	for (int j = 0; j < ALLOCATOR_RCS; j++) {
+		RcsMoment[j] = crossp(rcsPos[j], unit(rcsDir[j]) * rcsThrust[j]);
+		double m = ALLOCATOR_RCS_MIN_LEVEL * length(RcsMoment[j]);
+		if (m > 0 && (RcsMinMoment == 0 || m < RcsMinMoment)) RcsMinMoment = m;
+		Rcs(0, j) = RcsMoment[j].x;
+		Rcs(1, j) = RcsMoment[j].y;
+		Rcs(2, j) = RcsMoment[j].z;
+	}
+	bool primary[ALLOCATOR_PRIMARY], rcs[ALLOCATOR_RCS];
+	for (int j = 0; j < ALLOCATOR_PRIMARY; j++) primary[j] = true;
+	for (int j = 0; j < ALLOCATOR_RCS; j++) rcs[j] = true;
+	PrimaryInverse = pseudoInverse(Primary, primary);
+	RcsInverse = pseudoInverse(Rcs, rcs);
+	Configuration = configuration;
+}
+
+void ControlAllocator::allocate(VECTOR3 const & M, double thrust, double gimbalLimit, double sinAlphaLimit,
+	double vernier[3], double & sinAlpha, double rcs[ALLOCATOR_RCS]) const
+// Vernier levels, vernier 1 thrust vector sine and RCS levels for the moments M [N m] and the vernier axial thrust
+// [N], with the gimbal's lateral thrust limited to gimbalLimit of a vernier's full thrust
+{
+	// Verniers and gimbal
+	Vector<4> d;
+	d(0, 0) = M.x;
+	d(1, 0) = M.y;
+	d(2, 0) = M.z;
+	d(3, 0) = ALLOCATOR_THRUST_WEIGHT * thrust;
+	double const lo[ALLOCATOR_PRIMARY] = { 0, 0, 0, -gimbalLimit };
+	double const hi[ALLOCATOR_PRIMARY] = { 1, 1, 1, gimbalLimit };
+	Vector<ALLOCATOR_PRIMARY> u;
+	redistribute(Primary, PrimaryInverse, d, lo, hi, u);
+	for (int i = 1; i < 3; i++) vernier[i] = u(i, 0);
+
+	// Vernier 1's level and thrust vector angle from its axial and lateral thrust, within the angle limit. The thrust
+	// it then delivers is what the RCS tier makes up the moments from.
+	double level = sqrt(u(0, 0) * u(0, 0) + u(3, 0) * u(3, 0));
+	sinAlpha = level > 0 ? min(max(u(3, 0) / level, -sinAlphaLimit), sinAlphaLimit) : 0;
+	vernier[0] = min(level, 1);
+	u(0, 0) = vernier[0] * sqrt(1 - sinAlpha * sinAlpha);
+	u(3, 0) = vernier[0] * sinAlpha;
+
+	// RCS jets, for the moments the verniers leave, unless too small for any jet to make
+	Vector<4> delivered = Primary * u;
+	Vector<3> r;
+	for (int i = 0; i < 3; i++) r(i, 0) = d(i, 0) - delivered(i, 0);
+	if (r(0, 0) * r(0, 0) + r(1, 0) * r(1, 0) + r(2, 0) * r(2, 0) < RcsMinMoment * RcsMinMoment) {
+		for (int i = 0; i < ALLOCATOR_RCS; i++) rcs[i] = 0;
+		return;
+	}
+	double const off[ALLOCATOR_RCS] = { 0, 0, 0, 0, 0, 0 };
+	double const full[ALLOCATOR_RCS] = { 1, 1, 1, 1, 1, 1 };
+	Vector<ALLOCATOR_RCS> v;
+	redistribute(Rcs, RcsInverse, r, off, full, v);
+	for (int i = 0; i < ALLOCATOR_RCS; i++) rcs[i] = v(i, 0) < ALLOCATOR_RCS_MIN_LEVEL ? 0 : v(i, 0);
+}
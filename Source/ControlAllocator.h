@@ -0,0 +1,52 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ControlAllocator.h
+// Header file for the allocation of the attitude control moments
+// over the verniers, the vernier 1 gimbal and the RCS jets
+//
+// ==============================================================
+
+#pragma once
+
+#include "SurveyorConstants.h"
+#include "FixedMatrix.h"
+
+const int ALLOCATOR_PRIMARY = 4;             // Vernier levels and the vernier 1 gimbal
+const int ALLOCATOR_RCS = 6;                 // RCS jet levels
+const int ALLOCATOR_ITERATIONS = 4;          // Solves per tier and allocation, the first from the cached pseudo-inverse
+const double ALLOCATOR_THRUST_WEIGHT = 0.1;  // Weight of the axial thrust against the moments [m]
+const double ALLOCATOR_DAMPING = 1e-12;      // Pseudo-inverse damping, relative to the trace of B B'
+const double ALLOCATOR_RCS_MIN_LEVEL = 1e-3; // RCS levels below this are not fired
+
+/* Control allocation over two tiers of effectors. The primary tier is the three vernier levels and the lateral thrust
+   of the vernier 1 gimbal (its level times the sine of the thrust vector angle), which together must deliver the
+   demanded moments and the axial thrust of the steady state level. The moment the verniers cannot deliver within
+   their bounds passes to the second tier, the six RCS jets.
+
+   The effectiveness matrices are built from the thruster positions, directions and thrusts the host reports, and
+   their damped pseudo-inverses are cached, so configure() is called only when the configuration changes. Each tier
+   is solved by redistributed pseudo-inverse: effectors the solution drives past a bound are fixed at it, and the rest
+   re-solved for the demand left over, at most ALLOCATOR_ITERATIONS times. An allocation that saturates nothing costs
+   a few matrix-vector products, and no solve. */
+class ControlAllocator {
+public:
+	ControlAllocator(void);
+	void configure(VECTOR3 const vernierPos[3], double vernierThrust, VECTOR3 const rcsPos[ALLOCATOR_RCS],
+		VECTOR3 const rcsDir[ALLOCATOR_RCS], double const rcsThrust[ALLOCATOR_RCS], int configuration);
+	bool configured() const { return Configuration >= 0; }
+	int configuration() const { return Configuration; }
+	void allocate(VECTOR3 const & M, double thrust, double gimbalLimit, double sinAlphaLimit, double vernier[3],
+		double & sinAlpha, double rcs[ALLOCATOR_RCS]) const;
+	VECTOR3 const * rcsMoments() const { return RcsMoment; }
+private:
+	Matrix<4, ALLOCATOR_PRIMARY> Primary;        // Moments and weighted axial thrust per unit of each primary effector
+	Matrix<ALLOCATOR_PRIMARY, 4> PrimaryInverse; // Pseudo-inverse of Primary
+	Matrix<3, ALLOCATOR_RCS> Rcs;                // Moments per unit level of each RCS jet
+	Matrix<ALLOCATOR_RCS, 3> RcsInverse;         // Pseudo-inverse of Rcs
+	VECTOR3 RcsMoment[ALLOCATOR_RCS];            // Columns of Rcs [N m]
+	double RcsMinMoment;                         // Smallest moment a jet makes at ALLOCATOR_RCS_MIN_LEVEL [N m]
+	int Configuration;                           // Configuration the matrices were built for, or -1
+};
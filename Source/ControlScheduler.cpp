@@ -0,0 +1,186 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ControlScheduler.cpp
+// Fixed-rate autopilot scheduling with sub-stepping inside long frames
+//
+// ==============================================================
+
+#include "ControlScheduler.h"
+#include "Surveyor.h"
+#include <cstring>
+
+// Ticks this close to the start or end of a frame are taken to fall on it [s]
+const double TICK_TOLERANCE = 1e-9;
+
+ControlScheduler::ControlScheduler(void)
+{
+	reset();
+}
+
+void ControlScheduler::reset()
+// Restart the tick clock at the next frame
+{
+	Started = false;
+	T0 = 0;
+	Tick = 0;
+	LastGuidanceT = 0;
+	HaveLast = false;
+	memset(&Last, 0, sizeof(Last));
+	HaveHeld = false;
+	memset(&Held, 0, sizeof(Held));
+}
+
+void ControlScheduler::getCommands(Surveyor* sc, bool rcs, ScheduledCommands& c)
+// Autopilot commands currently set in the actuator buffer, with the RCS jets if the autopilot commands them
+{
+	for (int i = 0; i < 3; i++) c.Vernier[i] = sc->Actuators.getLevel(sc, sc->th_vernier[i]);
+	sc->Actuators.getDir(sc, sc->th_vernier[0], c.Vernier1Dir);
+	c.Retro = sc->Actuators.getLevel(sc, sc->th_retro);
+	for (int i = 0; i < 6; i++) c.Rcs[i] = rcs ? sc->Actuators.getLevel(sc, sc->th_rcs[i]) : 0;
+}
+
+void ControlScheduler::hold(ScheduledCommands const & c, VECTOR3 const dir[3], VECTOR3 const * rcs, double h, double mass, VECTOR3& w, ScheduledCommands& sum) const
+// Hold commands for h seconds: add them to the time integral in sum, and advance the angular velocity w by the
+// moments of the verniers, thrusting along dir (vernier 1 along c.Vernier1Dir), and of the RCS jets, whose moments
+// at full thrust are rcs, if the autopilot commands them. Gyroscopic coupling is neglected over a frame.
+{
+	if (h <= 0) return;
+	VECTOR3 M = _V(0, 0, 0);
+	for (int i = 0; i < 3; i++) {
+		sum.Vernier[i] += c.Vernier[i] * h;
+		M += crossp(VERNIER_POS[i], unit(i == 0 ? c.Vernier1Dir : dir[i]) * (c.Vernier[i] * VERNIER_THRUST));
+	}
+	sum.Vernier1Dir += c.Vernier1Dir * h;
+	sum.Retro += c.Retro * h;
+	if (rcs) {
+		for (int i = 0; i < 6; i++) {
+			sum.Rcs[i] += c.Rcs[i] * h;
+			M += rcs[i] * c.Rcs[i];
+		}
+	}
+
+	// The moments follow the right-hand rule, while Orbiter reports angular velocity with the opposite sign
+	w.x -= M.x / (mass * PB_PMI.x) * h;
+	w.y -= M.y / (mass * PB_PMI.y) * h;
+	w.z -= M.z / (mass * PB_PMI.z) * h;
+}
+
+void ControlScheduler::step(Surveyor* sc, AutoPilot& ap, StateFrame const & sf)
+// Run the autopilot ticks falling in the frame starting at sf.SimT, and set the frame's thrust commands
+{
+	AutoPilotParams const & p = ap.getParams();
+	if (!(p.RateLoopRate > 0)) {
+		// Fixed rates disabled: one autopilot update per frame
+		ap.autopilotUpdate(sc, sf);
+		return;
+	}
+	double period = 1 / p.RateLoopRate;
+	long long ratio = 1;
+	if (p.GuidanceRate > 0 && p.GuidanceRate < p.RateLoopRate) ratio = llround(p.RateLoopRate / p.GuidanceRate);
+	double start = sf.SimT;
+	double end = sf.SimT + sf.SimDT;
+
+	// Moments of the RCS jets, if the autopilot commands them
+	VECTOR3 const * rcs = ap.getOptions().ControlAllocation != 0 && ap.getAllocator().configured() ? ap.getAllocator().rcsMoments() : 0;
+
+	// Start the clock on the first frame, and again if time runs backwards. Ticks that fell before this frame,
+	// after a time jump, are skipped; the mode timers still advance by the time since the last autopilot update.
+	if (HaveLast && start < Last.SimT) reset();
+	if (!Started) {
+		Started = true;
+		T0 = start;
+		Tick = 0;
+		LastGuidanceT = start - ratio * period;
+	}
+	long long first = (long long)ceil((start - T0 - TICK_TOLERANCE) / period);
+	if (Tick < first) Tick = first;
+
+	// Rates of change of the translational quantities over the last frame, for carrying the state forward
+	StateFrame rate;
+	memset(&rate, 0, sizeof(rate));
+	if (HaveLast && start > Last.SimT) {
+		double dt = start - Last.SimT;
+		rate.Airspeed = (sf.Airspeed - Last.Airspeed) / dt;
+		rate.Altitude = (sf.Altitude - Last.Altitude) / dt;
+		rate.SurfaceElevation = (sf.SurfaceElevation - Last.SurfaceElevation) / dt;
+		rate.PropVernier = (sf.PropVernier - Last.PropVernier) / dt;
+		rate.PropRCS = (sf.PropRCS - Last.PropRCS) / dt;
+		rate.PropRetro = (sf.PropRetro - Last.PropRetro) / dt;
+	}
+
+	// Commands in force before the first tick: those of the last tick, or whatever is set before any tick
+	ScheduledCommands held;
+	if (HaveHeld) held = Held;
+	else getCommands(sc, rcs != 0, held);
+
+	// Directions of verniers 2 and 3, as set from the manual input for this frame
+	VECTOR3 dir[3];
+	for (int i = 1; i < 3; i++) sc->Actuators.getDir(sc, sc->th_vernier[i], dir[i]);
+
+	ScheduledCommands sum;
+	memset(&sum, 0, sizeof(sum));
+	VECTOR3 w = sf.AngularVel;
+	double segStart = start;
+	bool split = false;
+	for (double tau = T0 + Tick * period; tau < end - TICK_TOLERANCE; tau = T0 + Tick * period) {
+		if (tau > start + TICK_TOLERANCE) split = true;
+		else tau = start;
+		hold(held, dir, rcs, tau - segStart, sf.Mass, w, sum);
+		segStart = tau;
+
+		// State carried forward to the tick
+		StateFrame s = sf;
+		double h = tau - start;
+		s.SimT = tau;
+		s.Airspeed = sf.Airspeed + rate.Airspeed * h;
+		s.Altitude = sf.Altitude + rate.Altitude * h;
+		s.SurfaceElevation = sf.SurfaceElevation + rate.SurfaceElevation * h;
+		s.PropVernier = max(sf.PropVernier + rate.PropVernier * h, 0);
+		s.PropRCS = max(sf.PropRCS + rate.PropRCS * h, 0);
+		s.PropRetro = max(sf.PropRetro + rate.PropRetro * h, 0);
+		s.AngularVel = w;
+		sc->CompleteState(s);
+
+		if (Tick % ratio == 0) {
+			s.SimDT = tau - LastGuidanceT;
+			LastGuidanceT = tau;
+			ap.autopilotUpdate(sc, s);
+		}
+		else {
+			ap.rateLoopUpdate(sc, s);
+		}
+		getCommands(sc, rcs != 0, held);
+		HaveHeld = true;
+		Tick++;
+	}
+	if (!HaveHeld) {
+		Last = sf;
+		HaveLast = true;
+		return;
+	}
+	Held = held;
+
+	// The frame's commands: the time average over the sub-steps if a tick fell inside the frame, otherwise
+	// the commands of the last tick
+	ScheduledCommands c = held;
+	if (split) {
+		hold(held, dir, rcs, end - segStart, sf.Mass, w, sum);
+		double dt = end - start;
+		for (int i = 0; i < 3; i++) c.Vernier[i] = sum.Vernier[i] / dt;
+		c.Vernier1Dir = sum.Vernier1Dir / dt;
+		c.Retro = sum.Retro / dt;
+		for (int i = 0; i < 6; i++) c.Rcs[i] = sum.Rcs[i] / dt;
+	}
+	for (int i = 0; i < 3; i++) sc->Actuators.setLevel(sc->th_vernier[i], c.Vernier[i]);
+	sc->Actuators.setDir(sc->th_vernier[0], c.Vernier1Dir);
+	sc->Actuators.setLevel(sc->th_retro, c.Retro);
+	if (rcs) {
+		for (int i = 0; i < 6; i++) sc->Actuators.setLevel(sc->th_rcs[i], c.Rcs[i]);
+	}
+
+	Last = sf;
+	HaveLast = true;
+}
@@ -0,0 +1,51 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ControlScheduler.h
+// Header file for the fixed-rate autopilot scheduler
+//
+// ==============================================================
+
+#pragma once
+
+#include "StateFrame.h"
+
+class Surveyor;
+class AutoPilot;
+
+// Autopilot thrust commands in force over part of a frame
+struct ScheduledCommands {
+	double Vernier[3];    // Vernier thrust levels
+	VECTOR3 Vernier1Dir;  // Vernier thruster 1 thrust direction
+	double Retro;         // Retro thrust level
+	double Rcs[6];        // RCS jet levels, under control allocation
+};
+
+/* Runs the autopilot at fixed rates, whatever the frame length. The angular velocity loop ticks at RateLoopRate,
+   and every n-th tick (n = RateLoopRate / GuidanceRate) is a full autopilot update: mode sequencing, guidance and
+   the angle error loop. Ticks are counted from the first frame, so they fall at exact multiples of the tick period.
+
+   Orbiter holds thrust constant over a frame, so the ticks falling in the coming frame are flown as sub-steps. Each
+   sees the sampled state carried forward to its time: translational quantities by their rate of change over the
+   last frame, and the angular velocity by the moments of the vernier commands of the earlier sub-steps. The frame's
+   thrust commands are the time average of the sub-step commands, which delivers the impulse of the fixed-rate
+   controller and places a timer event, such as retro ignition, at its tick rather than at the next frame. */
+class ControlScheduler {
+public:
+	ControlScheduler(void);
+	void reset();
+	void step(Surveyor* sc, AutoPilot& ap, StateFrame const & sf);
+	static void getCommands(Surveyor* sc, bool rcs, ScheduledCommands& c);
+private:
+	void hold(ScheduledCommands const & c, VECTOR3 const dir[3], VECTOR3 const * rcs, double h, double mass, VECTOR3& w, ScheduledCommands& sum) const;
+	bool Started;           // Tick clock has been started
+	double T0;              // Time of tick 0 [s]
+	long long Tick;         // Index of the next tick
+	double LastGuidanceT;   // Time of the last autopilot update [s]
+	bool HaveLast;          // Last holds the previous frame
+	StateFrame Last;        // State sampled for the previous frame
+	bool HaveHeld;          // Held holds the commands of a tick
+	ScheduledCommands Held; // Commands set by the last tick
+};
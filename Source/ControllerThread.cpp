@@ -0,0 +1,242 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ControllerThread.cpp
+// Fixed-rate autopilot thread, released in wall clock time and fed
+// through triple buffers
+//
+// ==============================================================
+
+#include "ControllerThread.h"
+#include "Surveyor.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static bool pinThread(int cpu)
+// Pin the calling thread to one core. Returns false if the core does not exist or the system refuses.
+{
+	if (cpu < 0 || cpu >= 64) return false;
+#ifdef _WIN32
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#endif
+}
+
+ControllerThread::ControllerThread(Surveyor* sc, AutoPilot& ap)
+	: Vessel(sc), Pilot(ap), Spin(0), Cpu(-1), Epoch(std::chrono::steady_clock::now()), Stop(false), Pinned(false),
+	Rate(CONTROLLER_MIN_RATE), Ratio(1), Warp(1), Seen(0), Started(false), GuidanceTick(0),
+	LastGuidanceT(0), LatenessSum(0), ComputeSum(0), FrameAgeSum(0), PublishWall(0), Taken(0), Applied(0), CommandAgeSum(0),
+	CommandAgeMax(0)
+// Start the controller thread, pinned to ControllerCpu if it is set
+{
+	memset(&Input, 0, sizeof(Input));
+	memset(&Held, 0, sizeof(Held));
+	memset(&Timing, 0, sizeof(Timing));
+	memset(Histogram, 0, sizeof(Histogram));
+	AutoPilotOptions const& o = Pilot.getOptions();
+	Spin = max(o.ControllerSpin, 0);
+	Cpu = (int)o.ControllerCpu;
+	Worker = std::thread(&ControllerThread::threadLoop, this);
+}
+
+ControllerThread::~ControllerThread()
+// Stop the controller thread after its current tick
+{
+	Stop = true;
+	Worker.join();
+}
+
+void ControllerThread::submit(StateFrame const& sf, int staging, double warp)
+// Hand the controller the state sampled for a time step. Simulation thread only.
+{
+	ControllerInput in;
+	in.Frame = sf;
+	in.Staging = staging;
+	in.Warp = warp;
+	in.Wall = wall();
+	Inputs.write(in);
+}
+
+bool ControllerThread::latest(ControllerOutput& out)
+// Copy the commands of the latest tick if they have not been taken, and count their age towards the statistics.
+// Returns false if there are none. Simulation thread only.
+{
+	ControllerOutput o;
+	uint64_t n = Outputs.read(o);
+	if (n <= Taken) return false;
+	Taken = n;
+	out = o;
+	double age = wall() - out.Wall;
+	Applied++;
+	CommandAgeSum += age;
+	CommandAgeMax = max(CommandAgeMax, age);
+	return true;
+}
+
+bool ControllerThread::stats(ControllerStats& s) const
+// Latest timing statistics, with the age of the commands sent so far. Returns false before the first publication.
+// Simulation thread only.
+{
+	if (!Published.read(s)) return false;
+	s.Applied = Applied;
+	s.CommandAgeMean = Applied ? CommandAgeSum / Applied : 0;
+	s.CommandAgeMax = CommandAgeMax;
+	return true;
+}
+
+void ControllerThread::waitUntil(double release) const
+// Sleep until the release, or until Spin before it and busy-wait from there
+{
+	double wake = release - Spin;
+	double now = wall();
+	if (wake > now) {
+		std::this_thread::sleep_until(Epoch + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(wake)));
+	}
+	if (Spin > 0) {
+		while (wall() < release) {}
+	}
+}
+
+void ControllerThread::threadLoop()
+// Release the ticks at fixed wall clock times until stopped. Ticks only run once the first sensor frame is in.
+{
+	if (Cpu >= 0) Pinned = pinThread(Cpu);
+	long long k = 0;
+	double release = wall();
+	PublishWall = release;
+	while (!Stop) {
+		waitUntil(release);
+		double start = wall();
+		bool ran = tick(k);
+		double end = wall();
+		double period = 1 / (Rate * Warp);
+		if (ran) {
+			double late = max(start - release, 0);
+			Timing.Ticks++;
+			LatenessSum += late;
+			Timing.LatenessMax = max(Timing.LatenessMax, late);
+			Histogram[(int)min(late / CONTROLLER_HISTOGRAM_BIN, CONTROLLER_HISTOGRAM_BINS - 1)]++;
+			ComputeSum += end - start;
+			Timing.ComputeMax = max(Timing.ComputeMax, end - start);
+			Timing.Rate = 1 / period;
+		}
+
+		// A tick that finishes after the next release overruns. The next tick then runs at once, unless a whole
+		// period has gone since its release, in which case that release is dropped.
+		double next = release + period;
+		k++;
+		if (end > next) {
+			if (ran) Timing.Overruns++;
+			while (next + period <= end) {
+				next += period;
+				k++;
+				if (ran) Timing.Skipped++;
+			}
+		}
+		release = next;
+		if (end - PublishWall >= CONTROLLER_STATS_INTERVAL) publish();
+	}
+
+	// The final statistics are not dropped
+	while (!publish()) std::this_thread::yield();
+}
+
+bool ControllerThread::tick(long long k)
+// Run the autopilot for release k on the latest sensor frame and hand back its commands. Returns false if there is
+// no frame yet.
+{
+	std::lock_guard<std::mutex> hold(Lock);
+	uint64_t n = Inputs.read(Input);
+	if (!n) return false;
+	double now = wall();
+	AutoPilotParams const& p = Pilot.getParams();
+
+	// Tick rate and update ratio, which a parameter change may alter
+	Rate = p.RateLoopRate > 0 ? p.RateLoopRate : p.GuidanceRate;
+	Rate = max(Rate, CONTROLLER_MIN_RATE);
+	Ratio = 1;
+	if (p.RateLoopRate > 0 && p.GuidanceRate > 0 && p.GuidanceRate < p.RateLoopRate) Ratio = llround(p.RateLoopRate / p.GuidanceRate);
+	if (Input.Warp > 0) Warp = Input.Warp;
+
+	// Take a new frame. If time ran backwards, as on loading a state, the update clock restarts.
+	if (n != Seen) {
+		Seen = n;
+		if (Started && Input.Frame.SimT < Held.SimT) Started = false;
+		Held = Input.Frame;
+		Vessel->ControllerFrame(Held, Input.Staging);
+		Timing.Frames++;
+	}
+
+	// The frame's state, held at its sampling and timed by the wall clock since, up to the end of its step
+	double age = max(now - Input.Wall, 0);
+	StateFrame s = Held;
+	s.SimT = Held.SimT + min(age * Warp, Held.SimDT);
+	FrameAgeSum += age;
+	Timing.FrameAgeMax = max(Timing.FrameAgeMax, age);
+
+	if (!Started || k - GuidanceTick >= Ratio) {
+		if (!Started) LastGuidanceT = s.SimT - Ratio / Rate;
+		Started = true;
+		GuidanceTick = k;
+		s.SimDT = s.SimT - LastGuidanceT;
+		LastGuidanceT = s.SimT;
+		Pilot.autopilotUpdate(Vessel, s);
+	}
+	else {
+		Pilot.rateLoopUpdate(Vessel, s);
+	}
+
+	ControllerOutput out;
+	out.Rcs = Pilot.getOptions().ControlAllocation != 0 && Pilot.getAllocator().configured();
+	ControlScheduler::getCommands(Vessel, out.Rcs, out.Commands);
+	out.Mode = Pilot.getMode();
+	out.Timer = Pilot.getTimer();
+	out.Alpha = Pilot.getAlpha();
+	out.SimT = s.SimT;
+	out.Wall = wall();
+	Outputs.write(out);
+	Timing.SimT = s.SimT;
+	return true;
+}
+
+bool ControllerThread::publish()
+// Publish the statistics so far. Returns false if the reader holds the back buffer.
+{
+	ControllerStats s = Timing;
+	double n = Timing.Ticks > 0 ? (double)Timing.Ticks : 1;
+	s.LatenessMean = LatenessSum / n;
+	s.ComputeMean = ComputeSum / n;
+	s.FrameAgeMean = FrameAgeSum / n;
+	long long count = 0;
+	s.LatenessP50 = s.LatenessP99 = 0;
+	bool p50 = false;
+	for (int i = 0; i < CONTROLLER_HISTOGRAM_BINS && Timing.Ticks > 0; i++) {
+		count += Histogram[i];
+		double top = min((i + 1) * CONTROLLER_HISTOGRAM_BIN, Timing.LatenessMax);
+		if (!p50 && count >= 0.5 * Timing.Ticks) {
+			s.LatenessP50 = top;
+			p50 = true;
+		}
+		if (count >= 0.99 * Timing.Ticks) {
+			s.LatenessP99 = top;
+			break;
+		}
+	}
+	s.Pinned = Pinned;
+	if (!Published.write(s)) return false;
+	PublishWall = wall();
+	return true;
+}
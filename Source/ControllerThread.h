@@ -0,0 +1,139 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ControllerThread.h
+// Header file for the real-time controller thread, which runs a
+// vessel's autopilot at a fixed rate in wall clock time
+//
+// ==============================================================
+
+#pragma once
+
+#include "AutoPilotModes.h"
+#include "StateFrame.h"
+#include "ControlScheduler.h"
+#include "TripleBuffer.h"
+#include "DoubleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+class Surveyor;
+class AutoPilot;
+
+const double CONTROLLER_MIN_RATE = 1;          // Lowest tick rate [Hz]
+const double CONTROLLER_STATS_INTERVAL = 0.5;  // Wall clock time between publications of the timing statistics [s]
+const double CONTROLLER_HISTOGRAM_BIN = 5e-6;  // Width of a bin of the tick lateness histogram [s]
+const int CONTROLLER_HISTOGRAM_BINS = 2000;    // Bins of the histogram; the last counts everything beyond it
+
+// Sensor frame handed to the controller by the simulation thread
+struct ControllerInput {
+	StateFrame Frame;  // State sampled for a time step
+	int Staging;       // Staging configuration
+	double Warp;       // Simulated seconds per wall clock second
+	double Wall;       // Wall clock time it was handed over [s]
+};
+
+// Commands and autopilot status handed back by each tick
+struct ControllerOutput {
+	ScheduledCommands Commands; // Thrust commands, with the RCS jets if Rcs is set
+	bool Rcs;                   // The autopilot commands the RCS jets
+	AutoPilotStatus Mode;       // Autopilot mode after the tick
+	double Timer;               // Mode timer [s]
+	double Alpha;               // Vernier 1 thrust angle [rad]
+	double SimT;                // Simulation time the tick flew at [s]
+	double Wall;                // Wall clock time the tick finished [s]
+};
+
+// Timing of the controller thread. The lateness of a tick is the time from its release to its start: wake-up
+// latency, and any overrun of the tick before it. A tick overruns if it finishes after the next release.
+struct ControllerStats {
+	double Rate;                  // Tick rate in wall clock time, at the last tick [Hz]
+	long long Ticks;              // Ticks run
+	long long Overruns;           // Ticks that finished after the next release
+	long long Skipped;            // Releases dropped because a tick finished after them
+	long long Frames;             // Sensor frames taken
+	double SimT;                  // Simulation time of the last tick [s]
+	double LatenessMean;          // Tick lateness [s]
+	double LatenessP50;
+	double LatenessP99;
+	double LatenessMax;
+	double ComputeMean;           // Wall clock time of a tick [s]
+	double ComputeMax;
+	double FrameAgeMean;          // Age of the sensor frame a tick flies on [s]
+	double FrameAgeMax;
+	long long Applied;            // Commands taken by the simulation thread
+	double CommandAgeMean;        // Age of commands when taken [s]
+	double CommandAgeMax;
+	bool Pinned;                  // The thread is pinned to its core
+};
+
+/* Runs a vessel's autopilot on its own thread at RateLoopRate in wall clock time, scaled by the time acceleration,
+   as a flight computer would, whatever the simulation's frame rate. Every RateLoopRate / GuidanceRate-th tick is a
+   full autopilot update and the others are angular velocity loop updates, as under ControlScheduler. A tick flies on
+   the latest sensor frame, its time moved on by the wall clock time since the frame was handed over, up to the end
+   of the frame's step, and hands back its commands, which the next time step sends. Frames and commands pass
+   through triple buffers, so neither thread waits for the other.
+
+   Each tick is released at a fixed wall clock time. The thread sleeps until the release or, with ControllerSpin,
+   until that long before it and then busy-waits, which trades a core for lower wake-up latency. A tick that finishes
+   after the next release runs the next one at once, or drops it if a whole period has gone. ControllerCpu pins the
+   thread to a core. The timing statistics are published every CONTROLLER_STATS_INTERVAL.
+
+   While the thread runs it owns the autopilot, its actuator buffer and the navigation filter. The simulation thread
+   holds lock() for the rare changes it makes to them, such as loading state or rebuilding the control allocator;
+   each tick holds it while it runs. */
+class ControllerThread {
+public:
+	ControllerThread(Surveyor* sc, AutoPilot& ap);
+	~ControllerThread();
+	void submit(StateFrame const& sf, int staging, double warp);
+	bool latest(ControllerOutput& out);
+	bool stats(ControllerStats& s) const;
+	std::mutex& lock() { return Lock; }
+private:
+	ControllerThread(ControllerThread const&);
+	ControllerThread& operator=(ControllerThread const&);
+	double wall() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - Epoch).count(); }
+	void threadLoop();
+	void waitUntil(double release) const;
+	bool tick(long long k);
+	bool publish();
+
+	Surveyor* Vessel;                    // Vessel flown
+	AutoPilot& Pilot;                    // Its autopilot
+	double Spin;                         // Busy-wait before each release [s]
+	int Cpu;                             // Core to pin the thread to, or -1
+	std::chrono::steady_clock::time_point Epoch; // Origin of the wall clock times [s]
+	TripleBuffer<ControllerInput> Inputs;   // Latest sensor frame
+	TripleBuffer<ControllerOutput> Outputs; // Latest commands
+	DoubleBuffer<ControllerStats> Published; // Latest timing statistics
+	std::mutex Lock;                     // Held by each tick, and by the simulation thread to change the autopilot
+	std::atomic<bool> Stop;              // Set on destruction
+
+	// Controller thread only
+	bool Pinned;                         // The thread was pinned to Cpu
+	double Rate;                         // Tick rate in simulated time [Hz]
+	long long Ratio;                     // Ticks per full autopilot update
+	double Warp;                         // Simulated seconds per wall clock second, from the latest frame
+	ControllerInput Input;               // Latest sensor frame
+	uint64_t Seen;                       // Write number of the frame in Held
+	StateFrame Held;                     // Latest frame, completed with the navigation estimates
+	bool Started;                        // A full update has run since the last restart
+	long long GuidanceTick;              // Release of the last full update
+	double LastGuidanceT;                // Simulation time of the last full update [s]
+	ControllerStats Timing;              // Statistics so far
+	double LatenessSum, ComputeSum, FrameAgeSum;
+	long long Histogram[CONTROLLER_HISTOGRAM_BINS]; // Tick lateness
+	double PublishWall;                  // Wall clock time of the last publication [s]
+
+	// Simulation thread only
+	uint64_t Taken;                      // Write number of the last commands taken
+	long long Applied;                   // Commands taken
+	double CommandAgeSum, CommandAgeMax; // Their age when taken [s]
+
+	std::thread Worker;                  // Controller thread, started last
+};
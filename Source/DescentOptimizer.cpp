@@ -0,0 +1,359 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// DescentOptimizer.cpp
+// Background powered descent optimizer
+//
+// ==============================================================
+
+#include "DescentOptimizer.h"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// Problem at one final time, and the iterates solving it
+struct DescentSolve {
+	DescentProblem const* In;
+	double T, Dt;                    // Final time and interval [s]
+	double Mass[DESCENT_NODES + 1];  // Mass at the start of each interval, and at the end [kg]
+	double Lo[DESCENT_NODES];        // Thrust acceleration bounds over each interval [m/s^2]
+	double Hi[DESCENT_NODES];
+	double Cost[DESCENT_NODES];      // Fuel per unit of slack over each interval, relative
+	double Bx, By, Bz, Bh;           // Right hand sides of the terminal constraints
+	double Ayy, Ayh, Ahh;            // Gram matrix of the vertical velocity and height constraints
+	double X[DESCENT_VARIABLES], Z[DESCENT_VARIABLES], Y[DESCENT_VARIABLES];
+};
+
+static double heightWeight(DescentSolve const& s, int k)
+// Coefficient of interval k's vertical thrust acceleration in the final height
+{
+	return s.Dt * s.Dt * (DESCENT_NODES - k - 0.5);
+}
+
+static void setup(DescentSolve& s, double T)
+// Terminal constraints at final time T, and the thrust bounds and costs for the mass the iterate burns
+{
+	DescentProblem const& in = *s.In;
+	int const N = DESCENT_NODES;
+	s.T = T;
+	s.Dt = T / N;
+
+	// v(T) = v0 + g T + Dt sum(u) = (0, -TargetSpeed, 0) and h(T) = h0 + v0y T - g T^2 / 2 + sum(w u_y) = TargetAltitude
+	s.Bx = -in.Velocity.x / s.Dt;
+	s.Bz = -in.Velocity.z / s.Dt;
+	s.By = (-in.TargetSpeed - in.Velocity.y + in.Gravity * T) / s.Dt;
+	s.Bh = in.TargetAltitude - in.Altitude - in.Velocity.y * T + 0.5 * in.Gravity * T * T;
+	s.Ayy = N;
+	s.Ayh = 0;
+	s.Ahh = 0;
+	for (int k = 0; k < N; k++) {
+		double w = heightWeight(s, k);
+		s.Ayh += w;
+		s.Ahh += w * w;
+	}
+
+	// The mass falls with the slack of the iterate: the thrust acceleration held over an interval burns a fixed
+	// fraction of the mass
+	s.Mass[0] = in.Mass;
+	for (int k = 0; k < N; k++) {
+		double m = s.Mass[k];
+		s.Lo[k] = in.MinThrust / m;
+		s.Hi[k] = in.MaxThrust / m;
+		s.Cost[k] = m / in.Mass;
+		double a = fmin(fmax(s.Z[4 * k + 3], s.Lo[k]), s.Hi[k]);
+		s.Mass[k + 1] = m * exp(-a * s.Dt / in.ExhaustVelocity);
+	}
+}
+
+static void projectTerminal(DescentSolve const& s, double* x)
+// Project x onto the terminal constraints. The horizontal rows sum the thrust acceleration of each axis, and the
+// vertical velocity and height rows share the vertical components, so the projection is in closed form.
+{
+	int const N = DESCENT_NODES;
+	double sx = 0, sy = 0, sz = 0, sh = 0;
+	for (int k = 0; k < N; k++) {
+		sx += x[4 * k];
+		sy += x[4 * k + 1];
+		sz += x[4 * k + 2];
+		sh += heightWeight(s, k) * x[4 * k + 1];
+	}
+	double rx = (sx - s.Bx) / N, rz = (sz - s.Bz) / N;
+	double ry = sy - s.By, rh = sh - s.Bh;
+	double det = s.Ayy * s.Ahh - s.Ayh * s.Ayh;
+	double ly = (s.Ahh * ry - s.Ayh * rh) / det;
+	double lh = (s.Ayy * rh - s.Ayh * ry) / det;
+	for (int k = 0; k < N; k++) {
+		x[4 * k] -= rx;
+		x[4 * k + 1] -= ly + lh * heightWeight(s, k);
+		x[4 * k + 2] -= rz;
+	}
+}
+
+static void projectFrustum(double lo, double hi, double slope, double* u, int n, double& t)
+// Project (u, t), with u of n components, onto |u| <= slope t, lo <= t <= hi. The set is symmetric about the t axis,
+// so this is the projection of (|u|, t) onto the trapezoid between the bounds and the cone, in the plane: the nearest
+// point of its lower edge, its upper edge and its side on the cone.
+{
+	double r = 0;
+	for (int i = 0; i < n; i++) r += u[i] * u[i];
+	r = sqrt(r);
+	if (r <= slope * t && t >= lo && t <= hi) return;
+	double side = fmin(fmax((slope * r + t) / (1 + slope * slope), lo), hi);
+	double cand[3][2] = { { fmin(r, slope * lo), lo }, { fmin(r, slope * hi), hi }, { slope * side, side } };
+	double pr = 0, pt = 0, best = -1;
+	for (int i = 0; i < 3; i++) {
+		double dr = cand[i][0] - r, dt = cand[i][1] - t, d = dr * dr + dt * dt;
+		if (best < 0 || d < best) {
+			best = d;
+			pr = cand[i][0];
+			pt = cand[i][1];
+		}
+	}
+	double k = r > 0 ? pr / r : 0;
+	for (int i = 0; i < n; i++) u[i] *= k;
+	t = pt;
+}
+
+static void projectBounds(double lo, double hi, double cosTilt, double* v)
+// Project a thrust acceleration and its slack (u, s) onto |u| <= s, lo <= s <= hi, u_y >= s cosTilt. If the
+// projection onto the first two misses the tilt limit, the projection onto all three lies where the tilt limit is
+// met exactly: there the horizontal thrust is bounded by a narrower cone, in the slack along the limit.
+{
+	double q[4] = { v[0], v[1], v[2], v[3] };
+	projectFrustum(lo, hi, 1, q, 3, q[3]);
+	if (q[1] >= cosTilt * q[3]) {
+		for (int j = 0; j < 4; j++) v[j] = q[j];
+		return;
+	}
+	double a = sqrt(1 + cosTilt * cosTilt);
+	double h[2] = { v[0], v[2] };
+	double t = (cosTilt * v[1] + v[3]) / a;
+	projectFrustum(lo * a, hi * a, sqrt(1 - cosTilt * cosTilt) / a, h, 2, t);
+	v[0] = h[0];
+	v[1] = cosTilt * t / a;
+	v[2] = h[1];
+	v[3] = t / a;
+}
+
+static bool admm(DescentSolve& s, double rho, int& iterations)
+// Solve at the current final time from the current iterates. Returns true if the iterates converge.
+{
+	DescentProblem const& in = *s.In;
+	int const N = DESCENT_NODES;
+	double x[DESCENT_VARIABLES];
+	for (int it = 0; it < DESCENT_ITERATIONS; it++) {
+		iterations++;
+		for (int i = 0; i < DESCENT_VARIABLES; i++) x[i] = s.Z[i] - s.Y[i];
+		for (int k = 0; k < N; k++) x[4 * k + 3] -= s.Cost[k] / rho;
+		projectTerminal(s, x);
+		double primal = 0, dual = 0;
+		for (int k = 0; k < N; k++) {
+			double v[4], old[4];
+			for (int j = 0; j < 4; j++) {
+				int i = 4 * k + j;
+				old[j] = s.Z[i];
+				v[j] = x[i] + s.Y[i];
+			}
+			projectBounds(s.Lo[k], s.Hi[k], in.CosTilt, v);
+			for (int j = 0; j < 4; j++) {
+				int i = 4 * k + j;
+				s.X[i] = x[i];
+				s.Z[i] = v[j];
+				s.Y[i] += x[i] - v[j];
+				primal = fmax(primal, fabs(x[i] - v[j]));
+				dual = fmax(dual, fabs(v[j] - old[j]));
+			}
+		}
+		if (primal < DESCENT_TOLERANCE && dual < DESCENT_TOLERANCE) return true;
+	}
+	return false;
+}
+
+static bool aboveGround(DescentSolve const& s)
+// True if the descent the iterate flies stays above the ground at the end of each interval. The terminal constraints
+// alone admit descents that pass below it and climb back to the target, which over flat ground is all that a final
+// time longer than the shortest feasible one can reach.
+{
+	DescentProblem const& in = *s.In;
+	double h = in.Altitude, v = in.Velocity.y;
+	for (int k = 0; k < DESCENT_NODES - 1; k++) {
+		double a = s.X[4 * k + 1] - in.Gravity;
+		h += (v + 0.5 * a * s.Dt) * s.Dt;
+		v += a * s.Dt;
+		if (h < 0) return false;
+	}
+	return true;
+}
+
+static bool solveAt(DescentSolve& s, double T, double& fuel, DescentProfile& out)
+// Solve at final time T, and return the fuel of a converged solve [kg]. A solve that burns more than the propellant
+// on board, or passes below the ground, is infeasible.
+{
+	setup(s, T);
+	out.Solves++;
+	if (!admm(s, DESCENT_PENALTY / s.Hi[0], out.Iterations)) return false;
+	setup(s, T);
+	fuel = s.Mass[0] - s.Mass[DESCENT_NODES];
+	return fuel <= s.In->Propellant && aboveGround(s);
+}
+
+static void start(DescentSolve& s, DescentSolution const& warm, double elapsed, double T)
+// Start the iterates from the last solve, moved on by the time since it, over a final time T
+{
+	int const N = DESCENT_NODES;
+	double dt = T / N, last = warm.Duration / N;
+	for (int k = 0; k < N; k++) {
+		int j = (int)((elapsed + (k + 0.5) * dt) / last);
+		if (j > N - 1) j = N - 1;
+		memcpy(&s.X[4 * k], &warm.X[4 * j], 4 * sizeof(double));
+		memcpy(&s.Z[4 * k], &warm.Z[4 * j], 4 * sizeof(double));
+		memcpy(&s.Y[4 * k], &warm.Y[4 * j], 4 * sizeof(double));
+	}
+}
+
+static void coldStart(DescentSolve& s)
+// Start the iterates from a hover at the first interval's mass
+{
+	DescentProblem const& in = *s.In;
+	for (int k = 0; k < DESCENT_NODES; k++) {
+		double a = fmin(fmax(in.Gravity, in.MinThrust / in.Mass), in.MaxThrust / in.Mass);
+		double v[4] = { 0, a, 0, a };
+		for (int j = 0; j < 4; j++) {
+			s.X[4 * k + j] = v[j];
+			s.Z[4 * k + j] = v[j];
+			s.Y[4 * k + j] = 0;
+		}
+	}
+}
+
+static bool search(DescentSolve& s, DescentSolution const& warm, double& bestFuel, DescentProfile& out)
+// Search for the final time of least fuel, leaving its solve in s. Returns false if none is feasible.
+{
+	DescentProblem const& in = *s.In;
+	DescentSolve best;
+	double fuel = 0;
+	bool found = false;
+	bestFuel = 0;
+
+	// Warm start: search down from the last solve's final time, or up to a feasible one
+	double elapsed = in.SimT - warm.SimT;
+	if (warm.Valid && elapsed >= 0 && elapsed < warm.Duration) {
+		double T = warm.Duration - elapsed;
+		start(s, warm, elapsed, T);
+		if (solveAt(s, T, fuel, out)) {
+			best = s;
+			bestFuel = fuel;
+			found = true;
+			for (int i = 0; i < DESCENT_TIME_STEPS; i++) {
+				double shorter = best.T * (1 - DESCENT_TIME_STEP);
+				if (!solveAt(s, shorter, fuel, out) || !(fuel < bestFuel)) break;
+				best = s;
+				bestFuel = fuel;
+			}
+		}
+		else {
+			for (int i = 0; i < DESCENT_TIME_STEPS && !found; i++) {
+				T *= 1 + DESCENT_TIME_STEP;
+				if (solveAt(s, T, fuel, out)) {
+					best = s;
+					bestFuel = fuel;
+					found = true;
+				}
+			}
+		}
+	}
+
+	// Cold start: bracket the shortest feasible final time, from the time to reach the target at the mean of the
+	// initial and final speeds, and bisect for it
+	if (!found) {
+		double height = fmax(in.Altitude - in.TargetAltitude, 0);
+		double speed = sqrt(in.Velocity.x * in.Velocity.x + in.Velocity.y * in.Velocity.y + in.Velocity.z * in.Velocity.z);
+		double hi = fmax(2 * height / (speed + in.TargetSpeed), 1), lo = 0;
+		coldStart(s);
+		for (int i = 0; i < 12 && !found; i++) {
+			if (solveAt(s, hi, fuel, out)) {
+				best = s;
+				bestFuel = fuel;
+				found = true;
+			}
+			else {
+				lo = hi;
+				hi *= 2;
+			}
+		}
+		if (found && lo == 0) lo = 0.5 * hi;
+		while (found && hi - lo > DESCENT_TIME_TOLERANCE * hi) {
+			double mid = 0.5 * (lo + hi);
+			s = best;
+			if (solveAt(s, mid, fuel, out)) {
+				best = s;
+				bestFuel = fuel;
+				hi = mid;
+			}
+			else lo = mid;
+		}
+	}
+	if (!found) return false;
+
+	// The mass burnt by the chosen profile sets the bounds for one more solve at its final time
+	s = best;
+	if (solveAt(s, best.T, fuel, out)) bestFuel = fuel;
+	else s = best;
+	return true;
+}
+
+void DescentOptimizer::solve(DescentProblem const& in, DescentSolution& warm, DescentProfile& out)
+// Solve the fuel-optimal profile for a request, starting from and then replacing the last solve. If no profile is
+// feasible within the planned thrust bound, the search is repeated with the reserve bound, which the next request
+// does not start from.
+{
+	auto t0 = std::chrono::steady_clock::now();
+	int const N = DESCENT_NODES;
+	DescentSolve s;
+	DescentProblem reserve = in;
+	reserve.MaxThrust = fmax(in.ReserveThrust, in.MaxThrust);
+	s.In = &in;
+	out.SimT = in.SimT;
+	out.Feasible = false;
+	out.Reserve = false;
+	out.Solves = 0;
+	out.Iterations = 0;
+
+	double fuel = 0;
+	bool found = search(s, warm, fuel, out);
+	if (!found && reserve.MaxThrust > in.MaxThrust) {
+		s.In = &reserve;
+		found = out.Reserve = search(s, warm, fuel, out);
+	}
+
+	warm.Valid = found && !out.Reserve;
+	if (found) {
+		warm.SimT = in.SimT;
+		warm.Duration = s.T;
+		memcpy(warm.X, s.X, sizeof(warm.X));
+		memcpy(warm.Z, s.Z, sizeof(warm.Z));
+		memcpy(warm.Y, s.Y, sizeof(warm.Y));
+		out.Feasible = true;
+		out.Duration = s.T;
+		out.Propellant = fuel;
+		out.Gap = 0;
+		for (int k = 0; k < N; k++) {
+			double const* z = &s.Z[4 * k];
+			double r = sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+			double F = z[3] * s.Mass[k];
+			out.Thrust[k] = r > 0 ? _V(z[0], z[1], z[2]) * (F / r) : _V(0, F, 0);
+			out.Gap = fmax(out.Gap, (z[3] - r) * s.Mass[k]);
+		}
+	}
+	out.SolveTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+bool DescentOptimizer::serve(DescentChannel& c)
+// Solve the channel's latest request if it has not been solved, and publish the profile. Returns true if there was
+// work: a request solved, or a profile still waiting to be published.
+{
+	DescentSolution& warm = c.Solution;
+	return c.serve([&warm](DescentProblem const& in, DescentProfile& out) { solve(in, warm, out); });
+}
@@ -0,0 +1,107 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// DescentOptimizer.h
+// Header file for the background powered descent optimizer, which
+// solves fuel-optimal vernier thrust profiles to touchdown
+//
+// ==============================================================
+
+#pragma once
+
+#include "SurveyorConstants.h"
+#include "RequestWorker.h"
+
+const int DESCENT_NODES = 40;                // Intervals of a thrust profile, each with constant thrust
+const int DESCENT_VARIABLES = 4 * DESCENT_NODES; // Thrust acceleration and its bound in each interval
+const double DESCENT_INTERVAL = 0.25;        // Simulation time between optimizer requests from one vessel [s]
+const double DESCENT_MIN_LEVEL = 0.05;       // Lowest vernier level, the floor of the angular velocity loop
+const int DESCENT_ITERATIONS = 400;          // Iteration limit of one solve, beyond which it counts as infeasible
+const double DESCENT_TOLERANCE = 1e-3;       // Change and constraint violation of a converged solve [m/s^2]
+const double DESCENT_PENALTY = 5;            // Augmented Lagrangian penalty, relative to the cost per interval
+const double DESCENT_TIME_STEP = 0.02;       // Step of the warm-started final time search, relative
+const double DESCENT_TIME_TOLERANCE = 0.002; // Accuracy of the cold final time search, relative
+const int DESCENT_TIME_STEPS = 8;            // Steps the warm-started search takes before searching cold
+const double DESCENT_POLL = 0.002;           // Time the optimizer thread sleeps when no request is waiting [s]
+const double DESCENT_MAX_AGE = 1;            // Age beyond which the autopilot no longer flies a profile [s]
+
+// Powered descent problem: the state a descent starts from, sampled by the vessel on the simulation thread, and the
+// state it must reach. Vectors are in the local horizon frame, y up.
+struct DescentProblem {
+	double SimT;            // Simulation time [s]
+	double Altitude;        // Height above terrain [m]
+	VECTOR3 Velocity;       // Surface relative velocity [m/s]
+	double Mass;            // Total mass [kg]
+	double Propellant;      // Vernier propellant mass [kg]
+	double Gravity;         // Gravitational acceleration, held for the whole descent [m/s^2]
+	double MinThrust;       // Lower vernier thrust bound [N]
+	double MaxThrust;       // Planned upper bound, leaving a margin for thrust and mass errors
+	double ReserveThrust;   // Upper bound to fall back on when no profile is feasible within MaxThrust [N]
+	double CosTilt;         // Cosine of the largest angle of the thrust from the vertical
+	double ExhaustVelocity; // Vernier exhaust velocity [m/s]
+	double TargetAltitude;  // Height above terrain at the end of the descent [m]
+	double TargetSpeed;     // Speed at the end of the descent, straight down [m/s]
+};
+
+// Solved thrust profile, and the cost of solving it
+struct DescentProfile {
+	double SimT;                      // Simulation time of the state it was solved from, where it starts [s]
+	bool Feasible;                    // A profile was found; the rest is meaningless otherwise
+	bool Reserve;                     // It needs more than the planned thrust bound
+	double Duration;                  // Final time, from SimT [s]
+	VECTOR3 Thrust[DESCENT_NODES];    // Vernier thrust over each interval of Duration / DESCENT_NODES [N]
+	double Propellant;                // Vernier propellant the profile burns [kg]
+	double Gap;                       // Largest excess of a thrust bound over its thrust, a check of the relaxation [N]
+	int Solves;                       // Final times tried
+	int Iterations;                   // Iterations over all of them
+	double SolveTime;                 // Wall clock time taken [s]
+};
+
+// Iterates of the last solve, which the next one starts from
+struct DescentSolution {
+	bool Valid;                        // Holds a feasible solve
+	double SimT;                       // Start of the solved descent [s]
+	double Duration;                   // Its final time [s]
+	double X[DESCENT_VARIABLES];       // Iterate on the terminal constraints
+	double Z[DESCENT_VARIABLES];       // Iterate on the thrust bounds
+	double Y[DESCENT_VARIABLES];       // Scaled multipliers of X = Z
+};
+
+// One vessel's requests and profiles, and the solve the next request starts from
+class DescentChannel : public RequestChannel<DescentProblem, DescentProfile> {
+public:
+	DescentChannel(void) { Solution.Valid = false; }
+private:
+	friend class DescentOptimizer;
+	DescentSolution Solution;             // Warm start for the next request; optimizer only
+};
+
+/* Background powered descent optimizer. Its thread repeatedly takes the latest request of every registered vessel
+   and solves the fuel-optimal vernier thrust profile that takes it from its state to the target: a three degree of
+   freedom point mass over flat ground in constant gravity, with the thrust held between the vernier bounds over
+   each of DESCENT_NODES intervals. The lower thrust bound makes the problem nonconvex; it is solved through its
+   lossless convexification, in which the thrust acceleration u of each interval is bounded by a slack s, |u| <= s,
+   with s between the thrust bounds over the mass, u within a cone about the vertical, and the fuel the integral of s.
+   The relaxation is exact at the optimum. The mass falls with the thrust of the previous solve.
+
+   For a final time the problem is a second order cone program with four equality constraints, the velocity and
+   height at the end, solved by the alternating direction method of multipliers: a projection onto the terminal
+   constraints, in closed form, alternates with projections of each interval onto its thrust bounds. A final time
+   whose solve does not converge within DESCENT_ITERATIONS, burns more than the propellant on board, or passes below
+   the ground counts as infeasible. The fuel falls as the final time shortens, to the shortest feasible one, so the
+   optimal final time is found by searching down to it: from the last solve's, moved on by the time since, in steps
+   of DESCENT_TIME_STEP, or on a cold start by bisection. Each solve starts from the iterates of the last one, so a
+   profile that has not changed much since the last request costs few iterations. If no final time is feasible
+   within the planned thrust bound, the search is repeated with the reserve bound, and the profile is marked as
+   needing it.
+
+   serve() solves a channel's latest request and publishes the profile; the thread calls it for each registered
+   channel, and a caller may use it instead of the thread. add() and remove() wait for the solve in progress. */
+class DescentOptimizer : public RequestWorker<DescentChannel> {
+public:
+	DescentOptimizer(void) : RequestWorker<DescentChannel>(serve, DESCENT_POLL) {}
+	static bool serve(DescentChannel& c);
+	static void solve(DescentProblem const& in, DescentSolution& warm, DescentProfile& out);
+};
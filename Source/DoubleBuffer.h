@@ -0,0 +1,65 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// DoubleBuffer.h
+// Lock-free double buffer for handing a value from one thread to
+// another
+//
+// ==============================================================
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/* Latest value written by one thread, read by one other thread. write() fills the back buffer and then makes it the
+   front; read() marks the front buffer as being read, checks it is still the front, and copies it. Neither side
+   ever waits for the other: if the reader holds the back buffer, which only happens when it fell behind by a whole
+   write, write() drops the value and returns false, and the writer tries again with a newer one. Every value
+   carries the number of the write that produced it, so the reader can tell a new value from one it has seen. */
+template<class T>
+class DoubleBuffer {
+public:
+	DoubleBuffer(void) : Front(0), Reading(-1), Writes(0)
+	{
+		Number[0] = Number[1] = 0;
+	}
+
+	bool write(T const& value)
+	// Publish a value. Returns false if the reader holds the back buffer.
+	{
+		int back = 1 - Front.load(std::memory_order_relaxed);
+		if (Reading.load(std::memory_order_seq_cst) == back) return false;
+		Slot[back] = value;
+		Number[back] = ++Writes;
+		Front.store(back, std::memory_order_seq_cst);
+		return true;
+	}
+
+	uint64_t read(T& value) const
+	// Copy the latest value. Returns the number of the write that produced it, or 0 before the first write.
+	{
+		int front;
+		do {
+			front = Front.load(std::memory_order_acquire);
+			Reading.store(front, std::memory_order_seq_cst);
+		} while (Front.load(std::memory_order_seq_cst) != front);
+		uint64_t number = Number[front];
+		if (number) value = Slot[front];
+		Reading.store(-1, std::memory_order_release);
+		return number;
+	}
+
+	uint64_t writes() const { return Writes; } // Values published; writer only
+
+private:
+	DoubleBuffer(DoubleBuffer const&);
+	DoubleBuffer& operator=(DoubleBuffer const&);
+	T Slot[2];                       // Front and back values
+	uint64_t Number[2];              // Write that produced each value, 0 for none
+	std::atomic<int> Front;          // Buffer holding the latest value
+	mutable std::atomic<int> Reading; // Buffer the reader is copying, or -1
+	uint64_t Writes;                 // Values published; writer only
+};
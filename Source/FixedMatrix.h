@@ -0,0 +1,127 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// FixedMatrix.h
+// Matrices with compile-time dimensions, held by value, and a
+// Kalman filter built on them. Nothing here allocates: every
+// matrix lives on the stack or inside its owner.
+//
+// ==============================================================
+
+#pragma once
+
+// R x C matrix of doubles, row major
+template <int R, int C>
+struct Matrix {
+	double m[R][C];
+
+	double& operator()(int i, int j) { return m[i][j]; }
+	double operator()(int i, int j) const { return m[i][j]; }
+
+	static Matrix zero()
+	{
+		Matrix a;
+		for (int i = 0; i < R; i++) for (int j = 0; j < C; j++) a.m[i][j] = 0;
+		return a;
+	}
+
+	static Matrix identity()
+	{
+		Matrix a = zero();
+		for (int i = 0; i < R && i < C; i++) a.m[i][i] = 1;
+		return a;
+	}
+};
+
+// Column vector
+template <int N>
+using Vector = Matrix<N, 1>;
+
+template <int R, int K, int C>
+inline Matrix<R, C> operator*(Matrix<R, K> const& a, Matrix<K, C> const& b)
+{
+	Matrix<R, C> p;
+	for (int i = 0; i < R; i++) {
+		for (int j = 0; j < C; j++) {
+			double s = 0;
+			for (int k = 0; k < K; k++) s += a.m[i][k] * b.m[k][j];
+			p.m[i][j] = s;
+		}
+	}
+	return p;
+}
+
+template <int R, int C>
+inline Matrix<R, C> operator+(Matrix<R, C> const& a, Matrix<R, C> const& b)
+{
+	Matrix<R, C> s;
+	for (int i = 0; i < R; i++) for (int j = 0; j < C; j++) s.m[i][j] = a.m[i][j] + b.m[i][j];
+	return s;
+}
+
+template <int R, int C>
+inline Matrix<R, C> operator-(Matrix<R, C> const& a, Matrix<R, C> const& b)
+{
+	Matrix<R, C> s;
+	for (int i = 0; i < R; i++) for (int j = 0; j < C; j++) s.m[i][j] = a.m[i][j] - b.m[i][j];
+	return s;
+}
+
+template <int R, int C>
+inline Matrix<R, C> operator*(double k, Matrix<R, C> const& a)
+{
+	Matrix<R, C> s;
+	for (int i = 0; i < R; i++) for (int j = 0; j < C; j++) s.m[i][j] = k * a.m[i][j];
+	return s;
+}
+
+template <int R, int C>
+inline Matrix<C, R> transpose(Matrix<R, C> const& a)
+{
+	Matrix<C, R> t;
+	for (int i = 0; i < R; i++) for (int j = 0; j < C; j++) t.m[j][i] = a.m[i][j];
+	return t;
+}
+
+/* Linear Kalman filter over N states. Measurements are scalar and applied one at a time, so an update needs no
+   matrix inverse and a missing measurement is simply skipped. The covariance update uses the Joseph form, which
+   keeps it symmetric and positive definite through long runs of updates. */
+template <int N>
+class KalmanFilter {
+public:
+	void reset(Vector<N> const& x0, Matrix<N, N> const& P0)
+	{
+		X = x0;
+		P = P0;
+	}
+
+	void predict(Matrix<N, N> const& F, Vector<N> const& u, Matrix<N, N> const& Q)
+	// Time update: x = F x + u, P = F P F' + Q
+	{
+		X = F * X + u;
+		P = F * P * transpose(F) + Q;
+	}
+
+	bool update(Matrix<1, N> const& H, double z, double r, double gate)
+	// Measurement update with z = H x + noise of variance r. Rejects the measurement, returning false, if its
+	// innovation is more than gate standard deviations from the prediction.
+	{
+		Vector<N> PHt = P * transpose(H);
+		double s = (H * PHt)(0, 0) + r;
+		double y = z - (H * X)(0, 0);
+		if (!(y * y <= gate * gate * s)) return false;
+		Vector<N> K = (1 / s) * PHt;
+		X = X + y * K;
+		Matrix<N, N> A = Matrix<N, N>::identity() - K * H;
+		P = A * P * transpose(A) + r * (K * transpose(K));
+		return true;
+	}
+
+	Vector<N> const& state() const { return X; }
+	Matrix<N, N> const& covariance() const { return P; }
+private:
+	Vector<N> X;       // State estimate
+	Matrix<N, N> P;    // Estimate covariance
+};
@@ -0,0 +1,47 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// GuidanceFormat.h
+// Header file defining the layout of final descent guidance table files
+//
+// ==============================================================
+
+#pragma once
+
+#include <cstdint>
+
+/* A guidance table file is a header followed by vernier thrust levels stored as floats, one table per
+   target speed. Each table is a grid over radar altitude, descent speed and mass, with altitude varying
+   fastest: Levels[target][mass][speed][altitude]. Altitude and speed nodes are spaced uniformly in the square
+   root of their value, so the grid is finest near the surface and at low speed, where the level changes
+   fastest; mass nodes are spaced uniformly. */
+
+// Target speeds at the surface, one table each
+enum GuidanceTarget {
+	GDT_APPROACH,         // ApproachSpeed, flown above TerminalAltitude
+	GDT_TERMINAL,         // TerminalSpeed, flown below TerminalAltitude
+	GDT_TARGETS
+};
+
+const char GDT_MAGIC[8] = { 'S', 'V', 'Y', 'G', 'D', 'T', '\r', '\n' };
+const uint32_t GDT_VERSION = 1;
+
+// File header, at offset 0, followed directly by the levels
+struct GuidanceFileHeader {
+	char Magic[8];                       // GDT_MAGIC
+	uint32_t Version;                    // GDT_VERSION
+	uint32_t Altitudes;                  // Altitude nodes
+	uint32_t Speeds;                     // Descent speed nodes
+	uint32_t Masses;                     // Mass nodes
+	double MaxAltitude;                  // Altitude of the last node; the first is at 0 [m]
+	double MaxSpeed;                     // Speed of the last node; the first is at 0 [m/s]
+	double MinMass;                      // Mass of the first node [kg]
+	double MaxMass;                      // Mass of the last node [kg]
+	double TargetSpeed[GDT_TARGETS];     // Speed to reach at the surface, per table [m/s]
+	double AimFraction;                  // Fraction of the altitude in which the target speed is reached
+	double Thrust;                       // Total vernier thrust the table was solved for [N]
+	double Isp;                          // Vernier specific impulse [m/s]
+	double Gravity;                      // Surface gravity [m/s^2]
+};
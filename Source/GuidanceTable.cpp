@@ -0,0 +1,120 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// GuidanceTable.cpp
+// Final descent guidance table lookup
+//
+// ==============================================================
+
+#include "GuidanceTable.h"
+#include <cstring>
+
+GuidanceTable::GuidanceTable(void)
+	: Levels(0), MassScale(0), MassOffset(0), LastMass(0), LastMassCell(0), SpeedStride(0), MassStride(0), TargetStride(0)
+{
+	Nodes[0] = Nodes[1] = Nodes[2] = 0;
+}
+
+void GuidanceTable::SqrtAxis::setup(int nodes, double maxValue)
+// Index the cells of an axis whose last node is at maxValue. Node k is at the squared coordinate k^2, so cell k
+// spans 2k + 1 of it.
+{
+	int last = nodes - 1;
+	Scale = (double)last * last / maxValue;
+	Last = (double)last * last;
+	Lower.resize(last * last + 1);
+	for (int y = 0, k = 0; y <= last * last; y++) {
+		while (k + 1 < last && (k + 1) * (k + 1) <= y) k++;
+		Lower[y] = (uint16_t)k;
+	}
+	Cells.resize(last);
+	for (int k = 0; k < last; k++) {
+		Cells[k].Slope = 1.0 / (2 * k + 1);
+		Cells[k].Offset = (double)k * k / (2 * k + 1);
+	}
+}
+
+inline int GuidanceTable::SqrtAxis::cell(double value, double& f) const
+// Lower node of the cell holding a value, clamped to the axis, and the weight f of its upper node
+{
+	double y = min(max(value, 0) * Scale, Last);
+	int k = Lower[(int)y];
+	f = Cells[k].Slope * y - Cells[k].Offset;
+	return k;
+}
+
+bool GuidanceTable::open(const char* path)
+// Map a table file. Fails, leaving the table closed, if the file is missing, malformed or truncated.
+{
+	close();
+	if (!File.openRead(path)) return false;
+
+	GuidanceFileHeader const& h = header();
+	if (File.size() < sizeof(GuidanceFileHeader) || memcmp(h.Magic, GDT_MAGIC, sizeof(GDT_MAGIC)) != 0 ||
+		h.Version != GDT_VERSION || h.Altitudes < 2 || h.Speeds < 2 || h.Masses < 2 ||
+		h.Altitudes > GUIDANCE_MAX_SQRT_NODES || h.Speeds > GUIDANCE_MAX_SQRT_NODES ||
+		!(h.MaxAltitude > 0) || !(h.MaxSpeed > 0) || !(h.MaxMass > h.MinMass) ||
+		File.size() < sizeof(GuidanceFileHeader) + (size_t)GDT_TARGETS * h.Altitudes * h.Speeds * h.Masses * sizeof(float)) {
+		File.close();
+		return false;
+	}
+
+	Nodes[0] = h.Altitudes;
+	Nodes[1] = h.Speeds;
+	Nodes[2] = h.Masses;
+	Altitude.setup(Nodes[0], h.MaxAltitude);
+	Speed.setup(Nodes[1], h.MaxSpeed);
+	MassScale = (Nodes[2] - 1.0) / (h.MaxMass - h.MinMass);
+	MassOffset = -h.MinMass * MassScale;
+	LastMass = Nodes[2] - 1.0;
+	LastMassCell = Nodes[2] - 2.0;
+	SpeedStride = Nodes[0];
+	MassStride = SpeedStride * Nodes[1];
+	TargetStride = MassStride * Nodes[2];
+	Levels = (float const*)(File.data() + sizeof(GuidanceFileHeader));
+	return true;
+}
+
+void GuidanceTable::close()
+{
+	Levels = 0;
+	File.close();
+}
+
+bool GuidanceTable::matches(AutoPilotParams const& params) const
+// True if the table was solved for the current vernier constants and the given target speeds
+{
+	if (!isOpen()) return false;
+	GuidanceFileHeader const& h = header();
+	double thrust = 3 * VERNIER_THRUST;
+	return fabs(h.Thrust - thrust) <= 1e-9 * thrust && fabs(h.Isp - VERNIER_ISP) <= 1e-9 * VERNIER_ISP &&
+		fabs(h.Gravity - g) <= 1e-9 * g &&
+		h.TargetSpeed[GDT_APPROACH] == params.ApproachSpeed && h.TargetSpeed[GDT_TERMINAL] == params.TerminalSpeed;
+}
+
+double GuidanceTable::level(GuidanceTarget target, double altitude, double speed, double mass) const
+// Vernier thrust level (fraction of the total thrust of all three verniers) for the given state
+{
+	// Lower node and weight of the upper node along each axis, clamped to the grid. The last cell includes its
+	// upper edge.
+	int i[3];
+	double f[3];
+	i[0] = Altitude.cell(altitude, f[0]);
+	i[1] = Speed.cell(speed, f[1]);
+	double x = min(max(mass * MassScale + MassOffset, 0), LastMass);
+	i[2] = (int)min(x, LastMassCell);
+	f[2] = x - i[2];
+
+	// Interpolate along altitude, then speed, then mass
+	size_t da = 1, dv = SpeedStride, dm = MassStride;
+	float const* p = Levels + target * TargetStride + i[2] * dm + i[1] * dv + i[0];
+	double l00 = p[0] + f[0] * (p[da] - p[0]);
+	double l10 = p[dv] + f[0] * (p[dv + da] - p[dv]);
+	double l01 = p[dm] + f[0] * (p[dm + da] - p[dm]);
+	double l11 = p[dm + dv] + f[0] * (p[dm + dv + da] - p[dm + dv]);
+	double l0 = l00 + f[1] * (l10 - l00);
+	double l1 = l01 + f[1] * (l11 - l01);
+	return l0 + f[2] * (l1 - l0);
+}
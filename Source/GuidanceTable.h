@@ -0,0 +1,63 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// GuidanceTable.h
+// Header file for the final descent guidance table reader
+//
+// ==============================================================
+
+#pragma once
+
+#include "GuidanceFormat.h"
+#include "MappedFile.h"
+#include "AutoPilotParams.h"
+#include <cstdint>
+#include <vector>
+
+// Most altitude or speed nodes a table may have, which bounds the cell index of each axis
+const uint32_t GUIDANCE_MAX_SQRT_NODES = 1024;
+
+// Read-only final descent guidance table. The file is memory-mapped and never copied; a lookup is a
+// trilinear interpolation between the eight surrounding grid nodes, with inputs outside the grid clamped
+// to its edges, so its cost does not depend on the state. The altitude and speed nodes are spaced in the
+// square root of the value; rather than take square roots, a lookup finds the cell from an index on the
+// whole part of the squared node coordinate, and weighs its nodes linearly in the value within it.
+class GuidanceTable {
+public:
+	GuidanceTable(void);
+	bool open(const char* path);
+	void close();
+	bool isOpen() const { return Levels != 0; }
+	bool matches(AutoPilotParams const& params) const;
+	double level(GuidanceTarget target, double altitude, double speed, double mass) const;
+	GuidanceFileHeader const& header() const { return *(GuidanceFileHeader const*)File.data(); }
+private:
+	// Altitude or speed axis, with nodes at values proportional to the square of the node coordinate
+	struct SqrtAxis {
+		struct Cell {
+			double Slope, Offset;      // Weight of the upper node: Slope * y - Offset for squared coordinate y
+		};
+		double Scale;                  // Node coordinate squared per unit of the value
+		double Last;                   // Node coordinate squared of the last node
+		std::vector<uint16_t> Lower;   // Lower node of the cell of each whole squared coordinate
+		std::vector<Cell> Cells;       // Interpolation weights, per cell
+		void setup(int nodes, double maxValue);
+		int cell(double value, double& f) const;
+	};
+	GuidanceTable(GuidanceTable const&);
+	GuidanceTable& operator=(GuidanceTable const&);
+	MappedFile File;           // Table file
+	float const* Levels;       // First level, just past the header
+	int Nodes[3];              // Altitude, speed and mass nodes
+	SqrtAxis Altitude;         // Altitude axis [m]
+	SqrtAxis Speed;            // Speed axis [m/s]
+	double MassScale;          // Nodes per kg
+	double MassOffset;         // Node coordinate at zero mass
+	double LastMass;           // Node coordinate of the last mass node
+	double LastMassCell;       // Node coordinate of the lower node of the last mass cell
+	size_t SpeedStride;        // Levels between speed nodes
+	size_t MassStride;         // Levels between mass nodes
+	size_t TargetStride;       // Levels between the tables of the target speeds
+};
@@ -0,0 +1,281 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// MappedFile.cpp
+// Memory-mapped file and shared memory implementation for Windows
+// and POSIX
+//
+// ==============================================================
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(void) : Data(0), Size(0), Writable(false), Shared(false), File(INVALID_HANDLE_VALUE), Mapping(0)
+// Mapped file constructor
+{
+}
+
+bool MappedFile::create(const char* path, size_t size)
+// Create or truncate a file and map its first size bytes for writing
+{
+	close();
+	File = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (File == INVALID_HANDLE_VALUE) return false;
+	Writable = true;
+	Size = size;
+	if (!map()) {
+		close(0);
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::openRead(const char* path)
+// Map an existing file for reading
+{
+	close();
+	File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (File == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(File, &length) || length.QuadPart == 0) {
+		close();
+		return false;
+	}
+	Writable = false;
+	Size = (size_t)length.QuadPart;
+	if (!map()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::createShared(const char* name, size_t size)
+// Create a named shared memory mapping of size bytes and map it for writing. The mapping is released when the last
+// process that has it open closes it. A new mapping is zero filled, but if another process still has one open under
+// the same name, that one is returned with its contents, so the caller must initialise all of it.
+{
+	close();
+	unsigned long long n = size;
+	Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, (DWORD)(n >> 32), (DWORD)n, name);
+	if (!Mapping) return false;
+	Writable = true;
+	Shared = true;
+	Size = size;
+	Data = (char*)MapViewOfFile(Mapping, FILE_MAP_WRITE, 0, 0, Size);
+	if (!Data) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::openShared(const char* name)
+// Map named shared memory for reading
+{
+	close();
+	Mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	if (!Mapping) return false;
+	Writable = false;
+	Shared = true;
+	Data = (char*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION info;
+	if (!Data || !VirtualQuery(Data, &info, sizeof(info))) {
+		close();
+		return false;
+	}
+	Size = info.RegionSize;
+	return true;
+}
+
+bool MappedFile::map()
+// Map Size bytes of the open file, growing it if it is writable
+{
+	unsigned long long n = Size;
+	Mapping = CreateFileMappingA(File, 0, Writable ? PAGE_READWRITE : PAGE_READONLY, (DWORD)(n >> 32), (DWORD)n, 0);
+	if (!Mapping) return false;
+	Data = (char*)MapViewOfFile(Mapping, Writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, Size);
+	return Data != 0;
+}
+
+void MappedFile::unmap()
+// Release the view and the mapping, keeping the file open
+{
+	if (Data) UnmapViewOfFile(Data);
+	if (Mapping) CloseHandle(Mapping);
+	Data = 0;
+	Mapping = 0;
+}
+
+void MappedFile::close(size_t length)
+// Unmap and close the file. A writable file is cut to length bytes if that is shorter than the mapping.
+{
+	unmap();
+	if (File != INVALID_HANDLE_VALUE) {
+		if (Writable && length < Size) {
+			LARGE_INTEGER end;
+			end.QuadPart = (LONGLONG)length;
+			SetFilePointerEx(File, end, 0, FILE_BEGIN);
+			SetEndOfFile(File);
+		}
+		CloseHandle(File);
+	}
+	File = INVALID_HANDLE_VALUE;
+	Size = 0;
+	Shared = false;
+}
+
+#else
+
+MappedFile::MappedFile(void) : Data(0), Size(0), Writable(false), Shared(false), File(-1)
+// Mapped file constructor
+{
+	Name[0] = 0;
+}
+
+bool MappedFile::create(const char* path, size_t size)
+// Create or truncate a file and map its first size bytes for writing
+{
+	close();
+	File = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (File < 0) return false;
+	Writable = true;
+	Size = size;
+	if (ftruncate(File, (off_t)Size) != 0 || !map()) {
+		close(0);
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::openRead(const char* path)
+// Map an existing file for reading
+{
+	close();
+	File = ::open(path, O_RDONLY);
+	if (File < 0) return false;
+	struct stat st;
+	if (fstat(File, &st) != 0 || st.st_size == 0) {
+		close();
+		return false;
+	}
+	Writable = false;
+	Size = (size_t)st.st_size;
+	if (!map()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::createShared(const char* name, size_t size)
+// Create a POSIX shared memory object of size bytes, zero filled, and map it for writing. An object left under the
+// same name is replaced, so processes still mapping it keep the old contents.
+{
+	close();
+	if (strlen(name) >= sizeof(Name)) return false;
+	shm_unlink(name);
+	File = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (File < 0) return false;
+	strcpy(Name, name);
+	Writable = true;
+	Shared = true;
+	Size = size;
+	if (ftruncate(File, (off_t)Size) != 0 || !map()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::openShared(const char* name)
+// Map a POSIX shared memory object for reading
+{
+	close();
+	File = shm_open(name, O_RDONLY, 0);
+	if (File < 0) return false;
+	struct stat st;
+	if (fstat(File, &st) != 0 || st.st_size == 0) {
+		close();
+		return false;
+	}
+	Writable = false;
+	Shared = true;
+	Size = (size_t)st.st_size;
+	if (!map()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool MappedFile::map()
+// Map Size bytes of the open file
+{
+	void* p = mmap(0, Size, Writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, File, 0);
+	if (p == MAP_FAILED) return false;
+	Data = (char*)p;
+	return true;
+}
+
+void MappedFile::unmap()
+// Release the mapping, keeping the file open
+{
+	if (Data) munmap(Data, Size);
+	Data = 0;
+}
+
+void MappedFile::close(size_t length)
+// Unmap and close the file. A writable file is cut to length bytes if that is shorter than the mapping. Shared
+// memory created by this mapping is removed; processes that still map it keep their mapping.
+{
+	unmap();
+	if (File >= 0) {
+		if (Shared && Name[0]) shm_unlink(Name);
+		else if (Writable && length < Size) {
+			// On failure the file keeps its mapped length; readers go by the header, not the file size
+			int rc = ftruncate(File, (off_t)length);
+			(void)rc;
+		}
+		::close(File);
+	}
+	File = -1;
+	Size = 0;
+	Shared = false;
+	Name[0] = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+// Mapped file destructor
+{
+	close();
+}
+
+bool MappedFile::resize(size_t size)
+// Grow a writable mapping, keeping its contents
+{
+	if (!Writable || Shared || !isOpen()) return false;
+	unmap();
+	Size = size;
+#ifndef _WIN32
+	if (ftruncate(File, (off_t)Size) != 0) return false;
+#endif
+	return map();
+}
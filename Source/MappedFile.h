@@ -0,0 +1,49 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// MappedFile.h
+// Header file for a minimal memory-mapped file (Win32 file mapping
+// in the Orbiter module, mmap in the headless build), also used for
+// named shared memory
+//
+// ==============================================================
+
+#pragma once
+
+#include <cstddef>
+
+// Memory-mapped file. A writable mapping can be grown with resize(); close() trims the file to the requested length.
+// createShared() and openShared() map named shared memory instead of a file: a Win32 named file mapping, or a POSIX
+// shared memory object, which the creator removes on close(). Shared memory cannot be resized.
+class MappedFile {
+public:
+	MappedFile(void);
+	~MappedFile();
+	bool create(const char* path, size_t size);
+	bool openRead(const char* path);
+	bool createShared(const char* name, size_t size);
+	bool openShared(const char* name);
+	bool resize(size_t size);
+	void close(size_t length = (size_t)-1);
+	bool isOpen() const { return Data != 0; }
+	char* data() const { return Data; }
+	size_t size() const { return Size; }
+private:
+	MappedFile(MappedFile const&);
+	MappedFile& operator=(MappedFile const&);
+	bool map();
+	void unmap();
+	char* Data;     // Start of the mapping
+	size_t Size;    // Length of the mapping [bytes]
+	bool Writable;  // Mapping was created for writing
+	bool Shared;    // Mapping is named shared memory rather than a file
+#ifdef _WIN32
+	void* File;     // File handle
+	void* Mapping;  // File mapping handle
+#else
+	int File;       // File descriptor
+	char Name[64];  // Name of the shared memory object created by this mapping, removed on close
+#endif
+};
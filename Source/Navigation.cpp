@@ -0,0 +1,112 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Navigation.cpp
+// Descent navigation filter
+//
+// ==============================================================
+
+#include "Navigation.h"
+#include <cstring>
+
+Navigation::Navigation(void)
+	: Initialized(false), LastT(0), Rejected(0)
+{
+	memset(&Readings, 0, sizeof(Readings));
+}
+
+void Navigation::reset(uint64_t seed)
+// Restart the filter at the next update, with a new noise sequence
+{
+	Noise.reseed(seed);
+	Initialized = false;
+	Rejected = 0;
+}
+
+void Navigation::measure(Matrix<1, NAV_STATES> const& H, double z, double sigma)
+{
+	if (!Filter.update(H, z, sigma * sigma, NAV_GATE)) Rejected++;
+}
+
+void Navigation::update(StateFrame& sf, VECTOR3 const& thrust, bool amr)
+/* Replace the true velocity and radar altitude in a sampled state frame with their estimates. sf.Horizon must hold
+   the vessel to horizon frame rotation, thrust the force commanded over the last time step in the vessel frame [N],
+   and amr is false once the AMR has been jettisoned. The caller rederives the rest of the frame. */
+{
+	MATRIX3 const& R = sf.Horizon;
+	VECTOR3 up = _V(R.m21, R.m22, R.m23);
+	Radars.sample(sf.Airspeed, sf.RadarAltitude, up, amr, Noise, Readings);
+
+	Vector<NAV_STATES> x;
+	if (!Initialized) {
+		// Start from the tracked state
+		VECTOR3 v = mul(R, sf.Airspeed);
+		x(0, 0) = v.x + NAV_INIT_VELOCITY_SIGMA * Noise.gaussian();
+		x(1, 0) = v.y + NAV_INIT_VELOCITY_SIGMA * Noise.gaussian();
+		x(2, 0) = v.z + NAV_INIT_VELOCITY_SIGMA * Noise.gaussian();
+		x(3, 0) = sf.RadarAltitude + NAV_INIT_ALTITUDE_SIGMA * Noise.gaussian();
+		Matrix<NAV_STATES, NAV_STATES> P = Matrix<NAV_STATES, NAV_STATES>::zero();
+		P(0, 0) = P(1, 1) = P(2, 2) = NAV_INIT_VELOCITY_SIGMA * NAV_INIT_VELOCITY_SIGMA;
+		P(3, 3) = NAV_INIT_ALTITUDE_SIGMA * NAV_INIT_ALTITUDE_SIGMA;
+		Filter.reset(x, P);
+		Initialized = true;
+		LastT = sf.SimT;
+	}
+	else if (sf.SimT > LastT) {
+		// Commanded thrust and gravity, with the apparent lift of horizontal motion over the curved surface
+		double dt = sf.SimT - LastT;
+		LastT = sf.SimT;
+		x = Filter.state();
+		double r = NAV_BODY_RADIUS + x(3, 0);
+		double horizSq = x(0, 0) * x(0, 0) + x(2, 0) * x(2, 0);
+		VECTOR3 thrustAcc = thrust / sf.Mass;
+		VECTOR3 a = mul(R, thrustAcc);
+		a.y += horizSq / r - g * (NAV_BODY_RADIUS / r) * (NAV_BODY_RADIUS / r);
+
+		Matrix<NAV_STATES, NAV_STATES> F = Matrix<NAV_STATES, NAV_STATES>::identity();
+		F(3, 1) = dt;
+		Vector<NAV_STATES> u;
+		u(0, 0) = a.x * dt;
+		u(1, 0) = a.y * dt;
+		u(2, 0) = a.z * dt;
+		u(3, 0) = 0.5 * a.y * dt * dt;
+
+		// Acceleration noise integrated into the velocity and altitude, and terrain passing underneath
+		double sa = NAV_ACCEL_NOISE + NAV_THRUST_NOISE * length(thrustAcc);
+		double qa = sa * sa;
+		double st = NAV_TERRAIN_SLOPE * sqrt(horizSq);
+		Matrix<NAV_STATES, NAV_STATES> Q = Matrix<NAV_STATES, NAV_STATES>::zero();
+		Q(0, 0) = Q(1, 1) = Q(2, 2) = qa * dt;
+		Q(1, 3) = Q(3, 1) = qa * dt * dt / 2;
+		Q(3, 3) = qa * dt * dt * dt / 3 + st * st * NAV_TERRAIN_TIME * dt;
+		Filter.predict(F, u, Q);
+	}
+
+	// Heights from the ranges along the boresight
+	Matrix<1, NAV_STATES> Hh = Matrix<1, NAV_STATES>::zero();
+	Hh(0, 3) = 1;
+	RadarMeasurement const* ranges[2] = { &Readings.AMR, &Readings.Altimeter };
+	for (int i = 0; i < 2; i++) {
+		RadarMeasurement const& m = *ranges[i];
+		if (m.Valid) measure(Hh, m.Value * m.Incidence, m.Sigma * m.Incidence);
+	}
+
+	// Velocity along each doppler beam
+	for (int i = 0; i < 3; i++) {
+		RadarMeasurement const& m = Readings.Doppler[i];
+		if (!m.Valid) continue;
+		VECTOR3 b = mul(R, m.Beam);
+		Matrix<1, NAV_STATES> H;
+		H(0, 0) = b.x;
+		H(0, 1) = b.y;
+		H(0, 2) = b.z;
+		H(0, 3) = 0;
+		measure(H, m.Value, m.Sigma);
+	}
+
+	x = Filter.state();
+	sf.Airspeed = tmul(R, _V(x(0, 0), x(1, 0), x(2, 0)));
+	sf.SurfaceElevation = sf.Altitude - x(3, 0);
+}
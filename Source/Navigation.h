@@ -0,0 +1,53 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Navigation.h
+// Header file for the descent navigation filter, which estimates the
+// surface relative velocity and radar altitude from the radar models
+//
+// ==============================================================
+
+#pragma once
+
+#include "StateFrame.h"
+#include "Sensors.h"
+#include "FixedMatrix.h"
+
+// Filter states: surface relative velocity in the local horizon frame (east, up, north), then radar altitude
+const int NAV_STATES = 4;
+
+const double NAV_BODY_RADIUS = 1737400;    // Mean radius of the Moon, for gravity and the horizon frame curvature [m]
+const double NAV_INIT_VELOCITY_SIGMA = 1;  // Error of the initial velocity from ground tracking, one sigma [m/s]
+const double NAV_INIT_ALTITUDE_SIGMA = 1000; // Error of the initial altitude from ground tracking, one sigma [m]
+const double NAV_ACCEL_NOISE = 0.01;       // Unmodelled acceleration, one sigma [m/s^2]
+const double NAV_THRUST_NOISE = 0.03;      // Thrust uncertainty, fraction of the commanded thrust acceleration
+const double NAV_TERRAIN_SLOPE = 0.1;      // Terrain slope under the vessel, one sigma
+const double NAV_TERRAIN_TIME = 1;         // Time over which the terrain slope is correlated [s]
+const double NAV_GATE = 5;                 // Measurements further than this many sigmas from the estimate are rejected
+const double NAV_STEP_BUDGET = 2e-6;       // Wall time allowed for one navigation update [s]
+
+/* Surveyor's descent navigation. Each time step the radar models are sampled from the true state, and a linear
+   Kalman filter over the velocity in the local horizon frame and the radar altitude is advanced with the commanded
+   thrust and gravity, then updated with every beam that has a return: the AMR and RADVS altimeter ranges as height
+   measurements, the doppler beams as projections of the velocity. The filter starts from the true state with
+   ground tracking errors. Every matrix has fixed dimensions and is held by value, so an update makes no allocation. */
+class Navigation {
+public:
+	Navigation(void);
+	void reset(uint64_t seed);
+	void update(StateFrame& sf, VECTOR3 const& thrust, bool amr);
+	bool initialized() const { return Initialized; }
+	SensorReadings const& readings() const { return Readings; }
+	int rejected() const { return Rejected; }
+private:
+	void measure(Matrix<1, NAV_STATES> const& H, double z, double sigma);
+	DescentRadars Radars;                  // Radar beam models
+	SensorNoise Noise;                     // Radar and initial state noise
+	SensorReadings Readings;               // Radar samples of the last update
+	KalmanFilter<NAV_STATES> Filter;       // Velocity and radar altitude estimate
+	bool Initialized;                      // Filter has been started
+	double LastT;                          // Simulation time of the last update [s]
+	int Rejected;                          // Measurements rejected by the gate since reset
+};
@@ -0,0 +1,161 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Profiler.cpp
+// Latency histograms and Orbiter API call counters for the hot path.
+// The report is written to the Orbiter log.
+//
+// ==============================================================
+
+#include "Profiler.h"
+
+#ifdef SURVEYOR_PROFILE
+
+#include "orbitersdk.h"
+#include <cstdio>
+#include <cstring>
+
+static const char* ZoneNames[PROFILE_ZONES] = {
+	"clbkPreStep", "autopilotUpdate", "idleControl", "holdForRetroDescent",
+	"retroDescent", "finalDescent", "shutdown", "debug string sprintf"
+};
+
+static LatencyHistogram Zones[PROFILE_ZONES];        // One histogram per zone
+static std::atomic<ProfileCallSite*> CallSites(0);   // Head of the call site list
+
+LatencyHistogram::LatencyHistogram(void)
+// Latency histogram constructor
+{
+	reset();
+}
+
+void LatencyHistogram::record(unsigned long long ns)
+// Add one duration in nanoseconds
+{
+	int k = 0;
+	while (k < PROFILE_BUCKETS - 1 && (ns >> (k + 1)) != 0) k++;
+	Buckets[k].fetch_add(1, std::memory_order_relaxed);
+	Count.fetch_add(1, std::memory_order_relaxed);
+	Total.fetch_add(ns, std::memory_order_relaxed);
+
+	unsigned long long m = Max.load(std::memory_order_relaxed);
+	while (ns > m && !Max.compare_exchange_weak(m, ns, std::memory_order_relaxed));
+}
+
+unsigned long long LatencyHistogram::count() const
+// Number of recorded durations
+{
+	return Count.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+// Mean duration [ns]
+{
+	unsigned long long n = count();
+	return n ? (double)Total.load(std::memory_order_relaxed) / n : 0;
+}
+
+unsigned long long LatencyHistogram::percentile(double p) const
+// Upper edge of the bucket holding the p-th percentile [ns], capped at the maximum
+{
+	unsigned long long n = count();
+	if (n == 0) return 0;
+	unsigned long long rank = (unsigned long long)(p / 100 * n);
+	unsigned long long seen = 0;
+	for (int k = 0; k < PROFILE_BUCKETS; k++) {
+		seen += Buckets[k].load(std::memory_order_relaxed);
+		if (seen > rank) {
+			unsigned long long edge = k < PROFILE_BUCKETS - 1 ? (2ULL << k) : maximum();
+			return edge < maximum() ? edge : maximum();
+		}
+	}
+	return maximum();
+}
+
+unsigned long long LatencyHistogram::maximum() const
+// Longest recorded duration [ns]
+{
+	return Max.load(std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset()
+// Clear all counts
+{
+	Count.store(0, std::memory_order_relaxed);
+	Total.store(0, std::memory_order_relaxed);
+	Max.store(0, std::memory_order_relaxed);
+	for (int k = 0; k < PROFILE_BUCKETS; k++) Buckets[k].store(0, std::memory_order_relaxed);
+}
+
+ProfileCallSite::ProfileCallSite(const char* function, const char* file, int line)
+// Register a call site at the head of the global list
+{
+	Function = function;
+	const char* slash = strrchr(file, '/');
+	const char* backslash = strrchr(file, '\\');
+	if (backslash > slash) slash = backslash;
+	File = slash ? slash + 1 : file;
+	Line = line;
+	Count.store(0, std::memory_order_relaxed);
+	Next = CallSites.load(std::memory_order_relaxed);
+	while (!CallSites.compare_exchange_weak(Next, this, std::memory_order_release, std::memory_order_relaxed));
+}
+
+ProfileScope::~ProfileScope()
+// Record the time since construction
+{
+	std::chrono::nanoseconds ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start);
+	Zones[Zone].record((unsigned long long)ns.count());
+}
+
+LatencyHistogram& Profiler::zone(ProfileZone z)
+// Histogram of a zone
+{
+	return Zones[z];
+}
+
+void Profiler::report()
+// Write the latency and API call summary to the Orbiter log
+{
+	char line[256];
+	unsigned long long frames = Zones[PROFILE_PRESTEP].count();
+
+	sprintf(line, "Surveyor profile: %llu time steps", frames);
+	oapiWriteLog(line);
+	sprintf(line, "  %-24s %12s %10s %10s %10s %10s", "Zone [us]", "calls", "mean", "p50", "p99", "max");
+	oapiWriteLog(line);
+	for (int z = 0; z < PROFILE_ZONES; z++) {
+		LatencyHistogram const & h = Zones[z];
+		if (h.count() == 0) continue;
+		sprintf(line, "  %-24s %12llu %10.3f %10.3f %10.3f %10.3f", ZoneNames[z], h.count(),
+			h.mean() / 1000, h.percentile(50) / 1000.0, h.percentile(99) / 1000.0, h.maximum() / 1000.0);
+		oapiWriteLog(line);
+	}
+
+	sprintf(line, "  %-40s %12s %10s", "Orbiter API call site", "calls", "per step");
+	oapiWriteLog(line);
+	unsigned long long total = 0;
+	for (ProfileCallSite* s = CallSites.load(std::memory_order_acquire); s; s = s->Next) {
+		char site[128];
+		unsigned long long n = s->Count.load(std::memory_order_relaxed);
+		total += n;
+		sprintf(site, "%s (%s:%d)", s->Function, s->File, s->Line);
+		sprintf(line, "  %-40s %12llu %10.3f", site, n, frames ? (double)n / frames : 0.0);
+		oapiWriteLog(line);
+	}
+	sprintf(line, "  %-40s %12llu %10.3f", "Total", total, frames ? (double)total / frames : 0.0);
+	oapiWriteLog(line);
+}
+
+void Profiler::reset()
+// Clear all histograms and call counts
+{
+	for (int z = 0; z < PROFILE_ZONES; z++) Zones[z].reset();
+	for (ProfileCallSite* s = CallSites.load(std::memory_order_acquire); s; s = s->Next) {
+		s->Count.store(0, std::memory_order_relaxed);
+	}
+}
+
+#endif
@@ -0,0 +1,94 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Profiler.h
+// Header file for the hot path instrumentation. Defining
+// SURVEYOR_PROFILE enables latency histograms for the time step
+// callbacks and autopilot modes, and per call site counts of Orbiter
+// API calls. Without it the PROFILE_* macros expand to nothing.
+//
+// ==============================================================
+
+#pragma once
+
+#ifdef SURVEYOR_PROFILE
+
+#include <atomic>
+#include <chrono>
+
+// Instrumented code regions
+enum ProfileZone {
+	PROFILE_PRESTEP,        // Surveyor::clbkPreStep
+	PROFILE_AUTOPILOT,      // AutoPilot::autopilotUpdate
+	PROFILE_IDLE,           // AutoPilot::idleControl
+	PROFILE_HOLD_FOR_RETRO, // AutoPilot::holdForRetroDescent
+	PROFILE_RETRO_DESCENT,  // AutoPilot::retroDescent
+	PROFILE_FINAL_DESCENT,  // AutoPilot::finalDescent
+	PROFILE_SHUTDOWN,       // AutoPilot::shutdown
+	PROFILE_DEBUG_STRING,   // Formatting the autopilot debug string
+	PROFILE_ZONES
+};
+
+// Bucket k counts durations of [2^k, 2^(k+1)) ns; the last bucket also counts everything longer (about 8 ms and up)
+const int PROFILE_BUCKETS = 24;
+
+// Fixed-bucket latency histogram. Updates are relaxed atomic operations, so it can be shared by vessels
+// stepped on different threads without locks or allocation.
+class LatencyHistogram {
+public:
+	LatencyHistogram(void);
+	void record(unsigned long long ns);
+	unsigned long long count() const;
+	double mean() const;
+	unsigned long long percentile(double p) const;
+	unsigned long long maximum() const;
+	void reset();
+private:
+	std::atomic<unsigned long long> Count;
+	std::atomic<unsigned long long> Total;
+	std::atomic<unsigned long long> Max;
+	std::atomic<unsigned long long> Buckets[PROFILE_BUCKETS];
+};
+
+// Call counter for one Orbiter API call site. Each site is a function-local static that links itself into
+// a global list the first time it is reached, so no allocation is needed.
+struct ProfileCallSite {
+	ProfileCallSite(const char* function, const char* file, int line);
+	const char* Function;                 // Orbiter API function called
+	const char* File;                     // Source file of the call
+	int Line;                             // Source line of the call
+	std::atomic<unsigned long long> Count; // Number of calls
+	ProfileCallSite* Next;                // Next site in the global list
+};
+
+// Records the time spent in a scope into the histogram of a zone
+class ProfileScope {
+public:
+	explicit ProfileScope(ProfileZone zone) : Zone(zone), Start(std::chrono::steady_clock::now()) {}
+	~ProfileScope();
+private:
+	ProfileZone Zone;
+	std::chrono::steady_clock::time_point Start;
+};
+
+namespace Profiler {
+	LatencyHistogram& zone(ProfileZone z);
+	void report();
+	void reset();
+}
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(zone) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(zone)
+#define PROFILE_API(function) do { static ProfileCallSite site(function, __FILE__, __LINE__); site.Count.fetch_add(1, std::memory_order_relaxed); } while (0)
+#define PROFILE_REPORT() Profiler::report()
+
+#else
+
+#define PROFILE_SCOPE(zone)
+#define PROFILE_API(function)
+#define PROFILE_REPORT()
+
+#endif
@@ -0,0 +1,133 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// RequestWorker.h
+// Per-vessel request channels and the background thread that answers
+// them, shared by the trajectory predictor and the descent optimizer
+//
+// ==============================================================
+
+#pragma once
+
+#include "DoubleBuffer.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* One vessel's requests and results. The vessel writes requests with submit() and the autopilot reads results with
+   latest(); neither waits for the worker. serve() is called on the worker side only: it answers the latest request
+   if it has not been answered, and publishes the result. */
+template<class Request, class Result>
+class RequestChannel {
+public:
+	RequestChannel(void) : Done(0), Pending(false) {}
+	bool submit(Request const& in) { return Input.write(in); }
+	bool latest(Result& out) const { return Output.read(out) != 0; }
+
+	template<class F> bool serve(F answer)
+	// Answer the latest request with answer(request, result) if it has not been answered, and publish the result.
+	// Returns true if there was work: a request answered, or a result still waiting to be published.
+	{
+		Request in;
+		bool busy = false;
+		uint64_t request = Input.read(in);
+		if (request != 0 && request != Done) {
+			answer(in, Last);
+			Done = request;
+			Pending = true;
+			busy = true;
+		}
+		// The autopilot may be holding the back buffer; the result is then published on the next call
+		if (Pending && Output.write(Last)) Pending = false;
+		return busy || Pending;
+	}
+
+private:
+	RequestChannel(RequestChannel const&);
+	RequestChannel& operator=(RequestChannel const&);
+	DoubleBuffer<Request> Input;  // Latest request
+	DoubleBuffer<Result> Output;  // Latest result
+	uint64_t Done;                // Request the last result was computed from; worker only
+	bool Pending;                 // Result waiting to be published; worker only
+	Result Last;                  // Last result; worker only
+};
+
+/* Background thread serving registered channels. It repeatedly calls the serve function on every channel, and
+   sleeps for the poll period once a pass finds no work. add() and remove() wait for the request in progress. */
+template<class Channel>
+class RequestWorker {
+public:
+	typedef bool (*ServeFunction)(Channel& c);
+	RequestWorker(ServeFunction serve, double poll);
+	~RequestWorker();
+	void add(Channel* c);
+	void remove(Channel* c);
+private:
+	RequestWorker(RequestWorker const&);
+	RequestWorker& operator=(RequestWorker const&);
+	void workerLoop();
+	ServeFunction Serve;              // Answers a channel's latest request
+	double Poll;                      // Time the thread sleeps when no request is waiting [s]
+	std::mutex Lock;                  // Guards Channels and Stop, and is held while serving
+	std::condition_variable Wake;     // Signalled on stop
+	std::vector<Channel*> Channels;   // Registered vessels
+	bool Stop;                        // Set on destruction
+	std::thread Worker;               // Worker thread, started last
+};
+
+template<class Channel>
+RequestWorker<Channel>::RequestWorker(ServeFunction serve, double poll)
+	: Serve(serve), Poll(poll), Stop(false)
+// Start the worker thread
+{
+	Worker = std::thread(&RequestWorker::workerLoop, this);
+}
+
+template<class Channel>
+RequestWorker<Channel>::~RequestWorker()
+// Stop the worker thread
+{
+	{
+		std::lock_guard<std::mutex> lock(Lock);
+		Stop = true;
+	}
+	Wake.notify_one();
+	Worker.join();
+}
+
+template<class Channel>
+void RequestWorker<Channel>::add(Channel* c)
+// Register a vessel's channel
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	Channels.push_back(c);
+}
+
+template<class Channel>
+void RequestWorker<Channel>::remove(Channel* c)
+// Unregister a vessel's channel, once the request in progress is done
+{
+	std::lock_guard<std::mutex> lock(Lock);
+	for (size_t i = 0; i < Channels.size(); i++) {
+		if (Channels[i] != c) continue;
+		Channels[i] = Channels.back();
+		Channels.pop_back();
+		break;
+	}
+}
+
+template<class Channel>
+void RequestWorker<Channel>::workerLoop()
+// Worker thread: answer the latest request of each vessel, and sleep while there are none
+{
+	std::unique_lock<std::mutex> lock(Lock);
+	while (!Stop) {
+		bool busy = false;
+		for (size_t i = 0; i < Channels.size(); i++) busy = Serve(*Channels[i]) || busy;
+		if (!busy) Wake.wait_for(lock, std::chrono::duration<double>(Poll));
+	}
+}
@@ -0,0 +1,104 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Sensors.cpp
+// Descent radar models and their noise source
+//
+// ==============================================================
+
+#include "Sensors.h"
+
+static uint64_t rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+void SensorNoise::reseed(uint64_t seed)
+// Expand a seed into the generator state
+{
+	for (int i = 0; i < 4; i++) {
+		uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		S[i] = z ^ (z >> 31);
+	}
+}
+
+double SensorNoise::uniform()
+// Uniform on [0, 1)
+{
+	uint64_t r = rotl(S[1] * 5, 7) * 9;
+	uint64_t t = S[1] << 17;
+	S[2] ^= S[0];
+	S[3] ^= S[1];
+	S[1] ^= S[2];
+	S[0] ^= S[3];
+	S[2] ^= t;
+	S[3] = rotl(S[3], 45);
+	return (double)(r >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double SensorNoise::gaussian()
+// Standard normal, by the Box-Muller transform
+{
+	double u = 1 - uniform();
+	double v = uniform();
+	return sqrt(-2 * log(u)) * cos(2 * PI * v);
+}
+
+DescentRadars::DescentRadars(void)
+{
+	Boresight = _V(0, 0, -1);
+	CosAMRIncidence = cos(AMR_MAX_INCIDENCE);
+	CosRADVSIncidence = cos(RADVS_MAX_INCIDENCE);
+	for (int i = 0; i < 3; i++) {
+		// Velocity beams 120 degrees apart, the first in the plane of vernier 1
+		double phi = PI / 2 + i * 2 * PI / 3;
+		DopplerBeam[i] = _V(sin(RADVS_BEAM_CANT) * cos(phi), sin(RADVS_BEAM_CANT) * sin(phi), -cos(RADVS_BEAM_CANT));
+	}
+}
+
+bool DescentRadars::range(VECTOR3 const& beam, double radarAltitude, VECTOR3 const& up, double maxRange,
+	double cosMaxIncidence, RadarMeasurement& m) const
+// Slant range along a beam to the surface, and whether it is within the beam's reach
+{
+	m.Beam = beam;
+	m.Incidence = -dotp(beam, up);
+	m.Value = m.Incidence > 0 ? radarAltitude / m.Incidence : 0;
+	m.Valid = m.Incidence >= cosMaxIncidence && radarAltitude > 0 && m.Value <= maxRange;
+	return m.Valid;
+}
+
+void DescentRadars::sample(VECTOR3 const& airspeed, double radarAltitude, VECTOR3 const& up, bool amr,
+	SensorNoise& noise, SensorReadings& out) const
+// Sample every beam for the true velocity (vessel frame), radar altitude and local vertical (vessel frame). amr is
+// false once the AMR has been jettisoned. The noise draws per beam are fixed, so a beam dropping out does not
+// change the noise of the others.
+{
+	double gAmr = noise.gaussian();
+	if (range(Boresight, radarAltitude, up, AMR_MAX_RANGE, CosAMRIncidence, out.AMR) && amr) {
+		out.AMR.Sigma = AMR_RANGE_NOISE;
+		out.AMR.Value += out.AMR.Sigma * gAmr;
+	}
+	else out.AMR.Valid = false;
+
+	double gAlt = noise.gaussian(), dAlt = noise.uniform();
+	RadarMeasurement& alt = out.Altimeter;
+	if (range(Boresight, radarAltitude, up, RADVS_MAX_RANGE, CosRADVSIncidence, alt) && dAlt >= RADVS_DROPOUT) {
+		alt.Sigma = RADVS_RANGE_NOISE + RADVS_RANGE_SCALE_NOISE * alt.Value;
+		alt.Value += alt.Sigma * gAlt;
+	}
+	else alt.Valid = false;
+
+	for (int i = 0; i < 3; i++) {
+		double g = noise.gaussian(), d = noise.uniform();
+		RadarMeasurement& m = out.Doppler[i];
+		bool lock = range(DopplerBeam[i], radarAltitude, up, RADVS_MAX_RANGE, CosRADVSIncidence, m);
+		m.Value = dotp(airspeed, DopplerBeam[i]);
+		m.Sigma = RADVS_VELOCITY_NOISE + RADVS_VELOCITY_SCALE_NOISE * fabs(m.Value);
+		m.Value += m.Sigma * g;
+		m.Valid = lock && d >= RADVS_DROPOUT;
+	}
+}
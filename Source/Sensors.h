@@ -0,0 +1,73 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Sensors.h
+// Header file for the models of the descent radars: the altitude
+// marking radar (AMR) and the radar altimeter and doppler velocity
+// sensor (RADVS)
+//
+// ==============================================================
+
+#pragma once
+
+#include "SurveyorConstants.h"
+#include <cstdint>
+
+// Altitude marking radar, looking along the negative roll axis until it is jettisoned at retro ignition
+const double AMR_MAX_RANGE = 130000;       // Slant range at which the AMR acquires the surface [m]
+const double AMR_RANGE_NOISE = 200;        // Range noise, one sigma [m]
+const double AMR_MAX_INCIDENCE = 30 * RAD; // Largest beam angle from the local vertical with a usable return [rad]
+
+// RADVS: three doppler velocity beams around the negative roll axis, and an altimeter beam along it
+const double RADVS_BEAM_CANT = 25 * RAD;       // Velocity beam angle from the negative roll axis [rad]
+const double RADVS_MAX_RANGE = 15000;          // Slant range at which a beam locks on [m]
+const double RADVS_MAX_INCIDENCE = 60 * RAD;   // Largest beam angle from the local vertical with a usable return [rad]
+const double RADVS_VELOCITY_NOISE = 0.15;      // Velocity noise, one sigma [m/s]
+const double RADVS_VELOCITY_SCALE_NOISE = 0.01; // Velocity noise, fraction of the measured velocity
+const double RADVS_RANGE_NOISE = 1;            // Range noise, one sigma [m]
+const double RADVS_RANGE_SCALE_NOISE = 0.01;   // Range noise, fraction of the measured range
+const double RADVS_DROPOUT = 0.02;             // Chance of a locked beam missing one sample
+
+// Deterministic noise source, the same on every compiler (xoshiro256** with a splitmix64 seed expansion)
+class SensorNoise {
+public:
+	explicit SensorNoise(uint64_t seed = 1) { reseed(seed); }
+	void reseed(uint64_t seed);
+	double uniform();
+	double gaussian();
+private:
+	uint64_t S[4]; // Generator state
+};
+
+// One radar beam sample. Directions are in the vessel frame.
+struct RadarMeasurement {
+	bool Valid;      // The beam has a return this sample
+	VECTOR3 Beam;    // Unit beam direction, vessel frame
+	double Value;    // Slant range [m] or velocity along the beam, positive closing [m/s]
+	double Sigma;    // Noise standard deviation of Value
+	double Incidence; // Cosine of the beam angle from the local vertical
+};
+
+// All radar samples of one time step
+struct SensorReadings {
+	RadarMeasurement AMR;         // Altitude marking radar slant range
+	RadarMeasurement Doppler[3];  // RADVS velocity beams
+	RadarMeasurement Altimeter;   // RADVS slant range
+};
+
+// Beam geometry and noise of the descent radars. Returns are computed over a flat surface at the radar altitude.
+class DescentRadars {
+public:
+	DescentRadars(void);
+	void sample(VECTOR3 const& airspeed, double radarAltitude, VECTOR3 const& up, bool amr, SensorNoise& noise,
+		SensorReadings& out) const;
+private:
+	bool range(VECTOR3 const& beam, double radarAltitude, VECTOR3 const& up, double maxRange, double cosMaxIncidence,
+		RadarMeasurement& m) const;
+	VECTOR3 DopplerBeam[3];     // Velocity beam directions, vessel frame
+	VECTOR3 Boresight;          // AMR and altimeter beam direction, vessel frame
+	double CosAMRIncidence;     // cos(AMR_MAX_INCIDENCE)
+	double CosRADVSIncidence;   // cos(RADVS_MAX_INCIDENCE)
+};
@@ -0,0 +1,76 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Staging.cpp
+// Staging sequence detection and notification
+//
+// ==============================================================
+
+#include "Staging.h"
+
+// The vessel frame stays at the reference point the thrusters are placed about, so only the empty mass changes
+const MassProperties StagingMassProperties[STAGING_CONFIGURATIONS] = {
+	{ AMR_MASS + RETRO_EMPTY_MASS + LANDER_EMPTY_MASS, PB_PMI },
+	{ RETRO_EMPTY_MASS + LANDER_EMPTY_MASS, PB_PMI },
+	{ LANDER_EMPTY_MASS, PB_PMI }
+};
+
+// Retro propellant below which each configuration's next stage separates [kg]
+static const double SeparationThreshold[STAGING_CONFIGURATIONS] = {
+	STAGING_AMR_FRACTION * RETRO_PROP_MASS, STAGING_RETRO_EMPTY, -1
+};
+
+Staging::Staging(void)
+{
+	ObserverCount = 0;
+	reset(0);
+}
+
+void Staging::subscribe(StagingObserver* observer)
+// Notify observer of the separations from now on. Subscribing twice, or beyond STAGING_OBSERVERS, does nothing.
+{
+	for (int i = 0; i < ObserverCount; i++) if (Observers[i] == observer) return;
+	if (ObserverCount < STAGING_OBSERVERS) Observers[ObserverCount++] = observer;
+}
+
+void Staging::unsubscribe(StagingObserver* observer)
+// Stop notifying observer
+{
+	for (int i = 0; i < ObserverCount; i++) {
+		if (Observers[i] != observer) continue;
+		for (int j = i + 1; j < ObserverCount; j++) Observers[j - 1] = Observers[j];
+		ObserverCount--;
+		return;
+	}
+}
+
+void Staging::reset(int status)
+// Set the configuration, as when a vessel is created, loaded from a scenario or restored, without notifying
+{
+	Status = status >= 0 && status < STAGING_CONFIGURATIONS ? status : 0;
+	Threshold = SeparationThreshold[Status];
+}
+
+bool Staging::update(double propRetro)
+// Detect the separations the retro propellant mass implies, and notify the observers of each in turn.
+// Returns true if a stage separated.
+{
+	if (!(propRetro < Threshold)) return false;
+	int next = configuration(propRetro);
+	while (Status < next) {
+		reset(Status + 1);
+		for (int i = 0; i < ObserverCount; i++) Observers[i]->stagingChanged(Status, massProperties());
+	}
+	return true;
+}
+
+int Staging::configuration(double propRetro)
+// Configuration implied by the retro propellant mass: the AMR is attached until the retro is lit, and the retro
+// until its propellant is gone
+{
+	if (propRetro > SeparationThreshold[0]) return 0;
+	if (propRetro > SeparationThreshold[1]) return 1;
+	return 2;
+}
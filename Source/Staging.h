@@ -0,0 +1,56 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// Staging.h
+// Header file for the staging sequence and the mass properties of
+// each staging configuration
+//
+// ==============================================================
+
+#pragma once
+
+#include "SurveyorConstants.h"
+
+// Staging configurations, in the order the stages separate
+const int STAGING_CONFIGURATIONS = 3; // 0: retro and AMR attached, 1: AMR jettisoned, 2: retro jettisoned
+const double STAGING_AMR_FRACTION = 0.999; // The AMR goes once the retro has burnt this fraction of its propellant away
+const double STAGING_RETRO_EMPTY = 0.0001; // The retro goes once its propellant falls below this [kg]
+const int STAGING_OBSERVERS = 4;           // Observers a staging sequence can notify
+
+// Mass properties of a staging configuration
+struct MassProperties {
+	double EmptyMass;   // Empty mass [kg]
+	VECTOR3 PMI;        // Principal moments of inertia (mass-normalised) [m^2]
+};
+extern const MassProperties StagingMassProperties[STAGING_CONFIGURATIONS];
+
+// Receives the separations of a staging sequence
+class StagingObserver {
+public:
+	virtual ~StagingObserver() {}
+	// Called once for each separation, with the configuration entered and its mass properties
+	virtual void stagingChanged(int status, MassProperties const & mass) = 0;
+};
+
+/* Staging sequence of a Surveyor. The AMR separates when the retro is lit and the retro case when its propellant
+   is gone, each detected once from the retro propellant mass. The observers are notified of each separation as it
+   happens, in order, so nothing needs to poll the configuration or recompute its mass properties between
+   separations; a step with no separation costs one comparison. */
+class Staging {
+public:
+	Staging(void);
+	void subscribe(StagingObserver* observer);
+	void unsubscribe(StagingObserver* observer);
+	void reset(int status);
+	bool update(double propRetro);
+	int status() const { return Status; }
+	MassProperties const & massProperties() const { return StagingMassProperties[Status]; }
+	static int configuration(double propRetro);
+private:
+	int Status;                                  // Current configuration
+	double Threshold;                            // Retro propellant below which the next stage separates [kg]
+	StagingObserver* Observers[STAGING_OBSERVERS]; // Notified of each separation, in subscription order
+	int ObserverCount;                           // Number of observers
+};
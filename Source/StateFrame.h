@@ -0,0 +1,51 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// StateFrame.h
+// Header file defining the vessel state sampled once per time step
+//
+// ==============================================================
+
+#pragma once
+
+#include "SurveyorConstants.h"
+
+// Snapshot of the vessel state, sampled from Orbiter once at the start of each clbkPreStep and
+// passed to every autopilot mode, so no routine needs to query the simulator itself
+struct StateFrame {
+	double SimT;              // Simulation time [s]
+	double SimDT;             // Length of the time step [s]
+
+	// Surface relative velocity
+	VECTOR3 Airspeed;         // Velocity vector in the vessel frame [m/s]
+	double SpeedSq;           // Velocity magnitude squared [m^2/s^2]
+	double Speed;             // Velocity magnitude [m/s]
+	VECTOR3 AirspeedUnit;     // Unit velocity vector in the vessel frame (zero when at rest)
+	double LateralSpeed;      // Velocity magnitude normal to the roll axis [m/s]
+
+	// Rotation
+	VECTOR3 AngularVel;       // Angular velocity vector in the vessel frame [rad/s]
+	double AngularRate;       // Angular velocity magnitude [rad/s]
+
+	// Altitude
+	double Altitude;          // Altitude above mean radius [m]
+	double SurfaceElevation;  // Terrain elevation below the vessel [m]
+	double RadarAltitude;     // Radar altimeter: height above terrain [m]
+
+	// Mass
+	double PropVernier;       // Vernier propellant mass [kg]
+	double PropRCS;           // RCS propellant mass [kg]
+	double PropRetro;         // Retro propellant mass [kg]
+	double EmptyMass;         // Empty mass for the current staging [kg]
+	double Mass;              // Total mass [kg]
+
+	// Manual attitude input from the RCS thruster groups
+	double Pitch;             // Pitch up minus pitch down
+	double Yaw;               // Yaw right minus yaw left
+	double Roll;              // Bank right minus bank left
+
+	// Attitude, sampled only for the sensor models, the trajectory predictor or the descent optimizer
+	MATRIX3 Horizon;          // Vessel to local horizon frame rotation
+};
@@ -22,42 +22,150 @@
 #define ORBITER_MODULE
 
 #include "Surveyor.h"
+#include "AutoPilotManager.h"
+#include "TerrainService.h"
 #include <cstdlib>
+#include <cstring>
+
+// Attitude thruster groups and the RCS jets in each, in the order SampleState reads them
+struct RcsGroup {
+	THGROUP_TYPE Group;
+	int Count;
+	int Jets[2];
+};
+static const RcsGroup RcsGroups[6] = {
+	{ THGROUP_ATT_PITCHUP, 2, { 2, 4 } },
+	{ THGROUP_ATT_PITCHDOWN, 2, { 3, 5 } },
+	{ THGROUP_ATT_YAWRIGHT, 2, { 3, 4 } },
+	{ THGROUP_ATT_YAWLEFT, 2, { 2, 5 } },
+	{ THGROUP_ATT_BANKRIGHT, 1, { 0 } },
+	{ THGROUP_ATT_BANKLEFT, 1, { 1 } }
+};
 
 // ==============================================================
 // Shuttle-PB class interface
 // ==============================================================
 
-// Propelant resource handles
-PROPELLANT_HANDLE ph_vernier, ph_rcs, ph_retro;
-
 Surveyor::Surveyor(OBJHANDLE hVessel, int flightmodel)
-	: VESSEL3(hVessel, flightmodel)
+	: VESSEL3(hVessel, flightmodel), FrameValid(false), Manager(&AutoPilotManager::current()), Terrain(0),
+	TrackT(0), TrackLng(0), TrackLat(0), HaveTrack(false), UseSensors(false), UsePredictor(false), PredictT(0),
+	UseOptimizer(false), DescentT(0), UseTelemetry(false), UseTerrain(false)
 {
+	memset(&Commanded, 0, sizeof(Commanded));
+	Manager->add(this);
+	Stages.subscribe(this);
 }
 
 Surveyor::~Surveyor()
 {
+	SetController(false);
+	SetPredictor(false);
+	SetOptimizer(false);
+	Manager->remove(this);
 }
 
 // ==============================================================
 // Overloaded callback functions
 // ==============================================================
 
+// --------------------------------------------------------------
+// Start the flight telemetry file and the live telemetry bus once the vessel has its name, and attach the terrain
+// cache of the body it was placed on
+// --------------------------------------------------------------
+void Surveyor::clbkPostCreation()
+{
+	char path[256];
+	PROFILE_API("GetName");
+	if (UseTelemetry) {
+		sprintf(path, "%s/%.200s.tlm", TELEMETRY_DIRECTORY, GetName());
+		Telemetry.open(path, GetName());
+	}
+	Bus.open(GetName());
+	if (UseTerrain) {
+		PROFILE_API("GetSurfaceRef");
+		SetTerrain(Manager->terrain(GetSurfaceRef()));
+	}
+}
+
+// --------------------------------------------------------------
+// Save the staging status and the autopilot state with the scenario
+// --------------------------------------------------------------
+void Surveyor::clbkSaveState(FILEHANDLE scn)
+{
+	VESSEL3::clbkSaveState(scn);
+	oapiWriteScenario_int(scn, "STAGING", Stages.status());
+	std::unique_lock<std::mutex> hold = PauseController();
+	AutoFlight.saveState(scn);
+}
+
+// --------------------------------------------------------------
+// Read the staging status and autopilot state saved with the scenario. Orbiter calls this after clbkSetClassCaps,
+// so a flight saved mid-descent resumes with the stages it had, in the mode it was in.
+// --------------------------------------------------------------
+void Surveyor::clbkLoadStateEx(FILEHANDLE scn, void* vs)
+{
+	std::unique_lock<std::mutex> hold = PauseController();
+	char* line;
+	while (oapiReadScenario_nextline(scn, line)) {
+		int s;
+		if (sscanf(line, "STAGING %d", &s) == 1) {
+			if (s >= 0 && s < STAGING_CONFIGURATIONS) Stages.reset(s);
+		}
+		else if (!AutoFlight.loadStateLine(line)) ParseScenarioLineEx(line, vs);
+	}
+	SetupMeshes();
+	ApplyMassProperties(Stages.massProperties());
+
+	// Send the saved vernier commands with the first time step, until the autopilot's first update replaces them
+	AutoFlight.setVernierThrusters(this);
+	if (Controller) TakeAutoPilotCommands();
+}
+
+// --------------------------------------------------------------
+// Final descent guidance table, shared by all Surveyors. It is mapped on first use and stays mapped until the
+// module is unloaded. Returns null if Config/Surveyor/FinalDescent.gdt is missing or unreadable.
+// --------------------------------------------------------------
+static GuidanceTable const* FinalDescentGuidance()
+{
+	static GuidanceTable table;
+	static bool loaded = table.open("Config/Surveyor/FinalDescent.gdt");
+	return loaded ? &table : 0;
+}
+
 // --------------------------------------------------------------
 // Set the capabilities of the vessel class
 // --------------------------------------------------------------
 void Surveyor::clbkSetClassCaps(FILEHANDLE cfg)
 {
-	// Initialize status
-	status = 0;
+	// Initialize staging
+	SetController(false);
+	Stages.reset(0);
 
-	// Initialize autopilot
+	// Initialize autopilot, with tuned gains and thresholds and the feature switches if a parameter file is present.
+	// Sensors, Predictor (which PredictedIgnition also needs) and ConvexDescent start their features here,
+	// RealTimeController once the thrusters are set up, and Telemetry and Terrain once the vessel is placed.
 	AutoFlight = AutoPilot();
+	Scheduler.reset();
+	AutoPilotParams params;
+	AutoPilotOptions options;
+	FILEHANDLE apcfg = oapiOpenFile("Surveyor/AutoPilot.cfg", FILE_IN_ZEROONFAIL, CONFIG);
+	if (apcfg) {
+		params.read(apcfg);
+		options.read(apcfg);
+		oapiCloseFile(apcfg, FILE_IN);
+	}
+	AutoFlight.setParams(params);
+	AutoFlight.setOptions(options);
+	AutoFlight.setGuidance(FinalDescentGuidance());
+	SetSensors(options.Sensors != 0);
+	SetPredictor(options.Predictor != 0 || options.PredictedIgnition != 0);
+	SetOptimizer(options.ConvexDescent != 0);
+	UseTelemetry = options.Telemetry != 0;
+	UseTerrain = options.Terrain != 0;
 
 	// physical vessel parameters
 	SetSize(PB_SIZE);
-	SetPMI(PB_PMI);
+	ApplyMassProperties(Stages.massProperties());
 	SetCrossSections(PB_CS);
 	SetRotDrag(PB_RD);
 	SetTouchdownPoints(_V(0, LEG_RAD, LEG_STA), _V(sqrt(3.0) / 2 * LEG_RAD, -0.5 * LEG_RAD, LEG_STA), _V(-sqrt(3.0) / 2 * LEG_RAD, -0.5 * LEG_RAD, LEG_STA));
@@ -72,14 +180,20 @@ void Surveyor::clbkSetClassCaps(FILEHANDLE cfg)
 	AddExhaust(th_retro, 2, 0.3);
 
 	// Vernier engines
-	th_vernier[0] = CreateThruster(_V(0.0 * VERNIER_RAD, 1.0 * VERNIER_RAD, VERNIER_STA), _V(0, 0, 1), VERNIER_THRUST, ph_vernier, VERNIER_ISP);
-	th_vernier[1] = CreateThruster(_V(sqrt(3.0) / 2 * VERNIER_RAD, -0.5 * VERNIER_RAD, VERNIER_STA), _V(0, 0, 1), VERNIER_THRUST, ph_vernier, VERNIER_ISP);
-	th_vernier[2] = CreateThruster(_V(-sqrt(3.0) / 2 * VERNIER_RAD, -0.5 * VERNIER_RAD, VERNIER_STA), _V(0, 0, 1), VERNIER_THRUST, ph_vernier, VERNIER_ISP);
+	th_vernier[0] = CreateThruster(VERNIER_POS[0], _V(0, 0, 1), VERNIER_THRUST, ph_vernier, VERNIER_ISP);
+	th_vernier[1] = CreateThruster(VERNIER_POS[1], _V(0, 0, 1), VERNIER_THRUST, ph_vernier, VERNIER_ISP);
+	th_vernier[2] = CreateThruster(VERNIER_POS[2], _V(0, 0, 1), VERNIER_THRUST, ph_vernier, VERNIER_ISP);
 	CreateThrusterGroup(th_vernier, 3, THGROUP_MAIN);
 	for (int i = 0; i < 3; i++) {
 		AddExhaust(th_vernier[i], 1, 0.1);
 	}
 
+	// The autopilot reads back its own commands, and must not call Orbiter to do so
+	Actuators.track(this, th_retro);
+	for (int i = 0; i < 3; i++) {
+		Actuators.track(this, th_vernier[i]);
+	}
+
 	// Set surface friction coefficients
 	SetSurfaceFrictionCoeff(5, 5);
 
@@ -95,98 +209,543 @@ void Surveyor::clbkSetClassCaps(FILEHANDLE cfg)
 	th_rcs[4] = CreateThruster(_V(-sqrt(3.0) / 2 * RCS_RAD, -0.5 * RCS_RAD, RCS_STA - RCS_SPACE), _V(0, 0, 1), RCS_THRUST, ph_rcs, RCS_ISP);
 	th_rcs[5] = CreateThruster(_V(-sqrt(3.0) / 2 * RCS_RAD, -0.5 * RCS_RAD, RCS_STA + RCS_SPACE), _V(0, 0, -1), RCS_THRUST, ph_rcs, RCS_ISP);
 
-	// Thruster group for attitude pitch down
-	th_group[0] = th_rcs[3];
-	th_group[1] = th_rcs[5];
-	CreateThrusterGroup(th_group, 2, THGROUP_ATT_PITCHDOWN);
-
-	// Thruster group for attitude pitch up
-	th_group[0] = th_rcs[2];
-	th_group[1] = th_rcs[4];
-	CreateThrusterGroup(th_group, 2, THGROUP_ATT_PITCHUP);
-
-	// Thruster group for attitude roll right
-	th_group[0] = th_rcs[0];
-	CreateThrusterGroup(th_group, 1, THGROUP_ATT_BANKRIGHT);
-
-	// Thruster group for attitude roll left
-	th_group[0] = th_rcs[1];
-	CreateThrusterGroup(th_group, 1, THGROUP_ATT_BANKLEFT);
-
-	// Thruster group for attitude yaw right
-	th_group[0] = th_rcs[3];
-	th_group[1] = th_rcs[4];
-	CreateThrusterGroup(th_group, 2, THGROUP_ATT_YAWRIGHT);
-
-	// Thruster group for attitude yaw left
-	th_group[0] = th_rcs[2];
-	th_group[1] = th_rcs[5];
-	CreateThrusterGroup(th_group, 2, THGROUP_ATT_YAWLEFT);
+	// Thruster groups for attitude pitch, yaw and roll
+	for (int g = 0; g < 6; g++) {
+		for (int j = 0; j < RcsGroups[g].Count; j++) th_group[j] = th_rcs[RcsGroups[g].Jets[j]];
+		CreateThrusterGroup(th_group, RcsGroups[g].Count, RcsGroups[g].Group);
+	}
 
 	// Add exhaust parameters for each RCS thruster
 	for (int i = 0; i < 6; i++) {
 		AddExhaust(th_rcs[i], 0.1, 0.05);
 	}
 
+	// Under control allocation the autopilot reads back its RCS commands too
+	for (int i = 0; i < 6; i++) {
+		Actuators.track(this, th_rcs[i]);
+	}
+
 	// camera parameters
 	SetCameraOffset(_V(0, 0.8, 0));
 
 	// associate a mesh for the visual
 	SetupMeshes();
+
+	SetController(options.RealTimeController != 0);
 }
 
 void Surveyor::clbkPreStep(double SimT, double SimDT, double MJD) {
+	PROFILE_SCOPE(PROFILE_PRESTEP);
+
+	// Run the autopilot for this time step, in the batch of all Surveyors if it has not already run
+	Manager->preStep(this, SimT, SimDT);
+
+	// Or take the commands the real-time controller thread made since the last time step
+	if (Controller) ApplyControllerCommands();
+
+	// Send the thruster commands that changed during this time step
+	Sent().flush(this);
+
+	// Record the step, and publish it to monitors
+	if (Telemetry.isOpen()) RecordTelemetry();
+	if (Bus.isOpen()) PublishTelemetry();
+}
+
+void Surveyor::PrepareStep(double SimT, double SimDT, bool debugOutput) {
+	// Everything in a time step that calls Orbiter before the autopilot runs. The autopilot manager calls this
+	// on the simulation thread for every vessel, and may then run the autopilots on worker threads.
+
+	// Sample the vessel state once for this time step
+	SampleState(Frame, SimT, SimDT);
+	FrameValid = true;
+
+	// Steer the verniers by the manual input
+	SetManualDirs(Sent(), Frame);
 
-	// Get commanded roll, pitch, and yaw
-	double P, Y, R;
-	P = GetThrusterGroupLevel(THGROUP_ATT_PITCHUP) - GetThrusterGroupLevel(THGROUP_ATT_PITCHDOWN);
-	Y = GetThrusterGroupLevel(THGROUP_ATT_YAWRIGHT) - GetThrusterGroupLevel(THGROUP_ATT_YAWLEFT);
-	R = GetThrusterGroupLevel(THGROUP_ATT_BANKRIGHT) - GetThrusterGroupLevel(THGROUP_ATT_BANKLEFT);
+	// The controller thread does not call Orbiter, so it writes no debug string
+	if (!Controller) AutoFlight.setDebugOutput(debugOutput);
 
-	// Print the commanded roll, pitch, and yaw for debugging purposes
-	//sprintf(oapiDebugString(), "Pitch %f Yaw %f Roll %f", P, Y, R);
+	// Build the control allocator when control allocation is first enabled. Separations rebuild it.
+	if (AutoFlight.getOptions().ControlAllocation != 0 && !AutoFlight.getAllocator().configured()) ConfigureAllocator();
 
+	// Hand the state to the trajectory predictor every PREDICT_INTERVAL
+	if (UsePredictor && SimT >= PredictT + PREDICT_INTERVAL) SubmitPrediction(SimT);
+
+	// Hand the state to the descent optimizer every DESCENT_INTERVAL through the final descent
+	if (AutoFlight.getOptions().ConvexDescent != 0 && GetAutoPilotMode() == FINAL_DESCENT && SimT >= DescentT + DESCENT_INTERVAL)
+		SubmitDescent(SimT);
+
+	// And to the real-time controller thread, with the rate simulated time runs at
+	if (Controller) Controller->submit(Frame, Stages.status(), oapiGetTimeAcceleration());
+}
+
+void Surveyor::SetManualDirs(ActuatorBuffer& out, StateFrame const & sf) const {
 	// Define the thrust vector based on the commanded roll, pitch, and yaw
-	SetThrusterDir(th_vernier[0], _V(0.087 * R, 0, 1));
-	SetThrusterDir(th_vernier[1], _V(0, 0, 1.0 + 0.05 * (P - Y)));
-	SetThrusterDir(th_vernier[2], _V(0, 0, 1.0 + 0.05 * (P + Y)));
 
-	// Set empty mass
-	SetEmptyMass(CalcEmptyMass());
+	double P = sf.Pitch, Y = sf.Yaw, R = sf.Roll;
+	out.setDir(th_vernier[0], _V(0.087 * R, 0, 1));
+	out.setDir(th_vernier[1], _V(0, 0, 1.0 + 0.05 * (P - Y)));
+	out.setDir(th_vernier[2], _V(0, 0, 1.0 + 0.05 * (P + Y)));
+}
+
+void Surveyor::SetController(bool enable) {
+	// Start or stop the real-time controller thread. While it runs it flies the autopilot on Actuators, and each time
+	// step sends its latest commands through Thrusters. Stopping it hands the autopilot back to the time steps.
+
+	if (enable == (Controller != 0)) return;
+	if (enable) {
+		AutoFlight.setDebugOutput(false);
+		Thrusters = Actuators;
+		Controller.reset(new ControllerThread(this, AutoFlight));
+		std::unique_lock<std::mutex> hold = PauseController();
+		TakeAutoPilotCommands();
+	}
+	else {
+		Controller.reset();
+		Actuators = Thrusters;
+		Scheduler.reset();
+	}
+}
+
+std::unique_lock<std::mutex> Surveyor::PauseController() const {
+	// Hold the real-time controller thread between ticks while the simulation thread changes the autopilot, its
+	// actuator buffer or the navigation filter. Holds nothing if the thread is not running.
+
+	if (!Controller) return std::unique_lock<std::mutex>();
+	return std::unique_lock<std::mutex>(Controller->lock());
+}
+
+void Surveyor::ApplyControllerCommands() {
+	// Send the commands of the controller thread's latest tick, if this time step has not sent them already. Between
+	// ticks the thrusters hold their commands, or whatever the simulation thread has set since.
+
+	if (Controller->latest(Commanded)) SendCommanded();
+}
+
+void Surveyor::SendCommanded() {
+	// Write the commands in Commanded to the thruster commands sent with this time step
+
+	ScheduledCommands const & c = Commanded.Commands;
+	for (int i = 0; i < 3; i++) Thrusters.setLevel(th_vernier[i], c.Vernier[i]);
+	Thrusters.setDir(th_vernier[0], c.Vernier1Dir);
+	Thrusters.setLevel(th_retro, c.Retro);
+	if (Commanded.Rcs) {
+		for (int i = 0; i < 6; i++) Thrusters.setLevel(th_rcs[i], c.Rcs[i]);
+	}
+}
+
+void Surveyor::TakeAutoPilotCommands() {
+	// Send the commands and status the autopilot holds now, in place of the controller thread's last, after the
+	// simulation thread has set the autopilot's state. Called with the controller paused.
+
+	Commanded.Rcs = AutoFlight.getOptions().ControlAllocation != 0 && AutoFlight.getAllocator().configured();
+	ControlScheduler::getCommands(this, Commanded.Rcs, Commanded.Commands);
+	Commanded.Mode = AutoFlight.getMode();
+	Commanded.Timer = AutoFlight.getTimer();
+	Commanded.Alpha = AutoFlight.getAlpha();
+	SendCommanded();
+}
+
+void Surveyor::ControllerFrame(StateFrame& sf, int staging) {
+	// Complete a sensor frame on the controller thread, as RunAutoPilot does: the manual vernier directions, which the
+	// autopilot reads back, then the navigation estimates. Must not call Orbiter.
+
+	SetManualDirs(Actuators, sf);
+	if (UseSensors) {
+		Nav.update(sf, CommandedThrust(sf), staging == 0);
+		CompleteState(sf);
+	}
+}
+
+void Surveyor::SetPredictor(bool enable) {
+	// Register or unregister this vessel with the trajectory predictor of its autopilot manager
+
+	if (enable == UsePredictor) return;
+	if (enable) Manager->predictor().add(&Predictions);
+	else Manager->predictor().remove(&Predictions);
+	UsePredictor = enable;
+	PredictT = -PREDICT_INTERVAL;
+}
+
+void Surveyor::SetOptimizer(bool enable) {
+	// Register or unregister this vessel with the descent optimizer of its autopilot manager. An unregistered vessel
+	// still makes requests under ConvexDescent, for a caller that serves them itself.
+
+	if (enable == UseOptimizer) return;
+	if (enable) Manager->optimizer().add(&Descents);
+	else Manager->optimizer().remove(&Descents);
+	UseOptimizer = enable;
+	DescentT = -DESCENT_INTERVAL;
+}
+
+void Surveyor::ConfigureAllocator() {
+	// Build the autopilot's control allocator from the thruster geometry Orbiter reports. Called on the simulation
+	// thread when the staging changes, rather than at every step, as the allocator caches its pseudo-inverses.
+
+	VECTOR3 vernierPos[3], rcsPos[ALLOCATOR_RCS], rcsDir[ALLOCATOR_RCS];
+	double rcsThrust[ALLOCATOR_RCS];
+	for (int i = 0; i < 3; i++) {
+		PROFILE_API("GetThrusterRef");
+		GetThrusterRef(th_vernier[i], vernierPos[i]);
+	}
+	PROFILE_API("GetThrusterMax0");
+	double vernierThrust = GetThrusterMax0(th_vernier[0]);
+	for (int i = 0; i < ALLOCATOR_RCS; i++) {
+		PROFILE_API("GetThrusterRef");
+		GetThrusterRef(th_rcs[i], rcsPos[i]);
+		PROFILE_API("GetThrusterDir");
+		GetThrusterDir(th_rcs[i], rcsDir[i]);
+		PROFILE_API("GetThrusterMax0");
+		rcsThrust[i] = GetThrusterMax0(th_rcs[i]);
+	}
+	ControlAllocator allocator;
+	allocator.configure(vernierPos, vernierThrust, rcsPos, rcsDir, rcsThrust, Stages.status());
+	std::unique_lock<std::mutex> hold = PauseController();
+	AutoFlight.setAllocator(allocator);
+}
 
-	if (status == 1 && GetPropellantMass(ph_retro) < 0.0001) {
-		//Jettison the spent main retro
-		Jettison();
+void Surveyor::SaveSnapshot(SurveyorSnapshot& s) const {
+	// Copy the state carried between time steps. Taken between time steps, it holds no unsent thruster commands; with
+	// the controller thread running, it holds the commands last sent.
+
+	std::unique_lock<std::mutex> hold = PauseController();
+	s.AutoFlight = AutoFlight;
+	s.Scheduler = Scheduler;
+	s.Actuators = Sent();
+	s.Frame = Frame;
+	s.FrameValid = FrameValid;
+	s.TrackT = TrackT;
+	s.TrackLng = TrackLng;
+	s.TrackLat = TrackLat;
+	s.HaveTrack = HaveTrack;
+	s.Nav = Nav;
+	s.UseSensors = UseSensors;
+	s.PredictT = PredictT;
+	s.DescentT = DescentT;
+	s.status = Stages.status();
+}
+
+void Surveyor::RestoreSnapshot(SurveyorSnapshot const& s) {
+	// Resume from a snapshot. The thruster handles in it must be this vessel's, as they are for headless vessels
+	// built the same way.
+
+	std::unique_lock<std::mutex> hold = PauseController();
+	AutoFlight = s.AutoFlight;
+	Scheduler = s.Scheduler;
+	Actuators = s.Actuators;
+	if (Controller) {
+		AutoFlight.setDebugOutput(false);
+		Thrusters = s.Actuators;
+		TakeAutoPilotCommands();
 	}
-	if (status == 0 && GetPropellantMass(ph_retro) < 0.999 * RETRO_PROP_MASS) {
-		//Jettison the AMR if the retro has started burning
-		Jettison();
-		//Relight the retro if needed
-		SetThrusterLevel(th_retro, 1);
+	Frame = s.Frame;
+	FrameValid = s.FrameValid;
+	TrackT = s.TrackT;
+	TrackLng = s.TrackLng;
+	TrackLat = s.TrackLat;
+	HaveTrack = s.HaveTrack;
+	Nav = s.Nav;
+	UseSensors = s.UseSensors;
+	PredictT = s.PredictT;
+	DescentT = s.DescentT;
+	if (Stages.status() != s.status) {
+		Stages.reset(s.status);
+		SetupMeshes();
+		ApplyMassProperties(Stages.massProperties());
 	}
+}
+
+void Surveyor::SubmitPrediction(double SimT) {
+	// Request a prediction. A request the predictor thread is still reading is dropped, and made again on the next step.
 
-	// Call autopilot update loop
-	AutoFlight.autopilotUpdate(this, SimT, SimDT);
+	PredictionInput in;
+	MakePredictionInput(in, SimT);
+	if (Predictions.submit(in)) PredictT = SimT;
 }
 
-double Surveyor::CalcEmptyMass() {
-	// Calculate vessel empty mass
+void Surveyor::MakePredictionInput(PredictionInput& in, double SimT) {
+	// Prediction request from the sampled state, the autopilot's mode and its plan
+
+	VECTOR3 v = mul(Frame.Horizon, Frame.Airspeed);
+	in.SimT = SimT;
+	in.Radius = PREDICT_BODY_RADIUS + Frame.Altitude;
+	in.SurfaceElevation = Frame.SurfaceElevation;
+	in.VerticalSpeed = v.y;
+	in.HorizontalSpeed = sqrt(v.x * v.x + v.z * v.z);
+	in.PropVernier = Frame.PropVernier;
+	in.PropRCS = Frame.PropRCS;
+	in.PropRetro = Frame.PropRetro;
+	in.Mode = GetAutoPilotMode();
+	in.ModeTime = GetAutoPilotTimer();
+	in.Params = AutoFlight.getParams();
+	in.Guidance = AutoFlight.getGuidance();
+}
+
+void Surveyor::SubmitDescent(double SimT) {
+	// Request a thrust profile. A request the optimizer is still reading is dropped, and made again on the next step.
 
-	double EmptyMass = 0;
-	if (GetPropellantMass(ph_retro) > 0.999 * RETRO_PROP_MASS) {
-		// If the retro tnruster has not been fired yet, the AMR is still attached - add it to the empty mass
-		EmptyMass += AMR_MASS;
+	DescentProblem in;
+	MakeDescentProblem(in, SimT);
+	if (Descents.submit(in)) DescentT = SimT;
+}
+
+void Surveyor::MakeDescentProblem(DescentProblem& in, double SimT) {
+	// Optimizer request from the sampled state, to the autopilot's final descent target: TerminalSpeed straight down
+	// at ShutdownAltitude. The thrust bounds are the verniers' between the rate loop's floor and ConvexMaxLevel.
+
+	AutoPilotParams const& p = AutoFlight.getParams();
+	double r = PREDICT_BODY_RADIUS + Frame.Altitude;
+	in.SimT = SimT;
+	in.Altitude = Frame.RadarAltitude;
+	in.Velocity = mul(Frame.Horizon, Frame.Airspeed);
+	in.Mass = Frame.Mass;
+	in.Propellant = Frame.PropVernier;
+	in.Gravity = PREDICT_BODY_MU / (r * r);
+	in.MinThrust = 3 * VERNIER_THRUST * DESCENT_MIN_LEVEL;
+	in.MaxThrust = 3 * VERNIER_THRUST * p.ConvexMaxLevel;
+	in.ReserveThrust = 3 * VERNIER_THRUST;
+	in.CosTilt = cos(p.ConvexTiltLimit);
+	in.ExhaustVelocity = VERNIER_ISP;
+	in.TargetAltitude = p.ShutdownAltitude;
+	in.TargetSpeed = p.TerminalSpeed;
+}
+
+void Surveyor::RunAutoPilot() {
+	// Run the autopilot loop updates falling in this time step. Reads only the sampled state and writes only the
+	// actuator buffer, so it is safe on a worker thread. The real-time controller thread, if running, runs them instead.
+
+	if (Controller) return;
+
+	// Replace the true velocity and radar altitude with the navigation estimates. Telemetry records the frame
+	// the autopilot flew on, so replays of the flight see the same inputs.
+	if (UseSensors) {
+		Nav.update(Frame, CommandedThrust(Frame), Stages.status() == 0);
+		CompleteState(Frame);
+	}
+
+	Scheduler.step(this, AutoFlight, Frame);
+}
+
+void Surveyor::SampleState(StateFrame& sf, double SimT, double SimDT) {
+	// Query each simulator quantity once, and derive the magnitudes and unit vectors used by the autopilot
+
+	sf.SimT = SimT;
+	sf.SimDT = SimDT;
+
+	// Surface relative velocity
+	PROFILE_API("GetAirspeedVector");
+	GetAirspeedVector(FRAME_LOCAL, sf.Airspeed);
+
+	// Angular velocity
+	PROFILE_API("GetAngularVel");
+	GetAngularVel(sf.AngularVel);
+
+	// Altitude above mean radius and terrain elevation
+	PROFILE_API("GetAltitude");
+	sf.Altitude = GetAltitude();
+	if (Terrain) {
+		double lng, lat, rad;
+		PROFILE_API("GetEquPos");
+		GetEquPos(lng, lat, rad);
+		sf.SurfaceElevation = Terrain->elevation(lng, lat);
+		PrefetchTerrain(SimT, lng, lat);
 	}
-	if (GetPropellantMass(ph_retro) > 0.0001) {
-		// If the retro thruster has propellant left, it means the retro thruster is still attached - add it to the empty mass
-		EmptyMass += RETRO_EMPTY_MASS;
+	else {
+		PROFILE_API("GetSurfaceElevation");
+		sf.SurfaceElevation = GetSurfaceElevation();
 	}
 
-	// Add lander empty mass to the total empty mass
-	EmptyMass += LANDER_EMPTY_MASS;
+	// Propellant
+	PROFILE_API("GetPropellantMass");
+	sf.PropVernier = GetPropellantMass(ph_vernier);
+	PROFILE_API("GetPropellantMass");
+	sf.PropRCS = GetPropellantMass(ph_rcs);
+	PROFILE_API("GetPropellantMass");
+	sf.PropRetro = GetPropellantMass(ph_retro);
+
+	// Thruster group levels. The throttle, the attitude keys and the joystick set the groups as well as the actuator
+	// buffer, which resends its commands to a group that moved. While the autopilot flies it commands the verniers
+	// every step, so it overrides the throttle.
+	PROFILE_API("GetThrusterGroupLevel");
+	Sent().checkGroup(th_vernier, 3, GetThrusterGroupLevel(THGROUP_MAIN));
+	double att[6];
+	for (int g = 0; g < 6; g++) {
+		PROFILE_API("GetThrusterGroupLevel");
+		att[g] = GetThrusterGroupLevel(RcsGroups[g].Group);
+	}
 
-	// Return the calculated empty mass
-	return EmptyMass;
+	// Manual attitude input. Under control allocation the autopilot fires the RCS jets itself, so the group levels are
+	// its own commands, or the pilot's overridden by them.
+	if (AutoFlight.getOptions().ControlAllocation != 0) {
+		for (int g = 0; g < 6; g++) {
+			THRUSTER_HANDLE jets[2];
+			for (int j = 0; j < RcsGroups[g].Count; j++) jets[j] = th_rcs[RcsGroups[g].Jets[j]];
+			Sent().checkGroup(jets, RcsGroups[g].Count, att[g]);
+		}
+		sf.Pitch = 0;
+		sf.Yaw = 0;
+		sf.Roll = 0;
+	}
+	else {
+		sf.Pitch = att[0] - att[1];
+		sf.Yaw = att[2] - att[3];
+		sf.Roll = att[4] - att[5];
+	}
+
+	// Attitude relative to the local horizon, for the radar beam geometry, the predictor's velocity components and the
+	// descent optimizer's thrust profiles
+	if (UseSensors || UsePredictor || AutoFlight.getOptions().ConvexDescent != 0) {
+		VECTOR3 c[3];
+		for (int i = 0; i < 3; i++) {
+			PROFILE_API("HorizonRot");
+			HorizonRot(_V(i == 0, i == 1, i == 2), c[i]);
+		}
+		sf.Horizon = _M(c[0].x, c[1].x, c[2].x, c[0].y, c[1].y, c[2].y, c[0].z, c[1].z, c[2].z);
+	}
+
+	// Separate the stages whose time has come, so the mass is that of the configuration Orbiter flies this step. The
+	// staging observers, this vessel among them, are notified of each.
+	Stages.update(sf.PropRetro);
+	sf.EmptyMass = Stages.massProperties().EmptyMass;
+
+	CompleteState(sf);
+}
+
+VECTOR3 Surveyor::CommandedThrust(StateFrame const & sf) const {
+	// Thrust force of the commands in force over the last time step, vessel frame [N]. Read from the actuator buffer,
+	// so it does not call Orbiter. The retro delivers nothing once the propellant sampled in sf is gone.
+
+	VECTOR3 F = _V(0, 0, 0);
+	if (sf.PropRetro > 0) F.z = RETRO_THRUST * Actuators.getLevel(this, th_retro);
+	for (int i = 0; i < 3; i++) {
+		VECTOR3 dir;
+		Actuators.getDir(this, th_vernier[i], dir);
+		F += unit(dir) * (VERNIER_THRUST * Actuators.getLevel(this, th_vernier[i]));
+	}
+	return F;
+}
+
+void Surveyor::PrefetchTerrain(double SimT, double lng, double lat) {
+	// Ask the terrain service for the tiles ahead, about once a second, along the ground track since the last request
+
+	if (HaveTrack && SimT >= TrackT && SimT - TrackT < TERRAIN_PREFETCH_INTERVAL) return;
+	double lngRate = 0, latRate = 0;
+	if (HaveTrack && SimT > TrackT) {
+		double dlng = lng - TrackLng;
+		if (dlng > PI) dlng -= 2 * PI;
+		else if (dlng < -PI) dlng += 2 * PI;
+		lngRate = dlng / (SimT - TrackT);
+		latRate = (lat - TrackLat) / (SimT - TrackT);
+	}
+	Terrain->prefetch(lng, lat, lngRate, latRate);
+	TrackT = SimT;
+	TrackLng = lng;
+	TrackLat = lat;
+	HaveTrack = true;
+}
+
+void Surveyor::CompleteState(StateFrame& sf) {
+	// Derive the magnitudes, unit vectors and total mass from the sampled quantities and the empty mass of the frame's
+	// staging. Replay calls this with recorded values, so it must not query the simulator.
+
+	// Surface relative velocity
+	double LateralSq = pow(sf.Airspeed.x, 2) + pow(sf.Airspeed.y, 2);
+	sf.SpeedSq = LateralSq + pow(sf.Airspeed.z, 2);
+	sf.Speed = sqrt(sf.SpeedSq);
+	sf.LateralSpeed = sqrt(LateralSq);
+	if (sf.Speed > 0) {
+		sf.AirspeedUnit = { sf.Airspeed.x / sf.Speed, sf.Airspeed.y / sf.Speed, sf.Airspeed.z / sf.Speed };
+	}
+	else {
+		sf.AirspeedUnit = { 0, 0, 0 };
+	}
+
+	// Angular velocity
+	sf.AngularRate = sqrt(pow(sf.AngularVel.x, 2) + pow(sf.AngularVel.y, 2) + pow(sf.AngularVel.z, 2));
+
+	// Altitude above terrain
+	sf.RadarAltitude = sf.Altitude - sf.SurfaceElevation;
+
+	// Mass. The total is the empty mass for the current staging plus all propellant,
+	// which is what GetMass returns once SetEmptyMass has been applied for this step.
+	sf.Mass = sf.EmptyMass + sf.PropVernier + sf.PropRCS + sf.PropRetro;
+}
+
+void Surveyor::RecordTelemetry() {
+	// Append the sampled state and the thruster commands for this step to the telemetry file
+
+	double r[TLM_COLUMNS];
+	r[TLM_SIMT] = Frame.SimT;
+	r[TLM_SIMDT] = Frame.SimDT;
+	r[TLM_MODE] = GetAutoPilotMode();
+	r[TLM_ALTITUDE] = Frame.Altitude;
+	r[TLM_ELEVATION] = Frame.SurfaceElevation;
+	r[TLM_RADAR_ALTITUDE] = Frame.RadarAltitude;
+	r[TLM_VX] = Frame.Airspeed.x;
+	r[TLM_VY] = Frame.Airspeed.y;
+	r[TLM_VZ] = Frame.Airspeed.z;
+	r[TLM_WX] = Frame.AngularVel.x;
+	r[TLM_WY] = Frame.AngularVel.y;
+	r[TLM_WZ] = Frame.AngularVel.z;
+	r[TLM_ANGULAR_RATE] = Frame.AngularRate;
+	ActuatorBuffer const & sent = Sent();
+	r[TLM_VERNIER_1] = sent.getLevel(this, th_vernier[0]);
+	r[TLM_VERNIER_2] = sent.getLevel(this, th_vernier[1]);
+	r[TLM_VERNIER_3] = sent.getLevel(this, th_vernier[2]);
+	r[TLM_ALPHA] = GetAutoPilotAlpha();
+	r[TLM_RETRO] = sent.getLevel(this, th_retro);
+	r[TLM_PROP_VERNIER] = Frame.PropVernier;
+	r[TLM_PROP_RCS] = Frame.PropRCS;
+	r[TLM_PROP_RETRO] = Frame.PropRetro;
+	r[TLM_MASS] = Frame.Mass;
+	r[TLM_PITCH] = Frame.Pitch;
+	r[TLM_YAW] = Frame.Yaw;
+	r[TLM_ROLL] = Frame.Roll;
+	memcpy(&r[TLM_HORIZON_11], Frame.Horizon.data, sizeof(Frame.Horizon.data));
+	bool allocation = AutoFlight.getOptions().ControlAllocation != 0;
+	for (int i = 0; i < 6; i++) r[TLM_RCS_1 + i] = allocation ? sent.getLevel(this, th_rcs[i]) : 0;
+	Telemetry.record(r);
+}
+
+void Surveyor::PublishTelemetry() {
+	// Publish the state the autopilot flew on and its commands for this step to the telemetry bus. Only memory
+	// stores: the simulation thread never waits for a monitor.
+
+	TelemetryBusSample s;
+	s.SimT = Frame.SimT;
+	s.Altitude = Frame.Altitude;
+	s.RadarAltitude = Frame.RadarAltitude;
+	s.Velocity[0] = Frame.Airspeed.x;
+	s.Velocity[1] = Frame.Airspeed.y;
+	s.Velocity[2] = Frame.Airspeed.z;
+	s.Speed = Frame.Speed;
+	ActuatorBuffer const & sent = Sent();
+	for (int i = 0; i < 3; i++) s.Vernier[i] = sent.getLevel(this, th_vernier[i]);
+	s.Alpha = GetAutoPilotAlpha();
+	s.Retro = sent.getLevel(this, th_retro);
+	s.PropVernier = Frame.PropVernier;
+	s.PropRetro = Frame.PropRetro;
+	s.Mass = Frame.Mass;
+	s.Mode = GetAutoPilotMode();
+	s.Status = Stages.status();
+	Bus.publish(s);
+}
+
+double Surveyor::CalcEmptyMass(double RetroPropMass) {
+	// Vessel empty mass for the staging the remaining retro propellant implies. Replay and the trajectory predictor
+	// derive the mass from propellant this way, where there is no staging sequence to ask.
+
+	return StagingMassProperties[Staging::configuration(RetroPropMass)].EmptyMass;
+}
+
+void Surveyor::ApplyMassProperties(MassProperties const & mass) {
+	// Hand Orbiter the empty mass and moments of inertia of a staging configuration. Orbiter keeps them, so this is
+	// needed only when the configuration changes.
+
+	PROFILE_API("SetEmptyMass");
+	SetEmptyMass(mass.EmptyMass);
+	PROFILE_API("SetPMI");
+	SetPMI(mass.PMI);
 }
 
 int Surveyor::clbkConsumeBufferedKey(DWORD key, bool down, char* kstate) {
@@ -199,10 +758,13 @@ int Surveyor::clbkConsumeBufferedKey(DWORD key, bool down, char* kstate) {
 	}
 	else { // unmodified keys
 		switch (key) {
-		case OAPI_KEY_L:  // Fire Retro
-			SetThrusterLevel(th_retro, 1);
+		case OAPI_KEY_L: { // Fire Retro (sent with the next time step's thruster commands)
+			std::unique_lock<std::mutex> hold = PauseController();
+			Actuators.setLevel(th_retro, 1);
+			if (Controller) Thrusters.setLevel(th_retro, 1);
 			return 1;
 		}
+		}
 	}
 	return 0;
 }
@@ -212,62 +774,76 @@ void Surveyor::SpawnObject(char* classname, char* ext, VECTOR3 ofs) {
 
 	VESSELSTATUS vs;
 	char name[256];
+	PROFILE_API("GetStatus");
 	GetStatus(vs);
+	PROFILE_API("Local2Rel");
 	Local2Rel(ofs, vs.rpos);
 	vs.eng_main = 0;
 	vs.eng_hovr = 0.0;
 	vs.status = 0;
+	PROFILE_API("GetName");
 	strcpy(name, GetName());
 	strcat(name, ext);
+	PROFILE_API("oapiCreateVessel");
 	oapiCreateVessel(name, classname, vs);
 }
 
-void Surveyor::Jettison() {
-	// Jettison logic
+void Surveyor::stagingChanged(int status, MassProperties const & mass) {
+	// Jettison logic, called by the staging sequence on each separation
 	// status = 0 - Retro thruster and AMR are attached
 	// status = 1 - AMR is jettisoned
 	// status = 2 - Retro thruster is jettisoned
 
 	switch (status) {
-	case 0:
-		// Jettison AMR
-		status = 1;
+	case 1:
+		// Jettison the AMR once the retro has started burning, and relight the retro if needed
 		SpawnObject("Surveyor_AMR", "-AMR", _V(0, 0, -0.6));
-		SetupMeshes();
+		{
+			std::unique_lock<std::mutex> hold = PauseController();
+			Actuators.setLevel(th_retro, 1);
+			if (Controller) Thrusters.setLevel(th_retro, 1);
+		}
 		break;
-	case 1:
-		// Jettison retro thruster
-		status = 2;
+	case 2:
+		// Jettison the spent retro thruster
 		SpawnObject("Surveyor_Retro", "-Retro", _V(0, 0, -0.5));
-		SetupMeshes();
 		break;
 	}
+	SetupMeshes();
+	ApplyMassProperties(mass);
+
+	// The control allocator is rebuilt for each configuration
+	if (AutoFlight.getOptions().ControlAllocation != 0) ConfigureAllocator();
 }
 
 void Surveyor::AddLanderMesh() {
 	// Lander mesh
 
 	VECTOR3 ofs = _V(0, 0.3, 0);
+	PROFILE_API("AddMesh");
 	AddMesh("Surveyor-Lander", &ofs);
 }
 void Surveyor::AddRetroMesh() {
 	// Retro thruster mesh
 
 	VECTOR3 ofs = _V(0, 0, -0.5);
+	PROFILE_API("AddMesh");
 	AddMesh("Surveyor-Retro", &ofs);
 }
 void Surveyor::AddAMRMesh() {
 	// AMR mesh
 
 	VECTOR3 ofs = _V(0, 0, -0.6);
+	PROFILE_API("AddMesh");
 	AddMesh("Surveyor-AMR", &ofs);
 }
 
 void Surveyor::SetupMeshes() {
 	// Set up the meshes for the spacecraft stack
 
+	PROFILE_API("ClearMeshes");
 	ClearMeshes();
-	switch (status) {
+	switch (Stages.status()) {
 	case 0:
 		AddAMRMesh();
 	case 1:
@@ -292,3 +868,12 @@ DLLCLBK void ovcExit(VESSEL* vessel)
 {
 	if (vessel) delete (Surveyor*)vessel;
 }
+
+// --------------------------------------------------------------
+// Module cleanup
+// --------------------------------------------------------------
+DLLCLBK void ExitModule(HINSTANCE)
+{
+	// Write the hot path profile of all Surveyors to the Orbiter log once, if compiled in
+	PROFILE_REPORT();
+}
@@ -8,55 +8,213 @@
 //
 // ==============================================================
 
+#pragma once
+
 #include "SurveyorConstants.h"
+#include "AutoPilotModes.h"
+#include "StateFrame.h"
+#include "ActuatorBuffer.h"
+#include "Profiler.h"
+#include "TelemetryRecorder.h"
+#include "TelemetryBus.h"
+#include "AutoPilotParams.h"
+#include "AutoPilotOptions.h"
+#include "GuidanceTable.h"
+#include "ControlScheduler.h"
+#include "ControlAllocator.h"
+#include "AttitudeMath.h"
+#include "Navigation.h"
+#include "TrajectoryPredictor.h"
+#include "DescentOptimizer.h"
+#include "ControllerThread.h"
+#include "Staging.h"
+#include <memory>
+#include <mutex>
 
 class Surveyor;
-
-// Autopilot modes
-enum AutoPilotStatus { IDLE, HOLD_FOR_RETRO, RETRO_DESCENT, FINAL_DESCENT, SHUTDOWN };
+class AutoPilotManager;
+class TerrainService;
 
 // Autopilot class declaration
 class AutoPilot {
 public:
 	AutoPilot(void);
-	void vernierControl(Surveyor* sc, double const & thrustControl);
+	void vernierControl(Surveyor* sc, StateFrame const & sf, double const & thrustControl);
+	void vernierControl(Surveyor* sc, StateFrame const & sf, double const & thrustControl, VECTOR3 const & thrustDir);
+	bool profileThrust(Surveyor* sc, StateFrame const & sf, VECTOR3 & thrust) const;
 	void angularVelocityController(Surveyor* sc, VECTOR3 const omega_d, VECTOR3 const omega, double const & thrustLevel);
 	void updateTimer(double const dt);
-	void autopilotUpdate(Surveyor* sc, double const& SimT, double const & dt);
-	void idleControl(Surveyor* sc, double const & dt);
-	void holdForRetroDescent(Surveyor* sc);
-	void retroDescent(Surveyor* sc, double const & dt);
-	void finalDescent(Surveyor* sc);
-	void shutdown(Surveyor* sc);
-	double radarAltitude(Surveyor* sc);
+	bool timerReached(double const t) const;
+	void autopilotUpdate(Surveyor* sc, StateFrame const & sf);
+	void printDebugString(Surveyor* sc, StateFrame const & sf, char const* mode) const;
+	void idleControl(Surveyor* sc, StateFrame const & sf);
+	void holdForRetroDescent(Surveyor* sc, StateFrame const & sf);
+	void retroDescent(Surveyor* sc, StateFrame const & sf);
+	void finalDescent(Surveyor* sc, StateFrame const & sf);
+	void shutdown(Surveyor* sc, StateFrame const & sf);
 	void idleVernierThrusters(Surveyor* sc);
+	void setVernierThrusters(Surveyor* sc);
+	void rateLoopUpdate(Surveyor* sc, StateFrame const & sf);
+	AutoPilotStatus getMode() const;
+	double getTimer() const;
+	double getAlpha() const;
+	void setParams(AutoPilotParams const & params);
+	AutoPilotParams const & getParams() const;
+	void setOptions(AutoPilotOptions const & options);
+	AutoPilotOptions const & getOptions() const;
+	void setAllocator(ControlAllocator const & allocator);
+	ControlAllocator const & getAllocator() const;
+	void setGuidance(GuidanceTable const * table);
+	GuidanceTable const * getGuidance() const;
+	void setDebugOutput(bool enable);
+	void saveState(FILEHANDLE scn) const;
+	bool loadStateLine(char const* line);
 private:
+	// Mode sequencer (see AutoPilot.cpp). Each mode has optional entry and exit actions, an action run at each update,
+	// and the transitions out of it; only the current mode's guards are tested.
+	typedef void (AutoPilot::*ModeAction)(Surveyor* sc, StateFrame const & sf);
+	typedef bool (AutoPilot::*ModeGuard)(Surveyor* sc, StateFrame const & sf, double threshold) const;
+	struct ModeTransition {
+		ModeGuard Guard;                     // Predicate that takes the transition
+		double AutoPilotParams::* Threshold; // Parameter the guard tests against
+		bool Preempt;                        // Tested before the mode's action, which then does not run
+		AutoPilotStatus Next;                // Mode entered
+	};
+	struct ModeSpec {
+		ModeAction Entry;                    // Run on entering the mode, or null
+		ModeAction Action;                   // Run at each update in the mode
+		ModeAction Exit;                     // Run on leaving the mode, or null
+		bool Timed;                          // The mode timer runs in this mode
+		int First, Count;                    // Transitions out of the mode in ModeTransitions
+	};
+	static const ModeTransition ModeTransitions[];
+	static const ModeSpec ModeTable[AUTOPILOT_MODES];
+	bool takeTransition(Surveyor* sc, StateFrame const & sf, bool preempt);
+	bool timerGuard(Surveyor* sc, StateFrame const & sf, double t) const;
+	bool altitudeGuard(Surveyor* sc, StateFrame const & sf, double altitude) const;
+	bool retroIgnitionGuard(Surveyor* sc, StateFrame const & sf, double altitude) const;
+	void retroExit(Surveyor* sc, StateFrame const & sf);
+	void updateThresholds();
 	VECTOR3 VernierThrustLevel; // Throttle level for vernier engines
-	VECTOR3 Kp_w; // Proportional gain for angular velocity loop
-	double Kp_ang; // Proportional gain for angle error loop
-	double Alpha; // Thrust vector angle for vernier thruster 1 for roll control
+	double RcsLevel[ALLOCATOR_RCS]; // Throttle level for the RCS jets, under control allocation
+	ControlAllocator Allocator; // Spreads the moments over the verniers and RCS jets when ControlAllocation is on
+	AutoPilotParams Params; // Gains, limits and mode switching thresholds
+	AutoPilotOptions Options; // Switches of the optional features
+	GuidanceTable const * Guidance; // Final descent guidance table, or null
+	bool UseGuidance; // Guidance table is loaded and was solved for Params
+	double SinAlpha, CosAlpha; // Sine and cosine of the vernier thruster 1 thrust vector angle for roll control
+	double HalfDeadband; // sin(AngleDeadband / 2): attitude error deadband on the error quaternion
+	double HalfSaturation; // sin of half the attitude error at which the desired rate reaches RateLimit
+	double SinAlphaLimit; // sin(AlphaLimit)
+	VECTOR3 OmegaD; // Desired angular velocity from the last angle error loop update
+	double SteadyLevel; // Steady state vernier thrust level from the last guidance update
+	bool RateLoopActive; // Verniers are under angular velocity control, rather than idle
 	AutoPilotStatus Mode; // Autopilot mode
 	double Timer; // Timer used in switching autopilot modes
+	bool DebugOutput; // Write the mode and commands to the Orbiter debug string
+};
+
+// Autopilot, navigation and staging state a Surveyor carries between time steps, besides the state Orbiter keeps.
+// The headless harness copies it whole to fork descents from a checkpoint.
+struct SurveyorSnapshot {
+	AutoPilot AutoFlight;
+	ControlScheduler Scheduler;
+	ActuatorBuffer Actuators;
+	StateFrame Frame;
+	bool FrameValid;
+	double TrackT, TrackLng, TrackLat;
+	bool HaveTrack;
+	Navigation Nav;
+	bool UseSensors;
+	double PredictT;
+	double DescentT;
+	int status;
 };
 
 // Surveyor class declaration
-class Surveyor : public VESSEL3 {
+class Surveyor : public VESSEL3, public StagingObserver {
 public:
 	Surveyor(OBJHANDLE hVessel, int flightmodel);
 	~Surveyor();
 	void clbkSetClassCaps(FILEHANDLE cfg);
+	void clbkPostCreation();
+	void clbkSaveState(FILEHANDLE scn);
+	void clbkLoadStateEx(FILEHANDLE scn, void* vs);
 	void clbkPreStep(double SimT, double SimDT, double MJD);
-	double CalcEmptyMass();
+	void SampleState(StateFrame& sf, double SimT, double SimDT);
+	void PrepareStep(double SimT, double SimDT, bool debugOutput);
+	void RunAutoPilot();
+	bool AutoPilotDone(double SimT) const { return FrameValid && Frame.SimT == SimT; }
+	void PrefetchTerrain(double SimT, double lng, double lat);
+	void CompleteState(StateFrame& sf);
+	static double CalcEmptyMass(double RetroPropMass);
 	int clbkConsumeBufferedKey(DWORD key, bool down, char* kstate);
 	void SpawnObject(char* classname, char* ext, VECTOR3 ofs);
-	void Jettison();
+	void stagingChanged(int status, MassProperties const & mass);
+	void ApplyMassProperties(MassProperties const & mass);
 	void SetupMeshes();
+	void SetAutoPilotParams(AutoPilotParams const & params) { std::unique_lock<std::mutex> hold = PauseController(); AutoFlight.setParams(params); }
+	void SetAutoPilotOptions(AutoPilotOptions const & options) { std::unique_lock<std::mutex> hold = PauseController(); AutoFlight.setOptions(options); }
+	void SetTerrain(TerrainService* terrain) { Terrain = terrain; HaveTrack = false; }
+	void SetSensors(bool enable, uint64_t seed = 1) { std::unique_lock<std::mutex> hold = PauseController(); UseSensors = enable; Nav.reset(seed); }
+	void SetPredictor(bool enable);
+	void SetOptimizer(bool enable);
+	void SetController(bool enable);
+	void ControllerFrame(StateFrame& sf, int staging);
+	void ConfigureAllocator();
+	void SaveSnapshot(SurveyorSnapshot& s) const;
+	void RestoreSnapshot(SurveyorSnapshot const& s);
+	void SubmitPrediction(double SimT);
+	void MakePredictionInput(PredictionInput& in, double SimT);
+	void SubmitDescent(double SimT);
+	void MakeDescentProblem(DescentProblem& in, double SimT);
+	VECTOR3 CommandedThrust(StateFrame const & sf) const;
+	void SetManualDirs(ActuatorBuffer& out, StateFrame const & sf) const;
 	void AddLanderMesh();
 	void AddRetroMesh();
 	void AddAMRMesh();
+	void RecordTelemetry();
+	void PublishTelemetry();
 
 	THRUSTER_HANDLE th_vernier[3], th_retro, th_rcs[6], th_group[2];
+	PROPELLANT_HANDLE ph_vernier, ph_rcs, ph_retro; // Propellant resource handles
+	AutoPilot const & GetAutoPilot() const { return AutoFlight; }
+	AutoPilotStatus GetAutoPilotMode() const { return Controller ? Commanded.Mode : AutoFlight.getMode(); }
+	double GetAutoPilotTimer() const { return Controller ? Commanded.Timer : AutoFlight.getTimer(); }
+	double GetAutoPilotAlpha() const { return Controller ? Commanded.Alpha : AutoFlight.getAlpha(); }
+	ControllerThread const * GetController() const { return Controller.get(); }
+	int GetStagingStatus() const { return Stages.status(); }
+	ActuatorBuffer Actuators; // Thruster commands for the current time step, sent at the end of clbkPreStep. The
+	                          // real-time controller thread owns it while it runs.
+	TelemetryRecorder Telemetry; // Flight telemetry, recorded at the end of each clbkPreStep while open
+	TelemetryBus Bus; // Live telemetry for external monitors, published at the end of each clbkPreStep while open
+	PredictionChannel Predictions; // Trajectory predictions for the autopilot, from the manager's predictor thread
+	DescentChannel Descents; // Final descent thrust profiles for the autopilot, from the manager's descent optimizer
 private:
 	AutoPilot AutoFlight; // Autopilot
-	int status; // Vessel status to represent staging
+	ControlScheduler Scheduler; // Runs the autopilot loops at their fixed rates
+	StateFrame Frame; // Vessel state for the current time step, as the autopilot sees it
+	bool FrameValid; // Frame has been sampled
+	AutoPilotManager* Manager; // Runs this vessel's autopilot with those of the other Surveyors
+	TerrainService* Terrain; // Cached terrain elevation, or null to use Orbiter's surface elevation
+	double TrackT, TrackLng, TrackLat; // Time and position of the last terrain prefetch [s, rad, rad]
+	bool HaveTrack; // TrackT, TrackLng and TrackLat are set
+	Navigation Nav; // Radar models and navigation filter
+	bool UseSensors; // The autopilot flies on the navigation estimates rather than the true state
+	bool UsePredictor; // Predictions is registered with the manager's predictor
+	double PredictT; // Time of the last prediction request [s]
+	bool UseOptimizer; // Descents is registered with the manager's descent optimizer
+	double DescentT; // Time of the last descent optimizer request [s]
+	bool UseTelemetry; // The flight is recorded to TELEMETRY_DIRECTORY
+	bool UseTerrain; // The manager's terrain cache is attached once the vessel is placed
+	Staging Stages; // Staging configuration, notifying this vessel of each separation
+	std::unique_ptr<ControllerThread> Controller; // Real-time controller thread flying the autopilot, or null
+	ActuatorBuffer Thrusters; // Thruster commands sent at the end of clbkPreStep while the controller thread runs
+	ControllerOutput Commanded; // Latest commands and autopilot status of the controller thread
+	ActuatorBuffer& Sent() { return Controller ? Thrusters : Actuators; }
+	ActuatorBuffer const & Sent() const { return Controller ? Thrusters : Actuators; }
+	std::unique_lock<std::mutex> PauseController() const;
+	void ApplyControllerCommands();
+	void SendCommanded();
+	void TakeAutoPilotCommands();
 };
@@ -8,6 +8,8 @@
 //
 // ==============================================================
 
+#pragma once
+
 #include "orbitersdk.h"
 
 const double  PB_SIZE = 1.0;                // mean radius [m]
@@ -47,6 +49,11 @@ const double VERNIER_ISP = 3200;
 const double VERNIER_THRUST = 463;
 const double VERNIER_RAD = 0.86 - 0.28;
 const double VERNIER_STA = -0.5;
+const VECTOR3 VERNIER_POS[3] = {     // Vernier thruster positions, vessel frame
+	{ 0.0 * VERNIER_RAD, 1.0 * VERNIER_RAD, VERNIER_STA },
+	{ sqrt(3.0) / 2 * VERNIER_RAD, -0.5 * VERNIER_RAD, VERNIER_STA },
+	{ -sqrt(3.0) / 2 * VERNIER_RAD, -0.5 * VERNIER_RAD, VERNIER_STA }
+};
 
 // Define impact convex hull
 static const DWORD ntdvtx = 12;
@@ -0,0 +1,76 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryBus.cpp
+// Writer of the live telemetry bus
+//
+// ==============================================================
+
+#include "TelemetryBus.h"
+#include <cstring>
+
+TelemetryBus::TelemetryBus(void) : Slots(0), Next(0)
+// Telemetry bus constructor
+{
+}
+
+TelemetryBus::~TelemetryBus()
+// Telemetry bus destructor
+{
+	close();
+}
+
+bool TelemetryBus::open(const char* vessel)
+// Create the bus for a vessel, replacing any bus left under its name
+{
+	close();
+	char name[64];
+	TelemetryBusName(vessel, name, sizeof(name));
+	if (!Memory.createShared(name, TBUS_BYTES)) return false;
+
+	// Windows hands back the existing section, with the last run's counters, while a monitor still maps it. Withdraw
+	// the header and clear the published count and every slot sequence, so no reader takes an old sample for a new one.
+	TelemetryBusHeader* h = header();
+	h->Version.store(0, std::memory_order_relaxed);
+	h->Live.store(0, std::memory_order_relaxed);
+	h->Published.store(0, std::memory_order_relaxed);
+	Slots = (TelemetryBusSlot*)(Memory.data() + sizeof(TelemetryBusHeader));
+	for (uint32_t i = 0; i < TBUS_SLOTS; i++) Slots[i].Sequence.store(0, std::memory_order_relaxed);
+
+	memcpy(h->Magic, TBUS_MAGIC, sizeof(h->Magic));
+	h->Slots = TBUS_SLOTS;
+	h->SlotBytes = sizeof(TelemetryBusSlot);
+	h->SampleBytes = sizeof(TelemetryBusSample);
+	strncpy(h->Vessel, vessel, sizeof(h->Vessel) - 1);
+	h->Live.store(1, std::memory_order_relaxed);
+	h->Version.store(TBUS_VERSION, std::memory_order_release);
+	Next = 0;
+	return true;
+}
+
+void TelemetryBus::close()
+// Tell readers the writer has gone, and release the shared memory. Readers keep their mapping until they close it.
+{
+	if (!isOpen()) return;
+	header()->Live.store(0, std::memory_order_release);
+	Memory.close();
+	Slots = 0;
+}
+
+void TelemetryBus::publish(TelemetryBusSample const& sample)
+// Write a sample to the next slot, overwriting the oldest one
+{
+	uint64_t n = Next++;
+	TelemetryBusSlot& slot = Slots[n & (TBUS_SLOTS - 1)];
+	uint64_t words[TBUS_SAMPLE_WORDS];
+	memcpy(words, &sample, sizeof(words));
+
+	// Mark the slot as being written before any of the sample is, and as holding sample n after all of it is
+	slot.Sequence.store(2 * n + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	for (uint32_t i = 0; i < TBUS_SAMPLE_WORDS; i++) slot.Words[i].store(words[i], std::memory_order_relaxed);
+	slot.Sequence.store(2 * n + 2, std::memory_order_release);
+	header()->Published.store(n + 1, std::memory_order_release);
+}
@@ -0,0 +1,34 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryBus.h
+// Header file for the writer of the live telemetry bus
+//
+// ==============================================================
+
+#pragma once
+
+#include "TelemetryBusFormat.h"
+#include "MappedFile.h"
+
+// Publishes one sample per time step to the vessel's telemetry bus for external monitors. open() creates the shared
+// memory; publish() only stores to it, so it never blocks, allocates or makes a system call, whatever the readers do.
+class TelemetryBus {
+public:
+	TelemetryBus(void);
+	~TelemetryBus();
+	bool open(const char* vessel);
+	void close();
+	bool isOpen() const { return Memory.isOpen(); }
+	void publish(TelemetryBusSample const& sample);
+	uint64_t published() const { return Next; }
+private:
+	TelemetryBus(TelemetryBus const&);
+	TelemetryBus& operator=(TelemetryBus const&);
+	TelemetryBusHeader* header() const { return (TelemetryBusHeader*)Memory.data(); }
+	MappedFile Memory;        // Shared memory holding the bus
+	TelemetryBusSlot* Slots;  // Ring of samples
+	uint64_t Next;            // Number of the next sample
+};
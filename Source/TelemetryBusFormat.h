@@ -0,0 +1,88 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryBusFormat.h
+// Shared memory layout of the live telemetry bus
+//
+// ==============================================================
+
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+
+/* The telemetry bus is a ring of TBUS_SLOTS samples in named shared memory, written by one vessel and read by any
+   number of monitor processes. The writer never waits for readers: sample n goes to slot n % TBUS_SLOTS whether or
+   not it has been read. Each slot carries a sequence number that is odd while the slot is being written and
+   2 (n + 1) once it holds sample n, so a reader checks the sequence before and after copying a sample, and detects
+   both torn copies and samples that were overwritten before it got to them. */
+
+const char TBUS_MAGIC[8] = { 'S', 'V', 'Y', 'B', 'U', 'S', '\r', '\n' };
+const uint32_t TBUS_VERSION = 1;
+const uint32_t TBUS_SLOTS = 1024;  // Samples held by the ring, a power of two
+
+// Sample published every time step
+struct TelemetryBusSample {
+	double SimT;           // Simulation time [s]
+	double Altitude;       // Altitude above mean radius [m]
+	double RadarAltitude;  // Height above terrain [m]
+	double Velocity[3];    // Surface relative velocity, vessel frame [m/s]
+	double Speed;          // Surface relative speed [m/s]
+	double Vernier[3];     // Commanded vernier thrust levels
+	double Alpha;          // Commanded vernier 1 thrust vector angle [rad]
+	double Retro;          // Commanded retro thrust level
+	double PropVernier;    // Vernier propellant mass [kg]
+	double PropRetro;      // Retro propellant mass [kg]
+	double Mass;           // Total mass [kg]
+	int32_t Mode;          // Autopilot mode after the step (AutoPilotStatus)
+	int32_t Status;        // Staging status
+};
+
+// Samples are copied through 64-bit atomics, so a torn read is detected rather than undefined
+const uint32_t TBUS_SAMPLE_WORDS = sizeof(TelemetryBusSample) / sizeof(uint64_t);
+static_assert(sizeof(TelemetryBusSample) % sizeof(uint64_t) == 0, "Telemetry bus samples must be whole 64-bit words");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "The telemetry bus needs lock-free 64-bit atomics to work across processes");
+
+// Bus header, at offset 0. Version is stored last when the bus is created, so a reader that sees TBUS_VERSION also
+// sees the rest of the header.
+struct TelemetryBusHeader {
+	char Magic[8];                            // TBUS_MAGIC
+	std::atomic<uint32_t> Version;            // TBUS_VERSION, once the header is complete
+	uint32_t Slots;                           // Slots in the ring
+	uint32_t SlotBytes;                       // Size of one slot [bytes]
+	uint32_t SampleBytes;                     // Size of one sample [bytes]
+	char Vessel[64];                          // Name of the publishing vessel
+	alignas(64) std::atomic<uint64_t> Published; // Samples published since the bus was created
+	std::atomic<uint32_t> Live;               // 1 while the writer has the bus open
+};
+
+// Ring slot, on its own cache lines
+struct alignas(64) TelemetryBusSlot {
+	std::atomic<uint64_t> Sequence;                 // Odd while being written, 2 (n + 1) once it holds sample n
+	std::atomic<uint64_t> Words[TBUS_SAMPLE_WORDS]; // Sample, as raw 64-bit words
+};
+
+const size_t TBUS_BYTES = sizeof(TelemetryBusHeader) + TBUS_SLOTS * sizeof(TelemetryBusSlot);
+
+inline void TelemetryBusName(const char* vessel, char* name, size_t size)
+// Shared memory name of a vessel's bus, at most 64 bytes. Characters of the vessel name that are not allowed in
+// shared memory names are replaced with '_'.
+{
+#ifdef _WIN32
+	const char* prefix = "Local\\SurveyorBus.";
+#else
+	const char* prefix = "/SurveyorBus.";
+#endif
+	size_t n = 0, limit = size < 64 ? size : 64;
+	if (limit == 0) return;
+	for (const char* c = prefix; *c && n + 1 < limit; c++) name[n++] = *c;
+	for (const char* c = vessel; *c && n + 1 < limit; c++) {
+		bool allowed = isalnum((unsigned char)*c) || *c == '-' || *c == '_' || *c == '.';
+		name[n++] = allowed ? *c : '_';
+	}
+	name[n] = 0;
+}
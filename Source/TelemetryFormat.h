@@ -0,0 +1,105 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryFormat.h
+// Layout of the binary flight telemetry file
+//
+// ==============================================================
+
+#pragma once
+
+#include <cstdint>
+
+/* A telemetry file is a file header followed by fixed-size blocks. Each block holds up to
+   TLM_BLOCK_RECORDS time steps stored column by column, so one quantity can be scanned without
+   touching the others. Records are appended in simulation time order, which lets readers locate
+   a time by binary search over the block headers and then over the SimT column of one block. */
+
+// Recorded quantities, one column each. All values are stored as doubles.
+enum TelemetryColumn {
+	TLM_SIMT,             // Simulation time [s]
+	TLM_SIMDT,            // Length of the time step [s]
+	TLM_MODE,             // Autopilot mode after the step (AutoPilotStatus)
+	TLM_ALTITUDE,         // Altitude above mean radius [m]
+	TLM_ELEVATION,        // Terrain elevation below the vessel [m]
+	TLM_RADAR_ALTITUDE,   // Height above terrain [m]
+	TLM_VX,               // Surface relative velocity, vessel frame [m/s]
+	TLM_VY,
+	TLM_VZ,
+	TLM_WX,               // Angular velocity, vessel frame [rad/s]
+	TLM_WY,
+	TLM_WZ,
+	TLM_ANGULAR_RATE,     // Angular velocity magnitude [rad/s]
+	TLM_VERNIER_1,        // Commanded vernier thrust levels
+	TLM_VERNIER_2,
+	TLM_VERNIER_3,
+	TLM_ALPHA,            // Commanded vernier 1 thrust vector angle [rad]
+	TLM_RETRO,            // Commanded retro thrust level
+	TLM_PROP_VERNIER,     // Vernier propellant mass [kg]
+	TLM_PROP_RCS,         // RCS propellant mass [kg]
+	TLM_PROP_RETRO,       // Retro propellant mass [kg]
+	TLM_MASS,             // Total mass [kg]
+	TLM_PITCH,            // Manual attitude input: pitch up minus pitch down
+	TLM_YAW,              // Yaw right minus yaw left
+	TLM_ROLL,             // Bank right minus bank left
+	TLM_HORIZON_11,       // Vessel to local horizon frame rotation, by rows; zero when not sampled
+	TLM_HORIZON_12,
+	TLM_HORIZON_13,
+	TLM_HORIZON_21,
+	TLM_HORIZON_22,
+	TLM_HORIZON_23,
+	TLM_HORIZON_31,
+	TLM_HORIZON_32,
+	TLM_HORIZON_33,
+	TLM_RCS_1,            // Commanded RCS jet levels, under control allocation; 0 otherwise
+	TLM_RCS_2,
+	TLM_RCS_3,
+	TLM_RCS_4,
+	TLM_RCS_5,
+	TLM_RCS_6,
+	TLM_COLUMNS
+};
+
+// Column names, as used in CSV headers
+const char* const TelemetryColumnNames[TLM_COLUMNS] = {
+	"SimT", "SimDT", "Mode", "Altitude", "Elevation", "RadarAltitude",
+	"Vx", "Vy", "Vz", "Wx", "Wy", "Wz", "AngularRate",
+	"Vernier1", "Vernier2", "Vernier3", "Alpha", "Retro",
+	"PropVernier", "PropRCS", "PropRetro", "Mass",
+	"Pitch", "Yaw", "Roll",
+	"Horizon11", "Horizon12", "Horizon13", "Horizon21", "Horizon22", "Horizon23", "Horizon31", "Horizon32", "Horizon33",
+	"RCS1", "RCS2", "RCS3", "RCS4", "RCS5", "RCS6"
+};
+
+const char TLM_MAGIC[8] = { 'S', 'V', 'Y', 'T', 'L', 'M', '\r', '\n' };
+const uint32_t TLM_VERSION = 2;        // 2 adds the attitude input, horizon frame and RCS columns
+const uint32_t TLM_BLOCK_RECORDS = 1024;  // Time steps per block
+const uint32_t TLM_NAME_LENGTH = 16;      // Bytes per column name in the file header
+
+// File header, at offset 0. Blocks and Records are updated every time a block is written,
+// so a file cut short by a crash is readable up to the last complete block.
+struct TelemetryFileHeader {
+	char Magic[8];                                   // TLM_MAGIC
+	uint32_t Version;                                // TLM_VERSION
+	uint32_t Columns;                                // Number of columns
+	uint32_t BlockRecords;                           // Records per block
+	uint32_t BlockBytes;                             // Size of one block [bytes]
+	uint64_t Blocks;                                 // Number of blocks written
+	uint64_t Records;                                // Number of records written
+	char Vessel[64];                                 // Name of the recorded vessel
+	char ColumnNames[TLM_COLUMNS][TLM_NAME_LENGTH];  // Column names
+};
+
+// Block header, followed by TLM_COLUMNS arrays of BlockRecords doubles
+struct TelemetryBlockHeader {
+	uint32_t Count;   // Records in this block
+	uint32_t Reserved;
+	double FirstT;    // SimT of the first record
+	double LastT;     // SimT of the last record
+	double Pad;       // Keeps the columns 32-byte aligned
+};
+
+const uint32_t TLM_HEADER_BYTES = 4096;  // Space reserved for the file header
+const uint32_t TLM_BLOCK_BYTES = sizeof(TelemetryBlockHeader) + TLM_COLUMNS * TLM_BLOCK_RECORDS * sizeof(double);
@@ -0,0 +1,127 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryRecorder.cpp
+// Binary flight telemetry recorder
+//
+// ==============================================================
+
+#include "TelemetryRecorder.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static void makeParentDirectories(const char* path)
+// Create the directories leading to path that do not exist yet
+{
+	char dir[512];
+	size_t n = strlen(path);
+	if (n >= sizeof(dir)) return;
+	for (size_t i = 1; i < n; i++) {
+		if (path[i] != '/' && path[i] != '\\') continue;
+		memcpy(dir, path, i);
+		dir[i] = 0;
+#ifdef _WIN32
+		_mkdir(dir);
+#else
+		mkdir(dir, 0755);
+#endif
+	}
+}
+
+TelemetryRecorder::TelemetryRecorder(void)
+// Telemetry recorder constructor
+{
+	Count = 0;
+	FirstT = 0;
+	Block = 0;
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+// Telemetry recorder destructor. Writes the last partial block.
+{
+	close();
+}
+
+bool TelemetryRecorder::open(const char* path, const char* vessel)
+// Start a new telemetry file, replacing any file at path, and creating its directory if needed
+{
+	close();
+	makeParentDirectories(path);
+	if (!File.create(path, TLM_HEADER_BYTES + (size_t)TLM_GROW_BLOCKS * TLM_BLOCK_BYTES)) return false;
+
+	TelemetryFileHeader* h = header();
+	memset(h, 0, TLM_HEADER_BYTES);
+	memcpy(h->Magic, TLM_MAGIC, sizeof(h->Magic));
+	h->Version = TLM_VERSION;
+	h->Columns = TLM_COLUMNS;
+	h->BlockRecords = TLM_BLOCK_RECORDS;
+	h->BlockBytes = TLM_BLOCK_BYTES;
+	strncpy(h->Vessel, vessel, sizeof(h->Vessel) - 1);
+	for (int c = 0; c < TLM_COLUMNS; c++) strncpy(h->ColumnNames[c], TelemetryColumnNames[c], TLM_NAME_LENGTH - 1);
+
+	Block = new double[TLM_COLUMNS * TLM_BLOCK_RECORDS];
+	Count = 0;
+	return true;
+}
+
+void TelemetryRecorder::close()
+// Write the pending rows and close the file, trimmed to the blocks written
+{
+	if (!isOpen()) return;
+	if (Count > 0 && !writeBlock()) return;
+	File.close(TLM_HEADER_BYTES + (size_t)header()->Blocks * TLM_BLOCK_BYTES);
+	delete[] Block;
+	Block = 0;
+}
+
+void TelemetryRecorder::record(double const values[TLM_COLUMNS])
+// Append one row. Rows must arrive in SimT order.
+{
+	if (!isOpen()) return;
+	if (Count == 0) FirstT = values[TLM_SIMT];
+	for (int c = 0; c < TLM_COLUMNS; c++) Block[c * TLM_BLOCK_RECORDS + Count] = values[c];
+	if (++Count == TLM_BLOCK_RECORDS) writeBlock();
+}
+
+uint64_t TelemetryRecorder::records() const
+// Rows recorded so far, including those not yet written to the file
+{
+	return isOpen() ? header()->Records + Count : 0;
+}
+
+bool TelemetryRecorder::writeBlock()
+// Copy the current block into the file and update the file header
+{
+	uint64_t blocks = header()->Blocks;
+	size_t end = TLM_HEADER_BYTES + (size_t)(blocks + 1) * TLM_BLOCK_BYTES;
+	if (end > File.size() && !File.resize(File.size() + (size_t)TLM_GROW_BLOCKS * TLM_BLOCK_BYTES)) {
+		// Out of address space or disk: stop recording rather than fail the simulation, keeping the blocks written.
+		// The failed resize unmapped the header, so the block count read before it is used.
+		File.close(TLM_HEADER_BYTES + (size_t)blocks * TLM_BLOCK_BYTES);
+		delete[] Block;
+		Block = 0;
+		return false;
+	}
+
+	char* dst = File.data() + end - TLM_BLOCK_BYTES;
+	TelemetryBlockHeader bh;
+	memset(&bh, 0, sizeof(bh));
+	bh.Count = Count;
+	bh.FirstT = FirstT;
+	bh.LastT = Block[TLM_SIMT * TLM_BLOCK_RECORDS + Count - 1];
+	memcpy(dst, &bh, sizeof(bh));
+	memcpy(dst + sizeof(bh), Block, TLM_COLUMNS * TLM_BLOCK_RECORDS * sizeof(double));
+
+	TelemetryFileHeader* h = header();
+	h->Blocks = blocks + 1;
+	h->Records += Count;
+	Count = 0;
+	return true;
+}
@@ -0,0 +1,43 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TelemetryRecorder.h
+// Header file for the binary flight telemetry recorder
+//
+// ==============================================================
+
+#pragma once
+
+#include "TelemetryFormat.h"
+#include "MappedFile.h"
+
+// Blocks added to the file each time the mapping has to grow
+const uint32_t TLM_GROW_BLOCKS = 64;
+
+// Directory under the Orbiter folder that each Surveyor's flight is recorded to, if enabled
+const char* const TELEMETRY_DIRECTORY = "Telemetry/Surveyor";
+
+// Records one row of telemetry per time step. Rows are collected column by column in a block buffer
+// allocated by open(); each full block is copied into a memory-mapped file, so recording never
+// allocates and only touches the file system when the mapping grows.
+class TelemetryRecorder {
+public:
+	TelemetryRecorder(void);
+	~TelemetryRecorder();
+	bool open(const char* path, const char* vessel);
+	void close();
+	bool isOpen() const { return File.isOpen(); }
+	void record(double const values[TLM_COLUMNS]);
+	uint64_t records() const;
+private:
+	TelemetryRecorder(TelemetryRecorder const&);
+	TelemetryRecorder& operator=(TelemetryRecorder const&);
+	bool writeBlock();
+	TelemetryFileHeader* header() const { return (TelemetryFileHeader*)File.data(); }
+	MappedFile File;                                  // Output file
+	uint32_t Count;                                   // Rows in the current block
+	double FirstT;                                    // SimT of the first row in the current block
+	double* Block;                                    // Current block, TLM_BLOCK_RECORDS values per column
+};
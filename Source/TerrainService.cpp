@@ -0,0 +1,191 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TerrainService.cpp
+// Tiled terrain elevation cache with ground track prefetch
+//
+// ==============================================================
+
+#include "TerrainService.h"
+#include <climits>
+#include <cmath>
+
+// Grid intervals along each side of a tile
+const int TERRAIN_TILE_CELLS = TERRAIN_TILE_SAMPLES - 1;
+
+// Tracks waiting for the prefetch thread; further requests are dropped until it catches up
+const size_t TERRAIN_QUEUE_LENGTH = 64;
+
+// Tiles loaded by one prefetch() call for sources that cannot be read from the prefetch thread
+const int TERRAIN_INLINE_TILES = 1;
+
+double OrbiterTerrain::elevation(double lng, double lat) const
+{
+	return oapiSurfaceElevation(Body, lng, lat);
+}
+
+TerrainService::TerrainService(TerrainSource const& source, int level)
+	: Source(source), Level(level), Slots(2 * TERRAIN_CACHE_TILES), TileCount(0), Misses(0), Stop(false)
+{
+	Rows = 1 << Level;
+	Columns = 2 * Rows;
+	TileSize = PI / Rows;
+	Spacing = TileSize / TERRAIN_TILE_CELLS;
+	for (size_t i = 0; i < Slots.size(); i++) Slots[i].store(0, std::memory_order_relaxed);
+	if (Source.concurrent()) Worker = std::thread(&TerrainService::workerLoop, this);
+}
+
+TerrainService::~TerrainService()
+{
+	if (Worker.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(QueueLock);
+			Stop = true;
+		}
+		Wake.notify_one();
+		Worker.join();
+	}
+	for (size_t i = 0; i < Slots.size(); i++) delete Slots[i].load(std::memory_order_relaxed);
+}
+
+static size_t slotOf(uint64_t k, size_t slots)
+// Home slot of a key. The table size is a power of two.
+{
+	return (size_t)((k * 0x9E3779B97F4A7C15ull) >> 32) & (slots - 1);
+}
+
+TerrainService::Tile const* TerrainService::find(uint64_t k) const
+// Loaded tile with a key, or null
+{
+	size_t mask = Slots.size() - 1;
+	for (size_t i = slotOf(k, Slots.size());; i = (i + 1) & mask) {
+		Tile const* t = Slots[i].load(std::memory_order_acquire);
+		if (!t || t->Key == k) return t;
+	}
+}
+
+double TerrainService::elevation(double lng, double lat) const
+// Elevation at a longitude and latitude, bilinear between the grid samples around it [m]
+{
+	// Global grid coordinates, longitude wrapped onto [-PI, PI) and latitude clamped to the poles
+	double gx = (lng + PI) / Spacing;
+	double gy = (lat + 0.5 * PI) / Spacing;
+	double cols = (double)Columns * TERRAIN_TILE_CELLS, rows = (double)Rows * TERRAIN_TILE_CELLS;
+	gx -= cols * floor(gx / cols);
+	gy = fmin(fmax(gy, 0), rows);
+	int i = (int)fmin(floor(gx), cols - 1), j = (int)fmin(floor(gy), rows - 1);
+	double fx = gx - i, fy = gy - j;
+
+	// Tile holding the cell, and the cell's corner within it
+	int x = i / TERRAIN_TILE_CELLS, y = j / TERRAIN_TILE_CELLS;
+	int u = i - x * TERRAIN_TILE_CELLS, v = j - y * TERRAIN_TILE_CELLS;
+
+	float h00, h10, h01, h11;
+	Tile const* t = find(key(x, y));
+	if (t) {
+		float const* h = t->Height + v * TERRAIN_TILE_SAMPLES + u;
+		h00 = h[0];
+		h10 = h[1];
+		h01 = h[TERRAIN_TILE_SAMPLES];
+		h11 = h[TERRAIN_TILE_SAMPLES + 1];
+	}
+	else {
+		// Evaluate the corners exactly as load() would, so a miss returns what the tile will
+		Misses.fetch_add(1, std::memory_order_relaxed);
+		double lng0 = -PI + (x * TERRAIN_TILE_CELLS + u) * Spacing, lng1 = -PI + (x * TERRAIN_TILE_CELLS + u + 1) * Spacing;
+		double lat0 = -0.5 * PI + (y * TERRAIN_TILE_CELLS + v) * Spacing, lat1 = -0.5 * PI + (y * TERRAIN_TILE_CELLS + v + 1) * Spacing;
+		h00 = (float)Source.elevation(lng0, lat0);
+		h10 = (float)Source.elevation(lng1, lat0);
+		h01 = (float)Source.elevation(lng0, lat1);
+		h11 = (float)Source.elevation(lng1, lat1);
+	}
+	double h0 = h00 + (h10 - (double)h00) * fx;
+	double h1 = h01 + (h11 - (double)h01) * fx;
+	return h0 + (h1 - h0) * fy;
+}
+
+bool TerrainService::load(int x, int y)
+// Sample and publish a tile, unless it is loaded or the cache is full. Only one thread loads tiles. Returns true if
+// the tile was sampled.
+{
+	x = ((x % Columns) + Columns) % Columns;
+	if (y < 0 || y >= Rows) return false;
+	uint64_t k = key(x, y);
+	if (find(k) || TileCount.load(std::memory_order_relaxed) >= TERRAIN_CACHE_TILES) return false;
+
+	Tile* t = new Tile;
+	t->Key = k;
+	for (int v = 0; v < TERRAIN_TILE_SAMPLES; v++) {
+		double lat = -0.5 * PI + (y * TERRAIN_TILE_CELLS + v) * Spacing;
+		for (int u = 0; u < TERRAIN_TILE_SAMPLES; u++) {
+			double lng = -PI + (x * TERRAIN_TILE_CELLS + u) * Spacing;
+			t->Height[v * TERRAIN_TILE_SAMPLES + u] = (float)Source.elevation(lng, lat);
+		}
+	}
+
+	// The table never fills: it has twice as many slots as the cache has tiles
+	size_t mask = Slots.size() - 1;
+	size_t i = slotOf(k, Slots.size());
+	while (Slots[i].load(std::memory_order_relaxed)) i = (i + 1) & mask;
+	Slots[i].store(t, std::memory_order_release);
+	TileCount.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+void TerrainService::loadTrack(Track const& t, int budget)
+// Load the tiles around the vessel, then those under its ground track out to the prefetch horizon, nearest first,
+// until budget tiles have been sampled
+{
+	int x0 = (int)floor((t.Lng + PI) / TileSize), y0 = (int)floor((t.Lat + 0.5 * PI) / TileSize);
+	for (int dy = -1; dy <= 1; dy++) {
+		for (int dx = -1; dx <= 1; dx++) {
+			if (load(x0 + dx, y0 + dy) && --budget == 0) return;
+		}
+	}
+
+	// Step half a tile at a time along the track
+	double rate = fmax(fabs(t.LngRate) * cos(t.Lat), fabs(t.LatRate));
+	if (!(rate > 0)) return;
+	double step = 0.5 * TileSize / rate;
+	for (double s = step; s <= TERRAIN_PREFETCH_HORIZON; s += step) {
+		int x = (int)floor((t.Lng + t.LngRate * s + PI) / TileSize);
+		int y = (int)floor((t.Lat + t.LatRate * s + 0.5 * PI) / TileSize);
+		if (load(x, y) && --budget == 0) return;
+	}
+}
+
+bool TerrainService::prefetch(double lng, double lat, double lngRate, double latRate)
+// Request the tiles along a ground track. Never waits: returns false if the request was dropped.
+{
+	Track t = { lng, lat, lngRate, latRate };
+	if (!Worker.joinable()) {
+		// No prefetch thread: load a few tiles on the caller's thread
+		loadTrack(t, TERRAIN_INLINE_TILES);
+		return true;
+	}
+
+	std::unique_lock<std::mutex> lock(QueueLock, std::try_to_lock);
+	if (!lock.owns_lock() || Queue.size() >= TERRAIN_QUEUE_LENGTH) return false;
+	Queue.push_back(t);
+	lock.unlock();
+	Wake.notify_one();
+	return true;
+}
+
+void TerrainService::workerLoop()
+// Prefetch thread: load the tiles along each queued track
+{
+	std::vector<Track> tracks;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(QueueLock);
+			while (!Stop && Queue.empty()) Wake.wait(lock);
+			if (Stop) return;
+			tracks.swap(Queue);
+		}
+		for (size_t i = 0; i < tracks.size(); i++) loadTrack(tracks[i], INT_MAX);
+		tracks.clear();
+	}
+}
@@ -0,0 +1,106 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TerrainService.h
+// Header file for the cached terrain elevation service behind the
+// radar altitude
+//
+// ==============================================================
+
+#pragma once
+
+#include "orbitersdk.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Samples along each side of a tile; neighbouring tiles share their edge samples
+const int TERRAIN_TILE_SAMPLES = 65;
+
+// Default quadtree level of the cached tiles. At level L the globe is split into 2^(L+1) by 2^L tiles of pi / 2^L
+// radians; level 11 gives 2.7 km tiles sampled every 42 m on the Moon.
+const int TERRAIN_DEFAULT_LEVEL = 11;
+
+// Tiles the cache can hold. Tiles are never evicted, so a descent's ground track must fit.
+const size_t TERRAIN_CACHE_TILES = 4096;
+
+// Ground track prediction
+const double TERRAIN_PREFETCH_HORIZON = 60;  // Track length prefetched ahead of the vessel [s]
+const double TERRAIN_PREFETCH_INTERVAL = 1;  // Time between prefetch requests from one vessel [s]
+
+// Elevation model behind the service
+class TerrainSource {
+public:
+	virtual ~TerrainSource() {}
+	// Elevation above the mean radius at a longitude and latitude [m]
+	virtual double elevation(double lng, double lat) const = 0;
+	// True if elevation() may be called from the prefetch thread
+	virtual bool concurrent() const { return true; }
+};
+
+// Orbiter's own surface elevation for a body. Orbiter may only be called from its simulation thread, so the
+// service loads these tiles a few at a time in prefetch(), which must then only be called from that thread.
+class OrbiterTerrain : public TerrainSource {
+public:
+	explicit OrbiterTerrain(OBJHANDLE hBody) : Body(hBody) {}
+	double elevation(double lng, double lat) const;
+	bool concurrent() const { return false; }
+	OBJHANDLE body() const { return Body; }
+private:
+	OBJHANDLE Body; // Reference body
+};
+
+/* Tiled elevation cache in front of a terrain source. Tiles are grids of TERRAIN_TILE_SAMPLES x TERRAIN_TILE_SAMPLES
+   elevations at one quadtree level, found through a fixed-size hash table on their quadtree key. Lookups interpolate
+   bilinearly within a tile, and only read atomics: the prefetch thread is the only writer, and publishes a tile by
+   storing its pointer after filling it. Tiles are not modified or freed while the service exists.
+
+   Vessels call prefetch() with their position and ground track rates; the prefetch thread then loads the tiles along
+   the predicted track. A lookup in a tile that is not loaded yet evaluates the source at the four surrounding grid
+   points and interpolates between them, so it returns exactly what the tile would, and results do not depend on how
+   far the prefetch thread has got. */
+class TerrainService {
+public:
+	explicit TerrainService(TerrainSource const& source, int level = TERRAIN_DEFAULT_LEVEL);
+	~TerrainService();
+	double elevation(double lng, double lat) const;
+	bool prefetch(double lng, double lat, double lngRate, double latRate);
+	TerrainSource const& source() const { return Source; }
+	int level() const { return Level; }
+	size_t tiles() const { return TileCount.load(std::memory_order_relaxed); }
+	unsigned long long misses() const { return Misses.load(std::memory_order_relaxed); }
+private:
+	struct Tile {
+		uint64_t Key;                                              // Quadtree key
+		float Height[TERRAIN_TILE_SAMPLES * TERRAIN_TILE_SAMPLES]; // Elevations, longitude varying fastest [m]
+	};
+	struct Track {
+		double Lng, Lat;         // Position [rad]
+		double LngRate, LatRate; // Ground track rates [rad/s]
+	};
+	TerrainService(TerrainService const&);
+	TerrainService& operator=(TerrainService const&);
+	uint64_t key(int x, int y) const { return ((uint64_t)Level << 56) | ((uint64_t)y << 28) | (uint64_t)x; }
+	Tile const* find(uint64_t k) const;
+	bool load(int x, int y);
+	void loadTrack(Track const& t, int budget);
+	void workerLoop();
+	TerrainSource const& Source;                // Elevation model
+	int Level;                                  // Quadtree level of the tiles
+	int Columns, Rows;                          // Tiles around the equator and from pole to pole
+	double TileSize;                            // Tile width and height [rad]
+	double Spacing;                             // Sample spacing [rad]
+	std::vector<std::atomic<Tile*>> Slots;      // Open addressing hash table of loaded tiles
+	std::atomic<size_t> TileCount;              // Tiles loaded
+	mutable std::atomic<unsigned long long> Misses; // Lookups in tiles that were not loaded
+	std::mutex QueueLock;                       // Guards Queue and Stop
+	std::condition_variable Wake;               // Signalled when a track is queued or on stop
+	std::vector<Track> Queue;                   // Tracks waiting for the prefetch thread
+	bool Stop;                                  // Set on destruction
+	std::thread Worker;                         // Prefetch thread, for concurrent sources
+};
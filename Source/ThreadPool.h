@@ -0,0 +1,159 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// ThreadPool.h
+// Work-stealing thread pool for headless batch runs and the autopilot
+// manager. Each worker owns a task deque: it pops its own tasks from the
+// back and, when empty, steals from the front of the other workers' deques,
+// so long and short tasks balance across cores without a central queue
+// becoming a bottleneck.
+//
+// ==============================================================
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Thread pool class declaration
+class WorkStealingPool {
+public:
+	explicit WorkStealingPool(unsigned threads = 0);
+	~WorkStealingPool();
+	void submit(std::function<void()> task);
+	void wait();
+	template <class F> void parallelFor(size_t begin, size_t end, size_t grain, F fn);
+	unsigned size() const { return (unsigned)Workers.size(); }
+private:
+	struct Queue {
+		std::mutex Lock;
+		std::deque<std::function<void()>> Tasks;
+	};
+	bool tryPop(unsigned id, std::function<void()>& task);
+	void workerLoop(unsigned id);
+	static int& workerId();
+
+	std::vector<std::unique_ptr<Queue>> Queues; // One deque per worker
+	std::vector<std::thread> Workers;           // Worker threads
+	std::mutex WakeLock;                        // Guards sleeping and waiting
+	std::condition_variable Wake;               // Signalled when tasks are queued or on stop
+	std::condition_variable Done;               // Signalled when the pool runs dry
+	std::atomic<size_t> Queued;                 // Tasks sitting in deques
+	std::atomic<size_t> Pending;                // Tasks queued or running
+	std::atomic<unsigned> NextQueue;            // Round-robin target for external submits
+	bool Stop;                                  // Set on destruction
+};
+
+inline int& WorkStealingPool::workerId()
+// Index of the worker running on this thread, or -1 outside the pool
+{
+	static thread_local int id = -1;
+	return id;
+}
+
+inline WorkStealingPool::WorkStealingPool(unsigned threads)
+	: Queued(0), Pending(0), NextQueue(0), Stop(false)
+{
+	if (threads == 0) threads = std::max<unsigned>(1, std::thread::hardware_concurrency());
+	for (unsigned i = 0; i < threads; i++) Queues.emplace_back(new Queue);
+	for (unsigned i = 0; i < threads; i++) Workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+inline WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(WakeLock);
+		Stop = true;
+	}
+	Wake.notify_all();
+	for (std::thread& t : Workers) t.join();
+}
+
+inline void WorkStealingPool::submit(std::function<void()> task)
+// Queue a task. Tasks submitted from a worker go to its own deque, others are spread round-robin.
+{
+	int self = workerId();
+	unsigned target = self >= 0 ? (unsigned)self : NextQueue++ % Queues.size();
+	Pending++;
+	{
+		std::lock_guard<std::mutex> lock(Queues[target]->Lock);
+		Queues[target]->Tasks.push_back(std::move(task));
+	}
+	{
+		std::lock_guard<std::mutex> lock(WakeLock);
+		Queued++;
+	}
+	Wake.notify_one();
+}
+
+inline void WorkStealingPool::wait()
+// Block until every submitted task has finished
+{
+	std::unique_lock<std::mutex> lock(WakeLock);
+	Done.wait(lock, [this] { return Pending == 0; });
+}
+
+inline bool WorkStealingPool::tryPop(unsigned id, std::function<void()>& task)
+// Take the newest task from this worker's deque, otherwise steal the oldest from another
+{
+	size_t n = Queues.size();
+	for (size_t k = 0; k < n; k++) {
+		Queue& q = *Queues[(id + k) % n];
+		std::lock_guard<std::mutex> lock(q.Lock);
+		if (q.Tasks.empty()) continue;
+		if (k == 0) {
+			task = std::move(q.Tasks.back());
+			q.Tasks.pop_back();
+		}
+		else {
+			task = std::move(q.Tasks.front());
+			q.Tasks.pop_front();
+		}
+		Queued--;
+		return true;
+	}
+	return false;
+}
+
+inline void WorkStealingPool::workerLoop(unsigned id)
+{
+	workerId() = (int)id;
+	std::function<void()> task;
+	for (;;) {
+		if (tryPop(id, task)) {
+			task();
+			task = nullptr;
+			if (--Pending == 0) {
+				std::lock_guard<std::mutex> lock(WakeLock);
+				Done.notify_all();
+			}
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(WakeLock);
+		Wake.wait(lock, [this] { return Stop || Queued > 0; });
+		if (Stop && Queued == 0) return;
+	}
+}
+
+template <class F>
+void WorkStealingPool::parallelFor(size_t begin, size_t end, size_t grain, F fn)
+// Run fn(i) for every i in [begin, end), in chunks of grain indices, and wait for completion
+{
+	if (grain == 0) grain = 1;
+	for (size_t lo = begin; lo < end; lo += grain) {
+		size_t hi = std::min<size_t>(lo + grain, end);
+		submit([lo, hi, &fn] {
+			for (size_t i = lo; i < hi; i++) fn(i);
+		});
+	}
+	wait();
+}
@@ -0,0 +1,200 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TrajectoryPredictor.cpp
+// Background trajectory predictor
+//
+// ==============================================================
+
+#include "TrajectoryPredictor.h"
+#include "GuidanceTable.h"
+#include "Surveyor.h"
+#include <cmath>
+
+// Planar flight state over a spherical Moon
+struct PredictedState {
+	double T;           // Simulation time [s]
+	double R;           // Distance from the centre of the Moon [m]
+	double Vr, Vh;      // Vertical and horizontal surface relative velocity [m/s]
+	double PropRetro;   // Retro propellant mass [kg]
+	double PropVernier; // Vernier propellant mass [kg]
+};
+
+// Events along one flight of the plan
+struct PredictedFlight {
+	bool Impact;
+	double ImpactTime, ImpactSpeed, ImpactVernierProp;
+	bool Burnout;
+	double IgnitionTime, BurnoutTime, BurnoutAltitude, BurnoutVr, BurnoutVh;
+};
+
+static void accelerations(double r, double vr, double vh, double accel, double& ar, double& ah)
+// Gravity, the curvature terms of the polar frame and a thrust acceleration opposite the velocity
+{
+	double v = sqrt(vr * vr + vh * vh);
+	double ur = v > 0 ? vr / v : -1, uh = v > 0 ? vh / v : 0;
+	ar = -PREDICT_BODY_MU / (r * r) + vh * vh / r - accel * ur;
+	ah = -vr * vh / r - accel * uh;
+}
+
+static void integrate(PredictedState& s, double mass, double thrust, double flow, double h)
+// Advance the position and velocity over h seconds by fourth order Runge-Kutta, with constant thrust and a mass
+// falling at flow [kg/s]
+{
+	double a1r, a1h, a2r, a2h, a3r, a3h, a4r, a4h;
+	double m1 = mass, m2 = mass - 0.5 * h * flow, m4 = mass - h * flow;
+	accelerations(s.R, s.Vr, s.Vh, thrust / m1, a1r, a1h);
+	double r2 = s.R + 0.5 * h * s.Vr, vr2 = s.Vr + 0.5 * h * a1r, vh2 = s.Vh + 0.5 * h * a1h;
+	accelerations(r2, vr2, vh2, thrust / m2, a2r, a2h);
+	double r3 = s.R + 0.5 * h * vr2, vr3 = s.Vr + 0.5 * h * a2r, vh3 = s.Vh + 0.5 * h * a2h;
+	accelerations(r3, vr3, vh3, thrust / m2, a3r, a3h);
+	double r4 = s.R + h * vr3, vr4 = s.Vr + h * a3r, vh4 = s.Vh + h * a3h;
+	accelerations(r4, vr4, vh4, thrust / m4, a4r, a4h);
+	s.R += h / 6 * (s.Vr + 2 * vr2 + 2 * vr3 + vr4);
+	s.Vr += h / 6 * (a1r + 2 * a2r + 2 * a3r + a4r);
+	s.Vh += h / 6 * (a1h + 2 * a2h + 2 * a3h + a4h);
+	s.T += h;
+}
+
+static double vernierLevel(PredictionInput const& in, double altitude, double speed, double mass)
+// Steady state vernier level commanded by AutoPilot::finalDescent
+{
+	AutoPilotParams const& p = in.Params;
+	if (altitude > p.GuidanceAltitude) return 0;
+	if (in.Guidance) return in.Guidance->level(altitude <= p.TerminalAltitude ? GDT_TERMINAL : GDT_APPROACH, altitude, speed, mass);
+	double target = altitude <= p.TerminalAltitude ? p.TerminalSpeed : p.ApproachSpeed;
+	double F = mass * g - mass * (target * target - speed * speed) / altitude;
+	return fmin(fmax(F / (3 * VERNIER_THRUST), 0), 1);
+}
+
+static void fly(PredictionInput const& in, double retroStart, bool toBurnout, PredictedFlight& f)
+// Fly the autopilot's plan from the request, until the vessel reaches the surface or, if toBurnout is set, the
+// retro burns out. RETRO_DESCENT begins at retroStart if that is not negative, otherwise at RetroAltitude.
+{
+	AutoPilotParams const& p = in.Params;
+	double const ground = PREDICT_BODY_RADIUS + in.SurfaceElevation;
+	double const tol = 1e-9;
+	double const interval = p.GuidanceRate > 0 ? 1 / p.GuidanceRate : PREDICT_STEP;
+	PredictedState s = { in.SimT, in.Radius, in.VerticalSpeed, in.HorizontalSpeed, in.PropRetro, in.PropVernier };
+	int mode = in.Mode;
+	double timer = in.ModeTime;
+	bool lit = mode == RETRO_DESCENT && timer >= p.RetroIgnitionDelay - tol;
+
+	f.Impact = false;
+	f.Burnout = false;
+	f.IgnitionTime = lit ? in.SimT - (timer - p.RetroIgnitionDelay) : 0;
+	double end = in.SimT + PREDICT_HORIZON;
+	while (s.T < end) {
+		double altitude = s.R - ground;
+		double speed = sqrt(s.Vr * s.Vr + s.Vh * s.Vh);
+		double mass = Surveyor::CalcEmptyMass(s.PropRetro) + s.PropRetro + s.PropVernier + in.PropRCS;
+
+		// Thrust levels and mode switching, as in the autopilot's mode sequence at each guidance update. A new mode
+		// takes over at the next update.
+		double retro = 0, vernier = 0;
+		bool timed = false;
+		switch (mode) {
+		case IDLE:
+			if (timer >= p.IdleTime - tol) {
+				mode = HOLD_FOR_RETRO;
+				timer = 0;
+			}
+			else timed = true;
+			break;
+		case HOLD_FOR_RETRO:
+			if (retroStart >= 0 ? s.T >= retroStart - tol : altitude <= p.RetroAltitude) mode = RETRO_DESCENT;
+			break;
+		case RETRO_DESCENT:
+			if (timer >= p.RetroIgnitionDelay - tol && s.PropRetro > 0) {
+				if (!lit) f.IgnitionTime = s.T;
+				lit = true;
+				retro = 1;
+			}
+			if (timer >= p.RetroEndTime - tol) {
+				retro = 0;
+				mode = FINAL_DESCENT;
+				timer = 0;
+			}
+			else timed = true;
+			break;
+		case FINAL_DESCENT:
+			if (altitude <= p.ShutdownAltitude) mode = SHUTDOWN;
+			else if (s.PropVernier > 0) vernier = vernierLevel(in, altitude, speed, mass);
+			break;
+		}
+
+		// Step to the next guidance update, or to the end of the propellant
+		double h = interval;
+		double retroFlow = retro * RETRO_THRUST / RETRO_ISP, vernierFlow = vernier * 3 * VERNIER_THRUST / VERNIER_ISP;
+		bool retroOut = retroFlow > 0 && s.PropRetro <= retroFlow * h;
+		if (retroOut) h = s.PropRetro / retroFlow;
+		if (vernierFlow > 0 && s.PropVernier < vernierFlow * h) h = s.PropVernier / vernierFlow;
+		PredictedState last = s;
+		integrate(s, mass, retro * RETRO_THRUST + vernier * 3 * VERNIER_THRUST, retroFlow + vernierFlow, h);
+		s.PropRetro = retroOut ? 0 : s.PropRetro - retroFlow * h;
+		s.PropVernier = fmax(s.PropVernier - vernierFlow * h, 0);
+		if (timed) timer += h;
+
+		// Surface contact, between the two states
+		if (s.R <= ground) {
+			double u = (last.R - ground) / (last.R - s.R);
+			double vr = last.Vr + u * (s.Vr - last.Vr), vh = last.Vh + u * (s.Vh - last.Vh);
+			f.Impact = true;
+			f.ImpactTime = last.T + u * h;
+			f.ImpactSpeed = sqrt(vr * vr + vh * vh);
+			f.ImpactVernierProp = s.PropVernier;
+			return;
+		}
+		if (retroOut) {
+			f.Burnout = true;
+			f.BurnoutTime = s.T;
+			f.BurnoutAltitude = s.R - ground;
+			f.BurnoutVr = s.Vr;
+			f.BurnoutVh = s.Vh;
+			if (toBurnout) return;
+		}
+	}
+}
+
+void TrajectoryPredictor::predict(PredictionInput const& in, Prediction& out)
+// Fly the plan from a request, and search for the optimal ignition time if RETRO_DESCENT has not begun
+{
+	PredictedFlight f;
+	fly(in, -1, false, f);
+	out.SimT = in.SimT;
+	out.Impact = f.Impact;
+	out.ImpactTime = f.Impact ? f.ImpactTime : 0;
+	out.ImpactSpeed = f.Impact ? f.ImpactSpeed : 0;
+	out.ImpactVernierProp = f.Impact ? f.ImpactVernierProp : 0;
+	out.Burnout = f.Burnout;
+	out.IgnitionTime = f.Burnout ? f.IgnitionTime : 0;
+	out.BurnoutTime = f.Burnout ? f.BurnoutTime : 0;
+	out.BurnoutAltitude = f.Burnout ? f.BurnoutAltitude : 0;
+	out.BurnoutVerticalSpeed = f.Burnout ? f.BurnoutVr : 0;
+	out.BurnoutHorizontalSpeed = f.Burnout ? f.BurnoutVh : 0;
+	out.Optimal = false;
+	out.OptimalIgnitionTime = 0;
+	if (in.Mode != IDLE && in.Mode != HOLD_FOR_RETRO) return;
+
+	// The burnout altitude falls as RETRO_DESCENT begins later. Bisect on its start between now (or the end of
+	// IDLE) and the time a vessel that never fires would reach the surface; a burn that ends on the surface
+	// counts as below the target.
+	AutoPilotParams const& p = in.Params;
+	double lo = in.SimT + (in.Mode == IDLE ? fmax(p.IdleTime - in.ModeTime, 0) : 0);
+	double hi = lo;
+	fly(in, in.SimT + 2 * PREDICT_HORIZON, false, f);
+	if (f.Impact) hi = f.ImpactTime;
+	fly(in, lo, true, f);
+	if (f.Burnout && f.BurnoutAltitude > p.BurnoutAltitude) {
+		while (hi - lo > PREDICT_IGNITION_TOLERANCE) {
+			double mid = 0.5 * (lo + hi);
+			fly(in, mid, true, f);
+			if (f.Burnout && f.BurnoutAltitude > p.BurnoutAltitude) lo = mid;
+			else hi = mid;
+		}
+	}
+	out.Optimal = true;
+	out.OptimalIgnitionTime = lo + p.RetroIgnitionDelay;
+}
@@ -0,0 +1,78 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TrajectoryPredictor.h
+// Header file for the background trajectory predictor, which flies the
+// autopilot's retro and vernier plan ahead of the vessel
+//
+// ==============================================================
+
+#pragma once
+
+#include "AutoPilotParams.h"
+#include "RequestWorker.h"
+
+class GuidanceTable;
+
+// Central body
+const double PREDICT_BODY_RADIUS = 1737400;  // Mean radius of the Moon [m]
+const double PREDICT_BODY_MU = 6.67259e-11 * 7.349e22; // Gravitational parameter of the Moon [m^3/s^2]
+
+const double PREDICT_STEP = 0.1;             // Integration step when the autopilot runs once per frame [s]
+const double PREDICT_HORIZON = 3000;         // Longest prediction [s]
+const double PREDICT_INTERVAL = 0.5;         // Simulation time between prediction requests from one vessel [s]
+const double PREDICT_IGNITION_TOLERANCE = 0.05; // Accuracy of the optimal ignition time [s]
+const double PREDICT_POLL = 0.002;           // Time the predictor thread sleeps when no request is waiting [s]
+
+// State and plan a prediction starts from, sampled by the vessel on the simulation thread
+struct PredictionInput {
+	double SimT;                     // Simulation time [s]
+	double Radius;                   // Distance from the centre of the Moon [m]
+	double SurfaceElevation;         // Terrain elevation below the vessel, held for the whole prediction [m]
+	double VerticalSpeed;            // Surface relative velocity, up [m/s]
+	double HorizontalSpeed;          // Surface relative velocity, along the surface [m/s]
+	double PropVernier;              // Vernier propellant mass [kg]
+	double PropRCS;                  // RCS propellant mass [kg]
+	double PropRetro;                // Retro propellant mass [kg]
+	int Mode;                        // Autopilot mode (AutoPilotStatus)
+	double ModeTime;                 // Autopilot timer: time spent in IDLE or RETRO_DESCENT [s]
+	AutoPilotParams Params;          // Mode switching thresholds and final descent targets
+	GuidanceTable const* Guidance;   // Final descent guidance table the autopilot flies, or null
+};
+
+// Outcome of flying the autopilot's plan from a PredictionInput. Times are simulation times.
+struct Prediction {
+	double SimT;                     // Simulation time of the state the prediction started from [s]
+	bool Impact;                     // The vessel reaches the surface within PREDICT_HORIZON
+	double ImpactTime;               // Touchdown [s]
+	double ImpactSpeed;              // Surface relative speed at touchdown [m/s]
+	double ImpactVernierProp;        // Vernier propellant left at touchdown [kg]
+	bool Burnout;                    // The retro burn is still ahead, or under way
+	double IgnitionTime;             // Retro ignition under the fixed RetroAltitude rule [s]
+	double BurnoutTime;              // Retro burnout [s]
+	double BurnoutAltitude;          // Height above terrain at burnout [m]
+	double BurnoutVerticalSpeed;     // Surface relative velocity at burnout, up [m/s]
+	double BurnoutHorizontalSpeed;   // Surface relative velocity at burnout, along the surface [m/s]
+	bool Optimal;                    // OptimalIgnitionTime is set: the vessel has not entered RETRO_DESCENT
+	double OptimalIgnitionTime;      // Retro ignition that burns out at BurnoutAltitude above terrain [s]
+};
+
+// One vessel's requests and results
+typedef RequestChannel<PredictionInput, Prediction> PredictionChannel;
+
+/* Background trajectory predictor. Its thread repeatedly takes the latest request of every registered vessel and
+   flies the autopilot's plan from it: coast until RETRO_DESCENT begins at RetroAltitude, retro ignition after
+   RetroIgnitionDelay, full retro thrust to burnout, then final descent with the vernier guidance law until the
+   verniers shut down at ShutdownAltitude and the vessel reaches the surface. The model is planar, over a spherical
+   Moon with terrain at the height sampled with the request, with the thrust held opposite the surface relative
+   velocity as the autopilot holds it. It also searches for the ignition time that burns the retro out at
+   BurnoutAltitude. Each result is published to the vessel's channel; the autopilot reads it without waiting, and
+   nothing on the frame path propagates a trajectory. add() and remove() wait for the prediction in progress. */
+class TrajectoryPredictor : public RequestWorker<PredictionChannel> {
+public:
+	TrajectoryPredictor(void) : RequestWorker<PredictionChannel>(serve, PREDICT_POLL) {}
+	static bool serve(PredictionChannel& c) { return c.serve(predict); }
+	static void predict(PredictionInput const& in, Prediction& out);
+};
@@ -0,0 +1,62 @@
+// ==============================================================
+//                 ORBITER MODULE: Surveyor
+//             Copyright (C) 2022 Harish Saranathan
+//                Released under the MIT License
+//
+// TripleBuffer.h
+// Lock-free triple buffer for handing a stream of values from one
+// thread to another
+//
+// ==============================================================
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/* Latest value written by one thread, read by one other thread. The writer fills its back buffer and swaps it with
+   the middle one; the reader, if the middle buffer holds a value it has not taken, swaps it with its front buffer.
+   Each side owns one buffer outright and the middle changes hands in a single atomic exchange, so neither side ever
+   waits for the other and, unlike DoubleBuffer, a write is never dropped: a value is only lost when a newer one
+   replaces it before the reader looks. Every value carries the number of the write that produced it. */
+template<class T>
+class TripleBuffer {
+public:
+	TripleBuffer(void) : Middle(1), Back(2), Front(0), Writes(0)
+	{
+		Number[0] = Number[1] = Number[2] = 0;
+	}
+
+	void write(T const& value)
+	// Publish a value
+	{
+		Slot[Back] = value;
+		Number[Back] = ++Writes;
+		Back = Middle.exchange(Back | FRESH, std::memory_order_acq_rel) & INDEX;
+	}
+
+	uint64_t read(T& value) const
+	// Copy the latest value. Returns the number of the write that produced it, or 0 before the first write.
+	{
+		if (Middle.load(std::memory_order_relaxed) & FRESH) {
+			Front = Middle.exchange(Front, std::memory_order_acq_rel) & INDEX;
+		}
+		uint64_t number = Number[Front];
+		if (number) value = Slot[Front];
+		return number;
+	}
+
+	uint64_t writes() const { return Writes; } // Values published; writer only
+
+private:
+	TripleBuffer(TripleBuffer const&);
+	TripleBuffer& operator=(TripleBuffer const&);
+	static const int INDEX = 3;         // Buffer index bits of Middle
+	static const int FRESH = 4;         // Middle holds a value the reader has not taken
+	T Slot[3];                          // Front, middle and back values
+	uint64_t Number[3];                 // Write that produced each value, 0 for none
+	mutable std::atomic<int> Middle;    // Buffer between the sides, with FRESH
+	int Back;                           // Buffer being filled; writer only
+	mutable int Front;                  // Buffer being read; reader only
+	uint64_t Writes;                    // Values published; writer only
+};